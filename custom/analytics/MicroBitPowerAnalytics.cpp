@@ -0,0 +1,175 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "MicroBitPowerAnalytics.h"
+#include <string.h>
+
+// Rounded average of a sum of watts
+static int16_t average(int32_t sum, uint32_t n)
+{
+    return (n == 0) ? 0 : (int16_t)((sum + (int32_t)(n / 2)) / (int32_t)n);
+}
+
+MicroBitPowerAnalytics::MicroBitPowerAnalytics()
+{
+    this->ftp = MICROBIT_POWER_ANALYTICS_DEFAULT_FTP;
+    this->configStore = NULL;
+    this->reset();
+}
+
+void MicroBitPowerAnalytics::reset(void)
+{
+    memset(this->ring, 0, sizeof(this->ring));
+    this->head = 0;
+    this->sum3 = 0;
+    this->sum10 = 0;
+    this->sum30 = 0;
+    this->samples = 0;
+    this->sum4 = 0;
+    this->count4 = 0;
+    this->normalizedPower = 0;
+}
+
+void MicroBitPowerAnalytics::add(int16_t power)
+{
+    if (power < 0)
+    {
+        power = 0;
+    }
+
+    // The samples leaving each window; the ring starts with zeros.
+    const int size = sizeof(this->ring) / sizeof(this->ring[0]);
+    this->sum3 += power - this->ring[(this->head + size - 3) % size];
+    this->sum10 += power - this->ring[(this->head + size - 10) % size];
+    this->sum30 += power - this->ring[this->head];
+    this->ring[this->head] = power;
+    this->head = (this->head + 1) % size;
+    this->samples++;
+
+    if (this->samples >= 30)
+    {
+        uint64_t p = (uint64_t)this->getAverage30();
+        this->sum4 += p * p * p * p;
+        this->count4++;
+        this->normalizedPower = (uint16_t)isqrt(isqrt(this->sum4 / this->count4));
+    }
+}
+
+int16_t MicroBitPowerAnalytics::getAverage3(void)
+{
+    return average(this->sum3, (this->samples < 3) ? this->samples : 3);
+}
+
+int16_t MicroBitPowerAnalytics::getAverage10(void)
+{
+    return average(this->sum10, (this->samples < 10) ? this->samples : 10);
+}
+
+int16_t MicroBitPowerAnalytics::getAverage30(void)
+{
+    return average(this->sum30, (this->samples < 30) ? this->samples : 30);
+}
+
+uint16_t MicroBitPowerAnalytics::getNormalizedPower(void)
+{
+    return this->normalizedPower;
+}
+
+uint16_t MicroBitPowerAnalytics::getIntensityFactor1000(void)
+{
+    return (uint16_t)(((uint32_t)this->normalizedPower * 1000 + this->ftp / 2) / this->ftp);
+}
+
+uint16_t MicroBitPowerAnalytics::getTrainingStressScore10(void)
+{
+    // seconds x NP^2 / FTP^2 / 3600 x 100, x 10
+    uint64_t np2 = (uint64_t)this->normalizedPower * this->normalizedPower;
+    uint64_t ftp2 = (uint64_t)this->ftp * this->ftp;
+    uint64_t tss10 = ((uint64_t)this->samples * np2 * 10 + ftp2 * 18) / (ftp2 * 36);
+    return (tss10 > 0xFFFF) ? 0xFFFF : (uint16_t)tss10;
+}
+
+uint32_t MicroBitPowerAnalytics::getSamples(void)
+{
+    return this->samples;
+}
+
+uint16_t MicroBitPowerAnalytics::getFtp(void)
+{
+    return this->ftp;
+}
+
+void MicroBitPowerAnalytics::setFtp(uint16_t ftp)
+{
+    if (ftp < MIN_FTP)
+    {
+        ftp = MIN_FTP;
+    }
+    else if (ftp > MAX_FTP)
+    {
+        ftp = MAX_FTP;
+    }
+    this->ftp = ftp;
+    if (this->configStore)
+    {
+        this->configStore->set(MICROBIT_CONFIG_KEY_FTP, &this->ftp, sizeof(this->ftp));
+    }
+}
+
+void MicroBitPowerAnalytics::setConfigStore(MicroBitConfigStore *configStore)
+{
+    // Not saved while restoring
+    this->configStore = NULL;
+    uint16_t ftp;
+    if (configStore && configStore->get(MICROBIT_CONFIG_KEY_FTP, &ftp, sizeof(ftp)))
+    {
+        this->setFtp(ftp);
+    }
+    this->configStore = configStore;
+}
+
+uint32_t MicroBitPowerAnalytics::isqrt(uint64_t value)
+{
+    // one result bit per step, no division (Cortex-M0)
+    uint64_t result = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+    while (bit > value)
+    {
+        bit >>= 2;
+    }
+    while (bit != 0)
+    {
+        if (value >= result + bit)
+        {
+            value -= result + bit;
+            result = (result >> 1) + bit;
+        }
+        else
+        {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)result;
+}
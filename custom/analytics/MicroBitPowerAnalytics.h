@@ -0,0 +1,117 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MICROBIT_POWER_ANALYTICS_H
+#define MICROBIT_POWER_ANALYTICS_H
+
+#include <stdint.h>
+#include "MicroBitCustom.h"
+#include "MicroBitConfigStore.h"
+
+#define MIN_FTP 50
+#define MAX_FTP 1000
+
+/**
+  * Rolling power averages and training load of a session, from the power samples of the sensor (1 Hz).
+  * The 3 s, 10 s and 30 s averages are running sums over one ring of the last 30 samples: O(1) per sample.
+  * Normalized Power is the fourth root of the mean of the fourth powers of the 30 s average;
+  * Intensity Factor and TSS follow from NP and the FTP of the rider.
+  * Integer arithmetic only. No dependency on the micro:bit runtime, so the host test (tools/analytics_test) shares it.
+  */
+class MicroBitPowerAnalytics
+{
+
+public:
+    /**
+      * Constructor.
+      */
+    MicroBitPowerAnalytics();
+
+    /**
+      * Add a power sample (watt), one per second (the update period of the sensor). Negative power counts as 0.
+      */
+    void add(int16_t power);
+
+    /**
+      * Start a new session.
+      */
+    void reset(void);
+
+    /**
+      * Average power over the last 3, 10 and 30 samples (watt); fewer at the start of a session.
+      */
+    int16_t getAverage3(void);
+    int16_t getAverage10(void);
+    int16_t getAverage30(void);
+
+    /**
+      * Normalized Power (watt), 0 for the first 30 samples.
+      */
+    uint16_t getNormalizedPower(void);
+
+    /**
+      * Intensity Factor (NP / FTP) x 1000.
+      */
+    uint16_t getIntensityFactor1000(void);
+
+    /**
+      * Training Stress Score x 10 (seconds x NP x IF / (FTP x 3600) x 100).
+      */
+    uint16_t getTrainingStressScore10(void);
+
+    /**
+      * Samples in the session.
+      */
+    uint32_t getSamples(void);
+
+    // Functional Threshold Power (watt, 50 ~ 1000)
+    uint16_t getFtp(void);
+    void setFtp(uint16_t ftp);
+
+    // Restore the FTP from flash and save its changes (NULL: not saved)
+    void setConfigStore(MicroBitConfigStore *configStore);
+
+    // floor(sqrt(value))
+    static uint32_t isqrt(uint64_t value);
+
+private:
+    // last 30 samples, and the running sums of the last 3, 10 and 30
+    int16_t ring[30];
+    uint8_t head;
+    int32_t sum3;
+    int32_t sum10;
+    int32_t sum30;
+    uint32_t samples;
+
+    // sum of the fourth powers of the 30 s average, and its count
+    uint64_t sum4;
+    uint32_t count4;
+    uint16_t normalizedPower;
+
+    uint16_t ftp;
+    MicroBitConfigStore *configStore;
+
+};
+
+#endif /* #ifndef MICROBIT_POWER_ANALYTICS_H */
@@ -0,0 +1,122 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "MicroBitPowerPeaks.h"
+#include <string.h>
+
+// Buckets and seconds per bucket of each duration (5 s, 1 min, 5 min, 20 min)
+static const uint8_t bucketCounts[MICROBIT_POWER_PEAKS_COUNT] = { 5, 60, 60, 60 };
+static const uint8_t bucketSeconds[MICROBIT_POWER_PEAKS_COUNT] = { 1, 1, 5, 20 };
+
+MicroBitPowerPeaks::MicroBitPowerPeaks()
+{
+    uint16_t *p = this->storage;
+    for (int i = 0; i < MICROBIT_POWER_PEAKS_COUNT; i++)
+    {
+        this->windows[i].buckets = p;
+        this->windows[i].size = bucketCounts[i];
+        this->windows[i].bucketSeconds = bucketSeconds[i];
+        p += bucketCounts[i];
+    }
+    this->reset();
+}
+
+void MicroBitPowerPeaks::reset(void)
+{
+    memset(this->storage, 0, sizeof(this->storage));
+    for (int i = 0; i < MICROBIT_POWER_PEAKS_COUNT; i++)
+    {
+        Window &w = this->windows[i];
+        w.head = 0;
+        w.filled = 0;
+        w.partialCount = 0;
+        w.partial = 0;
+        w.sum = 0;
+        w.best = 0;
+    }
+}
+
+bool MicroBitPowerPeaks::add(int16_t power)
+{
+    if (power < 0)
+    {
+        power = 0;
+    }
+    else if (power > MICROBIT_POWER_PEAKS_MAX_POWER)
+    {
+        power = MICROBIT_POWER_PEAKS_MAX_POWER;
+    }
+
+    bool improved = false;
+    for (int i = 0; i < MICROBIT_POWER_PEAKS_COUNT; i++)
+    {
+        Window &w = this->windows[i];
+        w.partial += power;
+        if (++w.partialCount < w.bucketSeconds)
+        {
+            continue;
+        }
+
+        // The bucket is complete: it replaces the oldest one.
+        w.sum += w.partial;
+        w.sum -= w.buckets[w.head];
+        w.buckets[w.head] = w.partial;
+        w.head = (w.head + 1) % w.size;
+        w.partial = 0;
+        w.partialCount = 0;
+        if (w.filled < w.size)
+        {
+            w.filled++;
+        }
+        if (w.filled == w.size)
+        {
+            uint32_t seconds = (uint32_t)w.size * w.bucketSeconds;
+            uint16_t average = (uint16_t)((w.sum + seconds / 2) / seconds);
+            if (average > w.best)
+            {
+                w.best = average;
+                improved = true;
+            }
+        }
+    }
+    return improved;
+}
+
+uint16_t MicroBitPowerPeaks::getBest(int duration)
+{
+    if (duration < 0 || duration >= MICROBIT_POWER_PEAKS_COUNT)
+    {
+        return 0;
+    }
+    return this->windows[duration].best;
+}
+
+uint16_t MicroBitPowerPeaks::getSeconds(int duration)
+{
+    if (duration < 0 || duration >= MICROBIT_POWER_PEAKS_COUNT)
+    {
+        return 0;
+    }
+    return (uint16_t)bucketCounts[duration] * bucketSeconds[duration];
+}
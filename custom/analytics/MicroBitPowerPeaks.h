@@ -0,0 +1,99 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MICROBIT_POWER_PEAKS_H
+#define MICROBIT_POWER_PEAKS_H
+
+#include <stdint.h>
+#include "MicroBitCustom.h"
+
+// Durations of the session bests
+#define MICROBIT_POWER_PEAKS_5S     0
+#define MICROBIT_POWER_PEAKS_1MIN   1
+#define MICROBIT_POWER_PEAKS_5MIN   2
+#define MICROBIT_POWER_PEAKS_20MIN  3
+#define MICROBIT_POWER_PEAKS_COUNT  4
+
+// Largest power counted (watt); 20 samples of it fit a bucket (uint16_t)
+#define MICROBIT_POWER_PEAKS_MAX_POWER 3000
+
+/**
+  * Session bests of the mean power over 5 s, 1 min, 5 min and 20 min (mean-maximal power),
+  * from the power samples of the sensor (1 Hz).
+  * Each duration is a running sum over a ring of buckets: O(1) per sample and fixed RAM (370 bytes of rings).
+  *  - 5 s and 1 min: buckets of 1 s, every window.
+  *  - 5 min: buckets of 5 s; 20 min: buckets of 20 s. Only the windows ending on a bucket boundary count,
+  *    so a best is never above the true one, and below it by at most the power of one bucket at its edges.
+  * No dependency on the micro:bit runtime, so the host test (tools/analytics_test) shares it.
+  */
+class MicroBitPowerPeaks
+{
+
+public:
+    /**
+      * Constructor.
+      */
+    MicroBitPowerPeaks();
+
+    /**
+      * Add a power sample (watt), one per second. Negative power counts as 0.
+      * @return true if a best improved.
+      */
+    bool add(int16_t power);
+
+    /**
+      * Start a new session.
+      */
+    void reset(void);
+
+    /**
+      * Best mean power of a duration (MICROBIT_POWER_PEAKS_5S ...) in the session (watt), 0 until the session is that long.
+      */
+    uint16_t getBest(int duration);
+
+    /**
+      * Length of a duration (seconds).
+      */
+    static uint16_t getSeconds(int duration);
+
+private:
+    struct Window
+    {
+        uint16_t *buckets;      // sums of the last buckets, oldest at head
+        uint8_t size;           // buckets in the window
+        uint8_t bucketSeconds;  // samples per bucket
+        uint8_t head;
+        uint8_t filled;         // buckets since the start of the session, up to size
+        uint8_t partialCount;   // samples in the bucket being summed
+        uint16_t partial;
+        uint32_t sum;           // of the buckets in the ring
+        uint16_t best;
+    };
+
+    uint16_t storage[5+60+60+60];
+    Window windows[MICROBIT_POWER_PEAKS_COUNT];
+
+};
+
+#endif /* #ifndef MICROBIT_POWER_PEAKS_H */
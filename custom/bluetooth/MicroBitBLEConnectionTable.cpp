@@ -0,0 +1,296 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "MicroBitBLEConnectionTable.h"
+
+MicroBitBLEConnectionTable::MicroBitBLEConnectionTable(MicroBit &_uBit)
+    : uBit(_uBit)
+{
+    this->characteristicCount = 0;
+    this->scanResponseServiceCount = 0;
+    for (int i=0; i<MICROBIT_BLE_CONNECTION_TABLE_SIZE; i++)
+    {
+        this->connections[i].inUse = false;
+    }
+
+    // Gap and GattServer events
+    uBit.ble->gap().onConnection(this, &MicroBitBLEConnectionTable::onConnection);
+    uBit.ble->gap().onDisconnection(this, &MicroBitBLEConnectionTable::onDisconnection);
+    uBit.ble->gattServer().onUpdatesEnabled(GattServer::EventCallback_t(this, &MicroBitBLEConnectionTable::onUpdatesEnabled));
+    uBit.ble->gattServer().onUpdatesDisabled(GattServer::EventCallback_t(this, &MicroBitBLEConnectionTable::onUpdatesDisabled));
+    uBit.ble->gattServer().onConfirmationReceived(GattServer::EventCallback_t(this, &MicroBitBLEConnectionTable::onConfirmationReceived));
+}
+
+int MicroBitBLEConnectionTable::addCharacteristic(GattCharacteristic *characteristic)
+{
+    if (this->characteristicCount >= MICROBIT_BLE_CONNECTION_TABLE_CHARACTERISTICS)
+    {
+        return MICROBIT_NO_RESOURCES;
+    }
+    this->characteristics[this->characteristicCount] = characteristic;
+    return this->characteristicCount++;
+}
+
+int MicroBitBLEConnectionTable::notify(int index, const uint8_t *data, uint16_t len)
+{
+    if (index < 0 || index >= this->characteristicCount)
+    {
+        return 0;
+    }
+    
+    GattAttribute::Handle_t valueHandle = this->characteristics[index]->getValueHandle();
+    uint32_t mask = 1UL << index;
+    int sent = 0;
+    for (int i=0; i<MICROBIT_BLE_CONNECTION_TABLE_SIZE; i++)
+    {
+        MicroBitBLEConnection *c = &this->connections[i];
+        if (c->inUse && (c->subscriptions & mask))
+        {
+            if (uBit.ble->gattServer().write(c->handle, valueHandle, data, len) == BLE_ERROR_NONE)
+            {
+                sent++;
+            }
+        }
+    }
+    return sent;
+}
+
+int MicroBitBLEConnectionTable::indicate(Gap::Handle_t handle, int index, const uint8_t *data, uint16_t len)
+{
+    MicroBitBLEConnection *c = this->find(handle);
+    if (c == NULL || index < 0 || index >= this->characteristicCount)
+    {
+        return MICROBIT_INVALID_PARAMETER;
+    }
+    if (this->isIndicationPending(handle))
+    {
+        // The stack holds one indication per connection until it is confirmed.
+        return MICROBIT_BUSY;
+    }
+    
+    GattAttribute::Handle_t valueHandle = this->characteristics[index]->getValueHandle();
+    if (uBit.ble->gattServer().write(c->handle, valueHandle, data, len) == BLE_ERROR_NONE)
+    {
+        if ((c->subscriptions & (1UL << index)) && (this->characteristics[index]->getProperties() & GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_INDICATE))
+        {
+            c->indicationHandle = valueHandle;
+            c->indicationTime = MicroBitCustomClock::currentTimeUs();
+        }
+    }
+    return MICROBIT_OK;
+}
+
+bool MicroBitBLEConnectionTable::isIndicationPending(Gap::Handle_t handle)
+{
+    MicroBitBLEConnection *c = this->find(handle);
+    if (c == NULL || c->indicationHandle == 0)
+    {
+        return false;
+    }
+    // The central did not confirm within the ATT transaction timeout; the stack drops the link.
+    if (MicroBitCustomClock::currentTimeUs() - c->indicationTime >= (uint64_t)MICROBIT_BLE_INDICATION_TIMEOUT_MS * 1000)
+    {
+        c->indicationHandle = 0;
+        return false;
+    }
+    return true;
+}
+
+int MicroBitBLEConnectionTable::subscribers(int index)
+{
+    uint32_t mask = 1UL << index;
+    int n = 0;
+    for (int i=0; i<MICROBIT_BLE_CONNECTION_TABLE_SIZE; i++)
+    {
+        if (this->connections[i].inUse && (this->connections[i].subscriptions & mask))
+        {
+            n++;
+        }
+    }
+    return n;
+}
+
+MicroBitBLEConnection *MicroBitBLEConnectionTable::find(Gap::Handle_t handle)
+{
+    for (int i=0; i<MICROBIT_BLE_CONNECTION_TABLE_SIZE; i++)
+    {
+        if (this->connections[i].inUse && this->connections[i].handle == handle)
+        {
+            return &this->connections[i];
+        }
+    }
+    return NULL;
+}
+
+MicroBitBLEConnection *MicroBitBLEConnectionTable::findControl(void)
+{
+    for (int i=0; i<MICROBIT_BLE_CONNECTION_TABLE_SIZE; i++)
+    {
+        if (this->connections[i].inUse && this->connections[i].controlGranted)
+        {
+            return &this->connections[i];
+        }
+    }
+    return NULL;
+}
+
+int MicroBitBLEConnectionTable::count(void)
+{
+    int n = 0;
+    for (int i=0; i<MICROBIT_BLE_CONNECTION_TABLE_SIZE; i++)
+    {
+        if (this->connections[i].inUse)
+        {
+            n++;
+        }
+    }
+    return n;
+}
+
+int MicroBitBLEConnectionTable::addScanResponseService(uint16_t uuid)
+{
+    if (this->scanResponseServiceCount >= MICROBIT_BLE_SCAN_RESPONSE_SERVICES)
+    {
+        return MICROBIT_NO_RESOURCES;
+    }
+    uint8_t *u = &this->scanResponseServices[2*this->scanResponseServiceCount++];
+    u[0] = (uint8_t)uuid;
+    u[1] = (uint8_t)(uuid >> 8);
+    // The list field grows with every service
+    uBit.ble->gap().accumulateScanResponse(GapAdvertisingData::COMPLETE_LIST_16BIT_SERVICE_IDS, u, 2);
+    return MICROBIT_OK;
+}
+
+void MicroBitBLEConnectionTable::accumulateScanResponse(void)
+{
+    if (this->scanResponseServiceCount > 0)
+    {
+        uBit.ble->gap().accumulateScanResponse(GapAdvertisingData::COMPLETE_LIST_16BIT_SERVICE_IDS
+            , this->scanResponseServices, 2*this->scanResponseServiceCount);
+    }
+}
+
+void MicroBitBLEConnectionTable::onConnection(const Gap::ConnectionCallbackParams_t *params)
+{
+    MicroBitBLEConnection *slot = NULL;
+    for (int i=0; i<MICROBIT_BLE_CONNECTION_TABLE_SIZE; i++)
+    {
+        MicroBitBLEConnection *c = &this->connections[i];
+        if (!c->inUse)
+        {
+            c->handle = params->handle;
+            c->inUse = true;
+            c->subscriptions = 0;
+            c->controlGranted = false;
+            c->indicationHandle = 0;
+            slot = c;
+            break;
+        }
+    }
+    if (slot == NULL)
+    {
+        // No slot: a central the table does not track would get no control point responses.
+        uBit.ble->gap().disconnect(params->handle, Gap::REMOTE_DEV_TERMINATION_DUE_TO_LOW_RESOURCES);
+        return;
+    }
+    
+    // CCCDs of a bonded central are restored on connection.
+    for (int i=0; i<this->characteristicCount; i++)
+    {
+        this->refreshSubscriptions(i);
+    }
+    
+    // Keep advertising while there is room for another central (ignored by single-link stacks).
+    if (this->count() < MICROBIT_BLE_CONNECTION_TABLE_SIZE)
+    {
+        uBit.ble->gap().startAdvertising();
+    }
+}
+
+void MicroBitBLEConnectionTable::onDisconnection(const Gap::DisconnectionCallbackParams_t *params)
+{
+    MicroBitBLEConnection *c = this->find(params->handle);
+    if (c != NULL)
+    {
+        // Releasing the slot also releases FTMS control held by the central.
+        c->inUse = false;
+    }
+}
+
+void MicroBitBLEConnectionTable::onUpdatesEnabled(GattAttribute::Handle_t handle)
+{
+    for (int i=0; i<this->characteristicCount; i++)
+    {
+        if (this->characteristics[i]->getValueHandle() == handle)
+        {
+            this->refreshSubscriptions(i);
+        }
+    }
+}
+
+void MicroBitBLEConnectionTable::onUpdatesDisabled(GattAttribute::Handle_t handle)
+{
+    this->onUpdatesEnabled(handle);
+}
+
+void MicroBitBLEConnectionTable::onConfirmationReceived(GattAttribute::Handle_t handle)
+{
+    // The event carries the value handle but not the connection handle: the oldest indication
+    // of that characteristic is the one confirmed. A wrong guess between two centrals is undone
+    // by the other confirmation, or by the timeout of isIndicationPending() if the link goes.
+    MicroBitBLEConnection *oldest = NULL;
+    for (int i=0; i<MICROBIT_BLE_CONNECTION_TABLE_SIZE; i++)
+    {
+        MicroBitBLEConnection *c = &this->connections[i];
+        if (c->inUse && c->indicationHandle == handle && (oldest == NULL || c->indicationTime < oldest->indicationTime))
+        {
+            oldest = c;
+        }
+    }
+    if (oldest != NULL)
+    {
+        oldest->indicationHandle = 0;
+    }
+}
+
+void MicroBitBLEConnectionTable::refreshSubscriptions(int index)
+{
+    uint32_t mask = 1UL << index;
+    for (int i=0; i<MICROBIT_BLE_CONNECTION_TABLE_SIZE; i++)
+    {
+        MicroBitBLEConnection *c = &this->connections[i];
+        if (c->inUse)
+        {
+            bool enabled = false;
+            uBit.ble->gattServer().areUpdatesEnabled(c->handle, *this->characteristics[index], &enabled);
+            if (enabled)
+            {
+                c->subscriptions |= mask;
+            }
+            else
+            {
+                c->subscriptions &= ~mask;
+            }
+        }
+    }
+}
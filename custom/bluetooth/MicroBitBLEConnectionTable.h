@@ -0,0 +1,147 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MICROBIT_BLE_CONNECTION_TABLE_H
+#define MICROBIT_BLE_CONNECTION_TABLE_H
+
+#include "MicroBit.h"
+#include "MicroBitCustom.h"
+#include "MicroBitCustomClock.h"
+
+/**
+  * Per-connection state of one BLE central.
+  */
+struct MicroBitBLEConnection
+{
+    // Connection handle given by the stack
+    Gap::Handle_t handle;
+    // true while the slot is used by a connection
+    bool inUse;
+    // CCCD subscriptions, one bit per characteristic added to the table
+    uint32_t subscriptions;
+    // FTMS - the central was granted control by Request Control (op code 0x00)
+    bool controlGranted;
+    // Value handle of the indication sent and not confirmed yet, 0 if none (one at a time per connection)
+    GattAttribute::Handle_t indicationHandle;
+    // Time the indication was sent (us)
+    uint64_t indicationTime;
+};
+
+/**
+  * Fixed-size table of the connected centrals.
+  * The services encode each notification once and hand it to notify(), which fans it out to every subscribed connection.
+  */
+class MicroBitBLEConnectionTable
+{
+
+public:
+    /**
+      * Constructor.
+      * @param _uBit The instance of a MicroBit runtime include a BLE device that we're running on.
+      */
+    MicroBitBLEConnectionTable(MicroBit &_uBit);
+
+    /**
+      * Add a notify or indicate characteristic to the subscription tracking.
+      * The characteristic must be added to the GattServer first and outlive the table.
+      * @return The index used with notify() and isSubscribed(), or MICROBIT_NO_RESOURCES.
+      */
+    int addCharacteristic(GattCharacteristic *characteristic);
+
+    /**
+      * Send a notification (or indication) to every connection subscribed to the characteristic.
+      * @return The number of connections the value was sent to.
+      */
+    int notify(int index, const uint8_t *data, uint16_t len);
+
+    /**
+      * Send an indication (or notification) to one connection.
+      * @return MICROBIT_OK, MICROBIT_BUSY while an indication waits for confirmation, or MICROBIT_INVALID_PARAMETER.
+      */
+    int indicate(Gap::Handle_t handle, int index, const uint8_t *data, uint16_t len);
+
+    /**
+      * true while an indication to the connection waits for confirmation.
+      * An indication not confirmed within MICROBIT_BLE_INDICATION_TIMEOUT_MS is given up.
+      */
+    bool isIndicationPending(Gap::Handle_t handle);
+
+    /**
+      * Number of connections subscribed to the characteristic.
+      */
+    int subscribers(int index);
+
+    /**
+      * Per-connection state for a connection handle, or NULL when not connected.
+      */
+    MicroBitBLEConnection *find(Gap::Handle_t handle);
+
+    /**
+      * Per-connection state holding FTMS control, or NULL.
+      */
+    MicroBitBLEConnection *findControl(void);
+
+    /**
+      * Number of connected centrals.
+      */
+    int count(void);
+
+    /**
+      * List a service in the scan response (the advertising payload is full with FTMS).
+      * @param uuid 16 bit UUID of the service.
+      * @return MICROBIT_OK, or MICROBIT_NO_RESOURCES.
+      */
+    int addScanResponseService(uint16_t uuid);
+
+    /**
+      * Put the listed services in the scan response again, after it was cleared to be rebuilt.
+      */
+    void accumulateScanResponse(void);
+
+private:
+    // Gap / GattServer callbacks
+    void onConnection(const Gap::ConnectionCallbackParams_t *params);
+    void onDisconnection(const Gap::DisconnectionCallbackParams_t *params);
+    void onUpdatesEnabled(GattAttribute::Handle_t handle);
+    void onUpdatesDisabled(GattAttribute::Handle_t handle);
+    void onConfirmationReceived(GattAttribute::Handle_t handle);
+
+    // Reload the subscription bit of a characteristic for every connection
+    void refreshSubscriptions(int index);
+
+private:
+    // instance
+    MicroBit &uBit;
+
+    MicroBitBLEConnection connections[MICROBIT_BLE_CONNECTION_TABLE_SIZE];
+    GattCharacteristic *characteristics[MICROBIT_BLE_CONNECTION_TABLE_CHARACTERISTICS];
+    int characteristicCount;
+
+    // 16 bit service UUIDs of the scan response, little endian
+    uint8_t scanResponseServices[2*MICROBIT_BLE_SCAN_RESPONSE_SERVICES];
+    int scanResponseServiceCount;
+
+};
+
+#endif /* #ifndef MICROBIT_BLE_CONNECTION_TABLE_H */
@@ -0,0 +1,120 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "MicroBitCyclingPowerService.h"
+#include "struct.h"
+
+MicroBitCyclingPowerService::MicroBitCyclingPowerService(MicroBit &_uBit, MicroBitIndoorBikeStepSensor &_indoorBike, MicroBitBLEConnectionTable &_connections, uint16_t id)
+    : uBit(_uBit), indoorBike(_indoorBike), connections(_connections)
+{
+    this->id = id;
+
+    // CPS - Service UUID (Scan Response, the advertising payload is full with FTMS)
+    connections.addScanResponseService(0x1818);
+
+    // Caractieristic
+    cyclingPowerMeasurementCharacteristic = new GattCharacteristic(
+        UUID(0x2A63)
+        , (uint8_t *)&cyclingPowerMeasurementCharacteristicBuffer, 0, cyclingPowerMeasurementCharacteristicBufferSize
+        , GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY
+    );
+    GattCharacteristic  cyclingPowerFeatureCharacteristic(
+        UUID(0x2A65)
+        , (uint8_t *)&cyclingPowerFeatureCharacteristicBuffer, 0, cyclingPowerFeatureCharacteristicBufferSize
+        , GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ
+    );
+    GattCharacteristic  sensorLocationCharacteristic(
+        UUID(0x2A5D)
+        , (uint8_t *)&sensorLocationCharacteristicBuffer, 0, sensorLocationCharacteristicBufferSize
+        , GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ
+    );
+    
+    // Set default security requirements
+    cyclingPowerMeasurementCharacteristic->requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+    cyclingPowerFeatureCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+    sensorLocationCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+
+    // Service
+    GattCharacteristic *characteristics[] = {
+        cyclingPowerMeasurementCharacteristic,
+        &cyclingPowerFeatureCharacteristic,
+        &sensorLocationCharacteristic,
+    };
+    GattService service(
+        UUID(0x1818), characteristics, sizeof(characteristics) / sizeof(GattCharacteristic *)
+    );
+    if (uBit.ble->addService(service) != BLE_ERROR_NONE)
+    {
+        // MICROBIT_SD_GATT_TABLE_SIZE (mbed_app.json) has no room for the service
+        uBit.panic(MICROBIT_BLE_PANIC_GATT_TABLE_FULL);
+    }
+    
+    // Characteristic Handle
+    cyclingPowerMeasurementCharacteristicHandle = cyclingPowerMeasurementCharacteristic->getValueHandle();
+    cyclingPowerFeatureCharacteristicHandle = cyclingPowerFeatureCharacteristic.getValueHandle();
+    sensorLocationCharacteristicHandle = sensorLocationCharacteristic.getValueHandle();
+    
+    // Subscription tracking per connection
+    cyclingPowerMeasurementIndex = connections.addCharacteristic(cyclingPowerMeasurementCharacteristic);
+    
+    // GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ
+    uint8_t cyclingPowerFeatureBuff[cyclingPowerFeatureCharacteristicBufferSize];
+    struct_pack(cyclingPowerFeatureBuff, "<I", CPP_FLAGS_CYCLING_POWER_FEATURE_FIELD);
+    uBit.ble->gattServer().write(cyclingPowerFeatureCharacteristicHandle
+        ,(uint8_t *)&cyclingPowerFeatureBuff, cyclingPowerFeatureCharacteristicBufferSize);
+    uint8_t sensorLocationBuff[sensorLocationCharacteristicBufferSize];
+    struct_pack(sensorLocationBuff, "<B", CPP_VAL_SENSOR_LOCATION_00_OTHER);
+    uBit.ble->gattServer().write(sensorLocationCharacteristicHandle
+        ,(uint8_t *)&sensorLocationBuff, sensorLocationCharacteristicBufferSize);
+    
+    // Microbit Event listen
+    if (EventModel::defaultEventBus)
+    {
+        EventModel::defaultEventBus->listen(this->indoorBike.getId(), MICROBIT_INDOOR_BIKE_STEP_SENSOR_EVT_DATA_UPDATE
+            , this, &MicroBitCyclingPowerService::indoorBikeUpdate, MESSAGE_BUS_LISTENER_IMMEDIATE);
+    }
+
+}
+
+void MicroBitCyclingPowerService::indoorBikeUpdate(MicroBitEvent e)
+{
+    // Nothing to report while the FTMS session is paused or stopped, as for the CSC Measurement.
+    if (this->indoorBike.isSessionPaused())
+    {
+        return;
+    }
+    // Encode once, then fan out to every subscribed connection.
+    if (this->connections.subscribers(this->cyclingPowerMeasurementIndex) > 0)
+    {
+        // Same snapshot as the Indoor Bike Data: power from update(), crank data latched with it.
+        uint8_t buff[cyclingPowerMeasurementCharacteristicBufferSize];
+        struct_pack(buff, "<HhHH",
+            CPP_FLAGS_CYCLING_POWER_MEASUREMENT_CHAR,
+            this->indoorBike.getPower(),
+            (uint16_t)this->indoorBike.getCrankRevolutions(),
+            this->indoorBike.getCrankEventTime1024()
+        );
+        this->connections.notify(this->cyclingPowerMeasurementIndex
+            , (uint8_t *)&buff, cyclingPowerMeasurementCharacteristicBufferSize);
+    }
+}
@@ -0,0 +1,115 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MICROBIT_CYCLING_POWER_SERVICE_H
+#define MICROBIT_CYCLING_POWER_SERVICE_H
+
+#include "MicroBit.h"
+#include "MicroBitCustom.h"
+#include "MicroBitIndoorBikeStepSensor.h"
+#include "MicroBitBLEConnectionTable.h"
+
+/*
+# Bit Definitions for the Cycling Power Measurement Characteristic
+#                                       000 (bits 13-15) Reserved for Future Use
+#                                          0 (bit 12) Offset Compensation Indicator
+#                                           0 (bit 11) Accumulated Energy Present
+#                                            0 (bit 10) Bottom Dead Spot Angle Present
+#                                             0 (bit  9) Top Dead Spot Angle Present
+#                                              0 (bit  8) Extreme Angles Present
+#                                               0 (bit  7) Extreme Torque Magnitudes Present
+#                                                0 (bit  6) Extreme Force Magnitudes Present
+#                                                 1 (bit  5)*Crank Revolution Data Present
+#                                                  0 (bit  4) Wheel Revolution Data Present
+#                                                   0 (bit  3) Accumulated Torque Source
+#                                                    0 (bit  2) Accumulated Torque Present
+#                                                     0 (bit  1) Pedal Power Balance Reference
+#                                                      0 (bit  0) Pedal Power Balance Present
+#                                       5432109876543210 */
+#define CPP_FLAGS_CYCLING_POWER_MEASUREMENT_CHAR 0b0000000000100000
+
+/*
+# Definition of the bits of the Cycling Power Feature field
+#                                      000000000000 (bits 20-31) Reserved for Future Use
+#                                                  0000000000000000 (bits 4-19) (not supported features)
+#                                                                  1 (bit  3)*Crank Revolution Data Supported
+#                                                                   0 (bit  2) Wheel Revolution Data Supported
+#                                                                    0 (bit  1) Accumulated Torque Supported
+#                                                                     0 (bit  0) Pedal Power Balance Supported
+#                                      10987654321098765432109876543210 */
+#define CPP_FLAGS_CYCLING_POWER_FEATURE_FIELD 0b00000000000000000000000000001000
+
+// # Sensor Location values
+// # 0x00 Other
+#define CPP_VAL_SENSOR_LOCATION_00_OTHER 0x00
+
+class MicroBitCyclingPowerService
+{
+
+public:
+    /**
+      * Constructor.
+      * Create a representation of the CPS.
+      * @param _uBit The instance of a MicroBit runtime include a BLE device that we're running on.
+      * @param _indoorBike An instance of MicroBitIndoorBikeStepSensor to use as our power and crank revolution source.
+      * @param _connections The table of connected centrals to fan the notifications out to.
+      */
+    MicroBitCyclingPowerService(MicroBit &_uBit, MicroBitIndoorBikeStepSensor &_indoorBike, MicroBitBLEConnectionTable &_connections, uint16_t id = MICROBIT_CYCLING_POWER_SERVICE_ID);
+
+private:
+    /**
+     * Indoor Bike update callback
+     */
+    void indoorBikeUpdate(MicroBitEvent e);
+
+private:
+    // instance
+    MicroBit &uBit;
+    MicroBitIndoorBikeStepSensor &indoorBike;
+    MicroBitBLEConnectionTable &connections;
+    
+    // Event Bus ID of this service
+    uint16_t id;
+    
+    // Characteristic buffer
+    static const uint16_t cyclingPowerMeasurementCharacteristicBufferSize = 2+2+2+2; // "<HhHH", CPS p.14, <Flags>, <Instantaneous Power>, <Cumulative Crank Revolutions>, <Last Crank Event Time>
+    uint8_t cyclingPowerMeasurementCharacteristicBuffer[cyclingPowerMeasurementCharacteristicBufferSize];
+    static const uint16_t cyclingPowerFeatureCharacteristicBufferSize = 4; // "<I", CPS p.18, <Cycling Power Feature>
+    uint8_t cyclingPowerFeatureCharacteristicBuffer[cyclingPowerFeatureCharacteristicBufferSize];
+    static const uint16_t sensorLocationCharacteristicBufferSize = 1; // "<B", CPS p.19, <Sensor Location>
+    uint8_t sensorLocationCharacteristicBuffer[sensorLocationCharacteristicBufferSize];
+    
+    // Handles to access each characteristic when they are held by Soft Device.
+    GattAttribute::Handle_t cyclingPowerMeasurementCharacteristicHandle;
+    GattAttribute::Handle_t cyclingPowerFeatureCharacteristicHandle;
+    GattAttribute::Handle_t sensorLocationCharacteristicHandle;
+    
+    // Notify characteristic, kept for the subscription tracking of the connection table.
+    GattCharacteristic *cyclingPowerMeasurementCharacteristic;
+    // Index of the characteristic in the connection table.
+    int cyclingPowerMeasurementIndex;
+
+};
+
+#endif /* #ifndef MICROBIT_CYCLING_POWER_SERVICE_H */
@@ -0,0 +1,107 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "MicroBitCyclingSpeedCadenceService.h"
+#include "struct.h"
+
+MicroBitCyclingSpeedCadenceService::MicroBitCyclingSpeedCadenceService(MicroBit &_uBit, MicroBitIndoorBikeStepSensor &_indoorBike, MicroBitBLEConnectionTable &_connections, uint16_t id)
+    : uBit(_uBit), indoorBike(_indoorBike), connections(_connections)
+{
+    this->id = id;
+
+    // CSCS - Service UUID (Scan Response, the advertising payload is full with FTMS)
+    connections.addScanResponseService(0x1816);
+
+    // Caractieristic
+    cscMeasurementCharacteristic = new GattCharacteristic(
+        UUID(0x2A5B)
+        , (uint8_t *)&cscMeasurementCharacteristicBuffer, 0, cscMeasurementCharacteristicBufferSize
+        , GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY
+    );
+    GattCharacteristic  cscFeatureCharacteristic(
+        UUID(0x2A5C)
+        , (uint8_t *)&cscFeatureCharacteristicBuffer, 0, cscFeatureCharacteristicBufferSize
+        , GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ
+    );
+    
+    // Set default security requirements
+    cscMeasurementCharacteristic->requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+    cscFeatureCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+
+    // Service
+    GattCharacteristic *characteristics[] = {
+        cscMeasurementCharacteristic,
+        &cscFeatureCharacteristic,
+    };
+    GattService service(
+        UUID(0x1816), characteristics, sizeof(characteristics) / sizeof(GattCharacteristic *)
+    );
+    if (uBit.ble->addService(service) != BLE_ERROR_NONE)
+    {
+        // MICROBIT_SD_GATT_TABLE_SIZE (mbed_app.json) has no room for the service
+        uBit.panic(MICROBIT_BLE_PANIC_GATT_TABLE_FULL);
+    }
+    
+    // Characteristic Handle
+    cscMeasurementCharacteristicHandle = cscMeasurementCharacteristic->getValueHandle();
+    cscFeatureCharacteristicHandle = cscFeatureCharacteristic.getValueHandle();
+    
+    // Subscription tracking per connection
+    cscMeasurementIndex = connections.addCharacteristic(cscMeasurementCharacteristic);
+    
+    // GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ
+    uint8_t cscFeatureBuff[cscFeatureCharacteristicBufferSize];
+    struct_pack(cscFeatureBuff, "<H", CSCP_FLAGS_CSC_FEATURE_FIELD);
+    uBit.ble->gattServer().write(cscFeatureCharacteristicHandle
+        ,(uint8_t *)&cscFeatureBuff, cscFeatureCharacteristicBufferSize);
+    
+    // Microbit Event listen
+    if (EventModel::defaultEventBus)
+    {
+        EventModel::defaultEventBus->listen(this->indoorBike.getId(), MICROBIT_INDOOR_BIKE_STEP_SENSOR_EVT_DATA_UPDATE
+            , this, &MicroBitCyclingSpeedCadenceService::indoorBikeUpdate, MESSAGE_BUS_LISTENER_IMMEDIATE);
+    }
+
+}
+
+void MicroBitCyclingSpeedCadenceService::indoorBikeUpdate(MicroBitEvent e)
+{
+    // Nothing to report while the FTMS session is paused or stopped; the sensor holds the cumulative values meanwhile.
+    if (this->indoorBike.isSessionPaused())
+    {
+        return;
+    }
+    // Encode once, then fan out to every subscribed connection.
+    if (this->connections.subscribers(this->cscMeasurementIndex) > 0)
+    {
+        // The cumulative values are kept by the sensor per STEP edge, so this is a plain copy.
+        uint8_t buff[cscMeasurementCharacteristicBufferSize];
+        struct_pack(buff, "<BHH",
+            CSCP_FLAGS_CSC_MEASUREMENT_CHAR,
+            (uint16_t)this->indoorBike.getCrankRevolutions(),
+            this->indoorBike.getCrankEventTime1024()
+        );
+        this->connections.notify(this->cscMeasurementIndex
+            , (uint8_t *)&buff, cscMeasurementCharacteristicBufferSize);
+    }
+}
@@ -0,0 +1,95 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MICROBIT_CYCLING_SPEED_CADENCE_SERVICE_H
+#define MICROBIT_CYCLING_SPEED_CADENCE_SERVICE_H
+
+#include "MicroBit.h"
+#include "MicroBitCustom.h"
+#include "MicroBitIndoorBikeStepSensor.h"
+#include "MicroBitBLEConnectionTable.h"
+
+/*
+# Bit Definitions for the CSC Measurement Characteristic
+#                                        000000 (bits 2-7) Reserved for Future Use
+#                                              1 (bit 1)*Crank Revolution Data Present
+#                                               0 (bit 0) Wheel Revolution Data Present
+#                                        76543210 */
+#define CSCP_FLAGS_CSC_MEASUREMENT_CHAR 0b00000010
+
+/*
+# Bit Definitions for the CSC Feature Characteristic
+#                                     0000000000000 (bits 3-15) Reserved for Future Use
+#                                                  0 (bit 2) Multiple Sensor Locations Supported
+#                                                   1 (bit 1)*Crank Revolution Data Supported
+#                                                    0 (bit 0) Wheel Revolution Data Supported
+#                                     5432109876543210 */
+#define CSCP_FLAGS_CSC_FEATURE_FIELD 0b0000000000000010
+
+class MicroBitCyclingSpeedCadenceService
+{
+
+public:
+    /**
+      * Constructor.
+      * Create a representation of the CSCS.
+      * @param _uBit The instance of a MicroBit runtime include a BLE device that we're running on.
+      * @param _indoorBike An instance of MicroBitIndoorBikeStepSensor to use as our crank revolution source.
+      * @param _connections The table of connected centrals to fan the notifications out to.
+      */
+    MicroBitCyclingSpeedCadenceService(MicroBit &_uBit, MicroBitIndoorBikeStepSensor &_indoorBike, MicroBitBLEConnectionTable &_connections, uint16_t id = MICROBIT_CYCLING_SPEED_CADENCE_SERVICE_ID);
+
+private:
+    /**
+     * Indoor Bike update callback
+     */
+    void indoorBikeUpdate(MicroBitEvent e);
+
+private:
+    // instance
+    MicroBit &uBit;
+    MicroBitIndoorBikeStepSensor &indoorBike;
+    MicroBitBLEConnectionTable &connections;
+    
+    // Event Bus ID of this service
+    uint16_t id;
+    
+    // Characteristic buffer
+    static const uint16_t cscMeasurementCharacteristicBufferSize = 1+2+2; // "<BHH", CSCS p.9, <Flags>, <Cumulative Crank Revolutions>, <Last Crank Event Time>
+    uint8_t cscMeasurementCharacteristicBuffer[cscMeasurementCharacteristicBufferSize];
+    static const uint16_t cscFeatureCharacteristicBufferSize = 2; // "<H", CSCS p.10, <CSC Feature>
+    uint8_t cscFeatureCharacteristicBuffer[cscFeatureCharacteristicBufferSize];
+    
+    // Handles to access each characteristic when they are held by Soft Device.
+    GattAttribute::Handle_t cscMeasurementCharacteristicHandle;
+    GattAttribute::Handle_t cscFeatureCharacteristicHandle;
+    
+    // Notify characteristic, kept for the subscription tracking of the connection table.
+    GattCharacteristic *cscMeasurementCharacteristic;
+    // Index of the characteristic in the connection table.
+    int cscMeasurementIndex;
+
+};
+
+#endif /* #ifndef MICROBIT_CYCLING_SPEED_CADENCE_SERVICE_H */
@@ -0,0 +1,248 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "MicroBitDiagnosticsService.h"
+#include "struct.h"
+#include <string.h>
+
+MicroBitDiagnosticsService::MicroBitDiagnosticsService(MicroBit &_uBit, MicroBitIndoorBikeStepSensor &_indoorBike, MicroBitPowerAnalytics &_powerAnalytics, MicroBitPowerPeaks &_powerPeaks, MicroBitStepHealth &_stepHealth, MicroBitBLEConnectionTable &_connections, uint16_t id)
+    : uBit(_uBit), indoorBike(_indoorBike), powerAnalytics(_powerAnalytics), powerPeaks(_powerPeaks), stepHealth(_stepHealth), connections(_connections)
+{
+    this->id = id;
+    this->controlOpCode = 0;
+    this->controlParameter = 0;
+    memset(this->publishedPeaks, 0xFF, sizeof(this->publishedPeaks));
+
+    // Caractieristic
+    GattCharacteristic controlPointCharacteristic(
+        UUID(MicroBitDiagnosticsServiceControlPointUUID)
+        , (uint8_t *)&controlPointCharacteristicBuffer, 0, controlPointCharacteristicBufferSize
+        , GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE
+    );
+    analyticsCharacteristic = new GattCharacteristic(
+        UUID(MicroBitDiagnosticsServiceAnalyticsUUID)
+        , (uint8_t *)&analyticsCharacteristicBuffer, 0, analyticsCharacteristicBufferSize
+        , GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ | GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY
+    );
+    peaksCharacteristic = new GattCharacteristic(
+        UUID(MicroBitDiagnosticsServicePeaksUUID)
+        , (uint8_t *)&peaksCharacteristicBuffer, 0, peaksCharacteristicBufferSize
+        , GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ | GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY
+    );
+
+    GattCharacteristic healthCharacteristic(
+        UUID(MicroBitDiagnosticsServiceHealthUUID)
+        , (uint8_t *)&healthCharacteristicBuffer, 0, healthCharacteristicBufferSize
+        , GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ
+    );
+
+    // Set default security requirements
+    controlPointCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+    analyticsCharacteristic->requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+    peaksCharacteristic->requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+    healthCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+
+    // Service
+    GattCharacteristic *characteristics[] = {
+        &controlPointCharacteristic,
+        analyticsCharacteristic,
+        peaksCharacteristic,
+        &healthCharacteristic,
+    };
+    GattService service(
+        UUID(MicroBitDiagnosticsServiceUUID), characteristics, sizeof(characteristics) / sizeof(GattCharacteristic *)
+    );
+    if (uBit.ble->addService(service) != BLE_ERROR_NONE)
+    {
+        // MICROBIT_SD_GATT_TABLE_SIZE (mbed_app.json) has no room for the service
+        uBit.panic(MICROBIT_BLE_PANIC_GATT_TABLE_FULL);
+    }
+
+    // Characteristic Handle
+    controlPointCharacteristicHandle = controlPointCharacteristic.getValueHandle();
+    analyticsCharacteristicHandle = analyticsCharacteristic->getValueHandle();
+    peaksCharacteristicHandle = peaksCharacteristic->getValueHandle();
+    healthCharacteristicHandle = healthCharacteristic.getValueHandle();
+
+    // Subscription tracking per connection
+    analyticsIndex = connections.addCharacteristic(analyticsCharacteristic);
+    peaksIndex = connections.addCharacteristic(peaksCharacteristic);
+
+    // GattServer events
+    uBit.ble->onDataWritten(this, &MicroBitDiagnosticsService::onDataWritten);
+
+    // Microbit Event listen
+    if (EventModel::defaultEventBus)
+    {
+        EventModel::defaultEventBus->listen(this->indoorBike.getId(), MICROBIT_INDOOR_BIKE_STEP_SENSOR_EVT_DATA_UPDATE
+            , this, &MicroBitDiagnosticsService::indoorBikeUpdate, MESSAGE_BUS_LISTENER_IMMEDIATE);
+        EventModel::defaultEventBus->listen(this->id, MICROBIT_DIAGNOSTICS_SERVICE_EVT_CONTROL
+            , this, &MicroBitDiagnosticsService::onControl);
+    }
+}
+
+void MicroBitDiagnosticsService::indoorBikeUpdate(MicroBitEvent e)
+{
+    // The analytics and peaks do not move while the FTMS session is paused or stopped
+    if (this->indoorBike.isSessionPaused())
+    {
+        return;
+    }
+    uint8_t buff[analyticsCharacteristicBufferSize];
+    struct_pack(buff, "<hhhHHHHI",
+        this->powerAnalytics.getAverage3(),
+        this->powerAnalytics.getAverage10(),
+        this->powerAnalytics.getAverage30(),
+        this->powerAnalytics.getNormalizedPower(),
+        this->powerAnalytics.getIntensityFactor1000(),
+        this->powerAnalytics.getTrainingStressScore10(),
+        this->powerAnalytics.getFtp(),
+        this->powerAnalytics.getSamples()
+    );
+    this->publish(this->analyticsIndex, this->analyticsCharacteristicHandle, buff, analyticsCharacteristicBufferSize);
+
+    uint16_t peaks[MICROBIT_POWER_PEAKS_COUNT];
+    for (int i = 0; i < MICROBIT_POWER_PEAKS_COUNT; i++)
+    {
+        peaks[i] = this->powerPeaks.getBest(i);
+    }
+    if (memcmp(peaks, this->publishedPeaks, sizeof(peaks)) != 0)
+    {
+        memcpy(this->publishedPeaks, peaks, sizeof(peaks));
+        uint8_t peaksBuff[peaksCharacteristicBufferSize];
+        struct_pack(peaksBuff, "<HHHH", peaks[0], peaks[1], peaks[2], peaks[3]);
+        this->publish(this->peaksIndex, this->peaksCharacteristicHandle, peaksBuff, peaksCharacteristicBufferSize);
+    }
+
+    // Longer than a notification: read only
+    uint8_t healthBuff[healthCharacteristicBufferSize];
+    int len = struct_pack(healthBuff, "<IHHHI",
+        this->stepHealth.getEdges(),
+        this->stepHealth.getBounces(),
+        this->stepHealth.getMissed(),
+        this->stepHealth.getStops(),
+        this->stepHealth.getTypicalInterval()
+    );
+    for (int i = 0; i < MICROBIT_STEP_HEALTH_BUCKETS; i++)
+    {
+        len += struct_pack(&healthBuff[len], "<H", this->stepHealth.getHistogram(i));
+    }
+    uBit.ble->gattServer().write(this->healthCharacteristicHandle, healthBuff, len, true);
+}
+
+void MicroBitDiagnosticsService::publish(int index, GattAttribute::Handle_t handle, const uint8_t *data, uint16_t len)
+{
+    if (this->connections.subscribers(index) > 0)
+    {
+        this->connections.notify(index, data, len);
+    }
+    else
+    {
+        uBit.ble->gattServer().write(handle, data, len, true);
+    }
+}
+
+void MicroBitDiagnosticsService::onDataWritten(const GattWriteCallbackParams *params)
+{
+    if (params->handle != controlPointCharacteristicHandle || params->len < 1)
+    {
+        return;
+    }
+
+    uint16_t parameter = 0;
+    switch (params->data[0])
+    {
+    case DIAGNOSTICS_OP_CODE_01_RESET_SESSION:
+        if (params->len != 1)
+        {
+            return;
+        }
+        break;
+
+    case DIAGNOSTICS_OP_CODE_02_SET_FTP:
+        if (params->len != 1+2)
+        {
+            return;
+        }
+        struct_unpack(&params->data[1], "<H", &parameter);
+        break;
+
+    case DIAGNOSTICS_OP_CODE_03_SET_PULSES:
+        if (params->len != 1+1)
+        {
+            return;
+        }
+        parameter = params->data[1];
+        break;
+
+    default:
+        return;
+    }
+    this->controlOpCode = params->data[0];
+    this->controlParameter = parameter;
+    MicroBitEvent(this->id, MICROBIT_DIAGNOSTICS_SERVICE_EVT_CONTROL);
+}
+
+void MicroBitDiagnosticsService::onControl(MicroBitEvent e)
+{
+    switch (this->controlOpCode)
+    {
+    case DIAGNOSTICS_OP_CODE_01_RESET_SESSION:
+        this->powerAnalytics.reset();
+        this->powerPeaks.reset();
+        this->stepHealth.reset();
+        break;
+
+    case DIAGNOSTICS_OP_CODE_02_SET_FTP:
+        this->powerAnalytics.setFtp(this->controlParameter);
+        break;
+
+    case DIAGNOSTICS_OP_CODE_03_SET_PULSES:
+        this->indoorBike.setPulsesPerRevolution((uint8_t)this->controlParameter);
+        break;
+
+    default:
+        break;
+    }
+}
+
+const uint8_t MicroBitDiagnosticsServiceUUID[] = {
+    0xa3,0xc8,0x01,0x01,0x5d,0x1e,0x4f,0x3c,0x9b,0x7a,0x2f,0x6c,0x1d,0x0e,0x8b,0x41
+};
+
+const uint8_t MicroBitDiagnosticsServiceControlPointUUID[] = {
+    0xa3,0xc8,0x01,0x02,0x5d,0x1e,0x4f,0x3c,0x9b,0x7a,0x2f,0x6c,0x1d,0x0e,0x8b,0x41
+};
+
+const uint8_t MicroBitDiagnosticsServiceAnalyticsUUID[] = {
+    0xa3,0xc8,0x01,0x03,0x5d,0x1e,0x4f,0x3c,0x9b,0x7a,0x2f,0x6c,0x1d,0x0e,0x8b,0x41
+};
+
+const uint8_t MicroBitDiagnosticsServicePeaksUUID[] = {
+    0xa3,0xc8,0x01,0x04,0x5d,0x1e,0x4f,0x3c,0x9b,0x7a,0x2f,0x6c,0x1d,0x0e,0x8b,0x41
+};
+
+const uint8_t MicroBitDiagnosticsServiceHealthUUID[] = {
+    0xa3,0xc8,0x01,0x05,0x5d,0x1e,0x4f,0x3c,0x9b,0x7a,0x2f,0x6c,0x1d,0x0e,0x8b,0x41
+};
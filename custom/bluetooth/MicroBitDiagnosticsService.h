@@ -0,0 +1,128 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MICROBIT_DIAGNOSTICS_SERVICE_H
+#define MICROBIT_DIAGNOSTICS_SERVICE_H
+
+#include "MicroBit.h"
+#include "MicroBitCustom.h"
+#include "MicroBitIndoorBikeStepSensor.h"
+#include "MicroBitBLEConnectionTable.h"
+#include "MicroBitPowerAnalytics.h"
+#include "MicroBitPowerPeaks.h"
+#include "MicroBitStepHealth.h"
+
+/**
+  * Control point op codes (write)
+  */
+// 0x01 Reset session  "<B"
+// 0x02 Set FTP        "<BH" FTP (watt)
+// 0x03 Set pulses     "<BB" STEP pulses per crank revolution (1 ~ 8)
+#define DIAGNOSTICS_OP_CODE_01_RESET_SESSION    0x01
+#define DIAGNOSTICS_OP_CODE_02_SET_FTP          0x02
+#define DIAGNOSTICS_OP_CODE_03_SET_PULSES       0x03
+
+// Custom UUIDs
+extern const uint8_t MicroBitDiagnosticsServiceUUID[];
+extern const uint8_t MicroBitDiagnosticsServiceControlPointUUID[];
+extern const uint8_t MicroBitDiagnosticsServiceAnalyticsUUID[];
+extern const uint8_t MicroBitDiagnosticsServicePeaksUUID[];
+extern const uint8_t MicroBitDiagnosticsServiceHealthUUID[];
+
+/**
+  * Values computed on the device for coaching screens and remote diagnosis, updated with every sample of the sensor.
+  */
+class MicroBitDiagnosticsService
+{
+
+public:
+    /**
+      * Constructor.
+      * @param _uBit The instance of a MicroBit runtime include a BLE device that we're running on.
+      * @param _indoorBike An instance of MicroBitIndoorBikeStepSensor, whose updates trigger the notifications.
+      * @param _powerAnalytics The rolling power averages and training load fed by the sensor.
+      * @param _powerPeaks The session bests of the mean power fed by the sensor.
+      * @param _stepHealth The STEP edge statistics of the sensor.
+      * @param _connections The table of connected centrals to fan the notifications out to.
+      */
+    MicroBitDiagnosticsService(MicroBit &_uBit, MicroBitIndoorBikeStepSensor &_indoorBike, MicroBitPowerAnalytics &_powerAnalytics, MicroBitPowerPeaks &_powerPeaks, MicroBitStepHealth &_stepHealth, MicroBitBLEConnectionTable &_connections, uint16_t id = MICROBIT_DIAGNOSTICS_SERVICE_ID);
+
+private:
+    /**
+     * Indoor Bike update callback
+     */
+    void indoorBikeUpdate(MicroBitEvent e);
+
+    // Control point write; the operation runs in a fiber (it may write the flash)
+    void onDataWritten(const GattWriteCallbackParams *params);
+    void onControl(MicroBitEvent e);
+
+    // Notify the subscribers, or update the value for reads
+    void publish(int index, GattAttribute::Handle_t handle, const uint8_t *data, uint16_t len);
+
+private:
+    // instance
+    MicroBit &uBit;
+    MicroBitIndoorBikeStepSensor &indoorBike;
+    MicroBitPowerAnalytics &powerAnalytics;
+    MicroBitPowerPeaks &powerPeaks;
+    MicroBitStepHealth &stepHealth;
+    MicroBitBLEConnectionTable &connections;
+
+    // Event Bus ID of this service
+    uint16_t id;
+
+    // Characteristic buffer
+    static const uint16_t controlPointCharacteristicBufferSize = 1+2; // "<BH", <Op Code>, <Parameter>
+    uint8_t controlPointCharacteristicBuffer[controlPointCharacteristicBufferSize];
+    static const uint16_t analyticsCharacteristicBufferSize = 2+2+2+2+2+2+2+4; // "<hhhHHHHI", <3 s>, <10 s>, <30 s Average Power>, <NP>, <IF x 1000>, <TSS x 10>, <FTP>, <Elapsed Time>
+    uint8_t analyticsCharacteristicBuffer[analyticsCharacteristicBufferSize];
+    static const uint16_t peaksCharacteristicBufferSize = 2+2+2+2; // "<HHHH", <Best 5 s>, <1 min>, <5 min>, <20 min Mean Power>
+    uint8_t peaksCharacteristicBuffer[peaksCharacteristicBufferSize];
+    static const uint16_t healthCharacteristicBufferSize = 4+2+2+2+4+MICROBIT_STEP_HEALTH_BUCKETS*2; // "<IHHHI16H", <Edges>, <Bounces>, <Missed Pulses>, <Stops>, <Typical Interval>, <Histogram> (read only, long read)
+    uint8_t healthCharacteristicBuffer[healthCharacteristicBufferSize];
+
+    // Handles to access each characteristic when they are held by Soft Device.
+    GattAttribute::Handle_t controlPointCharacteristicHandle;
+    GattAttribute::Handle_t analyticsCharacteristicHandle;
+    GattAttribute::Handle_t peaksCharacteristicHandle;
+    GattAttribute::Handle_t healthCharacteristicHandle;
+
+    // Notify characteristics, kept for the subscription tracking of the connection table.
+    GattCharacteristic *analyticsCharacteristic;
+    GattCharacteristic *peaksCharacteristic;
+    // Index of each characteristic in the connection table.
+    int analyticsIndex;
+    int peaksIndex;
+
+    // Bests last published; the peaks are only sent when one changes
+    uint16_t publishedPeaks[MICROBIT_POWER_PEAKS_COUNT];
+
+    // Control point write waiting for the fiber
+    uint8_t controlOpCode;
+    uint16_t controlParameter;
+
+};
+
+#endif /* #ifndef MICROBIT_DIAGNOSTICS_SERVICE_H */
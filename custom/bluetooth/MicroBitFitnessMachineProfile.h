@@ -0,0 +1,233 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MICROBIT_FITNESS_MACHINE_PROFILE_H
+#define MICROBIT_FITNESS_MACHINE_PROFILE_H
+
+#include "MicroBit.h"
+#include "MicroBitCustom.h"
+#include "MicroBitIndoorBikeStepSensor.h"
+#include "struct.h"
+
+/**
+  * Fitness machine published by MicroBitIndoorBikeStepService, chosen at compile time (MICROBIT_FTMS_MACHINE).
+  * Every profile reads the same step-interval pipeline of MicroBitIndoorBikeStepSensor; only the selected one
+  * is compiled, so an image carries one data encoder and its feature bits:
+  *  - DATA_UUID, DATA_SIZE: the data characteristic and its encoded length.
+  *  - FEATURES: Fitness Machine Features field. MACHINE_TYPE: Fitness Machine Type of the FTMS Service Data.
+  *  - update(): once per sensor update, before encode(); reset(): a new session.
+  *  - encode(): the data characteristic from the latest values of the sensor.
+  */
+#if MICROBIT_FTMS_MACHINE == MICROBIT_FTMS_MACHINE_INDOOR_BIKE
+
+/*
+# Bit Definitions for the Indoor Bike Data Characteristic
+#                                          000 (bits 13-15) Reserved for Future Use
+#                                             0 (bit 12) Remaining Time Present
+#                                              0 (bit 11) Elapsed Time Present
+#                                               0 (bit 10) Metabolic Equivalent Present
+#                                                0 (bit  9) Heart Rate Present
+#                                                 0 (bit  8) Expended Energy Present
+#                                                  0 (bit  7) Average Power Present
+#                                                   1 (bit  6)*Instantaneous Power Present
+#                                                    0 (bit  5) Resistance Level Present
+#                                                     0 (bit  4) Total Distance Present
+#                                                      0 (bit  3) Average Cadence present
+#                                                       1 (bit  2)*Instantaneous Cadence (uint16, 1/minute with a resolution of 0.5)
+#                                                        0 (bit  1) Average Speed present
+#                                                         0 (bit  0) More Data
+#                                          5432109876543210 */
+#define FTMP_FLAGS_INDOOR_BIKE_DATA_CHAR 0b0000000001000100
+
+class MicroBitIndoorBikeProfile
+{
+public:
+    static const uint16_t DATA_UUID = 0x2AD2;
+    static const uint16_t DATA_SIZE = 2+2+2+2; // "<HHHh", FTMS p.42, <Flags>, <Instantaneous Speed>, <Instantaneous Cadence>, <Instantaneous Power>
+    static const uint32_t FEATURES = 0b00000000000000000100000000000010; // Cadence, Power Measurement
+    static const uint16_t MACHINE_TYPE = 1<<5; // Indoor Bike
+    static const GapAdvertisingData::Appearance_t APPEARANCE = GapAdvertisingData::GENERIC_CYCLING;
+
+    void update(MicroBitIndoorBikeStepSensor &sensor) {}
+    void reset(void) {}
+    void encode(uint8_t *buff, MicroBitIndoorBikeStepSensor &sensor)
+    {
+        struct_pack(buff, "<HHHh",
+            FTMP_FLAGS_INDOOR_BIKE_DATA_CHAR,
+            sensor.getSpeed100(),
+            sensor.getCadence2(),
+            sensor.getPower()
+        );
+    }
+};
+
+typedef MicroBitIndoorBikeProfile MicroBitFitnessMachineProfile;
+
+#elif MICROBIT_FTMS_MACHINE == MICROBIT_FTMS_MACHINE_ROWER
+
+/*
+# Bit Definitions for the Rower Data Characteristic
+#                                 000 (bits 13-15) Reserved for Future Use
+#                                    0 (bit 12) Remaining Time Present
+#                                     0 (bit 11) Elapsed Time Present
+#                                      0 (bit 10) Metabolic Equivalent Present
+#                                       0 (bit  9) Heart Rate Present
+#                                        0 (bit  8) Expended Energy Present
+#                                         0 (bit  7) Resistance Level Present
+#                                          0 (bit  6) Average Power Present
+#                                           1 (bit  5)*Instantaneous Power Present
+#                                            0 (bit  4) Average Pace Present
+#                                             0 (bit  3) Instantaneous Pace Present
+#                                              0 (bit  2) Total Distance Present
+#                                               0 (bit  1) Average Stroke Rate Present
+#                                                0 (bit  0)*More Data - 0: Stroke Rate (uint8, 1/minute with a resolution of 0.5) and Stroke Count (uint16) present
+#                                 5432109876543210 */
+#define FTMP_FLAGS_ROWER_DATA_CHAR 0b0000000000100000
+
+/**
+  * A stroke is a revolution of the flywheel pulley, so the stroke rate is the cadence of the sensor.
+  * The stroke count is the session's: the revolutions of the updates that are not paused or stopped, cleared by reset().
+  */
+class MicroBitRowerProfile
+{
+public:
+    static const uint16_t DATA_UUID = 0x2AD1;
+    static const uint16_t DATA_SIZE = 2+1+2+2; // "<HBHh", FTMS p.37, <Flags>, <Stroke Rate>, <Stroke Count>, <Instantaneous Power>
+    static const uint32_t FEATURES = 0b00000000000000000100000000000010; // Cadence, Power Measurement
+    static const uint16_t MACHINE_TYPE = 1<<4; // Rower
+    static const GapAdvertisingData::Appearance_t APPEARANCE = GapAdvertisingData::UNKNOWN;
+
+    MicroBitRowerProfile() : strokeCount(0), crankRevolutions(0) {}
+
+    void update(MicroBitIndoorBikeStepSensor &sensor)
+    {
+        uint32_t revolutions = sensor.getCrankRevolutions();
+        if (!sensor.isSessionPaused())
+        {
+            this->strokeCount += revolutions - this->crankRevolutions;
+        }
+        this->crankRevolutions = revolutions;
+    }
+    void reset(void)
+    {
+        this->strokeCount = 0;
+    }
+    void encode(uint8_t *buff, MicroBitIndoorBikeStepSensor &sensor)
+    {
+        uint32_t strokeRate2 = sensor.getCadence2();
+        struct_pack(buff, "<HBHh",
+            FTMP_FLAGS_ROWER_DATA_CHAR,
+            (strokeRate2 > 0xFF) ? 0xFF : strokeRate2,
+            (uint16_t)this->strokeCount,
+            sensor.getPower()
+        );
+    }
+
+private:
+    uint32_t strokeCount;
+    // the sensor's lifetime count at the last update
+    uint32_t crankRevolutions;
+};
+
+typedef MicroBitRowerProfile MicroBitFitnessMachineProfile;
+
+#elif MICROBIT_FTMS_MACHINE == MICROBIT_FTMS_MACHINE_CROSS_TRAINER
+
+/*
+# Bit Definitions for the Cross Trainer Data Characteristic (UINT24)
+#                                         00000000 (bits 16-23) Reserved for Future Use
+#                                                 0 (bit 15) Movement Direction - 0: Forward
+#                                                  0 (bit 14) Remaining Time Present
+#                                                   0 (bit 13) Elapsed Time Present
+#                                                    0 (bit 12) Metabolic Equivalent Present
+#                                                     0 (bit 11) Heart Rate Present
+#                                                      0 (bit 10) Expended Energy Present
+#                                                       0 (bit  9) Average Power Present
+#                                                        1 (bit  8)*Instantaneous Power Present
+#                                                         0 (bit  7) Resistance Level Present
+#                                                          0 (bit  6) Inclination and Ramp Angle Setting Present
+#                                                           0 (bit  5) Elevation Gain Present
+#                                                            0 (bit  4) Stride Count Present
+#                                                             1 (bit  3)*Step Count Present - Step Per Minute (uint16), Average Step Rate (uint16)
+#                                                              0 (bit  2) Total Distance Present
+#                                                               0 (bit  1) Average Speed Present
+#                                                                0 (bit  0)*More Data - 0: Instantaneous Speed (uint16, km/h with a resolution of 0.01) present
+#                                         321098765432109876543210 */
+#define FTMP_FLAGS_CROSS_TRAINER_DATA_CHAR 0b000000000000000100001000
+
+/**
+  * A revolution of the crank is two steps (left and right), so the step rate is twice the cadence:
+  * the cadence of the sensor in 0.5 rpm is the step rate in 1 step/min.
+  * The average step rate is the session's, over the updates the power analytics count (not paused or stopped).
+  */
+class MicroBitCrossTrainerProfile
+{
+public:
+    static const uint16_t DATA_UUID = 0x2ACE;
+    static const uint16_t DATA_SIZE = 3+2+2+2+2; // "<HBHHHh", FTMS p.32, <Flags (UINT24)>, <Instantaneous Speed>, <Step Per Minute>, <Average Step Rate>, <Instantaneous Power>
+    static const uint32_t FEATURES = 0b00000000000000000100000001000000; // Step Count, Power Measurement
+    static const uint16_t MACHINE_TYPE = 1<<1; // Cross Trainer
+    static const GapAdvertisingData::Appearance_t APPEARANCE = GapAdvertisingData::UNKNOWN;
+
+    MicroBitCrossTrainerProfile() : stepRateSum(0), stepRateCount(0) {}
+
+    void update(MicroBitIndoorBikeStepSensor &sensor)
+    {
+        if (!sensor.isSessionPaused())
+        {
+            this->stepRateSum += sensor.getCadence2();
+            this->stepRateCount++;
+        }
+    }
+    void reset(void)
+    {
+        this->stepRateSum = 0;
+        this->stepRateCount = 0;
+    }
+    void encode(uint8_t *buff, MicroBitIndoorBikeStepSensor &sensor)
+    {
+        uint32_t stepRate = sensor.getCadence2();
+        uint32_t averageStepRate = this->stepRateCount ? (uint32_t)(this->stepRateSum / this->stepRateCount) : 0;
+        struct_pack(buff, "<HBHHHh",
+            FTMP_FLAGS_CROSS_TRAINER_DATA_CHAR & 0xFFFF,
+            FTMP_FLAGS_CROSS_TRAINER_DATA_CHAR >> 16,
+            sensor.getSpeed100(),
+            (stepRate > 0xFFFF) ? 0xFFFF : stepRate,
+            (averageStepRate > 0xFFFF) ? 0xFFFF : averageStepRate,
+            sensor.getPower()
+        );
+    }
+
+private:
+    uint64_t stepRateSum;
+    uint32_t stepRateCount;
+};
+
+typedef MicroBitCrossTrainerProfile MicroBitFitnessMachineProfile;
+
+#else
+#error "MICROBIT_FTMS_MACHINE: unknown fitness machine"
+#endif /* MICROBIT_FTMS_MACHINE */
+
+#endif /* #ifndef MICROBIT_FITNESS_MACHINE_PROFILE_H */
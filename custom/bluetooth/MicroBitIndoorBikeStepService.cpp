@@ -23,36 +23,29 @@ SOFTWARE.
 */
 #include "MicroBitIndoorBikeStepService.h"
 #include "struct.h"
-#include "inttypes.h" // for Debug
 
-MicroBitIndoorBikeStepService::MicroBitIndoorBikeStepService(MicroBit &_uBit, MicroBitIndoorBikeStepSensor &_indoorBike, uint16_t id)
-    : uBit(_uBit), indoorBike(_indoorBike)
+MicroBitIndoorBikeStepService::MicroBitIndoorBikeStepService(MicroBit &_uBit, MicroBitIndoorBikeStepSensor &_indoorBike, MicroBitBLEConnectionTable &_connections, uint16_t id)
+    : uBit(_uBit), indoorBike(_indoorBike), connections(_connections)
 {
     this->id = id;
     this->stopOrPause=0;
+    this->sessionState=INDOOR_BIKE_SESSION_IDLE;
+    this->telemetry=NULL;
+    this->broadcastMode=INDOOR_BIKE_BROADCAST_OFF;
+    this->resetTargets();
 
-    // BLE Appearance and LOCAL_NAME
-    uBit.ble->gap().accumulateAdvertisingPayload(GapAdvertisingData::GENERIC_CYCLING);
-    if (BLE_DEVICE_LOCAL_NAME_CHENGE)
-    {
-        uBit.ble->gap().accumulateAdvertisingPayload(GapAdvertisingData::COMPLETE_LOCAL_NAME
-            , (const uint8_t *)BLE_DEVICE_LOCAL_NAME, sizeof(BLE_DEVICE_LOCAL_NAME)-1);
-    }
-    
-    // FTMS - Service Advertising Data
-    const uint8_t FTMS_UUID[sizeof(UUID::ShortUUIDBytes_t)] = {0x26, 0x18};
-    uBit.ble->accumulateAdvertisingPayload(GapAdvertisingData::COMPLETE_LIST_16BIT_SERVICE_IDS, FTMS_UUID, sizeof(FTMS_UUID));
-    uint8_t serviceData[2+1+2];
-    struct_pack(serviceData, "<HBH", 0x1826, 0x01, 1<<5);
-    uBit.ble->accumulateAdvertisingPayload(GapAdvertisingData::SERVICE_DATA, serviceData, sizeof(serviceData));
+    // BLE Appearance, LOCAL_NAME and FTMS - Service Advertising Data, on top of the payload and the interval of the runtime
+    this->basePayload = uBit.ble->gap().getAdvertisingPayload();
+    this->advertisingInterval = uBit.ble->gap().getAdvertisingParams().getInterval();
+    this->setupAdvertising();
 
     // Caractieristic
-    GattCharacteristic  indoorBikeDataCharacteristic(
-        UUID(0x2AD2)
-        , (uint8_t *)&indoorBikeDataCharacteristicBuffer, 0, indoorBikeDataCharacteristicBufferSize
+    machineDataCharacteristic = new GattCharacteristic(
+        UUID(MicroBitFitnessMachineProfile::DATA_UUID)
+        , (uint8_t *)&machineDataCharacteristicBuffer, 0, machineDataCharacteristicBufferSize
         , GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY
     );
-    GattCharacteristic  fitnessMachineControlPointCharacteristic(
+    fitnessMachineControlPointCharacteristic = new GattCharacteristic(
         UUID(0x2AD9)
         , (uint8_t *)&fitnessMachineControlPointCharacteristicBuffer, 0, fitnessMachineControlPointCharacteristicBufferSize
         , GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE|GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_INDICATE
@@ -62,43 +55,80 @@ MicroBitIndoorBikeStepService::MicroBitIndoorBikeStepService(MicroBit &_uBit, Mi
         , (uint8_t *)&fitnessMachineFeatureCharacteristicBuffer, 0, fitnessMachineFeatureCharacteristicBufferSize
         , GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ
     );
-    GattCharacteristic  fitnessMachineStatusCharacteristic(
+    GattCharacteristic  supportedResistanceLevelRangeCharacteristic(
+        UUID(0x2AD6)
+        , (uint8_t *)&supportedResistanceLevelRangeCharacteristicBuffer, 0, supportedResistanceLevelRangeCharacteristicBufferSize
+        , GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ
+    );
+    GattCharacteristic  supportedSpeedRangeCharacteristic(
+        UUID(0x2AD4)
+        , (uint8_t *)&supportedSpeedRangeCharacteristicBuffer, 0, supportedSpeedRangeCharacteristicBufferSize
+        , GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ
+    );
+    GattCharacteristic  supportedPowerRangeCharacteristic(
+        UUID(0x2AD8)
+        , (uint8_t *)&supportedPowerRangeCharacteristicBuffer, 0, supportedPowerRangeCharacteristicBufferSize
+        , GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ
+    );
+    fitnessMachineStatusCharacteristic = new GattCharacteristic(
         UUID(0x2ADA)
         , (uint8_t *)&fitnessMachineStatusCharacteristicBuffer, 0, fitnessMachineStatusCharacteristicBufferSize
         , GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY
     );
-    GattCharacteristic  fitnessTrainingStatusCharacteristic(
+    fitnessTrainingStatusCharacteristic = new GattCharacteristic(
         UUID(0x2AD3)
         , (uint8_t *)&fitnessTrainingStatusCharacteristicBuffer, 0, fitnessTrainingStatusCharacteristicBufferSize
         , GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ | GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY
     );
     
     // Set default security requirements
-    indoorBikeDataCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
-    fitnessMachineControlPointCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+    machineDataCharacteristic->requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+    fitnessMachineControlPointCharacteristic->requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
     fitnessMachineFeatureCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
-    fitnessMachineStatusCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
-    fitnessTrainingStatusCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+    supportedResistanceLevelRangeCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+    supportedSpeedRangeCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+    supportedPowerRangeCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+    fitnessMachineStatusCharacteristic->requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+    fitnessTrainingStatusCharacteristic->requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+    
+    // A control point write is refused while the response of the previous one waits for confirmation
+    fitnessMachineControlPointCharacteristic->setWriteAuthorizationCallback(this, &MicroBitIndoorBikeStepService::onControlPointWriteAuthorization);
 
     // Service
     GattCharacteristic *characteristics[] = {
-        &indoorBikeDataCharacteristic,
-        &fitnessMachineControlPointCharacteristic,
+        machineDataCharacteristic,
+        fitnessMachineControlPointCharacteristic,
         &fitnessMachineFeatureCharacteristic,
-        &fitnessMachineStatusCharacteristic,
-        &fitnessTrainingStatusCharacteristic,
+        &supportedResistanceLevelRangeCharacteristic,
+        &supportedSpeedRangeCharacteristic,
+        &supportedPowerRangeCharacteristic,
+        fitnessMachineStatusCharacteristic,
+        fitnessTrainingStatusCharacteristic,
     };
     GattService service(
         UUID(0x1826), characteristics, sizeof(characteristics) / sizeof(GattCharacteristic *)
     );
-    uBit.ble->addService(service);
+    if (uBit.ble->addService(service) != BLE_ERROR_NONE)
+    {
+        // MICROBIT_SD_GATT_TABLE_SIZE (mbed_app.json) has no room for the service
+        uBit.panic(MICROBIT_BLE_PANIC_GATT_TABLE_FULL);
+    }
     
     // Characteristic Handle
-    indoorBikeDataCharacteristicHandle = indoorBikeDataCharacteristic.getValueHandle();
-    fitnessMachineControlPointCharacteristicHandle = fitnessMachineControlPointCharacteristic.getValueHandle();
+    machineDataCharacteristicHandle = machineDataCharacteristic->getValueHandle();
+    fitnessMachineControlPointCharacteristicHandle = fitnessMachineControlPointCharacteristic->getValueHandle();
     fitnessMachineFeatureCharacteristicHandle = fitnessMachineFeatureCharacteristic.getValueHandle();
-    fitnessMachineStatusCharacteristicHandle = fitnessMachineStatusCharacteristic.getValueHandle();
-    fitnessTrainingStatusCharacteristicHandle = fitnessTrainingStatusCharacteristic.getValueHandle();
+    supportedResistanceLevelRangeCharacteristicHandle = supportedResistanceLevelRangeCharacteristic.getValueHandle();
+    supportedSpeedRangeCharacteristicHandle = supportedSpeedRangeCharacteristic.getValueHandle();
+    supportedPowerRangeCharacteristicHandle = supportedPowerRangeCharacteristic.getValueHandle();
+    fitnessMachineStatusCharacteristicHandle = fitnessMachineStatusCharacteristic->getValueHandle();
+    fitnessTrainingStatusCharacteristicHandle = fitnessTrainingStatusCharacteristic->getValueHandle();
+    
+    // Subscription tracking per connection
+    machineDataIndex = connections.addCharacteristic(machineDataCharacteristic);
+    fitnessMachineControlPointIndex = connections.addCharacteristic(fitnessMachineControlPointCharacteristic);
+    fitnessMachineStatusIndex = connections.addCharacteristic(fitnessMachineStatusCharacteristic);
+    fitnessTrainingStatusIndex = connections.addCharacteristic(fitnessTrainingStatusCharacteristic);
     
     // GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ
     uint8_t fitnessMachineFeatureBuff[fitnessMachineFeatureCharacteristicBufferSize];
@@ -109,6 +139,33 @@ MicroBitIndoorBikeStepService::MicroBitIndoorBikeStepService(MicroBit &_uBit, Mi
     );
     uBit.ble->gattServer().write(fitnessMachineFeatureCharacteristicHandle
         ,(uint8_t *)&fitnessMachineFeatureBuff, fitnessMachineFeatureCharacteristicBufferSize);
+    uint8_t supportedResistanceLevelRangeBuff[supportedResistanceLevelRangeCharacteristicBufferSize];
+    struct_pack(supportedResistanceLevelRangeBuff
+        , "<hhH"
+        , MIN_RESISTANCE_LEVEL10
+        , MAX_RESISTANCE_LEVEL10
+        , FTMP_VAL_SUPPORTED_RESISTANCE_LEVEL_INCREMENT
+    );
+    uBit.ble->gattServer().write(supportedResistanceLevelRangeCharacteristicHandle
+        ,(uint8_t *)&supportedResistanceLevelRangeBuff, supportedResistanceLevelRangeCharacteristicBufferSize);
+    uint8_t supportedSpeedRangeBuff[supportedSpeedRangeCharacteristicBufferSize];
+    struct_pack(supportedSpeedRangeBuff
+        , "<HHH"
+        , FTMP_VAL_SUPPORTED_SPEED_MIN100
+        , FTMP_VAL_SUPPORTED_SPEED_MAX100
+        , FTMP_VAL_SUPPORTED_SPEED_INCREMENT100
+    );
+    uBit.ble->gattServer().write(supportedSpeedRangeCharacteristicHandle
+        ,(uint8_t *)&supportedSpeedRangeBuff, supportedSpeedRangeCharacteristicBufferSize);
+    uint8_t supportedPowerRangeBuff[supportedPowerRangeCharacteristicBufferSize];
+    struct_pack(supportedPowerRangeBuff
+        , "<hhH"
+        , FTMP_VAL_SUPPORTED_POWER_MIN
+        , FTMP_VAL_SUPPORTED_POWER_MAX
+        , FTMP_VAL_SUPPORTED_POWER_INCREMENT
+    );
+    uBit.ble->gattServer().write(supportedPowerRangeCharacteristicHandle
+        ,(uint8_t *)&supportedPowerRangeBuff, supportedPowerRangeCharacteristicBufferSize);
     uint8_t fitnessTrainingStatusBuff[fitnessTrainingStatusCharacteristicBufferSize];
     struct_pack(fitnessTrainingStatusBuff
         , "<BB"
@@ -127,7 +184,97 @@ MicroBitIndoorBikeStepService::MicroBitIndoorBikeStepService(MicroBit &_uBit, Mi
         EventModel::defaultEventBus->listen(this->indoorBike.getId(), MICROBIT_INDOOR_BIKE_STEP_SENSOR_EVT_DATA_UPDATE
             , this, &MicroBitIndoorBikeStepService::indoorBikeUpdate, MESSAGE_BUS_LISTENER_IMMEDIATE);
     }
+    
+    // Live data in the advertising payload
+    if (BLE_INDOOR_BIKE_BROADCAST_MODE)
+    {
+        this->setBroadcastMode((MicroBitIndoorBikeBroadcastMode)BLE_INDOOR_BIKE_BROADCAST_MODE);
+    }
+
+}
 
+ble_error_t MicroBitIndoorBikeStepService::setupAdvertising(void)
+{
+    const uint8_t FTMS_UUID[sizeof(UUID::ShortUUIDBytes_t)] = {0x26, 0x18};
+    uint8_t serviceData[2+1+2];
+    struct_pack(serviceData, "<HBH", 0x1826, 0x01, MicroBitFitnessMachineProfile::MACHINE_TYPE);
+    
+    // Built from scratch for every mode: nothing of the previous mode is left.
+    uBit.ble->gap().clearScanResponse();
+    if (this->broadcastMode==INDOOR_BIKE_BROADCAST_OFF)
+    {
+        // The payload of the runtime (flags, LOCAL_NAME), then BLE Appearance and LOCAL_NAME (replaced)
+        uBit.ble->gap().setAdvertisingPayload(this->basePayload);
+        uBit.ble->gap().accumulateAdvertisingPayload(MicroBitFitnessMachineProfile::APPEARANCE);
+        if (BLE_DEVICE_LOCAL_NAME_CHENGE)
+        {
+            uBit.ble->gap().accumulateAdvertisingPayload(GapAdvertisingData::COMPLETE_LOCAL_NAME
+                , (const uint8_t *)BLE_DEVICE_LOCAL_NAME, sizeof(BLE_DEVICE_LOCAL_NAME)-1);
+        }
+        
+        // FTMS - Service Advertising Data
+        uBit.ble->accumulateAdvertisingPayload(GapAdvertisingData::COMPLETE_LIST_16BIT_SERVICE_IDS, FTMS_UUID, sizeof(FTMS_UUID));
+        uBit.ble->accumulateAdvertisingPayload(GapAdvertisingData::SERVICE_DATA, serviceData, sizeof(serviceData));
+    }
+    else
+    {
+        // 31 bytes: Flags(3), Appearance(4), FTMS UUID(4), FTMS Service Data(7), Manufacturer Specific Data(2+2+8)
+        // LOCAL_NAME moves to the Scan Response.
+        uBit.ble->gap().clearAdvertisingPayload();
+        uBit.ble->gap().accumulateAdvertisingPayload(GapAdvertisingData::BREDR_NOT_SUPPORTED | GapAdvertisingData::LE_GENERAL_DISCOVERABLE);
+        uBit.ble->gap().accumulateAdvertisingPayload(MicroBitFitnessMachineProfile::APPEARANCE);
+        uBit.ble->accumulateAdvertisingPayload(GapAdvertisingData::COMPLETE_LIST_16BIT_SERVICE_IDS, FTMS_UUID, sizeof(FTMS_UUID));
+        uBit.ble->accumulateAdvertisingPayload(GapAdvertisingData::SERVICE_DATA, serviceData, sizeof(serviceData));
+        uint8_t broadcastData[2+machineDataCharacteristicBufferSize];
+        struct_pack(broadcastData, "<H", BLE_INDOOR_BIKE_BROADCAST_COMPANY_ID);
+        this->machine.encode(&broadcastData[2], this->indoorBike);
+        uBit.ble->accumulateAdvertisingPayload(GapAdvertisingData::MANUFACTURER_SPECIFIC_DATA, broadcastData, sizeof(broadcastData));
+        if (BLE_DEVICE_LOCAL_NAME_CHENGE)
+        {
+            uBit.ble->gap().accumulateScanResponse(GapAdvertisingData::COMPLETE_LOCAL_NAME
+                , (const uint8_t *)BLE_DEVICE_LOCAL_NAME, sizeof(BLE_DEVICE_LOCAL_NAME)-1);
+        }
+    }
+    // The other services (CSC, CPS)
+    this->connections.accumulateScanResponse();
+    
+    // Broadcast only: scannable, so scanners still get the scan response, and no connections.
+    // It keeps running while centrals are connected; the stack refuses it faster than every 100 ms.
+    uBit.ble->gap().stopAdvertising();
+    if (this->broadcastMode==INDOOR_BIKE_BROADCAST_ONLY)
+    {
+        uBit.ble->gap().setAdvertisingType(GapAdvertisingParams::ADV_SCANNABLE_UNDIRECTED);
+        uBit.ble->gap().setAdvertisingInterval((this->advertisingInterval < BLE_INDOOR_BIKE_BROADCAST_ONLY_INTERVAL_MS)
+            ? BLE_INDOOR_BIKE_BROADCAST_ONLY_INTERVAL_MS : this->advertisingInterval);
+    }
+    else
+    {
+        uBit.ble->gap().setAdvertisingType(GapAdvertisingParams::ADV_CONNECTABLE_UNDIRECTED);
+        uBit.ble->gap().setAdvertisingInterval(this->advertisingInterval);
+    }
+    return uBit.ble->gap().startAdvertising();
+}
+
+void MicroBitIndoorBikeStepService::updateBroadcastData(const uint8_t *machineData)
+{
+    // Same length as the placeholder from setupAdvertising(), so the payload is patched in place.
+    uint8_t broadcastData[2+machineDataCharacteristicBufferSize];
+    struct_pack(broadcastData, "<H", BLE_INDOOR_BIKE_BROADCAST_COMPANY_ID);
+    memcpy(&broadcastData[2], machineData, machineDataCharacteristicBufferSize);
+    uBit.ble->gap().updateAdvertisingPayload(GapAdvertisingData::MANUFACTURER_SPECIFIC_DATA, broadcastData, sizeof(broadcastData));
+}
+
+void MicroBitIndoorBikeStepService::onControlPointWriteAuthorization(GattWriteAuthCallbackParams *params)
+{
+    // The next procedure runs after the response of the previous one is confirmed
+    if (this->connections.isIndicationPending(params->connHandle))
+    {
+        params->authorizationReply = (GattAuthCallbackReply_t)FTMP_ATT_ERROR_FE_PROCEDURE_ALREADY_IN_PROGRESS;
+    }
+    else
+    {
+        params->authorizationReply = AUTH_CALLBACK_REPLY_SUCCESS;
+    }
 }
 
 void MicroBitIndoorBikeStepService::onDataWritten(const GattWriteCallbackParams *params)
@@ -138,6 +285,52 @@ void MicroBitIndoorBikeStepService::onDataWritten(const GattWriteCallbackParams
     }
 }
 
+const MicroBitIndoorBikeStepService::ControlPointOp MicroBitIndoorBikeStepService::controlPointOps[FTMP_OP_CODE_CPPR_COUNT] = {
+    // format, procedure, status
+    { "<", &MicroBitIndoorBikeStepService::doRequestControl, NULL },                                       // 0x00 Request Control
+    { "<", &MicroBitIndoorBikeStepService::doReset, &MicroBitIndoorBikeStepService::sendFitnessMachineStatusReset },  // 0x01 Reset
+    { "<H", &MicroBitIndoorBikeStepService::doSetTargetSpeed, &MicroBitIndoorBikeStepService::sendFitnessMachineStatusTargetSpeed },  // 0x02 Set Target Speed
+    { "<h", NULL, NULL },                                                                                   // 0x03 Set Target Inclination
+    { "<B", &MicroBitIndoorBikeStepService::doSetTargetResistanceLevel, &MicroBitIndoorBikeStepService::sendFitnessMachineStatusTargetResistanceLevel },  // 0x04 Set Target Resistance Level
+    { "<h", &MicroBitIndoorBikeStepService::doSetTargetPower, &MicroBitIndoorBikeStepService::sendFitnessMachineStatusTargetPower },  // 0x05 Set Target Power
+    { "<B", NULL, NULL },                                                                                   // 0x06 Set Target Heart Rate
+    { "<", &MicroBitIndoorBikeStepService::doStartOrResume, &MicroBitIndoorBikeStepService::sendFitnessMachineStatusStartedOrResumed },  // 0x07 Start or Resume
+    { "<B", &MicroBitIndoorBikeStepService::doStopOrPause, &MicroBitIndoorBikeStepService::sendFitnessMachineStatusStoppedOrPaused },  // 0x08 Stop or Pause
+    { "<H", NULL, NULL },                                                                                   // 0x09 Set Targeted Expended Energy
+    { "<H", NULL, NULL },                                                                                   // 0x0A Set Targeted Number of Steps
+    { "<H", NULL, NULL },                                                                                   // 0x0B Set Targeted Number of Strides
+    { "<HB", NULL, NULL },                                                                                  // 0x0C Set Targeted Distance (UINT24: low 16 bits, high 8 bits)
+    { "<H", NULL, NULL },                                                                                   // 0x0D Set Targeted Training Time
+    { "<HH", NULL, NULL },                                                                                  // 0x0E Set Targeted Time in Two Heart Rate Zones
+    { "<HHH", NULL, NULL },                                                                                 // 0x0F Set Targeted Time in Three Heart Rate Zones
+    { "<HHHHH", NULL, NULL },                                                                               // 0x10 Set Targeted Time in Five Heart Rate Zones
+    { "<hhBB", &MicroBitIndoorBikeStepService::doSetIndoorBikeSimulation, &MicroBitIndoorBikeStepService::sendFitnessMachineStatusIndoorBikeSimulation },  // 0x11 Set Indoor Bike Simulation Parameters
+    { "<H", NULL, NULL },                                                                                   // 0x12 Set Wheel Circumference
+    { "<B", &MicroBitIndoorBikeStepService::doSpinDownControl, NULL },                                      // 0x13 Spin Down Control
+    { "<H", &MicroBitIndoorBikeStepService::doSetTargetedCadence, &MicroBitIndoorBikeStepService::sendFitnessMachineStatusTargetedCadence },  // 0x14 Set Targeted Cadence
+};
+
+int MicroBitIndoorBikeStepService::decodeControlPointParameters(const char *format, const uint8_t *data, int32_t *param)
+{
+    // One field at a time in the byte order of the format, so every procedure gets plain integers
+    char field[3] = { format[0], 0, 0 };
+    int offset = 0;
+    int count = 0;
+    for (const char *c = format + 1; *c != '\0' && count < controlPointParamMax; c++)
+    {
+        field[1] = *c;
+        switch (*c)
+        {
+        case 'b': { int8_t v; offset = struct_unpack_from(offset, data, field, &v); param[count++] = v; break; }
+        case 'B': { uint8_t v; offset = struct_unpack_from(offset, data, field, &v); param[count++] = v; break; }
+        case 'h': { int16_t v; offset = struct_unpack_from(offset, data, field, &v); param[count++] = v; break; }
+        case 'H': { uint16_t v; offset = struct_unpack_from(offset, data, field, &v); param[count++] = v; break; }
+        default: return -1;
+        }
+    }
+    return count;
+}
+
 void MicroBitIndoorBikeStepService::doFitnessMachineControlPoint(const GattWriteCallbackParams *params)
 {
     uint8_t responseBuffer[3];
@@ -145,105 +338,243 @@ void MicroBitIndoorBikeStepService::doFitnessMachineControlPoint(const GattWrite
     uint8_t *opCode=&responseBuffer[1];
     opCode[0]=params->data[0];
     uint8_t *result=&responseBuffer[2];
-    result[0] = FTMP_RESULT_CODE_CPPR_03_INVALID_PARAMETER;
-    switch (opCode[0])
+    
+    // Control point ownership - granted by Request Control, released on disconnection
+    MicroBitBLEConnection *client = this->connections.find(params->connHandle);
+    MicroBitBLEConnection *owner = this->connections.findControl();
+    bool permitted;
+    if (client == NULL)
+    {
+        permitted = false;
+    }
+    else if (owner != NULL)
+    {
+        permitted = (owner == client);
+    }
+    else
     {
-    case FTMP_OP_CODE_CPPR_00_REQUEST_CONTROL:
-        if (params->len == 1)
+        permitted = (opCode[0] == FTMP_OP_CODE_CPPR_00_REQUEST_CONTROL) || !MICROBIT_FTMS_REQUEST_CONTROL_REQUIRED;
+    }
+    
+    // The same checks for every op code: supported, permitted, parameter length, then the procedure's own.
+    const ControlPointOp *op = (opCode[0] < FTMP_OP_CODE_CPPR_COUNT) ? &controlPointOps[opCode[0]] : NULL;
+    if (op == NULL || op->procedure == NULL)
+    {
+        result[0] = FTMP_RESULT_CODE_CPPR_02_NOT_SUPORTED;
+    }
+    else if (!permitted)
+    {
+        // Another central holds control, or the writer did not request it
+        result[0] = FTMP_RESULT_CODE_CPPR_05_CONTROL_NOT_PERMITTED;
+    }
+    else if (params->len != 1 + struct_calcsize(op->format))
+    {
+        result[0] = FTMP_RESULT_CODE_CPPR_03_INVALID_PARAMETER;
+    }
+    else
+    {
+        int32_t param[controlPointParamMax];
+        if (decodeControlPointParameters(op->format, &params->data[1], param) < 0)
         {
-            result[0] = FTMP_RESULT_CODE_CPPR_01_SUCCESS;
+            result[0] = FTMP_RESULT_CODE_CPPR_04_OPERATION_FAILED;
         }
-        break;
-
-    case FTMP_OP_CODE_CPPR_01_RESET:
-        if (params->len == 1)
+        else
         {
-            result[0] = FTMP_RESULT_CODE_CPPR_01_SUCCESS;
+            result[0] = (this->*op->procedure)(client, param);
         }
-        break;
+    }
 
-    case FTMP_OP_CODE_CPPR_07_START_RESUME:
-        if (params->len == 1)
-        {
-            result[0] = FTMP_RESULT_CODE_CPPR_01_SUCCESS;
-        }
-        break;
+    // Response - Fitness Machine Control Point (indicated to the writer only)
+    this->connections.indicate(params->connHandle, this->fitnessMachineControlPointIndex
+            , (const uint8_t *)&responseBuffer, sizeof(responseBuffer));
+    
+    // Status of the procedure, after its response
+    if (result[0]==FTMP_RESULT_CODE_CPPR_01_SUCCESS && op->status != NULL)
+    {
+        (this->*op->status)();
+    }
+    
+    // Telemetry - USB Serial
+    if (this->telemetry)
+    {
+        this->telemetry->controlPoint(params->connHandle, params->data, params->len, result[0]);
+    }
 
-    case FTMP_OP_CODE_CPPR_08_STOP_PAUSE:
-        if (params->len == 2)
-        {
-            this->stopOrPause = params->data[1];
-            result[0] = FTMP_RESULT_CODE_CPPR_01_SUCCESS;
-        }
-        break;
-        
-    default:
-        result[0] = FTMP_RESULT_CODE_CPPR_02_NOT_SUPORTED;
-        break;
+}
 
+uint8_t MicroBitIndoorBikeStepService::doRequestControl(MicroBitBLEConnection *client, const int32_t *param)
+{
+    // # 0x00 M Request Control
+    if (client != NULL)
+    {
+        client->controlGranted = true;
     }
+    return FTMP_RESULT_CODE_CPPR_01_SUCCESS;
+}
 
-    // Response - Fitness Machine Control Point
-    uBit.ble->gattServer().write(fitnessMachineControlPointCharacteristicHandle
-            , (const uint8_t *)&responseBuffer, sizeof(responseBuffer));
-    
-    // opCode procedure
-    if (result[0]==FTMP_RESULT_CODE_CPPR_01_SUCCESS)
+uint8_t MicroBitIndoorBikeStepService::doReset(MicroBitBLEConnection *client, const int32_t *param)
+{
+    // # 0x01 M Reset - the writer loses control as well, a new Request Control is needed
+    if (client != NULL)
     {
-        switch (opCode[0])
-        {
-        case FTMP_OP_CODE_CPPR_00_REQUEST_CONTROL:
-            // # 0x00 M Request Control
-            // #define FTMP_EVENT_VAL_OP_CODE_CPPR_00_REQUEST_CONTROL
-            // (NOP)
-            break;
-        case FTMP_OP_CODE_CPPR_01_RESET:
-            // # 0x01 M Reset
-            // #define FTMP_EVENT_VAL_OP_CODE_CPPR_01_RESET
-            this->sendTrainingStatusManualMode();
-            break;
-        case FTMP_OP_CODE_CPPR_07_START_RESUME:
-            // # 0x07 M Start or Resume
-            // #define FTMP_EVENT_VAL_OP_CODE_CPPR_07_START_RESUME
-            this->sendTrainingStatusManualMode();
-            break;
-        case FTMP_OP_CODE_CPPR_08_STOP_PAUSE:
-            // # 0x08 M Stop or Pause [UINT8, 0x01-STOP, 0x02-PAUSE]
-            // #define FTMP_EVENT_VAL_OP_CODE_CPPR_08_STOP_PAUSE
-            this->sendTrainingStatusIdle();
-            break;
-        default:
-            break;
-        }
+        client->controlGranted = false;
+    }
+    this->stopOrPause = 0;
+    this->resetTargets();
+    this->indoorBike.resetAnalytics();
+    this->machine.reset();
+    this->setSessionState(INDOOR_BIKE_SESSION_IDLE);
+    return FTMP_RESULT_CODE_CPPR_01_SUCCESS;
+}
 
+uint8_t MicroBitIndoorBikeStepService::doSetTargetResistanceLevel(MicroBitBLEConnection *client, const int32_t *param)
+{
+    // # 0x04 O Set Target Resistance Level [UINT8, 0.1] - the same unit as the resistance level of the sensor
+    if (param[0] < MIN_RESISTANCE_LEVEL10 || param[0] > MAX_RESISTANCE_LEVEL10)
+    {
+        return FTMP_RESULT_CODE_CPPR_03_INVALID_PARAMETER;
     }
-    
-    // Debug - USB Serial
-    if (true)
+    // the rider's own level: target power stops driving it
+    this->targetPowerActive = false;
+    this->indoorBike.setResistanceLevel10((uint8_t)param[0]);
+    return FTMP_RESULT_CODE_CPPR_01_SUCCESS;
+}
+
+uint8_t MicroBitIndoorBikeStepService::doSetTargetSpeed(MicroBitBLEConnection *client, const int32_t *param)
+{
+    // # 0x02 O Set Target Speed [UINT16, 0.01 km/h] - the speed follows the cadence, the target is for the rider
+    if (param[0] < FTMP_VAL_SUPPORTED_SPEED_MIN100 || param[0] > FTMP_VAL_SUPPORTED_SPEED_MAX100)
     {
-        uBit.serial.printf("CP:%" PRIu32 ", opCode[0x%02X], result[0x%02X], data", (uint32_t)system_timer_current_time(), opCode[0], result[0]);
-        for (int i=0; i<params->len; i++)
-        {
-            uBit.serial.printf(", 0x%02X", params->data[i]);
-        }
-        uBit.serial.printf("\r\n");
+        return FTMP_RESULT_CODE_CPPR_03_INVALID_PARAMETER;
+    }
+    this->targetSpeed100 = (uint16_t)param[0];
+    return FTMP_RESULT_CODE_CPPR_01_SUCCESS;
+}
+
+uint8_t MicroBitIndoorBikeStepService::doSetTargetPower(MicroBitBLEConnection *client, const int32_t *param)
+{
+    // # 0x05 O Set Target Power [SINT16, W] - the resistance level that gives it at the current speed, at every update
+    if (param[0] < FTMP_VAL_SUPPORTED_POWER_MIN || param[0] > FTMP_VAL_SUPPORTED_POWER_MAX)
+    {
+        return FTMP_RESULT_CODE_CPPR_03_INVALID_PARAMETER;
+    }
+    this->targetPower = (int16_t)param[0];
+    this->targetPowerActive = true;
+    this->indoorBike.setResistanceLevel10(this->indoorBike.getResistanceLevel10ForPower(this->targetPower, this->indoorBike.getSpeed100()), false);
+    return FTMP_RESULT_CODE_CPPR_01_SUCCESS;
+}
+
+uint8_t MicroBitIndoorBikeStepService::doSetIndoorBikeSimulation(MicroBitBLEConnection *client, const int32_t *param)
+{
+    // # 0x11 O Set Indoor Bike Simulation Parameters [SINT16 wind speed 0.001 m/s, SINT16 grade 0.01 %, UINT8 crr 0.0001, UINT8 cw 0.01 kg/m]
+    // The grade sets the resistance level (incline coefficients of the sensor); wind, rolling and air resistance are only kept.
+    this->simulationWindSpeed1000 = (int16_t)param[0];
+    this->simulationGrade100 = (int16_t)param[1];
+    this->simulationCrr10000 = (uint8_t)param[2];
+    this->simulationCw100 = (uint8_t)param[3];
+    this->targetPowerActive = false;
+    this->indoorBike.setResistanceLevel10(this->indoorBike.getResistanceLevel10ForGrade(this->simulationGrade100), false);
+    return FTMP_RESULT_CODE_CPPR_01_SUCCESS;
+}
+
+uint8_t MicroBitIndoorBikeStepService::doSpinDownControl(MicroBitBLEConnection *client, const int32_t *param)
+{
+    // # 0x13 O Spin Down Control [UINT8, 0x01-START, 0x02-IGNORE] - no flywheel to calibrate: Start fails, Ignore has nothing to do
+    if (param[0] == FTMP_VAL_SPIN_DOWN_02_IGNORE)
+    {
+        return FTMP_RESULT_CODE_CPPR_01_SUCCESS;
+    }
+    if (param[0] == FTMP_VAL_SPIN_DOWN_01_START)
+    {
+        return FTMP_RESULT_CODE_CPPR_04_OPERATION_FAILED;
+    }
+    return FTMP_RESULT_CODE_CPPR_03_INVALID_PARAMETER;
+}
+
+uint8_t MicroBitIndoorBikeStepService::doSetTargetedCadence(MicroBitBLEConnection *client, const int32_t *param)
+{
+    // # 0x14 O Set Targeted Cadence [UINT16, 0.5 rpm] - for the rider, as the target speed
+    this->targetCadence2 = (uint16_t)param[0];
+    return FTMP_RESULT_CODE_CPPR_01_SUCCESS;
+}
+
+void MicroBitIndoorBikeStepService::resetTargets(void)
+{
+    this->targetSpeed100 = 0;
+    this->targetPower = 0;
+    this->targetPowerActive = false;
+    this->simulationWindSpeed1000 = 0;
+    this->simulationGrade100 = 0;
+    this->simulationCrr10000 = 0;
+    this->simulationCw100 = 0;
+    this->targetCadence2 = 0;
+}
+
+uint8_t MicroBitIndoorBikeStepService::doStartOrResume(MicroBitBLEConnection *client, const int32_t *param)
+{
+    // # 0x07 M Start or Resume - a stopped session is over, start a new one
+    if (this->sessionState == INDOOR_BIKE_SESSION_STOPPED)
+    {
+        this->indoorBike.resetAnalytics();
+        this->machine.reset();
     }
+    this->setSessionState(INDOOR_BIKE_SESSION_RUNNING);
+    return FTMP_RESULT_CODE_CPPR_01_SUCCESS;
+}
 
+uint8_t MicroBitIndoorBikeStepService::doStopOrPause(MicroBitBLEConnection *client, const int32_t *param)
+{
+    // # 0x08 M Stop or Pause [UINT8, 0x01-STOP, 0x02-PAUSE]
+    if (param[0] != FTMP_VAL_STOP_PAUSE_01_STOP && param[0] != FTMP_VAL_STOP_PAUSE_02_PAUSE)
+    {
+        return FTMP_RESULT_CODE_CPPR_03_INVALID_PARAMETER;
+    }
+    // only a running session pauses
+    if (param[0] == FTMP_VAL_STOP_PAUSE_02_PAUSE && this->sessionState != INDOOR_BIKE_SESSION_RUNNING)
+    {
+        return FTMP_RESULT_CODE_CPPR_04_OPERATION_FAILED;
+    }
+    this->stopOrPause = param[0];
+    this->setSessionState((param[0] == FTMP_VAL_STOP_PAUSE_01_STOP) ? INDOOR_BIKE_SESSION_STOPPED : INDOOR_BIKE_SESSION_PAUSED);
+    return FTMP_RESULT_CODE_CPPR_01_SUCCESS;
+}
+
+void MicroBitIndoorBikeStepService::setSessionState(MicroBitIndoorBikeSessionState state)
+{
+    this->sessionState = state;
+    this->indoorBike.setSessionPaused(state == INDOOR_BIKE_SESSION_PAUSED || state == INDOOR_BIKE_SESSION_STOPPED);
 }
 
 void MicroBitIndoorBikeStepService::indoorBikeUpdate(MicroBitEvent e)
 {
-    if (uBit.ble->getGapState().connected)
+    this->machine.update(this->indoorBike);
+    if (this->targetPowerActive)
+    {
+        this->indoorBike.setResistanceLevel10(this->indoorBike.getResistanceLevel10ForPower(this->targetPower, this->indoorBike.getSpeed100()), false);
+    }
+
+    // Nothing to report while the session is paused or stopped
+    if (this->indoorBike.isSessionPaused())
+    {
+        return;
+    }
+    bool notifying = this->connections.subscribers(this->machineDataIndex) > 0;
+    if (!notifying && this->broadcastMode==INDOOR_BIKE_BROADCAST_OFF)
+    {
+        return;
+    }
+    
+    // Encode once, then fan out to every subscribed connection and the advertising payload.
+    uint8_t buff[machineDataCharacteristicBufferSize];
+    this->machine.encode(buff, this->indoorBike);
+    if (notifying)
     {
-        uint8_t buff[indoorBikeDataCharacteristicBufferSize];
-        struct_pack(buff, "<HHHh",
-            FTMP_FLAGS_INDOOR_BIKE_DATA_CHAR,
-            this->indoorBike.getSpeed100(),
-            this->indoorBike.getCadence2(),
-            this->indoorBike.getPower()
-        );
-        uBit.ble->gattServer().notify(indoorBikeDataCharacteristicHandle
-            , (uint8_t *)&buff, indoorBikeDataCharacteristicBufferSize);
+        this->connections.notify(this->machineDataIndex
+            , (uint8_t *)&buff, machineDataCharacteristicBufferSize);
+    }
+    if (this->broadcastMode!=INDOOR_BIKE_BROADCAST_OFF)
+    {
+        this->updateBroadcastData(buff);
     }
 }
 
@@ -252,23 +583,114 @@ uint8_t MicroBitIndoorBikeStepService::getStopOrPause()
     return this->stopOrPause;
 }
 
+MicroBitIndoorBikeSessionState MicroBitIndoorBikeStepService::getSessionState(void)
+{
+    return this->sessionState;
+}
+
+MicroBitIndoorBikeBroadcastMode MicroBitIndoorBikeStepService::getBroadcastMode(void)
+{
+    return this->broadcastMode;
+}
+
+void MicroBitIndoorBikeStepService::setTelemetry(MicroBitTelemetry *telemetry)
+{
+    this->telemetry = telemetry;
+}
+
+void MicroBitIndoorBikeStepService::setBroadcastMode(MicroBitIndoorBikeBroadcastMode mode)
+{
+    if (machineDataCharacteristicBufferSize > broadcastDataMaxSize)
+    {
+        return;
+    }
+    if (mode!=this->broadcastMode)
+    {
+        MicroBitIndoorBikeBroadcastMode previous = this->broadcastMode;
+        this->broadcastMode = mode;
+        if (this->setupAdvertising() != BLE_ERROR_NONE)
+        {
+            // The stack refused the advertising of the mode: advertise as before rather than not at all
+            this->broadcastMode = previous;
+            this->setupAdvertising();
+        }
+    }
+}
+
 void MicroBitIndoorBikeStepService::sendTrainingStatusIdle(void)
 {
     static const uint8_t buff[]={FTMP_FLAGS_TRAINING_STATUS_FIELD_00_STATUS_ONLY, FTMP_VAL_TRAINING_STATUS_01_IDEL};
-    uBit.ble->gattServer().notify(this->fitnessTrainingStatusCharacteristicHandle
+    this->connections.notify(this->fitnessTrainingStatusIndex
         , (const uint8_t *)&buff, sizeof(buff));
 }
 
 void MicroBitIndoorBikeStepService::sendTrainingStatusManualMode(void)
 {
     static const uint8_t buff[]={FTMP_FLAGS_TRAINING_STATUS_FIELD_00_STATUS_ONLY, FTMP_VAL_TRAINING_STATUS_0D_MANUAL_MODE};
-    uBit.ble->gattServer().notify(this->fitnessTrainingStatusCharacteristicHandle
+    this->connections.notify(this->fitnessTrainingStatusIndex
         , (const uint8_t *)&buff, sizeof(buff));
 }
-    
+
 void MicroBitIndoorBikeStepService::sendFitnessMachineStatusReset(void)
 {
     static const uint8_t buff[]={FTMP_OP_CODE_FITNESS_MACHINE_STATUS_01_RESET};
-    uBit.ble->gattServer().notify(this->fitnessMachineStatusCharacteristicHandle
+    this->connections.notify(this->fitnessMachineStatusIndex
+        , (const uint8_t *)&buff, sizeof(buff));
+    this->sendTrainingStatusIdle();
+}
+
+void MicroBitIndoorBikeStepService::sendFitnessMachineStatusStartedOrResumed(void)
+{
+    static const uint8_t buff[]={FTMP_OP_CODE_FITNESS_MACHINE_STATUS_04_STARTED_RESUMED_BY_USER};
+    this->connections.notify(this->fitnessMachineStatusIndex
+        , (const uint8_t *)&buff, sizeof(buff));
+    this->sendTrainingStatusManualMode();
+}
+
+void MicroBitIndoorBikeStepService::sendFitnessMachineStatusStoppedOrPaused(void)
+{
+    uint8_t buff[]={FTMP_OP_CODE_FITNESS_MACHINE_STATUS_02_STOPPED_PAUSED_BY_USER, this->stopOrPause};
+    this->connections.notify(this->fitnessMachineStatusIndex
+        , (const uint8_t *)&buff, sizeof(buff));
+    this->sendTrainingStatusIdle();
+}
+
+void MicroBitIndoorBikeStepService::sendFitnessMachineStatusTargetResistanceLevel(void)
+{
+    uint8_t buff[]={FTMP_OP_CODE_FITNESS_MACHINE_STATUS_07_TARGET_RESISTANCE_LEVEL_CHANGED, this->indoorBike.getResistanceLevel10()};
+    this->connections.notify(this->fitnessMachineStatusIndex
+        , (const uint8_t *)&buff, sizeof(buff));
+}
+
+void MicroBitIndoorBikeStepService::sendFitnessMachineStatusTargetSpeed(void)
+{
+    uint8_t buff[1+2];
+    struct_pack(buff, "<BH", FTMP_OP_CODE_FITNESS_MACHINE_STATUS_05_TARGET_SPEED_CHANGED, this->targetSpeed100);
+    this->connections.notify(this->fitnessMachineStatusIndex
+        , (const uint8_t *)&buff, sizeof(buff));
+}
+
+void MicroBitIndoorBikeStepService::sendFitnessMachineStatusTargetPower(void)
+{
+    uint8_t buff[1+2];
+    struct_pack(buff, "<Bh", FTMP_OP_CODE_FITNESS_MACHINE_STATUS_08_TARGET_POWER_CHANGED, this->targetPower);
+    this->connections.notify(this->fitnessMachineStatusIndex
+        , (const uint8_t *)&buff, sizeof(buff));
+}
+
+void MicroBitIndoorBikeStepService::sendFitnessMachineStatusIndoorBikeSimulation(void)
+{
+    uint8_t buff[1+6];
+    struct_pack(buff, "<BhhBB", FTMP_OP_CODE_FITNESS_MACHINE_STATUS_12_INDOOR_BIKE_SIMULATION_CHANGED
+        , this->simulationWindSpeed1000, this->simulationGrade100, this->simulationCrr10000, this->simulationCw100);
+    this->connections.notify(this->fitnessMachineStatusIndex
+        , (const uint8_t *)&buff, sizeof(buff));
+}
+
+void MicroBitIndoorBikeStepService::sendFitnessMachineStatusTargetedCadence(void)
+{
+    uint8_t buff[1+2];
+    struct_pack(buff, "<BH", FTMP_OP_CODE_FITNESS_MACHINE_STATUS_15_TARGETED_CADENCE_CHANGED, this->targetCadence2);
+    this->connections.notify(this->fitnessMachineStatusIndex
         , (const uint8_t *)&buff, sizeof(buff));
 }
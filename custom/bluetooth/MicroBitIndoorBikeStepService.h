@@ -28,35 +28,55 @@ SOFTWARE.
 #include "MicroBit.h"
 #include "MicroBitCustom.h"
 #include "MicroBitIndoorBikeStepSensor.h"
-
-/*
-# Bit Definitions for the Indoor Bike Data Characteristic
-#                                          000 (bits 13-15) Reserved for Future Use
-#                                             0 (bit 12) Remaining Time Present
-#                                              0 (bit 11) Elapsed Time Present
-#                                               0 (bit 10) Metabolic Equivalent Present
-#                                                0 (bit  9) Heart Rate Present
-#                                                 0 (bit  8) Expended Energy Present
-#                                                  0 (bit  7) Average Power Present
-#                                                   1 (bit  6)*Instantaneous Power Present
-#                                                    0 (bit  5) Resistance Level Present
-#                                                     0 (bit  4) Total Distance Present
-#                                                      0 (bit  3) Average Cadence present
-#                                                       1 (bit  2)*Instantaneous Cadence (uint16, 1/minute with a resolution of 0.5)
-#                                                        0 (bit  1) Average Speed present
-#                                                         0 (bit  0) More Data
-#                                          5432109876543210 */
-#define FTMP_FLAGS_INDOOR_BIKE_DATA_CHAR 0b0000000001000100
+#include "MicroBitBLEConnectionTable.h"
+#include "MicroBitTelemetry.h"
+#include "MicroBitFitnessMachineProfile.h"
 
 // # Fitness Machine Control Point Procedure Requirements
 // # 0x00 M Request Control
 #define FTMP_OP_CODE_CPPR_00_REQUEST_CONTROL 0x00
 // # 0x01 M Reset
 #define FTMP_OP_CODE_CPPR_01_RESET 0x01
+// # 0x02 O Set Target Speed [UINT16, 0.01 km/h]
+#define FTMP_OP_CODE_CPPR_02_SET_TARGET_SPEED            0x02
+// # 0x03 O Set Target Inclination [SINT16, 0.1 %]
+#define FTMP_OP_CODE_CPPR_03_SET_TARGET_INCLINATION      0x03
+// # 0x04 O Set Target Resistance Level [UINT8, 0.1]
+#define FTMP_OP_CODE_CPPR_04_SET_TARGET_RESISTANCE_LEVEL 0x04
+// # 0x05 O Set Target Power [SINT16, 1 W]
+#define FTMP_OP_CODE_CPPR_05_SET_TARGET_POWER            0x05
+// # 0x06 O Set Target Heart Rate [UINT8, 1 bpm]
+#define FTMP_OP_CODE_CPPR_06_SET_TARGET_HEART_RATE       0x06
 // # 0x07 M Start or Resume
 #define FTMP_OP_CODE_CPPR_07_START_RESUME                0x07
 // # 0x08 M Stop or Pause [UINT8, 0x01-STOP, 0x02-PAUSE]
 #define FTMP_OP_CODE_CPPR_08_STOP_PAUSE                  0x08
+// # 0x09 O Set Targeted Expended Energy [UINT16, 1 cal]
+#define FTMP_OP_CODE_CPPR_09_SET_TARGETED_EXPENDED_ENERGY 0x09
+// # 0x0A O Set Targeted Number of Steps [UINT16]
+#define FTMP_OP_CODE_CPPR_0A_SET_TARGETED_STEPS          0x0A
+// # 0x0B O Set Targeted Number of Strides [UINT16]
+#define FTMP_OP_CODE_CPPR_0B_SET_TARGETED_STRIDES        0x0B
+// # 0x0C O Set Targeted Distance [UINT24, 1 m]
+#define FTMP_OP_CODE_CPPR_0C_SET_TARGETED_DISTANCE       0x0C
+// # 0x0D O Set Targeted Training Time [UINT16, 1 s]
+#define FTMP_OP_CODE_CPPR_0D_SET_TARGETED_TRAINING_TIME  0x0D
+// # 0x0E O Set Targeted Time in Two Heart Rate Zones [UINT16 x2, 1 s]
+#define FTMP_OP_CODE_CPPR_0E_SET_TARGETED_TIME_2_ZONES   0x0E
+// # 0x0F O Set Targeted Time in Three Heart Rate Zones [UINT16 x3, 1 s]
+#define FTMP_OP_CODE_CPPR_0F_SET_TARGETED_TIME_3_ZONES   0x0F
+// # 0x10 O Set Targeted Time in Five Heart Rate Zones [UINT16 x5, 1 s]
+#define FTMP_OP_CODE_CPPR_10_SET_TARGETED_TIME_5_ZONES   0x10
+// # 0x11 O Set Indoor Bike Simulation Parameters [SINT16 wind 0.001 m/s, SINT16 grade 0.01 %, UINT8 Crr 0.0001, UINT8 Cw 0.01 kg/m]
+#define FTMP_OP_CODE_CPPR_11_SET_INDOOR_BIKE_SIMULATION  0x11
+// # 0x12 O Set Wheel Circumference [UINT16, 0.1 mm]
+#define FTMP_OP_CODE_CPPR_12_SET_WHEEL_CIRCUMFERENCE     0x12
+// # 0x13 O Spin Down Control [UINT8, 0x01-START, 0x02-IGNORE]
+#define FTMP_OP_CODE_CPPR_13_SPIN_DOWN_CONTROL           0x13
+// # 0x14 O Set Targeted Cadence [UINT16, 0.5 1/min]
+#define FTMP_OP_CODE_CPPR_14_SET_TARGETED_CADENCE        0x14
+// # Op codes of the control point table (0x00-0x14)
+#define FTMP_OP_CODE_CPPR_COUNT                          0x15
 
 // # 0x80 M Response Code
 #define FTMP_OP_CODE_CPPR_80_RESPONSE_CODE         0x80
@@ -70,9 +90,17 @@ SOFTWARE.
 #define FTMP_RESULT_CODE_CPPR_02_NOT_SUPORTED      0x02
 // # 0x03 Invalid Parameter
 #define FTMP_RESULT_CODE_CPPR_03_INVALID_PARAMETER 0x03
+// # 0x04 Operation Failed
+#define FTMP_RESULT_CODE_CPPR_04_OPERATION_FAILED  0x04
+// # 0x05 Control Not Permitted
+#define FTMP_RESULT_CODE_CPPR_05_CONTROL_NOT_PERMITTED 0x05
+
+// # ATT error of a control point write (Core Specification Supplement, Common Profile and Service Error Codes)
+// # 0xFE Procedure Already In Progress - the response of the previous procedure is not confirmed yet
+#define FTMP_ATT_ERROR_FE_PROCEDURE_ALREADY_IN_PROGRESS 0x01FE
 
 /*
-# Definition of the bits of the Fitness Machine Features field
+# Definition of the bits of the Fitness Machine Features field (* Indoor Bike, MicroBitFitnessMachineProfile::FEATURES of each machine)
 #                                                  000000000000000 (bits 17-31) Reserved for Future Use
 #                                                                 0 (bit 16) User Data Retention Supported
 #                                                                  0 (bit 15) Force on Belt and Power Output Supported
@@ -92,15 +120,15 @@ SOFTWARE.
 #                                                                                1 (bit  1)*Cadence Supported
 #                                                                                 0 (bit  0) Average Speed Supported
 #                                                  10987654321098765432109876543210 */
-#define FTMP_FLAGS_FITNESS_MACINE_FEATURES_FIELD 0b00000000000000000100000000000010
+#define FTMP_FLAGS_FITNESS_MACINE_FEATURES_FIELD MicroBitFitnessMachineProfile::FEATURES
 
 /*
 # Definition of the bits of the Target Setting Features field
 #                                                  000000000000000 (bits 17-31) Reserved for Future Use
-#                                                                 0 (bit 16) Targeted Cadence Configuration Supported
+#                                                                 1 (bit 16)*Targeted Cadence Configuration Supported
 #                                                                  0 (bit 15) Spin Down Control Supported
 #                                                                   0 (bit 14) Wheel Circumference Configuration Supported
-#                                                                    0 (bit 13) Indoor Bike Simulation Parameters Supported
+#                                                                    1 (bit 13)*Indoor Bike Simulation Parameters Supported
 #                                                                     0 (bit 12) Targeted Time in Five Heart Rate Zones Configuration Supported
 #                                                                      0 (bit 11) Targeted Time in Three Heart Rate Zones Configuration Supported
 #                                                                       0 (bit 10) Targeted Time in Two Heart Rate Zones Configuration Supported
@@ -110,16 +138,51 @@ SOFTWARE.
 #                                                                           0 (bit  6) Targeted Step Number Configuration Supported
 #                                                                            0 (bit  5) Targeted Expended Energy Configuration Supported
 #                                                                             0 (bit  4) Heart Rate Target Setting Supported
-#                                                                              0 (bit  3) Power Target Setting Supported
-#                                                                               0 (bit  2) Resistance Target Setting Supported
+#                                                                              1 (bit  3)*Power Target Setting Supported
+#                                                                               1 (bit  2)*Resistance Target Setting Supported
 #                                                                                0 (bit  1) Inclination Target Setting Supported
-#                                                                                 0 (bit  0) Speed Target Setting Supported
+#                                                                                 1 (bit  0)*Speed Target Setting Supported
 #                                                  10987654321098765432109876543210 */
-#define FTMP_FLAGS_TARGET_SETTING_FEATURES_FIELD 0b00000000000000000000000000000000
+#define FTMP_FLAGS_TARGET_SETTING_FEATURES_FIELD 0b00000000000000010010000000001101
+
+// # Supported Resistance Level Range [SINT16 minimum, SINT16 maximum, UINT16 increment, 0.1]
+#define FTMP_VAL_SUPPORTED_RESISTANCE_LEVEL_INCREMENT 1
+
+// # Supported Speed Range [UINT16 minimum, UINT16 maximum, UINT16 increment, 0.01 km/h] - Set Target Speed
+#define FTMP_VAL_SUPPORTED_SPEED_MIN100       0
+#define FTMP_VAL_SUPPORTED_SPEED_MAX100       6000
+#define FTMP_VAL_SUPPORTED_SPEED_INCREMENT100 1
+
+// # Supported Power Range [SINT16 minimum, SINT16 maximum, UINT16 increment, W] - Set Target Power
+#define FTMP_VAL_SUPPORTED_POWER_MIN       0
+#define FTMP_VAL_SUPPORTED_POWER_MAX       1000
+#define FTMP_VAL_SUPPORTED_POWER_INCREMENT 1
 
 // # Fitness Machine Status values
 // # 0x01 Reset
 #define FTMP_OP_CODE_FITNESS_MACHINE_STATUS_01_RESET                                      0x01
+// # 0x02 Fitness Machine Stopped or Paused by the User [UINT8, 0x01-STOP, 0x02-PAUSE]
+#define FTMP_OP_CODE_FITNESS_MACHINE_STATUS_02_STOPPED_PAUSED_BY_USER                     0x02
+// # 0x04 Fitness Machine Started or Resumed by the User
+#define FTMP_OP_CODE_FITNESS_MACHINE_STATUS_04_STARTED_RESUMED_BY_USER                    0x04
+// # 0x05 Target Speed Changed [UINT16, 0.01 km/h]
+#define FTMP_OP_CODE_FITNESS_MACHINE_STATUS_05_TARGET_SPEED_CHANGED                       0x05
+// # 0x07 Target Resistance Level Changed [UINT8, 0.1]
+#define FTMP_OP_CODE_FITNESS_MACHINE_STATUS_07_TARGET_RESISTANCE_LEVEL_CHANGED            0x07
+// # 0x08 Target Power Changed [SINT16, W]
+#define FTMP_OP_CODE_FITNESS_MACHINE_STATUS_08_TARGET_POWER_CHANGED                       0x08
+// # 0x12 Indoor Bike Simulation Parameters Changed [SINT16 wind speed 0.001 m/s, SINT16 grade 0.01 %, UINT8 crr 0.0001, UINT8 cw 0.01 kg/m]
+#define FTMP_OP_CODE_FITNESS_MACHINE_STATUS_12_INDOOR_BIKE_SIMULATION_CHANGED             0x12
+// # 0x15 Targeted Cadence Changed [UINT16, 0.5 rpm]
+#define FTMP_OP_CODE_FITNESS_MACHINE_STATUS_15_TARGETED_CADENCE_CHANGED                   0x15
+
+// # Parameter of Stop or Pause
+#define FTMP_VAL_STOP_PAUSE_01_STOP  0x01
+#define FTMP_VAL_STOP_PAUSE_02_PAUSE 0x02
+
+// # Parameter of Spin Down Control
+#define FTMP_VAL_SPIN_DOWN_01_START  0x01
+#define FTMP_VAL_SPIN_DOWN_02_IGNORE 0x02
 
 // # Bit Definitions for the Training Status Characteristic
 // # (bits 2-7) Reseved for Future Use
@@ -136,6 +199,34 @@ SOFTWARE.
 // # UINT8 Manual Mode (Quick Start)
 #define FTMP_VAL_TRAINING_STATUS_0D_MANUAL_MODE 0x0D
 
+/**
+  * Live data in the advertising payload.
+  * The Indoor Bike Data bytes are advertised as Manufacturer Specific Data, so any number of scanners can read them without a connection.
+  * Rower Data fits the payload as well; Cross Trainer Data does not, and stays OFF.
+  */
+enum MicroBitIndoorBikeBroadcastMode
+{
+    INDOOR_BIKE_BROADCAST_OFF = 0,          // static payload (FTMS service data only)
+    INDOOR_BIKE_BROADCAST_CONNECTABLE = 1,  // live data while advertising, centrals can still connect
+    INDOOR_BIKE_BROADCAST_ONLY = 2          // live data, scannable advertising (no connections) that never stops
+};
+
+/**
+  * Training session, driven by the Fitness Machine Control Point.
+  *  - Start or Resume: IDLE, PAUSED -> RUNNING; STOPPED -> RUNNING with a new session (analytics reset).
+  *  - Stop: any -> STOPPED. Pause: RUNNING -> PAUSED only.
+  *  - Reset: any -> IDLE with a new session.
+  * The state reaches the sensor (setSessionPaused), so PAUSED and STOPPED time is not counted by the power analytics
+  * nor the crank revolutions, and neither Indoor Bike Data nor the CSC, CPS and diagnostics services notify meanwhile.
+  */
+enum MicroBitIndoorBikeSessionState
+{
+    INDOOR_BIKE_SESSION_IDLE = 0,
+    INDOOR_BIKE_SESSION_RUNNING = 1,
+    INDOOR_BIKE_SESSION_PAUSED = 2,
+    INDOOR_BIKE_SESSION_STOPPED = 3
+};
+
 class MicroBitIndoorBikeStepService
 {
 
@@ -145,8 +236,9 @@ public:
       * Create a representation of the FTMS.
       * @param _uBit The instance of a MicroBit runtime include a BLE device that we're running on.
       * @param _indoorBike An instance of MicroBitIndoorBikeStepSensor to use as our indoor bike source.
+      * @param _connections The table of connected centrals to fan the notifications out to.
       */
-    MicroBitIndoorBikeStepService(MicroBit &_uBit, MicroBitIndoorBikeStepSensor &_indoorBike, uint16_t id = MICROBIT_INDOORBIKE_STEP_SERVICE_ID);
+    MicroBitIndoorBikeStepService(MicroBit &_uBit, MicroBitIndoorBikeStepSensor &_indoorBike, MicroBitBLEConnectionTable &_connections, uint16_t id = MICROBIT_INDOORBIKE_STEP_SERVICE_ID);
 
 private:
     /**
@@ -154,55 +246,171 @@ private:
       */
     void onDataWritten(const GattWriteCallbackParams *params);
 
+    /**
+      * Callback. Invoked before a write of the Fitness Machine Control Point is accepted.
+      */
+    void onControlPointWriteAuthorization(GattWriteAuthCallbackParams *params);
+
     /**
       * Fitness Machine Control Point procedure.
       */
     void doFitnessMachineControlPoint(const GattWriteCallbackParams *params);
 
+    /**
+      * Control point procedures, in the table of op codes.
+      * The parameters are already decoded with the format of the op code, the procedure checks their values.
+      * @return FTMP_RESULT_CODE_CPPR_01_SUCCESS, or the result code of the failure.
+      */
+    uint8_t doRequestControl(MicroBitBLEConnection *client, const int32_t *param);
+    uint8_t doReset(MicroBitBLEConnection *client, const int32_t *param);
+    uint8_t doSetTargetSpeed(MicroBitBLEConnection *client, const int32_t *param);
+    uint8_t doSetTargetResistanceLevel(MicroBitBLEConnection *client, const int32_t *param);
+    uint8_t doSetTargetPower(MicroBitBLEConnection *client, const int32_t *param);
+    uint8_t doStartOrResume(MicroBitBLEConnection *client, const int32_t *param);
+    uint8_t doStopOrPause(MicroBitBLEConnection *client, const int32_t *param);
+    uint8_t doSetIndoorBikeSimulation(MicroBitBLEConnection *client, const int32_t *param);
+    uint8_t doSpinDownControl(MicroBitBLEConnection *client, const int32_t *param);
+    uint8_t doSetTargetedCadence(MicroBitBLEConnection *client, const int32_t *param);
+
+    /**
+      * Decode the parameters of a control point write, one integer per field of the struct format.
+      * @return The number of fields, -1 if the format has a field that is not an integer.
+      */
+    static int decodeControlPointParameters(const char *format, const uint8_t *data, int32_t *param);
+
     /**
      * Indoor Bike update callback
      */
     void indoorBikeUpdate(MicroBitEvent e);
 
+    /**
+     * Build the advertising payload for the current broadcast mode, and start advertising.
+     * @return The error of startAdvertising(), BLE_ERROR_NONE if it runs.
+     */
+    ble_error_t setupAdvertising(void);
+
+    /**
+     * Replace the live data of the advertising payload with an encoded Indoor Bike Data.
+     */
+    void updateBroadcastData(const uint8_t *machineData);
+
 private:
     // instance
     MicroBit &uBit;
     MicroBitIndoorBikeStepSensor &indoorBike;
+    MicroBitBLEConnectionTable &connections;
     
     // Event Bus ID of this service
     uint16_t id;
     
+    // Advertising payload of the runtime before the service, the base of the payload with broadcast off
+    GapAdvertisingData basePayload;
+    // Advertising interval of the runtime (ms), restored when broadcast only ends
+    uint16_t advertisingInterval;
+    
     // Characteristic buffer
-    static const uint16_t indoorBikeDataCharacteristicBufferSize = 2+2+2+2; // "<HHHh", FTMS p.42, <Flags>, <Instantaneous Speed>, <Instantaneous Cadence>, <Instantaneous Power Present>
-    uint8_t indoorBikeDataCharacteristicBuffer[indoorBikeDataCharacteristicBufferSize];
+    static const uint16_t machineDataCharacteristicBufferSize = MicroBitFitnessMachineProfile::DATA_SIZE; // Indoor Bike Data, Rower Data or Cross Trainer Data
+    uint8_t machineDataCharacteristicBuffer[machineDataCharacteristicBufferSize];
     static const uint16_t fitnessMachineControlPointCharacteristicBufferSize = 1+18; // "<B*" , FTMS p.50, <Op Code>, <Parameter>
     uint8_t fitnessMachineControlPointCharacteristicBuffer[fitnessMachineControlPointCharacteristicBufferSize];
     static const uint16_t fitnessMachineFeatureCharacteristicBufferSize = 4+4;// "<II" , FTMS p.19, <Fitness Machine Features>, <Target Setting Features>
     uint8_t fitnessMachineFeatureCharacteristicBuffer[fitnessMachineFeatureCharacteristicBufferSize];
-    static const uint16_t fitnessMachineStatusCharacteristicBufferSize = 1+0; // "<B*" , FTMS p.66, <Op Code>, <Parameter>
+    static const uint16_t supportedResistanceLevelRangeCharacteristicBufferSize = 2+2+2; // "<hhH" , FTMS p.56, <Minimum>, <Maximum>, <Minimum Increment>
+    uint8_t supportedResistanceLevelRangeCharacteristicBuffer[supportedResistanceLevelRangeCharacteristicBufferSize];
+    static const uint16_t supportedSpeedRangeCharacteristicBufferSize = 2+2+2; // "<HHH" , FTMS p.54, <Minimum>, <Maximum>, <Minimum Increment>
+    uint8_t supportedSpeedRangeCharacteristicBuffer[supportedSpeedRangeCharacteristicBufferSize];
+    static const uint16_t supportedPowerRangeCharacteristicBufferSize = 2+2+2; // "<hhH" , FTMS p.58, <Minimum>, <Maximum>, <Minimum Increment>
+    uint8_t supportedPowerRangeCharacteristicBuffer[supportedPowerRangeCharacteristicBufferSize];
+    static const uint16_t fitnessMachineStatusCharacteristicBufferSize = 1+6; // "<B*" , FTMS p.66, <Op Code>, <Parameter> (up to "<hhBB" of the simulation parameters)
     uint8_t fitnessMachineStatusCharacteristicBuffer[fitnessMachineStatusCharacteristicBufferSize];
     static const uint16_t fitnessTrainingStatusCharacteristicBufferSize = 1+1; // "<BB" , FTMS p.46, <Flags>, <Training Status>, <Training Status String (if present)>
     uint8_t fitnessTrainingStatusCharacteristicBuffer[fitnessTrainingStatusCharacteristicBufferSize];
     
     // Handles to access each characteristic when they are held by Soft Device.
-    GattAttribute::Handle_t indoorBikeDataCharacteristicHandle;
+    GattAttribute::Handle_t machineDataCharacteristicHandle;
     GattAttribute::Handle_t fitnessMachineControlPointCharacteristicHandle;
     GattAttribute::Handle_t fitnessMachineFeatureCharacteristicHandle;
+    GattAttribute::Handle_t supportedResistanceLevelRangeCharacteristicHandle;
+    GattAttribute::Handle_t supportedSpeedRangeCharacteristicHandle;
+    GattAttribute::Handle_t supportedPowerRangeCharacteristicHandle;
     GattAttribute::Handle_t fitnessMachineStatusCharacteristicHandle;
     GattAttribute::Handle_t fitnessTrainingStatusCharacteristicHandle;
+    
+    // Notify/Indicate characteristics, kept for the subscription tracking of the connection table.
+    GattCharacteristic *machineDataCharacteristic;
+    GattCharacteristic *fitnessMachineControlPointCharacteristic;
+    GattCharacteristic *fitnessMachineStatusCharacteristic;
+    GattCharacteristic *fitnessTrainingStatusCharacteristic;
+    
+    // Index of each characteristic in the connection table.
+    int machineDataIndex;
+    int fitnessMachineControlPointIndex;
+    int fitnessMachineStatusIndex;
+    int fitnessTrainingStatusIndex;
+
+    // Fitness Machine Control Point op code, indexed by the op code
+    struct ControlPointOp
+    {
+        // struct format of the parameters after the op code ("<": none): their length, and how they are decoded
+        const char *format;
+        // NULL: op code not supported
+        uint8_t (MicroBitIndoorBikeStepService::*procedure)(MicroBitBLEConnection *client, const int32_t *param);
+        // Fitness Machine Status and Training Status, notified after the response when the procedure succeeded (NULL: none)
+        void (MicroBitIndoorBikeStepService::*status)(void);
+    };
+    static const ControlPointOp controlPointOps[FTMP_OP_CODE_CPPR_COUNT];
+    // Most fields of a control point format ("<HHHHH" of five heart rate zones)
+    static const int controlPointParamMax = 5;
+
+    // Data characteristic of the machine (MICROBIT_FTMS_MACHINE)
+    MicroBitFitnessMachineProfile machine;
+    // Largest data that fits the advertising payload of the broadcast modes
+    static const uint16_t broadcastDataMaxSize = 9;
 
     // var
     uint8_t stopOrPause;
+    // Targets of the control point, reported back in the Fitness Machine Status.
+    // Target power and the grade of the simulation drive the resistance level (not saved to flash).
+    uint16_t targetSpeed100;
+    int16_t targetPower;
+    bool targetPowerActive;
+    int16_t simulationWindSpeed1000;
+    int16_t simulationGrade100;
+    uint8_t simulationCrr10000;
+    uint8_t simulationCw100;
+    uint16_t targetCadence2;
+    MicroBitIndoorBikeSessionState sessionState;
+    MicroBitIndoorBikeBroadcastMode broadcastMode;
+    MicroBitTelemetry *telemetry;
     
 public:
     // getter/setter
     uint8_t getStopOrPause(void);
+    MicroBitIndoorBikeSessionState getSessionState(void);
+    MicroBitIndoorBikeBroadcastMode getBroadcastMode(void);
+    // The mode stays as it was if the data does not fit the payload, or the stack refuses its advertising
+    void setBroadcastMode(MicroBitIndoorBikeBroadcastMode mode);
+    // Log control point writes (NULL: off)
+    void setTelemetry(MicroBitTelemetry *telemetry);
 
 private:
     // status message
     void sendTrainingStatusIdle(void);
     void sendTrainingStatusManualMode(void);
     void sendFitnessMachineStatusReset(void);
+    void sendFitnessMachineStatusStartedOrResumed(void);
+    void sendFitnessMachineStatusStoppedOrPaused(void);
+    void sendFitnessMachineStatusTargetSpeed(void);
+    void sendFitnessMachineStatusTargetResistanceLevel(void);
+    void sendFitnessMachineStatusTargetPower(void);
+    void sendFitnessMachineStatusIndoorBikeSimulation(void);
+    void sendFitnessMachineStatusTargetedCadence(void);
+
+    // targets
+    void resetTargets(void);
+
+    // session
+    void setSessionState(MicroBitIndoorBikeSessionState state);
 
 };
 
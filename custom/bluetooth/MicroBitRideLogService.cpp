@@ -0,0 +1,240 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "MicroBitRideLogService.h"
+#include "struct.h"
+
+MicroBitRideLogService::MicroBitRideLogService(MicroBit &_uBit, MicroBitRideLogRecorder &_recorder, MicroBitBLEConnectionTable &_connections, uint16_t id)
+    : uBit(_uBit), recorder(_recorder), connections(_connections), cursor(_recorder.getLog())
+{
+    this->id = id;
+    this->connHandle = 0;
+    this->startSequence = 0;
+    this->startOffset = 0;
+    this->streaming = false;
+    this->pumping = false;
+    this->pumpAgain = false;
+
+    // Caractieristic
+    GattCharacteristic controlPointCharacteristic(
+        UUID(MicroBitRideLogServiceControlPointUUID)
+        , (uint8_t *)&controlPointCharacteristicBuffer, 0, controlPointCharacteristicBufferSize
+        , GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE
+    );
+    dataCharacteristic = new GattCharacteristic(
+        UUID(MicroBitRideLogServiceDataUUID)
+        , (uint8_t *)&dataCharacteristicBuffer, 0, dataCharacteristicBufferSize
+        , GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY
+    );
+
+    // Set default security requirements
+    controlPointCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+    dataCharacteristic->requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+
+    // Service
+    GattCharacteristic *characteristics[] = {
+        &controlPointCharacteristic,
+        dataCharacteristic,
+    };
+    GattService service(
+        UUID(MicroBitRideLogServiceUUID), characteristics, sizeof(characteristics) / sizeof(GattCharacteristic *)
+    );
+    if (uBit.ble->addService(service) != BLE_ERROR_NONE)
+    {
+        // MICROBIT_SD_GATT_TABLE_SIZE (mbed_app.json) has no room for the service
+        uBit.panic(MICROBIT_BLE_PANIC_GATT_TABLE_FULL);
+    }
+
+    // Characteristic Handle
+    controlPointCharacteristicHandle = controlPointCharacteristic.getValueHandle();
+    dataCharacteristicHandle = dataCharacteristic->getValueHandle();
+
+    // Subscription tracking per connection
+    dataIndex = connections.addCharacteristic(dataCharacteristic);
+
+    // GattServer / Gap events
+    uBit.ble->onDataWritten(this, &MicroBitRideLogService::onDataWritten);
+    uBit.ble->gattServer().onDataSent(this, &MicroBitRideLogService::onDataSent);
+    uBit.ble->gap().onDisconnection(this, &MicroBitRideLogService::onDisconnection);
+
+    // Microbit Event listen
+    if (EventModel::defaultEventBus)
+    {
+        EventModel::defaultEventBus->listen(this->id, MICROBIT_RIDE_LOG_SERVICE_EVT_START
+            , this, &MicroBitRideLogService::onStart);
+    }
+}
+
+void MicroBitRideLogService::onDataWritten(const GattWriteCallbackParams *params)
+{
+    if (params->handle != controlPointCharacteristicHandle || params->len < 1)
+    {
+        return;
+    }
+
+    switch (params->data[0])
+    {
+    case RIDE_LOG_OP_CODE_01_START:
+        if (params->len == controlPointCharacteristicBufferSize)
+        {
+            uint8_t opCode;
+            struct_unpack(params->data, "<BIH", &opCode, &this->startSequence, &this->startOffset);
+            this->connHandle = params->connHandle;
+            // Flushing the ride log waits for the flash: not in a BLE callback.
+            MicroBitEvent(this->id, MICROBIT_RIDE_LOG_SERVICE_EVT_START);
+        }
+        break;
+
+    case RIDE_LOG_OP_CODE_02_STOP:
+        if (params->connHandle == this->connHandle)
+        {
+            this->stop();
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+void MicroBitRideLogService::onDataSent(unsigned count)
+{
+    if (this->streaming)
+    {
+        this->pump();
+    }
+}
+
+void MicroBitRideLogService::onDisconnection(const Gap::DisconnectionCallbackParams_t *params)
+{
+    if (params->handle == this->connHandle)
+    {
+        this->stop();
+    }
+}
+
+void MicroBitRideLogService::onStart(MicroBitEvent e)
+{
+    // A serial export holds the lock; a restart keeps it.
+    if (!this->streaming && !this->recorder.lock())
+    {
+        return;
+    }
+    this->streaming = false;
+    this->recorder.getLog().flush();
+    this->cursor.start(this->startSequence, this->startOffset);
+    this->streaming = true;
+    this->pump();
+}
+
+void MicroBitRideLogService::pump(void)
+{
+    __disable_irq();
+    if (this->pumping)
+    {
+        // the running pump() goes round once more
+        this->pumpAgain = true;
+        __enable_irq();
+        return;
+    }
+    this->pumping = true;
+    __enable_irq();
+
+    // No SoftDevice call with the interrupts disabled.
+    for (;;)
+    {
+        while (this->streaming && this->send())
+        {
+        }
+        __disable_irq();
+        if (!this->pumpAgain)
+        {
+            this->pumping = false;
+            __enable_irq();
+            break;
+        }
+        this->pumpAgain = false;
+        __enable_irq();
+    }
+}
+
+bool MicroBitRideLogService::send(void)
+{
+    // The stack takes a notification without a subscription and sends nothing.
+    MicroBitBLEConnection *c = this->connections.find(this->connHandle);
+    if (c == NULL || !(c->subscriptions & (1UL << this->dataIndex)))
+    {
+        this->stop();
+        return false;
+    }
+
+    uint8_t packet[MICROBIT_RIDE_LOG_CURSOR_PACKET_MAX];
+    int len = this->cursor.peek(packet);
+    if (len == 0)
+    {
+        this->stop();
+        return false;
+    }
+
+    ble_error_t error = uBit.ble->gattServer().write(this->connHandle, this->dataCharacteristicHandle, packet, len);
+    if (error == BLE_ERROR_NONE)
+    {
+        this->cursor.advance();
+        if (this->cursor.finished())
+        {
+            this->stop();
+        }
+        return true;
+    }
+    if (error != BLE_ERROR_NO_MEM && error != BLE_STACK_BUSY)
+    {
+        this->stop();
+    }
+    // The transmit buffers are full until the next TX complete event.
+    return false;
+}
+
+void MicroBitRideLogService::stop(void)
+{
+    __disable_irq();
+    bool wasStreaming = this->streaming;
+    this->streaming = false;
+    __enable_irq();
+    if (wasStreaming)
+    {
+        this->recorder.unlock();
+    }
+}
+
+const uint8_t MicroBitRideLogServiceUUID[] = {
+    0xa3,0xc8,0x00,0x01,0x5d,0x1e,0x4f,0x3c,0x9b,0x7a,0x2f,0x6c,0x1d,0x0e,0x8b,0x41
+};
+
+const uint8_t MicroBitRideLogServiceControlPointUUID[] = {
+    0xa3,0xc8,0x00,0x02,0x5d,0x1e,0x4f,0x3c,0x9b,0x7a,0x2f,0x6c,0x1d,0x0e,0x8b,0x41
+};
+
+const uint8_t MicroBitRideLogServiceDataUUID[] = {
+    0xa3,0xc8,0x00,0x03,0x5d,0x1e,0x4f,0x3c,0x9b,0x7a,0x2f,0x6c,0x1d,0x0e,0x8b,0x41
+};
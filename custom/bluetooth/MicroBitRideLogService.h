@@ -0,0 +1,118 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MICROBIT_RIDE_LOG_SERVICE_H
+#define MICROBIT_RIDE_LOG_SERVICE_H
+
+#include "MicroBit.h"
+#include "MicroBitCustom.h"
+#include "MicroBitBLEConnectionTable.h"
+#include "MicroBitRideLogRecorder.h"
+#include "MicroBitRideLogCursor.h"
+
+/**
+  * Control point op codes (write)
+  */
+// 0x01 Start  "<BIH" block sequence number (0: oldest block), byte offset in the block
+// 0x02 Stop   "<B"
+#define RIDE_LOG_OP_CODE_01_START   0x01
+#define RIDE_LOG_OP_CODE_02_STOP    0x02
+
+// Custom UUIDs
+extern const uint8_t MicroBitRideLogServiceUUID[];
+extern const uint8_t MicroBitRideLogServiceControlPointUUID[];
+extern const uint8_t MicroBitRideLogServiceDataUUID[];
+
+/**
+  * Bulk export of the ride log over BLE.
+  * The data characteristic notifies the packets of MicroBitRideLogCursor back to back:
+  * every TX complete event of the stack refills the free transmit buffers, so each connection event carries
+  * as many packets as the stack allows. The ride log is not written during an export.
+  */
+class MicroBitRideLogService
+{
+
+public:
+    /**
+      * Constructor.
+      * @param _uBit The instance of a MicroBit runtime include a BLE device that we're running on.
+      * @param _recorder The recorder of the ride log to export.
+      * @param _connections The table of connected centrals.
+      */
+    MicroBitRideLogService(MicroBit &_uBit, MicroBitRideLogRecorder &_recorder, MicroBitBLEConnectionTable &_connections, uint16_t id = MICROBIT_RIDE_LOG_SERVICE_ID);
+
+private:
+    // GattServer / Gap callbacks
+    void onDataWritten(const GattWriteCallbackParams *params);
+    void onDataSent(unsigned count);
+    void onDisconnection(const Gap::DisconnectionCallbackParams_t *params);
+
+    // Start (or restart) an export, in a fiber: the ride log is flushed first
+    void onStart(MicroBitEvent e);
+    // Fill the transmit buffers
+    void pump(void);
+    // Send one packet, false when the stack has no buffer left or the export ended
+    bool send(void);
+    // End the export and let the recorder write again
+    void stop(void);
+
+private:
+    // instance
+    MicroBit &uBit;
+    MicroBitRideLogRecorder &recorder;
+    MicroBitBLEConnectionTable &connections;
+
+    // Event Bus ID of this service
+    uint16_t id;
+
+    // Characteristic buffer
+    static const uint16_t controlPointCharacteristicBufferSize = 1+4+2; // "<BIH", <Op Code>, <Block Sequence Number>, <Byte Offset>
+    uint8_t controlPointCharacteristicBuffer[controlPointCharacteristicBufferSize];
+    static const uint16_t dataCharacteristicBufferSize = MICROBIT_RIDE_LOG_CURSOR_PACKET_MAX; // MicroBitRideLogCursor packet
+    uint8_t dataCharacteristicBuffer[dataCharacteristicBufferSize];
+
+    // Handles to access each characteristic when they are held by Soft Device.
+    GattAttribute::Handle_t controlPointCharacteristicHandle;
+    GattAttribute::Handle_t dataCharacteristicHandle;
+
+    // Notify characteristic, kept for the subscription tracking of the connection table.
+    GattCharacteristic *dataCharacteristic;
+    // Index of the characteristic in the connection table.
+    int dataIndex;
+
+    MicroBitRideLogCursor cursor;
+
+    // The central of the export, and the position it asked for
+    Gap::Handle_t connHandle;
+    uint32_t startSequence;
+    uint16_t startOffset;
+
+    // pump() runs from a fiber and from TX complete events
+    volatile bool streaming;
+    volatile bool pumping;
+    volatile bool pumpAgain;
+
+};
+
+#endif /* #ifndef MICROBIT_RIDE_LOG_SERVICE_H */
@@ -2,6 +2,7 @@
 #include "struct_endian.h"
 
 #include <stdarg.h>
+#include <limits.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -37,12 +38,9 @@
 
 #define CLEAR_REPETITION(_x) _struct_rep = 0
 
-static int myendian = STRUCT_ENDIAN_NOT_SET;
-
-static void struct_init(void)
-{
-    myendian = struct_get_endian();
-}
+// reject counts that would overflow _struct_rep
+#define CHECK_REPETITION(_x) \
+    if (_struct_rep > (INT_MAX - (*p - '0')) / 10) { return -1; }
 
 static uint64_t pack_ieee754(long double f,
         unsigned int bits, unsigned int expbits)
@@ -106,7 +104,9 @@ static uint64_t pack_ieee754(long double f,
     exp = shift + ((1LL << (expbits - 1)) - 1);
 
     // return the final answer
-    return (sign << (bits - 1U)) | (exp << (bits - expbits - 1U)) | significand;
+    return ((uint64_t)sign << (bits - 1U))
+        | ((uint64_t)exp << (bits - expbits - 1U))
+        | (uint64_t)significand;
 }
 
 static long double unpack_ieee754(uint64_t i,
@@ -172,7 +172,7 @@ static long double unpack_ieee754(uint64_t i,
 
 static void pack_int16_t(unsigned char **bp, uint16_t val, int endian)
 {
-    if (endian == myendian) {
+    if (endian == STRUCT_ENDIAN_LITTLE) {
         *((*bp)++) = val;
         *((*bp)++) = val >> 8;
     } else {
@@ -183,7 +183,7 @@ static void pack_int16_t(unsigned char **bp, uint16_t val, int endian)
 
 static void pack_int32_t(unsigned char **bp, uint32_t val, int endian)
 {
-    if (endian == myendian) {
+    if (endian == STRUCT_ENDIAN_LITTLE) {
         *((*bp)++) = val;
         *((*bp)++) = val >> 8;
         *((*bp)++) = val >> 16;
@@ -198,7 +198,7 @@ static void pack_int32_t(unsigned char **bp, uint32_t val, int endian)
 
 static void pack_int64_t(unsigned char **bp, uint64_t val, int endian)
 {
-    if (endian == myendian) {
+    if (endian == STRUCT_ENDIAN_LITTLE) {
         *((*bp)++) = val;
         *((*bp)++) = val >> 8;
         *((*bp)++) = val >> 16;
@@ -234,7 +234,7 @@ static void pack_double(unsigned char **bp, double val, int endian)
 static void unpack_int16_t(const unsigned char **bp, int16_t *dst, int endian)
 {
     uint16_t val;
-    if (endian == myendian) {
+    if (endian == STRUCT_ENDIAN_LITTLE) {
         val = *((*bp)++);
         val |= (uint16_t)(*((*bp)++)) << 8;
     } else {
@@ -250,7 +250,7 @@ static void unpack_int16_t(const unsigned char **bp, int16_t *dst, int endian)
 
 static void unpack_uint16_t(const unsigned char **bp, uint16_t *dst, int endian)
 {
-    if (endian == myendian) {
+    if (endian == STRUCT_ENDIAN_LITTLE) {
         *dst = *((*bp)++);
         *dst |= (uint16_t)(*((*bp)++)) << 8;
     } else {
@@ -262,13 +262,13 @@ static void unpack_uint16_t(const unsigned char **bp, uint16_t *dst, int endian)
 static void unpack_int32_t(const unsigned char **bp, int32_t *dst, int endian)
 {
     uint32_t val;
-    if (endian == myendian) {
+    if (endian == STRUCT_ENDIAN_LITTLE) {
         val = *((*bp)++);
         val |= (uint32_t)(*((*bp)++)) << 8;
         val |= (uint32_t)(*((*bp)++)) << 16;
         val |= (uint32_t)(*((*bp)++)) << 24;
     } else {
-        val = *((*bp)++) << 24;
+        val = (uint32_t)(*((*bp)++)) << 24;
         val |= (uint32_t)(*((*bp)++)) << 16;
         val |= (uint32_t)(*((*bp)++)) << 8;
         val |= (uint32_t)(*((*bp)++));
@@ -282,13 +282,13 @@ static void unpack_int32_t(const unsigned char **bp, int32_t *dst, int endian)
 
 static void unpack_uint32_t(const unsigned char **bp, uint32_t *dst, int endian)
 {
-    if (endian == myendian) {
+    if (endian == STRUCT_ENDIAN_LITTLE) {
         *dst = *((*bp)++);
         *dst |= (uint32_t)(*((*bp)++)) << 8;
         *dst |= (uint32_t)(*((*bp)++)) << 16;
         *dst |= (uint32_t)(*((*bp)++)) << 24;
     } else {
-        *dst = *((*bp)++) << 24;
+        *dst = (uint32_t)(*((*bp)++)) << 24;
         *dst |= (uint32_t)(*((*bp)++)) << 16;
         *dst |= (uint32_t)(*((*bp)++)) << 8;
         *dst |= (uint32_t)(*((*bp)++));
@@ -298,7 +298,7 @@ static void unpack_uint32_t(const unsigned char **bp, uint32_t *dst, int endian)
 static void unpack_int64_t(const unsigned char **bp, int64_t *dst, int endian)
 {
     uint64_t val;
-    if (endian == myendian) {
+    if (endian == STRUCT_ENDIAN_LITTLE) {
         val = *((*bp)++);
         val |= (uint64_t)(*((*bp)++)) << 8;
         val |= (uint64_t)(*((*bp)++)) << 16;
@@ -326,7 +326,7 @@ static void unpack_int64_t(const unsigned char **bp, int64_t *dst, int endian)
 
 static void unpack_uint64_t(const unsigned char **bp, uint64_t *dst, int endian)
 {
-    if (endian == myendian) {
+    if (endian == STRUCT_ENDIAN_LITTLE) {
         *dst = *((*bp)++);
         *dst |= (uint64_t)(*((*bp)++)) << 8;
         *dst |= (uint64_t)(*((*bp)++)) << 16;
@@ -367,8 +367,8 @@ static int pack_va_list(unsigned char *buf, int offset, const char *fmt,
     INIT_REPETITION();
     const char *p;
     unsigned char *bp;
-    int *ep = &myendian;
-    int endian;
+    const int native = STRUCT_ENDIAN_NATIVE;
+    int endian = native;
 
     char b;
     unsigned char B;
@@ -382,10 +382,6 @@ static int pack_va_list(unsigned char *buf, int offset, const char *fmt,
     double d;
     char *s;
 
-    if (STRUCT_ENDIAN_NOT_SET == myendian) {
-        struct_init();
-    }
-
     /*
      * 'char' and 'short' values, they must be extracted as 'int's,
      * because C promotes 'char' and 'short' arguments to 'int' when they are
@@ -396,19 +392,16 @@ static int pack_va_list(unsigned char *buf, int offset, const char *fmt,
     for (p = fmt; *p != '\0'; p++) {
         switch (*p) {
         case '=': /* native */
-            ep = &myendian;
+            endian = native;
             break;
         case '<': /* little-endian */
             endian = STRUCT_ENDIAN_LITTLE;
-            ep = &endian;
             break;
         case '>': /* big-endian */
             endian = STRUCT_ENDIAN_BIG;
-            ep = &endian;
             break;
         case '!': /* network (= big-endian) */
             endian = STRUCT_ENDIAN_BIG;
-            ep = &endian;
             break;
         case 'b':
             BEGIN_REPETITION();
@@ -425,51 +418,51 @@ static int pack_va_list(unsigned char *buf, int offset, const char *fmt,
         case 'h':
             BEGIN_REPETITION();
                 h = va_arg(args, int);
-                pack_int16_t(&bp, h, *ep);
+                pack_int16_t(&bp, h, endian);
             END_REPETITION();
             break;
         case 'H':
             BEGIN_REPETITION();
                 H = va_arg(args, int);
-                pack_int16_t(&bp, H, *ep);
+                pack_int16_t(&bp, H, endian);
             END_REPETITION();
             break;
         case 'i': /* fall through */
         case 'l':
             BEGIN_REPETITION();
                 l = va_arg(args, int32_t);
-                pack_int32_t(&bp, l, *ep);
+                pack_int32_t(&bp, l, endian);
             END_REPETITION();
             break;
         case 'I': /* fall through */
         case 'L':
             BEGIN_REPETITION();
                 L = va_arg(args, uint32_t);
-                pack_int32_t(&bp, L, *ep);
+                pack_int32_t(&bp, L, endian);
             END_REPETITION();
             break;
         case 'q':
             BEGIN_REPETITION();
                 q = va_arg(args, int64_t);
-                pack_int64_t(&bp, q, *ep);
+                pack_int64_t(&bp, q, endian);
             END_REPETITION();
             break;
         case 'Q':
             BEGIN_REPETITION();
                 Q = va_arg(args, uint64_t);
-                pack_int64_t(&bp, Q, *ep);
+                pack_int64_t(&bp, Q, endian);
             END_REPETITION();
             break;
         case 'f':
             BEGIN_REPETITION();
                 f = va_arg(args, double);
-                pack_float(&bp, f, *ep);
+                pack_float(&bp, f, endian);
             END_REPETITION();
             break;
         case 'd':
             BEGIN_REPETITION();
                 d = va_arg(args, double);
-                pack_double(&bp, d, *ep);
+                pack_double(&bp, d, endian);
             END_REPETITION();
             break;
         case 's': /* fall through */
@@ -489,6 +482,7 @@ static int pack_va_list(unsigned char *buf, int offset, const char *fmt,
             break;
         default:
             if (isdigit((int)*p)) {
+                CHECK_REPETITION();
                 INC_REPETITION();
             } else {
                 return -1;
@@ -511,8 +505,8 @@ static int unpack_va_list(
     INIT_REPETITION();
     const char *p;
     const unsigned char *bp;
-    int *ep = &myendian;
-    int endian;
+    const int native = STRUCT_ENDIAN_NATIVE;
+    int endian = native;
 
     char *b;
     unsigned char *B;
@@ -526,27 +520,20 @@ static int unpack_va_list(
     double *d;
     char *s;
 
-    if (STRUCT_ENDIAN_NOT_SET == myendian) {
-        struct_init();
-    }
-
     bp = buf + offset;
     for (p = fmt; *p != '\0'; p++) {
         switch (*p) {
         case '=': /* native */
-            ep = &myendian;
+            endian = native;
             break;
         case '<': /* little-endian */
             endian = STRUCT_ENDIAN_LITTLE;
-            ep = &endian;
             break;
         case '>': /* big-endian */
             endian = STRUCT_ENDIAN_BIG;
-            ep = &endian;
             break;
         case '!': /* network (= big-endian) */
             endian = STRUCT_ENDIAN_BIG;
-            ep = &endian;
             break;
         case 'b':
             BEGIN_REPETITION();
@@ -563,51 +550,51 @@ static int unpack_va_list(
         case 'h':
             BEGIN_REPETITION();
                 h = va_arg(args, int16_t*);
-                unpack_int16_t(&bp, h, *ep);
+                unpack_int16_t(&bp, h, endian);
             END_REPETITION();
             break;
         case 'H':
             BEGIN_REPETITION();
                 H = va_arg(args, uint16_t*);
-                unpack_uint16_t(&bp, H, *ep);
+                unpack_uint16_t(&bp, H, endian);
             END_REPETITION();
             break;
         case 'i': /* fall through */
         case 'l':
             BEGIN_REPETITION();
                 l = va_arg(args, int32_t*);
-                unpack_int32_t(&bp, l, *ep);
+                unpack_int32_t(&bp, l, endian);
             END_REPETITION();
             break;
         case 'I': /* fall through */
         case 'L':
             BEGIN_REPETITION();
                 L = va_arg(args, uint32_t*);
-                unpack_uint32_t(&bp, L, *ep);
+                unpack_uint32_t(&bp, L, endian);
             END_REPETITION();
             break;
         case 'q':
             BEGIN_REPETITION();
                 q = va_arg(args, int64_t*);
-                unpack_int64_t(&bp, q, *ep);
+                unpack_int64_t(&bp, q, endian);
             END_REPETITION();
             break;
         case 'Q':
             BEGIN_REPETITION();
                 Q = va_arg(args, uint64_t*);
-                unpack_uint64_t(&bp, Q, *ep);
+                unpack_uint64_t(&bp, Q, endian);
             END_REPETITION();
             break;
         case 'f':
             BEGIN_REPETITION();
                 f = va_arg(args, float*);
-                unpack_float(&bp, f, *ep);
+                unpack_float(&bp, f, endian);
             END_REPETITION();
             break;
         case 'd':
             BEGIN_REPETITION();
                 d = va_arg(args, double*);
-                unpack_double(&bp, d, *ep);
+                unpack_double(&bp, d, endian);
             END_REPETITION();
             break;
         case 's': /* fall through */
@@ -627,6 +614,7 @@ static int unpack_va_list(
             break;
         default:
             if (isdigit((int)*p)) {
+                CHECK_REPETITION();
                 INC_REPETITION();
             } else {
                 return -1;
@@ -702,93 +690,75 @@ int struct_calcsize(const char *fmt)
 {
     INIT_REPETITION();
     int ret = 0;
+    int size;
     const char *p;
 
-    if (STRUCT_ENDIAN_NOT_SET == myendian) {
-        struct_init();
-    }
-
     for (p = fmt; *p != '\0'; p++) {
         switch (*p) {
         case '=': /* fall through */
         case '<': /* fall through */
         case '>': /* fall through */
         case '!': /* ignore endian characters */
+            size = 0;
             break;
         case 'b':
-            BEGIN_REPETITION();
-            ret += sizeof(int8_t);
-            END_REPETITION();
+            size = sizeof(int8_t);
             break;
         case 'B':
-            BEGIN_REPETITION();
-            ret += sizeof(uint8_t);
-            END_REPETITION();
+            size = sizeof(uint8_t);
             break;
         case 'h':
-            BEGIN_REPETITION();
-            ret += sizeof(int16_t);
-            END_REPETITION();
+            size = sizeof(int16_t);
             break;
         case 'H':
-            BEGIN_REPETITION();
-            ret += sizeof(uint16_t);
-            END_REPETITION();
+            size = sizeof(uint16_t);
             break;
         case 'i': /* fall through */
         case 'l':
-            BEGIN_REPETITION();
-            ret += sizeof(int32_t);
-            END_REPETITION();
+            size = sizeof(int32_t);
             break;
         case 'I': /* fall through */
         case 'L':
-            BEGIN_REPETITION();
-            ret += sizeof(uint32_t);
-            END_REPETITION();
+            size = sizeof(uint32_t);
             break;
         case 'q':
-            BEGIN_REPETITION();
-            ret += sizeof(int64_t);
-            END_REPETITION();
+            size = sizeof(int64_t);
             break;
         case 'Q':
-            BEGIN_REPETITION();
-            ret += sizeof(uint64_t);
-            END_REPETITION();
+            size = sizeof(uint64_t);
             break;
         case 'f':
-            BEGIN_REPETITION();
-            ret += sizeof(int32_t); // see pack_float()
-            END_REPETITION();
+            size = sizeof(int32_t); // see pack_float()
             break;
         case 'd':
-            BEGIN_REPETITION();
-            ret += sizeof(int64_t); // see pack_double()
-            END_REPETITION();
+            size = sizeof(int64_t); // see pack_double()
             break;
         case 's': /* fall through */
         case 'p':
-            BEGIN_REPETITION();
-            ret += sizeof(int8_t);
-            END_REPETITION();
+            size = sizeof(int8_t);
             break;
         case 'x':
-            BEGIN_REPETITION();
-            ret += sizeof(int8_t);
-            END_REPETITION();
+            size = sizeof(int8_t);
             break;
         default:
             if (isdigit((int)*p)) {
+                CHECK_REPETITION();
                 INC_REPETITION();
+                continue;
             } else {
                 return -1;
             }
         }
 
-        if (!isdigit((int)*p)) {
-            CLEAR_REPETITION();
+        // same as BEGIN_REPETITION/END_REPETITION: a count of 0 counts once
+        if (size > 0) {
+            int count = (_struct_rep > 0) ? _struct_rep : 1;
+            if (count > (INT_MAX - ret) / size) {
+                return -1;
+            }
+            ret += count * size;
         }
+        CLEAR_REPETITION();
     }
     return ret;
 }
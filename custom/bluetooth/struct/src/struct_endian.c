@@ -1,9 +1,14 @@
 #include "struct_endian.h"
 
+/* read-only probe: initialized at load time, never written afterwards */
+static const union {
+	unsigned int i;
+	unsigned char c[sizeof(unsigned int)];
+} struct_endian_probe = { 1U };
+
 int struct_get_endian(void)
 {
-	int i = 0x00000001;
-	if (((char *)&i)[0]) {
+	if (struct_endian_probe.c[0]) {
 		return STRUCT_ENDIAN_LITTLE;
 	} else {
 		return STRUCT_ENDIAN_BIG;
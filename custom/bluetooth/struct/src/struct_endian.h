@@ -5,6 +5,26 @@
 #define STRUCT_ENDIAN_BIG       1
 #define STRUCT_ENDIAN_LITTLE    2
 
+/*
+ * STRUCT_ENDIAN_NATIVE is a compile-time constant when the compiler exposes
+ * the target byte order (GCC, Clang and armcc all do). Otherwise it falls
+ * back to struct_get_endian(), which only reads a constant-initialized
+ * object and never writes shared state, so it is safe from any thread.
+ */
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__) \
+    && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define STRUCT_ENDIAN_NATIVE    STRUCT_ENDIAN_LITTLE
+#elif defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) \
+    && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define STRUCT_ENDIAN_NATIVE    STRUCT_ENDIAN_BIG
+#elif defined(__LITTLE_ENDIAN__) || defined(__ARMEL__)
+#define STRUCT_ENDIAN_NATIVE    STRUCT_ENDIAN_LITTLE
+#elif defined(__BIG_ENDIAN__) || defined(__ARMEB__)
+#define STRUCT_ENDIAN_NATIVE    STRUCT_ENDIAN_BIG
+#else
+#define STRUCT_ENDIAN_NATIVE    (struct_get_endian())
+#endif
+
 extern int struct_get_endian(void);
 
 #endif /* !STRUCT_ENDIAN_INCLUDED */
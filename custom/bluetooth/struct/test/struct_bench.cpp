@@ -0,0 +1,149 @@
+/*
+ * struct_bench.cpp
+ *
+ * Throughput benchmark for struct_pack/struct_unpack/struct_calcsize over
+ * the formats the firmware actually uses plus a few wider mixes.
+ *
+ * usage: struct_bench [iterations]
+ */
+
+#include "struct.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+
+namespace {
+
+// keeps results alive so the calls are not optimized away
+volatile uint32_t sink;
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsed_ns(Clock::time_point t0)
+{
+	return std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+}
+
+void report(const char *name, const char *fmt, long iterations, double ns)
+{
+	int size = struct_calcsize(fmt);
+	double per_op = ns / iterations;
+	printf("%-10s %-16s %6.1f ns/op %8.1f MB/s\n",
+			name, fmt, per_op, (size * 1e3) / per_op);
+}
+
+template <typename Pack, typename Unpack>
+void bench(const char *fmt, long iterations, Pack pack, Unpack unpack)
+{
+	unsigned char buf[64];
+	Clock::time_point t0;
+
+	t0 = Clock::now();
+	for (long i = 0; i < iterations; i++) {
+		sink += pack(buf, (uint32_t)i);
+	}
+	report("pack", fmt, iterations, elapsed_ns(t0));
+
+	t0 = Clock::now();
+	for (long i = 0; i < iterations; i++) {
+		buf[0] = (unsigned char)i;
+		sink += unpack(buf);
+	}
+	report("unpack", fmt, iterations, elapsed_ns(t0));
+
+	t0 = Clock::now();
+	for (long i = 0; i < iterations; i++) {
+		sink += struct_calcsize(fmt);
+	}
+	report("calcsize", fmt, iterations, elapsed_ns(t0));
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	long iterations = (argc > 1) ? atol(argv[1]) : 2000000;
+
+	// Indoor Bike Data notification
+	bench("<HHHh", iterations,
+		[](unsigned char *b, uint32_t i) {
+			return struct_pack(b, "<HHHh", 0x0044, i & 0xffff, (i >> 1) & 0xffff, (int)(i & 0x3ff));
+		},
+		[](const unsigned char *b) {
+			uint16_t f, s, c; int16_t p;
+			struct_unpack(b, "<HHHh", &f, &s, &c, &p);
+			return (uint32_t)(f + s + c + p);
+		});
+
+	// Fitness Machine Feature
+	bench("<II", iterations,
+		[](unsigned char *b, uint32_t i) {
+			return struct_pack(b, "<II", i, ~i);
+		},
+		[](const unsigned char *b) {
+			uint32_t x, y;
+			struct_unpack(b, "<II", &x, &y);
+			return x ^ y;
+		});
+
+	// control point write (op code + parameter)
+	bench("<BB", iterations,
+		[](unsigned char *b, uint32_t i) {
+			return struct_pack(b, "<BB", i & 0xff, 0x01);
+		},
+		[](const unsigned char *b) {
+			uint8_t op, param;
+			struct_unpack(b, "<BB", &op, &param);
+			return (uint32_t)(op + param);
+		});
+
+	// advertising service data
+	bench("<HBH", iterations,
+		[](unsigned char *b, uint32_t i) {
+			return struct_pack(b, "<HBH", 0x1826, 0x01, i & 0xffff);
+		},
+		[](const unsigned char *b) {
+			uint16_t u, f; uint8_t s;
+			struct_unpack(b, "<HBH", &u, &s, &f);
+			return (uint32_t)(u + s + f);
+		});
+
+	// every integer width, both byte orders
+	bench(">bBhHiIqQ", iterations,
+		[](unsigned char *b, uint32_t i) {
+			return struct_pack(b, ">bBhHiIqQ", (int)i, i, (int)i, i, (int32_t)i, i, (int64_t)i, (uint64_t)i);
+		},
+		[](const unsigned char *b) {
+			char c; unsigned char C; int16_t h; uint16_t H; int32_t l; uint32_t L; int64_t q; uint64_t Q;
+			struct_unpack(b, ">bBhHiIqQ", &c, &C, &h, &H, &l, &L, &q, &Q);
+			return (uint32_t)(c + C + h + H + l + L + q + Q);
+		});
+
+	// IEEE754 emulation
+	bench("<fd", iterations / 4,
+		[](unsigned char *b, uint32_t i) {
+			return struct_pack(b, "<fd", (double)i * 0.5, (double)i * 0.25);
+		},
+		[](const unsigned char *b) {
+			float f; double d;
+			struct_unpack(b, "<fd", &f, &d);
+			return (uint32_t)(f + d);
+		});
+
+	// strings and repeat counts
+	bench("=16s4x", iterations,
+		[](unsigned char *b, uint32_t i) {
+			(void)i;
+			return struct_pack(b, "=16s4x", "STEP:BIT rider 1");
+		},
+		[](const unsigned char *b) {
+			char s[16];
+			struct_unpack(b, "=16s4x", s);
+			return (uint32_t)s[0];
+		});
+
+	return (sink == 0xFFFFFFFFu) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
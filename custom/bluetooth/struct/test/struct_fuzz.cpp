@@ -0,0 +1,313 @@
+/*
+ * struct_fuzz.cpp
+ *
+ * Fuzz target for the format parser and pack/unpack round trips.
+ *
+ * Input layout: <format string> '\0' <payload bytes>
+ *
+ *  1. struct_calcsize() must accept exactly the formats the reference
+ *     tokenizer below accepts, and report the same size.
+ *  2. Every element of a valid format is unpacked from the payload and
+ *     packed back; integers and strings must reproduce the payload bytes.
+ *  3. The fixed formats the firmware uses on BLE data are unpacked from the
+ *     payload whenever it is long enough.
+ *
+ * Built with Clang, this is a libFuzzer target (-fsanitize=fuzzer). With
+ * any other compiler a standalone driver replays the files given on the
+ * command line, then mutates a built-in seed corpus for -runs=N inputs.
+ */
+
+#include "struct.h"
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+namespace {
+
+const size_t MAX_FORMAT_LEN = 64;
+const int MAX_PACKED_LEN = 4096;
+
+void fail(const char *what, const char *fmt)
+{
+	fprintf(stderr, "struct_fuzz: %s (format \"%s\")\n", what, fmt);
+	abort();
+}
+
+struct Element {
+	char order;
+	char type;
+	int count;
+};
+
+int element_size(char type)
+{
+	switch (type) {
+	case 'b': case 'B': case 's': case 'p': case 'x':
+		return 1;
+	case 'h': case 'H':
+		return 2;
+	case 'i': case 'l': case 'I': case 'L': case 'f':
+		return 4;
+	case 'q': case 'Q': case 'd':
+		return 8;
+	default:
+		return 0;
+	}
+}
+
+// reference tokenizer, written independently of struct.c
+bool tokenize(const char *fmt, std::vector<Element> &out, long *size)
+{
+	char order = '=';
+	long rep = 0;
+	long total = 0;
+
+	for (const char *p = fmt; *p != '\0'; p++) {
+		if (isdigit((unsigned char)*p)) {
+			rep = rep * 10 + (*p - '0');
+			if (rep > INT_MAX) {
+				return false;
+			}
+			continue;
+		}
+		if (*p == '=' || *p == '<' || *p == '>' || *p == '!') {
+			order = *p;
+		} else {
+			int es = element_size(*p);
+			if (es == 0) {
+				return false;
+			}
+			Element e = { order, *p, (rep > 0) ? (int)rep : 1 };
+			total += (long)es * e.count;
+			if (total > INT_MAX) {
+				return false;
+			}
+			out.push_back(e);
+		}
+		rep = 0;
+	}
+	*size = total;
+	return true;
+}
+
+// unpack one element from payload, pack it back into out, compare
+void round_trip(const Element &e, const unsigned char *in, unsigned char *out, const char *fmt)
+{
+	char one[16];
+	int n = 0, m = 0;
+
+	snprintf(one, sizeof(one), "%c%c", e.order, e.type);
+	switch (e.type) {
+	case 'b': { char v; n = struct_unpack(in, one, &v); m = struct_pack(out, one, v); break; }
+	case 'B': { unsigned char v; n = struct_unpack(in, one, &v); m = struct_pack(out, one, v); break; }
+	case 'h': { int16_t v; n = struct_unpack(in, one, &v); m = struct_pack(out, one, v); break; }
+	case 'H': { uint16_t v; n = struct_unpack(in, one, &v); m = struct_pack(out, one, v); break; }
+	case 'i': case 'l': { int32_t v; n = struct_unpack(in, one, &v); m = struct_pack(out, one, v); break; }
+	case 'I': case 'L': { uint32_t v; n = struct_unpack(in, one, &v); m = struct_pack(out, one, v); break; }
+	case 'q': { int64_t v; n = struct_unpack(in, one, &v); m = struct_pack(out, one, v); break; }
+	case 'Q': { uint64_t v; n = struct_unpack(in, one, &v); m = struct_pack(out, one, v); break; }
+	case 'f': { float v; n = struct_unpack(in, one, &v); m = struct_pack(out, one, (double)v); break; }
+	case 'd': { double v; n = struct_unpack(in, one, &v); m = struct_pack(out, one, v); break; }
+	default:
+		fail("unexpected element", fmt);
+	}
+	if (n != element_size(e.type) || m != n) {
+		fail("element length mismatch", fmt);
+	}
+	// IEEE754 emulation canonicalizes NaN, -0.0 and subnormals: only check ints
+	if (e.type != 'f' && e.type != 'd' && memcmp(in, out, n) != 0) {
+		fail("integer round trip mismatch", fmt);
+	}
+}
+
+void check_format(const char *fmt, const unsigned char *payload, size_t len)
+{
+	std::vector<Element> elements;
+	long expected = -1;
+	bool valid = tokenize(fmt, elements, &expected);
+	int size = struct_calcsize(fmt);
+
+	if (!valid) {
+		if (size != -1) {
+			fail("calcsize accepted an invalid format", fmt);
+		}
+		return;
+	}
+	if (size != expected) {
+		fail("calcsize disagrees with reference", fmt);
+	}
+	if (size > MAX_PACKED_LEN || (size_t)size > len) {
+		return;
+	}
+
+	std::vector<unsigned char> out(size + 1, 0xA5);
+	const unsigned char *in = payload;
+	unsigned char *op = &out[0];
+	for (size_t i = 0; i < elements.size(); i++) {
+		const Element &e = elements[i];
+		char one[24];
+		if (e.type == 's' || e.type == 'p') {
+			std::vector<char> s(e.count);
+			snprintf(one, sizeof(one), "%c%ds", e.order, e.count);
+			if (struct_unpack(in, one, &s[0]) != e.count
+					|| struct_pack(op, one, &s[0]) != e.count
+					|| memcmp(in, op, e.count) != 0) {
+				fail("string round trip mismatch", fmt);
+			}
+		} else if (e.type == 'x') {
+			snprintf(one, sizeof(one), "%dx", e.count);
+			if (struct_unpack(in, one) != e.count || struct_pack(op, one) != e.count) {
+				fail("pad length mismatch", fmt);
+			}
+		} else {
+			for (int r = 0; r < e.count; r++) {
+				round_trip(e, in + r * element_size(e.type), op + r * element_size(e.type), fmt);
+			}
+		}
+		in += e.count * element_size(e.type);
+		op += e.count * element_size(e.type);
+	}
+	if (op - &out[0] != size || out[size] != 0xA5) {
+		fail("packed past calcsize", fmt);
+	}
+}
+
+// formats the firmware applies to BLE payloads
+void check_firmware_formats(const unsigned char *payload, size_t len)
+{
+	uint8_t B1, B2;
+	uint16_t H1, H2, H3;
+	int16_t h;
+	uint32_t I1, I2;
+
+	if (len >= 1 && struct_unpack(payload, "<B", &B1) != 1) {
+		fail("unpack length", "<B");
+	}
+	if (len >= 2 && struct_unpack(payload, "<BB", &B1, &B2) != 2) {
+		fail("unpack length", "<BB");
+	}
+	if (len >= 5 && struct_unpack(payload, "<HBH", &H1, &B1, &H2) != 5) {
+		fail("unpack length", "<HBH");
+	}
+	if (len >= 8 && struct_unpack(payload, "<HHHh", &H1, &H2, &H3, &h) != 8) {
+		fail("unpack length", "<HHHh");
+	}
+	if (len >= 8 && struct_unpack(payload, "<II", &I1, &I2) != 8) {
+		fail("unpack length", "<II");
+	}
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	char fmt[MAX_FORMAT_LEN + 1];
+	size_t n = 0;
+
+	while (n < size && n < MAX_FORMAT_LEN && data[n] != '\0') {
+		fmt[n] = (char)data[n];
+		n++;
+	}
+	fmt[n] = '\0';
+	if (n < size && data[n] == '\0') {
+		n++;
+	}
+
+	// copy so reads past the payload are caught by ASan
+	std::vector<unsigned char> payload(data + n, data + size);
+	const unsigned char *p = payload.empty() ? NULL : &payload[0];
+
+	check_format(fmt, p, payload.size());
+	check_firmware_formats(p, payload.size());
+	return 0;
+}
+
+#ifndef STRUCT_FUZZ_LIBFUZZER
+
+namespace {
+
+uint32_t xorshift32(uint32_t *state)
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+const char *const seeds[] = {
+	"<HHHh", "<II", "<BB", "<HBH", "<B", "=bBhHiIlLqQfd", ">4h2I", "!q",
+	"<10s", "3x2b", "0s", "<2p>H=I", "12", "<HZ", "2147483647x", "99999999999b",
+};
+
+void run(const std::vector<uint8_t> &input)
+{
+	LLVMFuzzerTestOneInput(input.empty() ? NULL : &input[0], input.size());
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	long runs = 100000;
+	uint32_t seed = 0x2AD2u;
+
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "-runs=", 6) == 0) {
+			runs = atol(argv[i] + 6);
+		} else if (strncmp(argv[i], "-seed=", 6) == 0) {
+			seed = (uint32_t)strtoul(argv[i] + 6, NULL, 0) | 1u;
+		} else {
+			FILE *fp = fopen(argv[i], "rb");
+			if (fp == NULL) {
+				perror(argv[i]);
+				return EXIT_FAILURE;
+			}
+			std::vector<uint8_t> input;
+			int c;
+			while ((c = fgetc(fp)) != EOF) {
+				input.push_back((uint8_t)c);
+			}
+			fclose(fp);
+			run(input);
+		}
+	}
+
+	static const char alphabet[] = "<>=!bBhHiIlLqQfdspx0123456789";
+	const size_t nseeds = sizeof(seeds) / sizeof(seeds[0]);
+	for (long r = 0; r < runs; r++) {
+		const char *s = seeds[r % nseeds];
+		std::vector<uint8_t> input(s, s + strlen(s));
+		int edits = xorshift32(&seed) % 4;
+		for (int e = 0; e < edits; e++) {
+			uint32_t x = xorshift32(&seed);
+			size_t at = input.empty() ? 0 : x % (input.size() + 1);
+			uint8_t c = (x >> 16) & 3 ? alphabet[(x >> 8) % (sizeof(alphabet) - 1)] : (uint8_t)(x >> 8);
+			if (c == '\0') {
+				c = 'x';
+			}
+			if ((x >> 24) & 1 && at < input.size()) {
+				input[at] = c;
+			} else {
+				input.insert(input.begin() + at, c);
+			}
+		}
+		input.push_back('\0');
+		size_t payload = xorshift32(&seed) % 96;
+		for (size_t i = 0; i < payload; i++) {
+			input.push_back((uint8_t)xorshift32(&seed));
+		}
+		run(input);
+	}
+
+	printf("struct_fuzz: %ld runs ok\n", runs);
+	return EXIT_SUCCESS;
+}
+
+#endif /* !STRUCT_FUZZ_LIBFUZZER */
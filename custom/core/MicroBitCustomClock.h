@@ -0,0 +1,57 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MICROBIT_CUSTOM_CLOCK_H
+#define MICROBIT_CUSTOM_CLOCK_H
+
+#include "MicroBit.h"
+
+/**
+  * Time source of the custom components, the system timer on the micro:bit.
+  * Every time read in custom/ goes through MicroBitCustomClock::currentTimeUs().
+  */
+class MicroBitSystemClock
+{
+public:
+    /**
+      * Current time (us).
+      */
+    static inline uint64_t currentTimeUs(void)
+    {
+        return system_timer_current_time_us();
+    }
+};
+
+/**
+  * The clock is chosen at compile time, so reading it costs what reading the system timer does.
+  * A host build defines MICROBIT_CUSTOM_CLOCK as a class with the same static currentTimeUs()
+  * (e.g., a simulated clock in its MicroBit.h) to run the components at any speed.
+  */
+#ifndef MICROBIT_CUSTOM_CLOCK
+#define MICROBIT_CUSTOM_CLOCK MicroBitSystemClock
+#endif /* #ifndef MICROBIT_CUSTOM_CLOCK */
+
+typedef MICROBIT_CUSTOM_CLOCK MicroBitCustomClock;
+
+#endif /* #ifndef MICROBIT_CUSTOM_CLOCK_H */
@@ -26,6 +26,7 @@ SOFTWARE.
 #define MICROBIT_CUSTOM_COMPONENT_H
 
 #include "MicroBit.h"
+#include "MicroBitCustomClock.h"
 
 class MicroBitCustomComponent : public MicroBitComponent
 {
@@ -0,0 +1,300 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MICROBIT_CUSTOM_PIPELINE_H
+#define MICROBIT_CUSTOM_PIPELINE_H
+
+#include "MicroBit.h"
+#include "MicroBitCustom.h"
+#include "MicroBitCustomComponent.h"
+#include "struct.h"
+
+#define MICROBIT_CUSTOM_PIPELINE_ADDED_TO_IDLE 0x02
+
+/**
+  * Sensor pipelines composed at compile time: a source, a stage and a sink are the template parameters
+  * of MicroBitCustomPipeline, which polls the source from the idle thread.
+  *
+  *  - Source: typedef output_type; bool read(output_type &sample) - the next sample, false while there is none.
+  *  - Stage:  typedef input_type, output_type; bool process(const input_type &in, output_type &out) - false drops the sample.
+  *  - Sink:   typedef input_type; void write(const input_type &sample).
+  *  - All:    void begin(void), once when the pipeline starts (MicroBitPipelinePart has an empty one).
+  *
+  * Parts are held by value and called through their static types, so a chain of stages inlines into one loop:
+  * no virtual call and no allocation per sample. The pipeline's idleTick() is the only virtual call, once per tick.
+  * MicroBitPipelineChain joins two stages and MicroBitPipelineTee two sinks; nest them for more.
+  * Parts are copied into the pipeline when it is made; begin() is where they may hand out their address (listen).
+  *
+  * Sources and sinks of the micro:bit runtime and the custom components are in MicroBitCustomPipelineParts.h.
+  */
+class MicroBitPipelinePart
+{
+public:
+    void begin(void) {}
+};
+
+template <class Source, class Stage, class Sink>
+class MicroBitCustomPipeline : public MicroBitCustomComponent
+{
+public:
+    Source source;
+    Stage stage;
+    Sink sink;
+
+    /**
+      * Constructor.
+      * @param id The Event Bus ID of this pipeline, for the events of its parts.
+      */
+    MicroBitCustomPipeline(const Source &_source = Source(), const Stage &_stage = Stage(), const Sink &_sink = Sink()
+        , uint16_t id = MICROBIT_CUSTOM_PIPELINE_ID)
+        : source(_source), stage(_stage), sink(_sink)
+    {
+        this->id = id;
+    }
+
+    /**
+      * Begin the parts, and run the pipeline from the idle thread from now on.
+      */
+    void start(void)
+    {
+        if (!(status & MICROBIT_CUSTOM_PIPELINE_ADDED_TO_IDLE))
+        {
+            this->source.begin();
+            this->stage.begin();
+            this->sink.begin();
+            fiber_add_idle_component(this);
+            status |= MICROBIT_CUSTOM_PIPELINE_ADDED_TO_IDLE;
+        }
+    }
+
+    /**
+      * Pass every sample the source has through the stage to the sink.
+      * @return The number of samples written to the sink.
+      */
+    int run(void)
+    {
+        typename Source::output_type in;
+        typename Stage::output_type out;
+        int written = 0;
+        while (this->source.read(in))
+        {
+            if (this->stage.process(in, out))
+            {
+                this->sink.write(out);
+                written++;
+            }
+        }
+        return written;
+    }
+
+    /**
+      * Periodic callback from MicroBit idle thread.
+      */
+    virtual void idleTick()
+    {
+        this->run();
+    }
+};
+
+/**
+  * Two stages, one after the other.
+  */
+template <class First, class Second>
+class MicroBitPipelineChain : public MicroBitPipelinePart
+{
+public:
+    typedef typename First::input_type input_type;
+    typedef typename Second::output_type output_type;
+
+    First first;
+    Second second;
+
+    MicroBitPipelineChain(const First &_first = First(), const Second &_second = Second())
+        : first(_first), second(_second)
+    {
+    }
+
+    void begin(void)
+    {
+        this->first.begin();
+        this->second.begin();
+    }
+
+    bool process(const input_type &in, output_type &out)
+    {
+        typename First::output_type middle;
+        return this->first.process(in, middle) && this->second.process(middle, out);
+    }
+};
+
+/**
+  * Two sinks, written with the same sample.
+  */
+template <class First, class Second>
+class MicroBitPipelineTee : public MicroBitPipelinePart
+{
+public:
+    typedef typename First::input_type input_type;
+
+    First first;
+    Second second;
+
+    MicroBitPipelineTee(const First &_first = First(), const Second &_second = Second())
+        : first(_first), second(_second)
+    {
+    }
+
+    void begin(void)
+    {
+        this->first.begin();
+        this->second.begin();
+    }
+
+    void write(const input_type &sample)
+    {
+        this->first.write(sample);
+        this->second.write(sample);
+    }
+};
+
+/**
+  * Stage that passes every sample as it is (a source straight to a sink).
+  */
+template <typename T>
+class MicroBitPipelinePass : public MicroBitPipelinePart
+{
+public:
+    typedef T input_type;
+    typedef T output_type;
+
+    bool process(const input_type &in, output_type &out)
+    {
+        out = in;
+        return true;
+    }
+};
+
+/**
+  * Stage that passes one sample in every N (the first one, then every Nth).
+  */
+template <typename T, int N>
+class MicroBitPipelineDecimate : public MicroBitPipelinePart
+{
+public:
+    typedef T input_type;
+    typedef T output_type;
+
+    MicroBitPipelineDecimate() : count(0) {}
+
+    bool process(const input_type &in, output_type &out)
+    {
+        bool pass = (this->count == 0);
+        if (++this->count >= N)
+        {
+            this->count = 0;
+        }
+        out = in;
+        return pass;
+    }
+
+private:
+    int count;
+};
+
+/**
+  * Stage averaging the last N samples (fewer at the start): a running sum over a ring, O(1) per sample.
+  * Sum holds N samples; integer averages are truncated toward zero.
+  */
+template <typename T, int N, typename Sum = int32_t>
+class MicroBitPipelineMovingAverage : public MicroBitPipelinePart
+{
+public:
+    typedef T input_type;
+    typedef T output_type;
+
+    MicroBitPipelineMovingAverage() : head(0), count(0), sum(0) {}
+
+    bool process(const input_type &in, output_type &out)
+    {
+        if (this->count == N)
+        {
+            this->sum -= this->ring[this->head];
+        }
+        else
+        {
+            this->count++;
+        }
+        this->ring[this->head] = in;
+        this->sum += in;
+        this->head = (this->head + 1) % N;
+        out = (T)(this->sum / this->count);
+        return true;
+    }
+
+private:
+    T ring[N];
+    int head;
+    int count;
+    Sum sum;
+};
+
+/**
+  * Encoded bytes, for the sinks that send bytes (BLE, radio).
+  */
+template <int N>
+struct MicroBitPipelinePacket
+{
+    uint8_t data[N];
+    uint16_t length;
+};
+
+/**
+  * Stage encoding a value with struct_pack and a format of one value (e.g. "<H").
+  */
+template <typename T, int N>
+class MicroBitPipelinePack : public MicroBitPipelinePart
+{
+public:
+    typedef T input_type;
+    typedef MicroBitPipelinePacket<N> output_type;
+
+    MicroBitPipelinePack(const char *_format = "<i") : format(_format) {}
+
+    bool process(const input_type &in, output_type &out)
+    {
+        int length = struct_calcsize(this->format);
+        if (length <= 0 || length > N)
+        {
+            return false;
+        }
+        struct_pack(out.data, this->format, in);
+        out.length = (uint16_t)length;
+        return true;
+    }
+
+private:
+    const char *format;
+};
+
+#endif /* #ifndef MICROBIT_CUSTOM_PIPELINE_H */
@@ -0,0 +1,312 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MICROBIT_CUSTOM_PIPELINE_PARTS_H
+#define MICROBIT_CUSTOM_PIPELINE_PARTS_H
+
+#include "MicroBit.h"
+#include "MicroBitCustom.h"
+#include "MicroBitCustomPipeline.h"
+#include "MicroBitBLEConnectionTable.h"
+#include "MicroBitRideLog.h"
+#include "MicroBitTelemetry.h"
+
+/**
+  * Sources and sinks of MicroBitCustomPipeline on the micro:bit runtime and the custom components.
+  * Sources:
+  *  - MicroBitPipelineEdgeSource: edge times (us) of a pin, queued by the event handler.
+  *  - MicroBitPipelineAnalogSource: the analog value of a pin, once per period.
+  *  - MicroBitPipelineAccelerometerSource: the acceleration (milli-g), once per period.
+  * Sinks:
+  *  - MicroBitPipelineEventSink: keeps the sample and raises MICROBIT_CUSTOM_PIPELINE_EVT_DATA_UPDATE.
+  *  - MicroBitPipelineTelemetrySink: a telemetry record per sample on the USB serial (COBS framed, telemetry_decode).
+  *  - MicroBitPipelineRadioSink, MicroBitPipelineNotifySink: packets as radio datagrams, BLE notifications.
+  *  - MicroBitPipelineRideLogSink: edge times to the ride log in flash.
+  */
+
+// The free-running uint8_t indexes wrap around at 256, so the size must divide it (up to 128: full is not empty).
+typedef char MICROBIT_CUSTOM_PIPELINE_EDGES_must_be_a_power_of_two[
+    (MICROBIT_CUSTOM_PIPELINE_EDGES>0 && (MICROBIT_CUSTOM_PIPELINE_EDGES & (MICROBIT_CUSTOM_PIPELINE_EDGES-1))==0 && MICROBIT_CUSTOM_PIPELINE_EDGES<=128) ? 1 : -1];
+
+/**
+  * Source of edge times (us) of a pin. The event handler only queues the time;
+  * MICROBIT_CUSTOM_PIPELINE_EDGES edges wait for the next idle tick, the edges beyond are dropped (getDropped()).
+  */
+class MicroBitPipelineEdgeSource : public MicroBitPipelinePart
+{
+public:
+    typedef uint64_t output_type;
+
+    /**
+      * Constructor.
+      * @param _pin The pin, e.g. uBit.io.P2.
+      * @param _pinId The Event Bus ID of the pin, e.g. MICROBIT_ID_IO_P2.
+      * @param _value The edge, MICROBIT_PIN_EVT_FALL or MICROBIT_PIN_EVT_RISE.
+      */
+    MicroBitPipelineEdgeSource(MicroBitPin &_pin, uint16_t _pinId, uint16_t _value = MICROBIT_PIN_EVT_FALL)
+        : pin(&_pin), pinId(_pinId), value(_value), head(0), tail(0), dropped(0)
+    {
+    }
+
+    void begin(void)
+    {
+        if (EventModel::defaultEventBus)
+        {
+            EventModel::defaultEventBus->listen(this->pinId, this->value, this, &MicroBitPipelineEdgeSource::onEdge);
+        }
+        this->pin->eventOn(MICROBIT_PIN_EVENT_ON_EDGE);
+    }
+
+    bool read(output_type &sample)
+    {
+        if (this->tail == this->head)
+        {
+            return false;
+        }
+        sample = this->edges[this->tail % MICROBIT_CUSTOM_PIPELINE_EDGES];
+        this->tail++;
+        return true;
+    }
+
+    uint32_t getDropped(void)
+    {
+        return this->dropped;
+    }
+
+private:
+    void onEdge(MicroBitEvent e)
+    {
+        if ((uint8_t)(this->head - this->tail) >= MICROBIT_CUSTOM_PIPELINE_EDGES)
+        {
+            this->dropped++;
+            return;
+        }
+        this->edges[this->head % MICROBIT_CUSTOM_PIPELINE_EDGES] = e.timestamp;
+        this->head++;
+    }
+
+    MicroBitPin *pin;
+    uint16_t pinId;
+    uint16_t value;
+    uint64_t edges[MICROBIT_CUSTOM_PIPELINE_EDGES];
+    // free-running indexes
+    uint8_t head;
+    uint8_t tail;
+    uint32_t dropped;
+};
+
+/**
+  * Source sampling the analog value of a pin (0 - 1023) once per period.
+  */
+class MicroBitPipelineAnalogSource : public MicroBitPipelinePart
+{
+public:
+    typedef int output_type;
+
+    MicroBitPipelineAnalogSource(MicroBitPin &_pin, uint32_t _periodUs)
+        : pin(&_pin), periodUs(_periodUs), next(0)
+    {
+    }
+
+    bool read(output_type &sample)
+    {
+        uint64_t now = MicroBitCustomClock::currentTimeUs();
+        if (now < this->next)
+        {
+            return false;
+        }
+        this->next = now + this->periodUs;
+        sample = this->pin->getAnalogValue();
+        return true;
+    }
+
+private:
+    MicroBitPin *pin;
+    uint32_t periodUs;
+    uint64_t next;
+};
+
+// Acceleration of the three axes (milli-g)
+struct MicroBitPipelineAcceleration
+{
+    int16_t x;
+    int16_t y;
+    int16_t z;
+};
+
+/**
+  * Source sampling the accelerometer once per period.
+  */
+class MicroBitPipelineAccelerometerSource : public MicroBitPipelinePart
+{
+public:
+    typedef MicroBitPipelineAcceleration output_type;
+
+    MicroBitPipelineAccelerometerSource(MicroBitAccelerometer &_accelerometer, uint32_t _periodUs)
+        : accelerometer(&_accelerometer), periodUs(_periodUs), next(0)
+    {
+    }
+
+    bool read(output_type &sample)
+    {
+        uint64_t now = MicroBitCustomClock::currentTimeUs();
+        if (now < this->next)
+        {
+            return false;
+        }
+        this->next = now + this->periodUs;
+        sample.x = this->accelerometer->getX();
+        sample.y = this->accelerometer->getY();
+        sample.z = this->accelerometer->getZ();
+        return true;
+    }
+
+private:
+    MicroBitAccelerometer *accelerometer;
+    uint32_t periodUs;
+    uint64_t next;
+};
+
+/**
+  * Sink keeping the latest sample, and raising MICROBIT_CUSTOM_PIPELINE_EVT_DATA_UPDATE on an Event Bus ID
+  * (the pipeline's), so listeners read it with get() as they read the sensor.
+  */
+template <typename T>
+class MicroBitPipelineEventSink : public MicroBitPipelinePart
+{
+public:
+    typedef T input_type;
+
+    MicroBitPipelineEventSink(uint16_t _id = MICROBIT_CUSTOM_PIPELINE_ID) : id(_id), latest() {}
+
+    void write(const input_type &sample)
+    {
+        this->latest = sample;
+        MicroBitEvent(this->id, MICROBIT_CUSTOM_PIPELINE_EVT_DATA_UPDATE);
+    }
+
+    const T &get(void)
+    {
+        return this->latest;
+    }
+
+private:
+    uint16_t id;
+    T latest;
+};
+
+/**
+  * Sink recording every sample as a PIPELINE telemetry record with an Event Bus ID (the pipeline's),
+  * in the framed stream of MicroBitTelemetry rather than as text of its own on the serial port.
+  */
+class MicroBitPipelineTelemetrySink : public MicroBitPipelinePart
+{
+public:
+    typedef int32_t input_type;
+
+    MicroBitPipelineTelemetrySink(MicroBitTelemetry &_telemetry, uint16_t _id = MICROBIT_CUSTOM_PIPELINE_ID)
+        : telemetry(&_telemetry), id(_id)
+    {
+    }
+
+    void write(const input_type &sample)
+    {
+        this->telemetry->pipeline(this->id, sample);
+    }
+
+private:
+    MicroBitTelemetry *telemetry;
+    uint16_t id;
+};
+
+/**
+  * Sink sending every packet as a radio datagram (the radio enabled by the caller).
+  */
+template <int N>
+class MicroBitPipelineRadioSink : public MicroBitPipelinePart
+{
+public:
+    typedef MicroBitPipelinePacket<N> input_type;
+
+    MicroBitPipelineRadioSink(MicroBitRadio &_radio) : radio(&_radio) {}
+
+    void write(const input_type &sample)
+    {
+        this->radio->datagram.send((uint8_t *)sample.data, sample.length);
+    }
+
+private:
+    MicroBitRadio *radio;
+};
+
+/**
+  * Sink notifying every packet to the subscribers of a characteristic of the connection table.
+  */
+template <int N>
+class MicroBitPipelineNotifySink : public MicroBitPipelinePart
+{
+public:
+    typedef MicroBitPipelinePacket<N> input_type;
+
+    /**
+      * @param _index The index of the characteristic, from MicroBitBLEConnectionTable::addCharacteristic().
+      */
+    MicroBitPipelineNotifySink(MicroBitBLEConnectionTable &_connections, int _index)
+        : connections(&_connections), index(_index)
+    {
+    }
+
+    void write(const input_type &sample)
+    {
+        if (this->connections->subscribers(this->index) > 0)
+        {
+            this->connections->notify(this->index, sample.data, sample.length);
+        }
+    }
+
+private:
+    MicroBitBLEConnectionTable *connections;
+    int index;
+};
+
+/**
+  * Sink recording edge times (us) in the ride log.
+  */
+class MicroBitPipelineRideLogSink : public MicroBitPipelinePart
+{
+public:
+    typedef uint64_t input_type;
+
+    MicroBitPipelineRideLogSink(MicroBitRideLog &_rideLog) : rideLog(&_rideLog) {}
+
+    void write(const input_type &sample)
+    {
+        this->rideLog->edge(sample);
+    }
+
+private:
+    MicroBitRideLog *rideLog;
+};
+
+#endif /* #ifndef MICROBIT_CUSTOM_PIPELINE_PARTS_H */
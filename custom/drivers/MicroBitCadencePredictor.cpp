@@ -0,0 +1,112 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "MicroBitCadencePredictor.h"
+
+MicroBitCadencePredictor::MicroBitCadencePredictor()
+{
+    this->reset();
+}
+
+void MicroBitCadencePredictor::reset(void)
+{
+    this->lastEdge = 0;
+    this->intervals[0] = 0;
+    this->intervals[1] = 0;
+    this->count = 0;
+    this->predicted = 0;
+    this->trendConfidence = 0;
+}
+
+void MicroBitCadencePredictor::edge(uint64_t timestamp)
+{
+    if (this->count == 0)
+    {
+        this->lastEdge = timestamp;
+        this->count = 1;
+        return;
+    }
+
+    uint32_t interval = (uint32_t)(timestamp - this->lastEdge);
+    this->lastEdge = timestamp;
+    if (interval == 0)
+    {
+        return;
+    }
+
+    // Score the prediction of this interval: 0 at 50 % off or more
+    if (this->predicted != 0)
+    {
+        uint32_t error = (interval > this->predicted) ? interval - this->predicted : this->predicted - interval;
+        uint32_t percent = (uint32_t)((uint64_t)error * 100 / interval);
+        this->trendConfidence = (percent >= 50) ? 0 : (uint8_t)(MICROBIT_CADENCE_PREDICTOR_MEASURED - 1 - percent * 2);
+    }
+
+    this->intervals[0] = this->intervals[1];
+    this->intervals[1] = interval;
+    if (this->count < 3)
+    {
+        this->count++;
+    }
+
+    if (this->count < 3)
+    {
+        // no trend yet: the same interval again
+        this->predicted = interval;
+        return;
+    }
+
+    // Geometric extrapolation, at most a halving or doubling per revolution
+    uint32_t i1 = this->intervals[0];
+    uint32_t i2 = this->intervals[1];
+    uint64_t next = (uint64_t)i2 * i2 / i1;
+    if (next < i2 / 2)
+    {
+        next = i2 / 2;
+    }
+    else if (next > (uint64_t)i2 * 2)
+    {
+        next = (uint64_t)i2 * 2;
+    }
+    this->predicted = (uint32_t)next;
+}
+
+uint32_t MicroBitCadencePredictor::predict(uint64_t now, uint8_t *confidence)
+{
+    if (this->count < 2)
+    {
+        *confidence = 0;
+        return 0;
+    }
+
+    // The revolution takes at least the time since its edge
+    uint64_t elapsed = (now > this->lastEdge) ? now - this->lastEdge : 0;
+    if (elapsed <= this->predicted)
+    {
+        *confidence = this->trendConfidence;
+        return this->predicted;
+    }
+    *confidence = (uint8_t)((uint64_t)this->trendConfidence * this->predicted / elapsed);
+    return (elapsed > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t)elapsed;
+}
@@ -0,0 +1,80 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MICROBIT_CADENCE_PREDICTOR_H
+#define MICROBIT_CADENCE_PREDICTOR_H
+
+#include <stdint.h>
+#include "MicroBitCustom.h"
+
+// Confidence of a measured value; predictions are tagged 0 ~ 99
+#define MICROBIT_CADENCE_PREDICTOR_MEASURED 100
+
+/**
+  * Crank interval estimate between STEP edges, for a display that follows standing starts and stops.
+  * The next interval is extrapolated from the trend of the last two (i2 x i2 / i1), and bounded by the time since the
+  * last edge. The confidence comes from how well the previous prediction matched its edge, and falls once the edge is late.
+  * The sensor shows the measured interval on the first update after an edge, and the estimate only between edges.
+  * It takes one edge per crank revolution: with several STEP pulses per revolution the sensor does not use it.
+  * No dependency on the micro:bit runtime, so the host test (tools/cadence_predictor_test) shares it.
+  */
+class MicroBitCadencePredictor
+{
+
+public:
+    /**
+      * Constructor.
+      */
+    MicroBitCadencePredictor();
+
+    /**
+      * A STEP edge (us).
+      */
+    void edge(uint64_t timestamp);
+
+    /**
+      * Forget the edges (pedalling stopped).
+      */
+    void reset(void);
+
+    /**
+      * Estimated interval of the current crank revolution.
+      * @param now Time (us), not before the last edge.
+      * @param confidence 0 ~ 99, 0 without a trend yet.
+      * @return The interval (us), 0 without two edges.
+      */
+    uint32_t predict(uint64_t now, uint8_t *confidence);
+
+private:
+    uint64_t lastEdge;
+    // last two intervals (us), oldest first
+    uint32_t intervals[2];
+    uint8_t count;
+    // prediction of the interval ending at the next edge (us), 0: none
+    uint32_t predicted;
+    uint8_t trendConfidence;
+
+};
+
+#endif /* #ifndef MICROBIT_CADENCE_PREDICTOR_H */
@@ -37,20 +37,38 @@ void MicroBitIndoorBikeStepSensor::calcIndoorBikeData(uint32_t crankIntervalTime
         *cadence2 = (uint32_t)( (uint64_t)K_STEP_CADENCE / crankIntervalTime );
         *speed100 = (uint32_t)( (uint64_t)K_STEP_SPEED   / crankIntervalTime );
         // https://diary.cyclekikou.net/archives/15876
-        *power = (int32_t)((double)(*speed100) * (K_INCLINE_A * ((double)resistanceLevel10)/10 + K_INCLINE_B) * K_POWER);
+        *power = (int32_t)((double)(*speed100) * (this->inclineA * ((double)resistanceLevel10)/10 + this->inclineB) * this->kPower);
     }
 }
 
 MicroBitIndoorBikeStepSensor::MicroBitIndoorBikeStepSensor(MicroBit &_uBit, MicrobitIndoorBikeStepSensorPin pin, uint16_t id)
-    : uBit(_uBit)
+    : uBit(_uBit), pulsePhase(MICROBIT_INDOOR_BIKE_STEP_SENSOR_PULSES)
 {
     this->id = id;
     this->lastIntervalTime=0;
     this->lastCadence2=0;
     this->lastSpeed100=0;
     this->lastPower=0;
+    this->lastConfidence=MICROBIT_CADENCE_PREDICTOR_MEASURED;
+    this->lastCrankRevolutions=0;
+    this->lastCrankEventTime1024=0;
+    this->crankRevolutions=0;
+    this->crankEventTime1024=0;
     this->updateSampleTimestamp=0;
     this->resistanceLevel10 = MIN_RESISTANCE_LEVEL10;
+    this->inclineA = DEFAULT_INCLINE_A;
+    this->inclineB = DEFAULT_INCLINE_B;
+    this->telemetry = NULL;
+    this->configStore = NULL;
+    this->setRiderWeight(DEFAULT_RIDER_WEIGHT);
+    this->rideLog = NULL;
+    this->powerAnalytics = NULL;
+    this->powerPeaks = NULL;
+    this->cadencePredictor = NULL;
+    this->predictorEdge = false;
+    this->stepHealth = NULL;
+    this->stepHealthTelemetryCount = 0;
+    this->sessionPaused = false;
 
     if (EventModel::defaultEventBus)
         EventModel::defaultEventBus->listen(MICROBIT_INDOOR_BIKE_STEP_SENSOR_EVENT_IDs[pin], MICROBIT_PIN_EVT_FALL
@@ -89,6 +107,11 @@ uint32_t MicroBitIndoorBikeStepSensor::getIntervalTime(void)
     return this->lastIntervalTime;
 }
 
+uint8_t MicroBitIndoorBikeStepSensor::getIntervalConfidence(void)
+{
+    return this->lastConfidence;
+}
+
 uint32_t MicroBitIndoorBikeStepSensor::getCadence2(void)
 {
     return this->lastCadence2;
@@ -104,11 +127,21 @@ int16_t MicroBitIndoorBikeStepSensor::getPower(void)
     return this->lastPower;
 }
 
+uint32_t MicroBitIndoorBikeStepSensor::getCrankRevolutions(void)
+{
+    return this->lastCrankRevolutions;
+}
+
+uint16_t MicroBitIndoorBikeStepSensor::getCrankEventTime1024(void)
+{
+    return this->lastCrankEventTime1024;
+}
+
 uint8_t MicroBitIndoorBikeStepSensor::getResistanceLevel10(void)
 {
     return this->resistanceLevel10;
 }
-void MicroBitIndoorBikeStepSensor::setResistanceLevel10(uint8_t resistanceLevel10)
+void MicroBitIndoorBikeStepSensor::setResistanceLevel10(uint8_t resistanceLevel10, bool save)
 {
     if (resistanceLevel10<MIN_RESISTANCE_LEVEL10)
     {
@@ -122,11 +155,150 @@ void MicroBitIndoorBikeStepSensor::setResistanceLevel10(uint8_t resistanceLevel1
     {
         this->resistanceLevel10 = resistanceLevel10;
     }
+    if (save)
+    {
+        this->saveConfig(MICROBIT_CONFIG_KEY_RESISTANCE_LEVEL10, &this->resistanceLevel10, sizeof(this->resistanceLevel10));
+    }
+}
+
+uint8_t MicroBitIndoorBikeStepSensor::getResistanceLevel10ForPower(int16_t power, uint32_t speed100)
+{
+    // power = speed100 * 勾配 * kPower を負荷のレベルについて解く（止まっている間は今のレベル）
+    if (speed100==0)
+    {
+        return this->resistanceLevel10;
+    }
+    return this->resistanceLevel10ForIncline((double)power / ((double)speed100 * this->kPower));
+}
+
+uint8_t MicroBitIndoorBikeStepSensor::getResistanceLevel10ForGrade(int16_t grade100)
+{
+    return this->resistanceLevel10ForIncline((double)grade100 / 100);
+}
+
+uint8_t MicroBitIndoorBikeStepSensor::resistanceLevel10ForIncline(double incline)
+{
+    // 勾配 = a * 負荷のレベル + b を負荷のレベルについて解く（a が 0 なら今のレベル）
+    if (this->inclineA==0)
+    {
+        return this->resistanceLevel10;
+    }
+    double level10 = 10 * (incline - this->inclineB) / this->inclineA;
+    if (level10 <= MIN_RESISTANCE_LEVEL10)
+    {
+        return MIN_RESISTANCE_LEVEL10;
+    }
+    if (level10 >= MAX_RESISTANCE_LEVEL10)
+    {
+        return MAX_RESISTANCE_LEVEL10;
+    }
+    return (uint8_t)(level10 + 0.5);
+}
+
+uint8_t MicroBitIndoorBikeStepSensor::getRiderWeight(void)
+{
+    return this->riderWeight;
+}
+void MicroBitIndoorBikeStepSensor::setRiderWeight(uint8_t riderWeight)
+{
+    if (riderWeight<MIN_RIDER_WEIGHT)
+    {
+        riderWeight=MIN_RIDER_WEIGHT;
+    }
+    else if (riderWeight>MAX_RIDER_WEIGHT)
+    {
+        riderWeight=MAX_RIDER_WEIGHT;
+    }
+    this->riderWeight = riderWeight;
+    // https://diary.cyclekikou.net/archives/15876
+    this->kPower = 0.8 * (riderWeight * 9.80665) / (360 * 0.95 * 100);
+    this->saveConfig(MICROBIT_CONFIG_KEY_RIDER_WEIGHT, &this->riderWeight, sizeof(this->riderWeight));
+}
+
+float MicroBitIndoorBikeStepSensor::getInclineA(void)
+{
+    return this->inclineA;
+}
+float MicroBitIndoorBikeStepSensor::getInclineB(void)
+{
+    return this->inclineB;
+}
+void MicroBitIndoorBikeStepSensor::setInclineCoefficients(float a, float b)
+{
+    this->inclineA = a;
+    this->inclineB = b;
+    this->saveConfig(MICROBIT_CONFIG_KEY_INCLINE_A, &this->inclineA, sizeof(this->inclineA));
+    this->saveConfig(MICROBIT_CONFIG_KEY_INCLINE_B, &this->inclineB, sizeof(this->inclineB));
+}
+
+uint8_t MicroBitIndoorBikeStepSensor::getPulsesPerRevolution(void)
+{
+    return this->pulsePhase.getPulses();
+}
+void MicroBitIndoorBikeStepSensor::setPulsesPerRevolution(uint8_t pulses)
+{
+    this->pulsePhase.setPulses(pulses);
+    // 数え直す
+    while (this->intervalList.size()>0)
+    {
+        this->intervalList.pop();
+    }
+    pulses = this->pulsePhase.getPulses();
+    if (this->rideLog)
+    {
+        this->rideLog->setPulses(pulses);
+    }
+    if (this->cadencePredictor)
+    {
+        this->cadencePredictor->reset();
+    }
+    this->saveConfig(MICROBIT_CONFIG_KEY_PULSES, &pulses, sizeof(pulses));
+}
+
+void MicroBitIndoorBikeStepSensor::setConfigStore(MicroBitConfigStore *configStore)
+{
+    // 復元中は保存しない
+    this->configStore = NULL;
+    if (configStore)
+    {
+        uint8_t u8;
+        float a = this->inclineA;
+        float b = this->inclineB;
+        if (configStore->get(MICROBIT_CONFIG_KEY_RESISTANCE_LEVEL10, &u8, sizeof(u8)))
+        {
+            this->setResistanceLevel10(u8);
+        }
+        if (configStore->get(MICROBIT_CONFIG_KEY_RIDER_WEIGHT, &u8, sizeof(u8)))
+        {
+            this->setRiderWeight(u8);
+        }
+        if (configStore->get(MICROBIT_CONFIG_KEY_PULSES, &u8, sizeof(u8)))
+        {
+            this->setPulsesPerRevolution(u8);
+        }
+        configStore->get(MICROBIT_CONFIG_KEY_INCLINE_A, &a, sizeof(a));
+        configStore->get(MICROBIT_CONFIG_KEY_INCLINE_B, &b, sizeof(b));
+        this->setInclineCoefficients(a, b);
+    }
+    this->configStore = configStore;
+}
+
+void MicroBitIndoorBikeStepSensor::saveConfig(uint16_t key, const void *value, uint8_t len)
+{
+    if (this->configStore)
+    {
+        this->configStore->set(key, value, len);
+    }
+}
+
+void MicroBitIndoorBikeStepSensor::setTelemetry(MicroBitTelemetry *telemetry)
+{
+    this->telemetry = telemetry;
 }
 
 void MicroBitIndoorBikeStepSensor::update(void)
 {
-    uint64_t currentTime = system_timer_current_time_us();
+    uint64_t currentTime = MicroBitCustomClock::currentTimeUs();
 
     if (currentTime >= this->updateSampleTimestamp)
     {
@@ -138,9 +310,31 @@ void MicroBitIndoorBikeStepSensor::update(void)
             {
                 this->intervalList.pop();
             }
+            if (this->cadencePredictor)
+            {
+                this->cadencePredictor->reset();
+            }
+            this->pulsePhase.reset();
+            if (this->stepHealth)
+            {
+                this->stepHealth->stop();
+            }
         }
         
-        if (this->intervalList.size() < 2)
+        if (this->pulsePhase.getPulses() > 1)
+        {
+            // 磁石ごとの補正をした1回転の間隔。次のSTEP信号までの経過時間で制限する（単調に減少）
+            this->lastIntervalTime = this->pulsePhase.getIntervalTime();
+            if (this->lastIntervalTime != 0)
+            {
+                uint32_t boundTime = this->pulsePhase.getIntervalBound(currentTime - this->intervalList.back());
+                if (boundTime > this->lastIntervalTime)
+                {
+                    this->lastIntervalTime = boundTime;
+                }
+            }
+        }
+        else if (this->intervalList.size() < 2)
         {
             this->lastIntervalTime = 0;
         }
@@ -149,14 +343,127 @@ void MicroBitIndoorBikeStepSensor::update(void)
             uint64_t intervalNum = this->intervalList.size() - 1;
             uint64_t periodTime = this->intervalList.back() - this->intervalList.front();
             this->lastIntervalTime = periodTime / intervalNum;
+            // 次のSTEP信号までの間隔は、最後のSTEP信号からの経過時間以上になる。
+            // 経過時間で平均間隔を制限し、ペダルを止めるとケイデンスとパワーが単調に減少する
+            // （MAX_STEPS_INTERVAL_TIME_USでゼロ）。
+            uint64_t elapsedTime = currentTime - this->intervalList.back();
+            if (elapsedTime > this->lastIntervalTime)
+            {
+                this->lastIntervalTime = elapsedTime;
+            }
+        }
+        
+        // 信頼できる予測値があれば、計測値の代わりに使う。
+        // STEP信号の後の最初のupdateは計測値に戻す（予測はSTEP信号の間だけ）
+        uint32_t measuredIntervalTime = this->lastIntervalTime;
+        this->lastConfidence = MICROBIT_CADENCE_PREDICTOR_MEASURED;
+        bool anchored = this->predictorEdge;
+        this->predictorEdge = false;
+        if (this->cadencePredictor && this->pulsePhase.getPulses() == 1 && this->lastIntervalTime != 0 && !anchored)
+        {
+            uint8_t confidence;
+            uint32_t predictedIntervalTime = this->cadencePredictor->predict(currentTime, &confidence);
+            if (predictedIntervalTime != 0 && confidence >= MICROBIT_CADENCE_PREDICTOR_MIN_CONFIDENCE)
+            {
+                this->lastIntervalTime = predictedIntervalTime;
+                this->lastConfidence = confidence;
+            }
         }
         
         calcIndoorBikeData(this->lastIntervalTime, this->resistanceLevel10, &this->lastCadence2, &this->lastSpeed100, &this->lastPower);
+        this->lastCrankRevolutions = this->crankRevolutions;
+        this->lastCrankEventTime1024 = this->crankEventTime1024;
+        bool peaksImproved = false;
+        if (!this->sessionPaused)
+        {
+            if (this->powerAnalytics)
+            {
+                this->powerAnalytics->add(this->lastPower);
+            }
+            peaksImproved = this->powerPeaks && this->powerPeaks->add(this->lastPower);
+        }
+        
+        if (this->telemetry)
+        {
+            this->telemetry->sample(this->lastIntervalTime, this->lastSpeed100, this->lastCadence2, this->lastPower, this->resistanceLevel10);
+            if (this->stepHealth && ++this->stepHealthTelemetryCount >= MICROBIT_STEP_HEALTH_TELEMETRY_PERIOD)
+            {
+                this->stepHealthTelemetryCount = 0;
+                this->telemetry->health(*this->stepHealth);
+            }
+            if (this->cadencePredictor)
+            {
+                this->telemetry->prediction(measuredIntervalTime, this->lastIntervalTime, this->lastConfidence);
+            }
+            if (this->powerAnalytics)
+            {
+                MicroBitPowerAnalytics *a = this->powerAnalytics;
+                this->telemetry->analytics(a->getAverage3(), a->getAverage10(), a->getAverage30()
+                    , a->getNormalizedPower(), a->getIntensityFactor1000(), a->getTrainingStressScore10(), a->getFtp());
+            }
+            if (peaksImproved)
+            {
+                MicroBitPowerPeaks *p = this->powerPeaks;
+                this->telemetry->peaks(p->getBest(MICROBIT_POWER_PEAKS_5S), p->getBest(MICROBIT_POWER_PEAKS_1MIN)
+                    , p->getBest(MICROBIT_POWER_PEAKS_5MIN), p->getBest(MICROBIT_POWER_PEAKS_20MIN));
+            }
+        }
         
         MicroBitEvent e(id, MICROBIT_INDOOR_BIKE_STEP_SENSOR_EVT_DATA_UPDATE);
     }
 }
 
+void MicroBitIndoorBikeStepSensor::setRideLog(MicroBitRideLog *rideLog)
+{
+    this->rideLog = rideLog;
+    if (this->rideLog)
+    {
+        this->rideLog->setPulses(this->pulsePhase.getPulses());
+    }
+}
+
+void MicroBitIndoorBikeStepSensor::setPowerAnalytics(MicroBitPowerAnalytics *powerAnalytics)
+{
+    this->powerAnalytics = powerAnalytics;
+}
+
+void MicroBitIndoorBikeStepSensor::setPowerPeaks(MicroBitPowerPeaks *powerPeaks)
+{
+    this->powerPeaks = powerPeaks;
+}
+
+void MicroBitIndoorBikeStepSensor::setCadencePredictor(MicroBitCadencePredictor *cadencePredictor)
+{
+    this->cadencePredictor = cadencePredictor;
+}
+
+void MicroBitIndoorBikeStepSensor::setStepHealth(MicroBitStepHealth *stepHealth)
+{
+    this->stepHealth = stepHealth;
+}
+
+bool MicroBitIndoorBikeStepSensor::isSessionPaused(void)
+{
+    return this->sessionPaused;
+}
+
+void MicroBitIndoorBikeStepSensor::setSessionPaused(bool paused)
+{
+    this->sessionPaused = paused;
+}
+
+void MicroBitIndoorBikeStepSensor::resetAnalytics(void)
+{
+    if (this->powerAnalytics)
+    {
+        this->powerAnalytics->reset();
+    }
+    if (this->powerPeaks)
+    {
+        this->powerPeaks->reset();
+    }
+}
+
 void MicroBitIndoorBikeStepSensor::onStepSensor(MicroBitEvent e) 
 {
     uint64_t currentTime = e.timestamp;
@@ -171,4 +478,33 @@ void MicroBitIndoorBikeStepSensor::onStepSensor(MicroBitEvent e)
     {
         this->intervalList.pop();
     }
+    
+    if (this->stepHealth)
+    {
+        this->stepHealth->edge(currentTime);
+    }
+    
+    // 1回転ごとに累積値を更新する（セッションの一時停止・停止中は止める）。走行ログはSTEP信号ごと（ブロックに1回転のパルス数）
+    bool revolution = this->pulsePhase.edge(currentTime);
+    if (revolution && !this->sessionPaused)
+    {
+        // CSC/CPS用の累積値 - 1秒/1024単位（マイクロ秒 * 128 / 125000）
+        this->crankRevolutions++;
+        this->crankEventTime1024 = (uint16_t)((currentTime * 128) / 125000);
+    }
+    
+    if (this->telemetry)
+    {
+        this->telemetry->stepEdge(currentTime, this->crankRevolutions);
+    }
+    if (this->rideLog)
+    {
+        this->rideLog->edge(currentTime);
+    }
+    // 予測は1回転の間隔の傾向から。磁石が複数なら磁石ごとの補正をした計測値を使う
+    if (this->cadencePredictor && this->pulsePhase.getPulses() == 1)
+    {
+        this->cadencePredictor->edge(currentTime);
+        this->predictorEdge = true;
+    }
 }
@@ -28,6 +28,14 @@ SOFTWARE.
 #include "MicroBit.h"
 #include "MicroBitCustom.h"
 #include "MicroBitCustomComponent.h"
+#include "MicroBitTelemetry.h"
+#include "MicroBitConfigStore.h"
+#include "MicroBitRideLog.h"
+#include "MicroBitPowerAnalytics.h"
+#include "MicroBitPowerPeaks.h"
+#include "MicroBitCadencePredictor.h"
+#include "MicroBitPulsePhase.h"
+#include "MicroBitStepHealth.h"
 #include <queue>
 
 /**
@@ -40,6 +48,14 @@ SOFTWARE.
 #define MIN_RESISTANCE_LEVEL10 10
 #define MAX_RESISTANCE_LEVEL10 80
 
+#define MIN_RIDER_WEIGHT 30
+#define MAX_RIDER_WEIGHT 200
+#define DEFAULT_RIDER_WEIGHT 70
+
+// https://diary.cyclekikou.net/archives/15876
+#define DEFAULT_INCLINE_A 0.9f // Incline(%) - a
+#define DEFAULT_INCLINE_B 0.6f // Incline(%) - b
+
 enum MicrobitIndoorBikeStepSensorPin
 {
     EDGE_P0 = 0,
@@ -74,6 +90,8 @@ public:
 private:
     // STEP信号の計測時間のリスト（単位: マイクロ秒 - 1秒/1000000）
     std::queue<uint64_t> intervalList;
+    // 1回転に複数のSTEP信号（磁石）があるときの、磁石ごとの間隔の補正
+    MicroBitPulsePhase pulsePhase;
     
     // 最新のインターバル時間（単位: マイクロ秒 - 1秒/1000000）
     uint32_t lastIntervalTime;
@@ -83,31 +101,112 @@ private:
     uint32_t lastSpeed100;
     // 最新のパワー（単位： watt）
     int16_t lastPower;
+    // 最新のインターバル時間の信頼度（MICROBIT_CADENCE_PREDICTOR_MEASURED: 計測値、0～99: 予測値）
+    uint8_t lastConfidence;
+    // 最新の累積クランク回転数
+    uint32_t lastCrankRevolutions;
+    // 最新のクランクイベント時間（単位： 1秒/1024）
+    uint16_t lastCrankEventTime1024;
+    
+    // 累積クランク回転数（STEP信号ごとに加算）
+    uint32_t crankRevolutions;
+    // 最後のクランクイベント時間（単位： 1秒/1024、65536/1024秒で一巡）
+    uint16_t crankEventTime1024;
     
     // 次のupdate実行時間
     uint64_t updateSampleTimestamp;
     
     // 負荷のレベル（範囲：10～80） - パワーの算出用
     uint8_t resistanceLevel10;
+    
+    // 体重（単位： kg） - パワーの算出用
+    uint8_t riderWeight;
+    // 勾配(%)の係数 a, b（勾配 = a * 負荷のレベル + b） - パワーの算出用
+    float inclineA;
+    float inclineB;
+    // パワーの係数（体重から算出）
+    double kPower;
+    
+    // テレメトリ（NULL: 記録しない）
+    MicroBitTelemetry *telemetry;
+    // 設定の保存先（NULL: 保存しない）
+    MicroBitConfigStore *configStore;
+    // 走行ログ（NULL: 記録しない）
+    MicroBitRideLog *rideLog;
+    // パワーの分析（NULL: 分析しない）
+    MicroBitPowerAnalytics *powerAnalytics;
+    // ベストパワー（NULL: 記録しない）
+    MicroBitPowerPeaks *powerPeaks;
+    // STEP信号間のケイデンスの予測（NULL: 予測しない）
+    MicroBitCadencePredictor *cadencePredictor;
+    // 前回のupdateの後に予測へSTEP信号を渡した（次のupdateは計測値を使う）
+    bool predictorEdge;
+    // STEP信号の統計（NULL: 集計しない）、テレメトリへの出力までのupdate回数
+    MicroBitStepHealth *stepHealth;
+    uint8_t stepHealthTelemetryCount;
+    // セッションの一時停止・停止中（累積クランク回転数、パワーの分析とベストパワーに加えない）
+    bool sessionPaused;
 
 private:
     // クランク回転数と速度、パワーを再計算する（最新化）
     void update();
     // クランク間時間から、クランク回転数と速度、パワーを計算する。
     void calcIndoorBikeData(uint32_t crankIntervalTime, uint8_t resistanceLevel10, uint32_t* cadence2, uint32_t* speed100, int16_t* power);
+    // 勾配(%)になる負荷のレベル（範囲：10～80）
+    uint8_t resistanceLevel10ForIncline(double incline);
+    // 設定を保存する
+    void saveConfig(uint16_t key, const void *value, uint8_t len);
 
 public:
     // インターバル時間を取得する（単位: マイクロ秒 - 1秒/1000000）
     uint32_t getIntervalTime(void);
+    // インターバル時間の信頼度を取得する（MICROBIT_CADENCE_PREDICTOR_MEASURED: 計測値、0～99: 予測値）
+    uint8_t getIntervalConfidence(void);
     // クランク回転数を取得する（単位：rpm の 2倍）
     uint32_t getCadence2(void);
     // 速度を取得する（単位： km/h の 100倍）
     uint32_t getSpeed100(void);
     // パワーを取得する（単位： watt）
     int16_t getPower(void);
-    // 負荷のレベルを取得・設定する（範囲：10～80）
+    // 累積クランク回転数を取得する（セッションの一時停止・停止中は加算しない）
+    uint32_t getCrankRevolutions(void);
+    // 最後のクランクイベント時間を取得する（単位： 1秒/1024）
+    uint16_t getCrankEventTime1024(void);
+    // 負荷のレベルを取得・設定する（範囲：10～80、save: false ならフラッシュに保存しない）
     uint8_t getResistanceLevel10(void);
-    void setResistanceLevel10(uint8_t resistanceLevel10);
+    void setResistanceLevel10(uint8_t resistanceLevel10, bool save = true);
+    // 速度（km/h の 100倍）でパワー（watt）になる負荷のレベル、勾配（% の 100倍）の負荷のレベルを求める（範囲：10～80）
+    uint8_t getResistanceLevel10ForPower(int16_t power, uint32_t speed100);
+    uint8_t getResistanceLevel10ForGrade(int16_t grade100);
+    // 体重を取得・設定する（単位： kg、範囲：30～200）
+    uint8_t getRiderWeight(void);
+    void setRiderWeight(uint8_t riderWeight);
+    // 勾配(%)の係数を取得・設定する（勾配 = a * 負荷のレベル + b）
+    float getInclineA(void);
+    float getInclineB(void);
+    void setInclineCoefficients(float a, float b);
+    // 1回転あたりのSTEP信号の数を取得・設定する（範囲：1～8）
+    uint8_t getPulsesPerRevolution(void);
+    void setPulsesPerRevolution(uint8_t pulses);
+    // 設定をフラッシュから復元し、以降の変更を保存する（NULL: 保存しない）
+    void setConfigStore(MicroBitConfigStore *configStore);
+    // STEP信号と計算結果をテレメトリに記録する（NULL: 記録しない）
+    void setTelemetry(MicroBitTelemetry *telemetry);
+    // STEP信号を走行ログに記録する（NULL: 記録しない）
+    void setRideLog(MicroBitRideLog *rideLog);
+    // パワーの計算結果を分析に渡す（NULL: 分析しない）
+    void setPowerAnalytics(MicroBitPowerAnalytics *powerAnalytics);
+    // パワーの計算結果からベストパワーを記録する（NULL: 記録しない）
+    void setPowerPeaks(MicroBitPowerPeaks *powerPeaks);
+    // STEP信号間のケイデンスを予測する（NULL: 計測値のみ）
+    void setCadencePredictor(MicroBitCadencePredictor *cadencePredictor);
+    // STEP信号の統計を集計する（NULL: 集計しない）
+    void setStepHealth(MicroBitStepHealth *stepHealth);
+    // セッションを一時停止・停止する、再開する（累積値を止め、一時停止中の時間を平均に含めない）
+    bool isSessionPaused(void);
+    void setSessionPaused(bool paused);
+    // パワーの分析とベストパワーをリセットする（新しいセッション）
+    void resetAnalytics(void);
 
 private:
     // STEPセンサーのイベントハンドラ
@@ -118,11 +217,6 @@ private:
     static const uint64_t K_STEP_CADENCE =  120000000;
     static const uint64_t K_STEP_SPEED   = 1800000000;
 
-    // https://diary.cyclekikou.net/archives/15876
-    static const double K_POWER = 0.8 * (70 * 9.80665) / (360 * 0.95 * 100); // weight(70kg)
-    static const double K_INCLINE_A = 0.9; // Incline(%) - a
-    static const double K_INCLINE_B = 0.6; // Incline(%) - b
-
 };
 
 #endif /* #ifndef MICROBIT_INDOOR_BIKE_STEP_SENSOR_H */
\ No newline at end of file
@@ -0,0 +1,120 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "MicroBitPulsePhase.h"
+
+MicroBitPulsePhase::MicroBitPulsePhase(uint8_t pulses)
+{
+    this->setPulses(pulses);
+}
+
+void MicroBitPulsePhase::setPulses(uint8_t pulses)
+{
+    if (pulses < MIN_PULSES_PER_REVOLUTION)
+    {
+        pulses = MIN_PULSES_PER_REVOLUTION;
+    }
+    else if (pulses > MAX_PULSES_PER_REVOLUTION)
+    {
+        pulses = MAX_PULSES_PER_REVOLUTION;
+    }
+    this->pulses = pulses;
+    // evenly spaced until learned
+    for (int i = 0; i < MAX_PULSES_PER_REVOLUTION; i++)
+    {
+        this->shares[i] = 65536 / pulses;
+    }
+    this->magnet = pulses - 1;
+    this->reset();
+}
+
+uint8_t MicroBitPulsePhase::getPulses(void)
+{
+    return this->pulses;
+}
+
+void MicroBitPulsePhase::reset(void)
+{
+    // The magnets keep their numbers: the flywheel does not pass one without a pulse.
+    this->known = 0;
+    this->head = 0;
+    this->intervals[0] = 0;
+    this->intervals[1] = 0;
+}
+
+bool MicroBitPulsePhase::edge(uint64_t timestamp)
+{
+    const int size = this->pulses;
+    uint64_t previous = this->timestamps[(this->head + size - 1) % size];
+    uint64_t revolutionStart = this->timestamps[this->head];
+    this->timestamps[this->head] = timestamp;
+    this->head = (this->head + 1) % size;
+    this->magnet = (uint8_t)((this->magnet + 1) % this->pulses);
+    if (this->known <= this->pulses)
+    {
+        this->known++;
+    }
+
+    if (this->known >= 2)
+    {
+        uint32_t interval = (uint32_t)(timestamp - previous);
+        // the interval follows the previous magnet
+        uint8_t k = (uint8_t)((this->magnet + this->pulses - 1) % this->pulses);
+        uint32_t revolution = (this->shares[k] == 0) ? 0 : (uint32_t)(((uint64_t)interval << 16) / this->shares[k]);
+        // learned after use: a change of cadence within the revolution does not bend the share of this pulse
+        if (this->known > this->pulses && this->pulses > 1 && timestamp > revolutionStart)
+        {
+            uint32_t share = (uint32_t)(((uint64_t)interval << 16) / (timestamp - revolutionStart));
+            this->shares[k] = (this->shares[k] * 7 + share + 4) / 8;
+        }
+        this->intervals[0] = (this->intervals[1] == 0) ? revolution : this->intervals[1];
+        this->intervals[1] = revolution;
+    }
+    return this->magnet == this->pulses - 1;
+}
+
+uint32_t MicroBitPulsePhase::getIntervalTime(void)
+{
+    return (uint32_t)(((uint64_t)this->intervals[0] + this->intervals[1]) / 2);
+}
+
+uint32_t MicroBitPulsePhase::getIntervalBound(uint64_t elapsed)
+{
+    uint32_t share = this->shares[this->magnet];
+    if (share == 0)
+    {
+        return 0xFFFFFFFF;
+    }
+    uint64_t bound = (elapsed << 16) / share;
+    return (bound > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t)bound;
+}
+
+uint16_t MicroBitPulsePhase::getShare(uint8_t magnet)
+{
+    if (magnet >= this->pulses)
+    {
+        return 0;
+    }
+    return (this->shares[magnet] > 0xFFFF) ? 0xFFFF : (uint16_t)this->shares[magnet];
+}
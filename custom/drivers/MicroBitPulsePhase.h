@@ -0,0 +1,98 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MICROBIT_PULSE_PHASE_H
+#define MICROBIT_PULSE_PHASE_H
+
+#include <stdint.h>
+#include "MicroBitCustom.h"
+
+#define MIN_PULSES_PER_REVOLUTION 1
+#define MAX_PULSES_PER_REVOLUTION 8
+
+/**
+  * Crank interval from every pulse of a flywheel with N magnets, spaced evenly or not.
+  * The share of the revolution after each magnet is learned with an EWMA (1/8) of the pulse interval over the
+  * revolution that ends with it; dividing a pulse interval by its share gives the interval of a full revolution.
+  * The magnets are told apart by counting the pulses, so a missed pulse swaps the shares until they are learned again.
+  * No dependency on the micro:bit runtime, so the host test (tools/pulse_phase_test) shares it.
+  */
+class MicroBitPulsePhase
+{
+
+public:
+    /**
+      * Constructor.
+      * @param pulses Pulses per revolution (1 ~ 8).
+      */
+    MicroBitPulsePhase(uint8_t pulses = 1);
+
+    /**
+      * Pulses per revolution (1 ~ 8), forgets the shares and the pulses.
+      */
+    void setPulses(uint8_t pulses);
+    uint8_t getPulses(void);
+
+    /**
+      * Forget the pulses (pedalling stopped); the shares are kept.
+      */
+    void reset(void);
+
+    /**
+      * A pulse (us).
+      * @return true if the pulse completes a revolution (every N pulses).
+      */
+    bool edge(uint64_t timestamp);
+
+    /**
+      * Interval of a revolution (us): the average over the last two pulses, 0 until one is known.
+      */
+    uint32_t getIntervalTime(void);
+
+    /**
+      * Lowest interval of the revolution (us), given the time since the last pulse: the next pulse is at least that late.
+      */
+    uint32_t getIntervalBound(uint64_t elapsed);
+
+    /**
+      * Share of the revolution after a magnet (1/65536).
+      */
+    uint16_t getShare(uint8_t magnet);
+
+private:
+    uint8_t pulses;
+    // magnet of the last pulse, and the pulses known since the reset (up to N + 1)
+    uint8_t magnet;
+    uint8_t known;
+    // timestamps of the last N pulses, oldest at head
+    uint64_t timestamps[MAX_PULSES_PER_REVOLUTION];
+    uint8_t head;
+    // share of the revolution after each magnet (1/65536)
+    uint32_t shares[MAX_PULSES_PER_REVOLUTION];
+    // revolution intervals of the last two pulses (us)
+    uint32_t intervals[2];
+
+};
+
+#endif /* #ifndef MICROBIT_PULSE_PHASE_H */
@@ -0,0 +1,160 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "MicroBitStepHealth.h"
+#include <string.h>
+
+// Intervals of the typical one before the bounces and missed pulses are told
+#define TYPICAL_COUNT_MIN 4
+
+static void increment(uint16_t *counter)
+{
+    if (*counter < 0xFFFF)
+    {
+        (*counter)++;
+    }
+}
+
+MicroBitStepHealth::MicroBitStepHealth()
+{
+    this->reset();
+}
+
+void MicroBitStepHealth::reset(void)
+{
+    this->lastEdge = 0;
+    this->haveLastEdge = false;
+    this->typical = 0;
+    this->typicalCount = 0;
+    this->edges = 0;
+    this->bounces = 0;
+    this->missed = 0;
+    this->stops = 0;
+    memset(this->histogram, 0, sizeof(this->histogram));
+}
+
+int MicroBitStepHealth::getBucket(uint32_t interval)
+{
+    if (interval < MICROBIT_STEP_HEALTH_FIRST_US)
+    {
+        return 0;
+    }
+    // octave, then the upper half of it (x sqrt(2) = 181/128)
+    uint32_t ratio = interval / MICROBIT_STEP_HEALTH_FIRST_US;
+    int octave = 0;
+    while ((ratio >> (octave + 1)) != 0)
+    {
+        octave++;
+    }
+    uint64_t low = (uint64_t)MICROBIT_STEP_HEALTH_FIRST_US << octave;
+    int bucket = octave * 2 + (((uint64_t)interval * 128 >= low * 181) ? 1 : 0);
+    return (bucket >= MICROBIT_STEP_HEALTH_BUCKETS) ? MICROBIT_STEP_HEALTH_BUCKETS - 1 : bucket;
+}
+
+void MicroBitStepHealth::edge(uint64_t timestamp)
+{
+    if (this->edges < 0xFFFFFFFF)
+    {
+        this->edges++;
+    }
+    if (!this->haveLastEdge)
+    {
+        this->lastEdge = timestamp;
+        this->haveLastEdge = true;
+        return;
+    }
+
+    uint64_t interval64 = timestamp - this->lastEdge;
+    uint32_t interval = (interval64 > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t)interval64;
+    increment(&this->histogram[getBucket(interval)]);
+
+    bool known = this->typicalCount >= TYPICAL_COUNT_MIN;
+    if (interval < MICROBIT_STEP_HEALTH_BOUNCE_US || (known && (uint64_t)interval * 4 < this->typical))
+    {
+        // The bounce is not a revolution: the next interval starts at the edge before it.
+        increment(&this->bounces);
+        return;
+    }
+    this->lastEdge = timestamp;
+    if (known && (uint64_t)interval * 10 >= (uint64_t)this->typical * 16 && (uint64_t)interval * 10 < (uint64_t)this->typical * 26)
+    {
+        increment(&this->missed);
+        return;
+    }
+
+    if (this->typicalCount == 0)
+    {
+        this->typical = interval;
+    }
+    else
+    {
+        this->typical = (uint32_t)(((uint64_t)this->typical * 7 + interval + 4) / 8);
+    }
+    if (this->typicalCount < TYPICAL_COUNT_MIN)
+    {
+        this->typicalCount++;
+    }
+}
+
+void MicroBitStepHealth::stop(void)
+{
+    increment(&this->stops);
+    // the cadence after a stop has nothing to do with the one before
+    this->haveLastEdge = false;
+    this->typicalCount = 0;
+}
+
+uint32_t MicroBitStepHealth::getEdges(void)
+{
+    return this->edges;
+}
+
+uint16_t MicroBitStepHealth::getBounces(void)
+{
+    return this->bounces;
+}
+
+uint16_t MicroBitStepHealth::getMissed(void)
+{
+    return this->missed;
+}
+
+uint16_t MicroBitStepHealth::getStops(void)
+{
+    return this->stops;
+}
+
+uint16_t MicroBitStepHealth::getHistogram(int bucket)
+{
+    if (bucket < 0 || bucket >= MICROBIT_STEP_HEALTH_BUCKETS)
+    {
+        return 0;
+    }
+    return this->histogram[bucket];
+}
+
+uint32_t MicroBitStepHealth::getTypicalInterval(void)
+{
+    return (this->typicalCount >= TYPICAL_COUNT_MIN) ? this->typical : 0;
+}
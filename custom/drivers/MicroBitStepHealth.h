@@ -0,0 +1,98 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MICROBIT_STEP_HEALTH_H
+#define MICROBIT_STEP_HEALTH_H
+
+#include <stdint.h>
+#include "MicroBitCustom.h"
+
+// Histogram of the STEP intervals: half octaves from 16 ms, the last bucket open ended
+#define MICROBIT_STEP_HEALTH_BUCKETS        16
+#define MICROBIT_STEP_HEALTH_FIRST_US       16000
+
+/**
+  * Statistics of the STEP edges of a session, to tell a failing reed switch or magnet from a firmware problem remotely.
+  *  - Histogram of the intervals between edges, in half octave buckets.
+  *  - Bounces: intervals shorter than MICROBIT_STEP_HEALTH_BOUNCE_US or a quarter of the typical interval.
+  *  - Missed pulses: intervals of about twice the typical one (1.6 ~ 2.6 x).
+  *  - Stops: the sensor cleared its edges after MAX_STEPS_INTERVAL_TIME_US without one.
+  * The typical interval is an EWMA (1/8) of the intervals that are neither. With unevenly spaced magnets
+  * the normal intervals spread around it, so the missed pulse count is approximate there.
+  * No dependency on the micro:bit runtime, so the host test (tools/step_health_test) shares it.
+  */
+class MicroBitStepHealth
+{
+
+public:
+    /**
+      * Constructor.
+      */
+    MicroBitStepHealth();
+
+    /**
+      * A STEP edge (us).
+      */
+    void edge(uint64_t timestamp);
+
+    /**
+      * The sensor cleared its edges (pedalling stopped, or no signal).
+      */
+    void stop(void);
+
+    /**
+      * Start a new session.
+      */
+    void reset(void);
+
+    /**
+      * Bucket of an interval (us).
+      */
+    static int getBucket(uint32_t interval);
+
+    // Counts of the session (saturated)
+    uint32_t getEdges(void);
+    uint16_t getBounces(void);
+    uint16_t getMissed(void);
+    uint16_t getStops(void);
+    uint16_t getHistogram(int bucket);
+    // Typical interval (us), 0 until known
+    uint32_t getTypicalInterval(void);
+
+private:
+    uint64_t lastEdge;
+    // no interval from the first edge after a stop
+    bool haveLastEdge;
+    uint32_t typical;
+    uint8_t typicalCount;
+
+    uint32_t edges;
+    uint16_t bounces;
+    uint16_t missed;
+    uint16_t stops;
+    uint16_t histogram[MICROBIT_STEP_HEALTH_BUCKETS];
+
+};
+
+#endif /* #ifndef MICROBIT_STEP_HEALTH_H */
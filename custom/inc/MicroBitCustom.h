@@ -40,6 +40,165 @@ static const uint16_t MICROBIT_CUSTOM_ID_BASE = 32768;
 // Event value
 #define MICROBIT_INDOOR_BIKE_STEP_SENSOR_EVT_DATA_UPDATE 0b0000000000000001
 
+// STEP pulses per crank revolution (magnets on the flywheel, 1 ~ 8) until one is set
+#ifndef MICROBIT_INDOOR_BIKE_STEP_SENSOR_PULSES
+#define MICROBIT_INDOOR_BIKE_STEP_SENSOR_PULSES 1
+#endif /* #ifndef MICROBIT_INDOOR_BIKE_STEP_SENSOR_PULSES */
+
+/*
+ * MicroBitStepHealth
+ */
+
+// STEP intervals shorter than this are bounces of the switch (us)
+#ifndef MICROBIT_STEP_HEALTH_BOUNCE_US
+#define MICROBIT_STEP_HEALTH_BOUNCE_US 20000
+#endif /* #ifndef MICROBIT_STEP_HEALTH_BOUNCE_US */
+
+// Sensor updates between the health records on the serial stream
+#ifndef MICROBIT_STEP_HEALTH_TELEMETRY_PERIOD
+#define MICROBIT_STEP_HEALTH_TELEMETRY_PERIOD 10
+#endif /* #ifndef MICROBIT_STEP_HEALTH_TELEMETRY_PERIOD */
+
+/*
+ * MicroBitCadencePredictor
+ */
+
+// Estimate the cadence between STEP edges from the trend of the intervals
+// (off: with jitter on the edges it is worse than the measured value, tools/estimator_bench)
+#ifndef MICROBIT_CADENCE_PREDICTOR_ENABLED
+#define MICROBIT_CADENCE_PREDICTOR_ENABLED 0
+#endif /* #ifndef MICROBIT_CADENCE_PREDICTOR_ENABLED */
+
+// Lowest confidence (0 ~ 99) of an estimate shown instead of the measured value
+#ifndef MICROBIT_CADENCE_PREDICTOR_MIN_CONFIDENCE
+#define MICROBIT_CADENCE_PREDICTOR_MIN_CONFIDENCE 50
+#endif /* #ifndef MICROBIT_CADENCE_PREDICTOR_MIN_CONFIDENCE */
+
+/*
+ * MicroBitTelemetry
+ */
+
+// Binary telemetry on USB serial (the radio hub role uses the serial port for its table)
+#ifndef MICROBIT_TELEMETRY_ENABLED
+#define MICROBIT_TELEMETRY_ENABLED 1
+#endif /* #ifndef MICROBIT_TELEMETRY_ENABLED */
+
+// Event Bus ID for telemetry
+#ifndef MICROBIT_TELEMETRY_ID
+#define MICROBIT_TELEMETRY_ID (MICROBIT_CUSTOM_ID_BASE+6)
+#endif /* #ifndef MICROBIT_TELEMETRY_ID */
+
+// Ring buffer of the framed records (bytes, a power of two)
+#ifndef MICROBIT_TELEMETRY_BUFFER_SIZE
+#define MICROBIT_TELEMETRY_BUFFER_SIZE 512
+#endif /* #ifndef MICROBIT_TELEMETRY_BUFFER_SIZE */
+
+// Serial TX buffer (bytes)
+#ifndef MICROBIT_TELEMETRY_SERIAL_BUFFER_SIZE
+#define MICROBIT_TELEMETRY_SERIAL_BUFFER_SIZE 64
+#endif /* #ifndef MICROBIT_TELEMETRY_SERIAL_BUFFER_SIZE */
+
+/*
+ * MicroBitConfigStore
+ */
+
+// Flash page size of the nRF51 (bytes)
+#ifndef MICROBIT_CONFIG_STORE_PAGE_SIZE
+#define MICROBIT_CONFIG_STORE_PAGE_SIZE 1024
+#endif /* #ifndef MICROBIT_CONFIG_STORE_PAGE_SIZE */
+
+// The store uses the pages (top - offset) and (top - offset - 1).
+// The DAL uses 17 (MicroBitStorage) and 19 (scratch), the SoftDevice bond data the top pages.
+#ifndef MICROBIT_CONFIG_STORE_PAGE_OFFSET
+#define MICROBIT_CONFIG_STORE_PAGE_OFFSET 21
+#endif /* #ifndef MICROBIT_CONFIG_STORE_PAGE_OFFSET */
+
+// Number of keys, and largest value (bytes)
+#ifndef MICROBIT_CONFIG_STORE_KEY_MAX
+#define MICROBIT_CONFIG_STORE_KEY_MAX 16
+#endif /* #ifndef MICROBIT_CONFIG_STORE_KEY_MAX */
+#ifndef MICROBIT_CONFIG_STORE_VALUE_MAX
+#define MICROBIT_CONFIG_STORE_VALUE_MAX 16
+#endif /* #ifndef MICROBIT_CONFIG_STORE_VALUE_MAX */
+
+// Keys
+#define MICROBIT_CONFIG_KEY_RESISTANCE_LEVEL10  1   // uint8_t
+#define MICROBIT_CONFIG_KEY_RIDER_WEIGHT        2   // uint8_t, kg
+#define MICROBIT_CONFIG_KEY_INCLINE_A           3   // float
+#define MICROBIT_CONFIG_KEY_INCLINE_B           4   // float
+#define MICROBIT_CONFIG_KEY_FTP                 5   // uint16_t, watt
+#define MICROBIT_CONFIG_KEY_PULSES              6   // uint8_t, per revolution
+
+/*
+ * MicroBitRideLog
+ */
+
+// Log of every STEP edge in flash
+#ifndef MICROBIT_RIDE_LOG_ENABLED
+#define MICROBIT_RIDE_LOG_ENABLED 1
+#endif /* #ifndef MICROBIT_RIDE_LOG_ENABLED */
+
+// The log uses the pages (top - offset) down to (top - offset - pages + 1), below MicroBitConfigStore.
+// The lowest page must stay above the end of the program.
+#ifndef MICROBIT_RIDE_LOG_PAGE_OFFSET
+#define MICROBIT_RIDE_LOG_PAGE_OFFSET 23
+#endif /* #ifndef MICROBIT_RIDE_LOG_PAGE_OFFSET */
+
+// Number of pages; a page holds about 1000 edges at a steady cadence (11 minutes at 90 rpm, one pulse per revolution)
+#ifndef MICROBIT_RIDE_LOG_PAGES
+#define MICROBIT_RIDE_LOG_PAGES 8
+#endif /* #ifndef MICROBIT_RIDE_LOG_PAGES */
+
+// Edges waiting in RAM for the flash (a power of two)
+#ifndef MICROBIT_RIDE_LOG_QUEUE_SIZE
+#define MICROBIT_RIDE_LOG_QUEUE_SIZE 32
+#endif /* #ifndef MICROBIT_RIDE_LOG_QUEUE_SIZE */
+
+// Event Bus ID for the ride log
+#ifndef MICROBIT_RIDE_LOG_ID
+#define MICROBIT_RIDE_LOG_ID (MICROBIT_CUSTOM_ID_BASE+7)
+#endif /* #ifndef MICROBIT_RIDE_LOG_ID */
+
+/*
+ * MicroBitPowerAnalytics
+ */
+
+// Functional Threshold Power until one is set (watt)
+#ifndef MICROBIT_POWER_ANALYTICS_DEFAULT_FTP
+#define MICROBIT_POWER_ANALYTICS_DEFAULT_FTP 200
+#endif /* #ifndef MICROBIT_POWER_ANALYTICS_DEFAULT_FTP */
+
+/*
+ * MicroBitBLEConnectionTable
+ */
+
+// Number of BLE centrals served at the same time.
+// Note: the S110 SoftDevice of the micro:bit v1 accepts one central at a time,
+//       the other slots are used with a multi-link stack (S130).
+#ifndef MICROBIT_BLE_CONNECTION_TABLE_SIZE
+#define MICROBIT_BLE_CONNECTION_TABLE_SIZE 3
+#endif /* #ifndef MICROBIT_BLE_CONNECTION_TABLE_SIZE */
+
+// Number of notify/indicate characteristics tracked per connection (bits of the subscription mask)
+#ifndef MICROBIT_BLE_CONNECTION_TABLE_CHARACTERISTICS
+#define MICROBIT_BLE_CONNECTION_TABLE_CHARACTERISTICS 12
+#endif /* #ifndef MICROBIT_BLE_CONNECTION_TABLE_CHARACTERISTICS */
+
+// Number of services listed in the scan response (CSC, CPS)
+#ifndef MICROBIT_BLE_SCAN_RESPONSE_SERVICES
+#define MICROBIT_BLE_SCAN_RESPONSE_SERVICES 4
+#endif /* #ifndef MICROBIT_BLE_SCAN_RESPONSE_SERVICES */
+
+// An indication not confirmed in this time is given up (ATT transaction timeout, ms)
+#ifndef MICROBIT_BLE_INDICATION_TIMEOUT_MS
+#define MICROBIT_BLE_INDICATION_TIMEOUT_MS 30000
+#endif /* #ifndef MICROBIT_BLE_INDICATION_TIMEOUT_MS */
+
+// Panic code of a service the GATT table of the SoftDevice has no room for (MICROBIT_SD_GATT_TABLE_SIZE, mbed_app.json)
+#ifndef MICROBIT_BLE_PANIC_GATT_TABLE_FULL
+#define MICROBIT_BLE_PANIC_GATT_TABLE_FULL 120
+#endif /* #ifndef MICROBIT_BLE_PANIC_GATT_TABLE_FULL */
+
 /*
  * MicroBitIndoorBikeStepService
  */
@@ -52,6 +211,38 @@ static const uint16_t MICROBIT_CUSTOM_ID_BASE = 32768;
 #define BLE_DEVICE_LOCAL_NAME "STEP:BIT"
 #endif /* #ifndef BLE_DEVICE_LOCAL_NAME */
 
+// FTMS procedures need Request Control (op code 0x00) first, as the spec says.
+// 0: a central may run them while nobody holds control (apps that never request control)
+#ifndef MICROBIT_FTMS_REQUEST_CONTROL_REQUIRED
+#define MICROBIT_FTMS_REQUEST_CONTROL_REQUIRED 1
+#endif /* #ifndef MICROBIT_FTMS_REQUEST_CONTROL_REQUIRED */
+
+// Live data in the advertising payload (MicroBitIndoorBikeBroadcastMode)
+// 0: off, 1: connectable, 2: broadcast only (scannable, not connectable)
+#ifndef BLE_INDOOR_BIKE_BROADCAST_MODE
+#define BLE_INDOOR_BIKE_BROADCAST_MODE 0
+#endif /* #ifndef BLE_INDOOR_BIKE_BROADCAST_MODE */
+
+// Shortest advertising interval of broadcast only (ms): the SoftDevice refuses
+// scannable and non-connectable advertising faster than every 100 ms
+#ifndef BLE_INDOOR_BIKE_BROADCAST_ONLY_INTERVAL_MS
+#define BLE_INDOOR_BIKE_BROADCAST_ONLY_INTERVAL_MS 100
+#endif /* #ifndef BLE_INDOOR_BIKE_BROADCAST_ONLY_INTERVAL_MS */
+
+// Company Identifier of the Manufacturer Specific Data carrying the live data
+// 0xFFFF: not assigned, reserved for testing
+#ifndef BLE_INDOOR_BIKE_BROADCAST_COMPANY_ID
+#define BLE_INDOOR_BIKE_BROADCAST_COMPANY_ID 0xFFFF
+#endif /* #ifndef BLE_INDOOR_BIKE_BROADCAST_COMPANY_ID */
+
+// Fitness machine published by the FTMS, one per image (MicroBitFitnessMachineProfile.h)
+#define MICROBIT_FTMS_MACHINE_INDOOR_BIKE    0   // Indoor Bike Data (0x2AD2): speed, cadence, power
+#define MICROBIT_FTMS_MACHINE_ROWER          1   // Rower Data (0x2AD1): stroke rate, stroke count, power
+#define MICROBIT_FTMS_MACHINE_CROSS_TRAINER  2   // Cross Trainer Data (0x2ACE): speed, step rate, power
+#ifndef MICROBIT_FTMS_MACHINE
+#define MICROBIT_FTMS_MACHINE MICROBIT_FTMS_MACHINE_INDOOR_BIKE
+#endif /* #ifndef MICROBIT_FTMS_MACHINE */
+
 // Event Bus ID for IndoorBike step sensor
 #ifndef MICROBIT_INDOORBIKE_STEP_SERVICE_ID
 #define MICROBIT_INDOORBIKE_STEP_SERVICE_ID (MICROBIT_CUSTOM_ID_BASE+2)
@@ -61,4 +252,117 @@ static const uint16_t MICROBIT_CUSTOM_ID_BASE = 32768;
 // Fitness Machine Control Point
 #define FTMP_EVENT_VAL_FITNESS_MACHINE_CONTROL_POINT    0b0000000000000001
 
+/*
+ * MicroBitCyclingSpeedCadenceService
+ */
+
+// Event Bus ID for Cycling Speed and Cadence service
+#ifndef MICROBIT_CYCLING_SPEED_CADENCE_SERVICE_ID
+#define MICROBIT_CYCLING_SPEED_CADENCE_SERVICE_ID (MICROBIT_CUSTOM_ID_BASE+3)
+#endif /* #ifndef MICROBIT_CYCLING_SPEED_CADENCE_SERVICE_ID */
+
+/*
+ * MicroBitCyclingPowerService
+ */
+
+// Event Bus ID for Cycling Power service
+#ifndef MICROBIT_CYCLING_POWER_SERVICE_ID
+#define MICROBIT_CYCLING_POWER_SERVICE_ID (MICROBIT_CUSTOM_ID_BASE+4)
+#endif /* #ifndef MICROBIT_CYCLING_POWER_SERVICE_ID */
+
+/*
+ * MicroBitRideLogService
+ */
+
+// Event Bus ID for the ride log service
+#ifndef MICROBIT_RIDE_LOG_SERVICE_ID
+#define MICROBIT_RIDE_LOG_SERVICE_ID (MICROBIT_CUSTOM_ID_BASE+8)
+#endif /* #ifndef MICROBIT_RIDE_LOG_SERVICE_ID */
+
+// Event value
+#define MICROBIT_RIDE_LOG_SERVICE_EVT_START 0b0000000000000001
+
+/*
+ * MicroBitDiagnosticsService
+ */
+
+// Event Bus ID for the diagnostics service
+#ifndef MICROBIT_DIAGNOSTICS_SERVICE_ID
+#define MICROBIT_DIAGNOSTICS_SERVICE_ID (MICROBIT_CUSTOM_ID_BASE+9)
+#endif /* #ifndef MICROBIT_DIAGNOSTICS_SERVICE_ID */
+
+// Event value
+#define MICROBIT_DIAGNOSTICS_SERVICE_EVT_CONTROL 0b0000000000000001
+
+/*
+ * main.cpp
+ */
+
+// Firmware role
+#define MICROBIT_INDOOR_BIKE_ROLE_BLE           0   // BLE services (FTMS, CSC, CPS)
+#define MICROBIT_INDOOR_BIKE_ROLE_RADIO_SENDER  1   // radio frames to a hub (MICROBIT_BLE_ENABLED=0)
+#define MICROBIT_INDOOR_BIKE_ROLE_RADIO_HUB     2   // radio hub, table on USB serial (MICROBIT_BLE_ENABLED=0)
+#ifndef MICROBIT_INDOOR_BIKE_ROLE
+#define MICROBIT_INDOOR_BIKE_ROLE MICROBIT_INDOOR_BIKE_ROLE_BLE
+#endif /* #ifndef MICROBIT_INDOOR_BIKE_ROLE */
+
+/*
+ * MicroBitIndoorBikeRadioSender / MicroBitIndoorBikeRadioHub
+ */
+
+// Radio group shared by the bikes and the hub of a class
+#ifndef MICROBIT_INDOOR_BIKE_RADIO_GROUP
+#define MICROBIT_INDOOR_BIKE_RADIO_GROUP 42
+#endif /* #ifndef MICROBIT_INDOOR_BIKE_RADIO_GROUP */
+
+// Transmit power of the bikes (0-7)
+#ifndef MICROBIT_INDOOR_BIKE_RADIO_POWER
+#define MICROBIT_INDOOR_BIKE_RADIO_POWER 6
+#endif /* #ifndef MICROBIT_INDOOR_BIKE_RADIO_POWER */
+
+// Number of bikes in the hub table
+#ifndef MICROBIT_INDOOR_BIKE_RADIO_HUB_SIZE
+#define MICROBIT_INDOOR_BIKE_RADIO_HUB_SIZE 32
+#endif /* #ifndef MICROBIT_INDOOR_BIKE_RADIO_HUB_SIZE */
+
+// A bike silent for this long restarts its sequence numbers (ms)
+#ifndef MICROBIT_INDOOR_BIKE_RADIO_HUB_RESYNC_MS
+#define MICROBIT_INDOOR_BIKE_RADIO_HUB_RESYNC_MS 3000
+#endif /* #ifndef MICROBIT_INDOOR_BIKE_RADIO_HUB_RESYNC_MS */
+
+// A bike silent for this long is removed from the table (ms)
+#ifndef MICROBIT_INDOOR_BIKE_RADIO_HUB_EXPIRE_MS
+#define MICROBIT_INDOOR_BIKE_RADIO_HUB_EXPIRE_MS 10000
+#endif /* #ifndef MICROBIT_INDOOR_BIKE_RADIO_HUB_EXPIRE_MS */
+
+// Serial stream period of the hub (ms)
+#ifndef MICROBIT_INDOOR_BIKE_RADIO_HUB_STREAM_PERIOD_MS
+#define MICROBIT_INDOOR_BIKE_RADIO_HUB_STREAM_PERIOD_MS 1000
+#endif /* #ifndef MICROBIT_INDOOR_BIKE_RADIO_HUB_STREAM_PERIOD_MS */
+
+// Event Bus ID for the radio hub
+#ifndef MICROBIT_INDOOR_BIKE_RADIO_HUB_ID
+#define MICROBIT_INDOOR_BIKE_RADIO_HUB_ID (MICROBIT_CUSTOM_ID_BASE+5)
+#endif /* #ifndef MICROBIT_INDOOR_BIKE_RADIO_HUB_ID */
+
+// Event value
+#define MICROBIT_INDOOR_BIKE_RADIO_HUB_EVT_STREAM 0b0000000000000001
+
+/*
+ * MicroBitCustomPipeline
+ */
+
+// Event Bus ID of a pipeline (each pipeline takes its own)
+#ifndef MICROBIT_CUSTOM_PIPELINE_ID
+#define MICROBIT_CUSTOM_PIPELINE_ID (MICROBIT_CUSTOM_ID_BASE+10)
+#endif /* #ifndef MICROBIT_CUSTOM_PIPELINE_ID */
+
+// Event value - MicroBitPipelineEventSink
+#define MICROBIT_CUSTOM_PIPELINE_EVT_DATA_UPDATE 0b0000000000000001
+
+// Edges an edge source holds between two idle ticks (a power of 2, up to 128)
+#ifndef MICROBIT_CUSTOM_PIPELINE_EDGES
+#define MICROBIT_CUSTOM_PIPELINE_EDGES 8
+#endif /* #ifndef MICROBIT_CUSTOM_PIPELINE_EDGES */
+
 #endif /* #ifndef MICROBIT_CUSTOM_H */
\ No newline at end of file
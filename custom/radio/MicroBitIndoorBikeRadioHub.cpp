@@ -0,0 +1,121 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "MicroBitIndoorBikeRadioHub.h"
+#include <stdio.h>
+
+MicroBitIndoorBikeRadioHub::MicroBitIndoorBikeRadioHub(MicroBit &_uBit, uint16_t id)
+    : uBit(_uBit)
+{
+    this->id = id;
+    this->streamTimestamp = 0;
+
+    uBit.radio.enable();
+    uBit.radio.setGroup(MICROBIT_INDOOR_BIKE_RADIO_GROUP);
+
+    if (EventModel::defaultEventBus)
+    {
+        EventModel::defaultEventBus->listen(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_DATAGRAM
+            , this, &MicroBitIndoorBikeRadioHub::onDatagram, MESSAGE_BUS_LISTENER_IMMEDIATE);
+        // Serial writes block, so the stream runs in a fiber of the message bus.
+        EventModel::defaultEventBus->listen(this->id, MICROBIT_INDOOR_BIKE_RADIO_HUB_EVT_STREAM
+            , this, &MicroBitIndoorBikeRadioHub::onStream, MESSAGE_BUS_LISTENER_DROP_IF_BUSY);
+    }
+}
+
+void MicroBitIndoorBikeRadioHub::idleTick()
+{
+    if(!(status & MICROBIT_INDOOR_BIKE_RADIO_HUB_ADDED_TO_IDLE))
+    {
+        fiber_add_idle_component(this);
+        status |= MICROBIT_INDOOR_BIKE_RADIO_HUB_ADDED_TO_IDLE;
+    }
+
+    uint64_t currentTime = MicroBitCustomClock::currentTimeUs();
+    if (currentTime >= this->streamTimestamp)
+    {
+        this->streamTimestamp = currentTime + (uint64_t)MICROBIT_INDOOR_BIKE_RADIO_HUB_STREAM_PERIOD_MS * 1000;
+        MicroBitEvent e(id, MICROBIT_INDOOR_BIKE_RADIO_HUB_EVT_STREAM);
+    }
+}
+
+MicroBitIndoorBikeRadioTable &MicroBitIndoorBikeRadioHub::getTable(void)
+{
+    return this->table;
+}
+
+void MicroBitIndoorBikeRadioHub::onDatagram(MicroBitEvent e)
+{
+    // Drain the receive queue, it holds only a few frames.
+    uint32_t now = (uint32_t)(MicroBitCustomClock::currentTimeUs() / 1000);
+    PacketBuffer packet = uBit.radio.datagram.recv();
+    while (packet.length() > 0)
+    {
+        MicroBitIndoorBikeRadioSnapshot snapshot;
+        if (MicroBitIndoorBikeRadioFrame::decode(packet.getBytes(), packet.length(), &snapshot))
+        {
+            this->table.accept(snapshot, packet.getRSSI(), now);
+        }
+        packet = uBit.radio.datagram.recv();
+    }
+}
+
+void MicroBitIndoorBikeRadioHub::onStream(MicroBitEvent e)
+{
+    uint32_t now = (uint32_t)(MicroBitCustomClock::currentTimeUs() / 1000);
+    this->table.expire(now);
+
+    char line[96];
+    int len = snprintf(line, sizeof(line), "H,%d,%lu,%lu,%lu,%lu\r\n",
+        this->table.count(),
+        (unsigned long)this->table.accepted,
+        (unsigned long)this->table.duplicates,
+        (unsigned long)this->table.stale,
+        (unsigned long)this->table.full);
+    uBit.serial.send((uint8_t *)line, len, SYNC_SLEEP);
+
+    for (int i=0; i<MICROBIT_INDOOR_BIKE_RADIO_HUB_SIZE; i++)
+    {
+        const MicroBitIndoorBikeRadioEntry *p = this->table.get(i);
+        if (p == NULL)
+        {
+            continue;
+        }
+        // Copy first: frames keep arriving while the fiber sleeps in send().
+        MicroBitIndoorBikeRadioEntry entry = *p;
+        now = (uint32_t)(MicroBitCustomClock::currentTimeUs() / 1000);
+        len = snprintf(line, sizeof(line), "B,%08lX,%u,%u,%u,%d,%lu,%u,%d,%lu,%lu\r\n",
+            (unsigned long)entry.snapshot.bikeId,
+            entry.snapshot.sequence,
+            entry.snapshot.speed100,
+            entry.snapshot.cadence2,
+            entry.snapshot.power,
+            (unsigned long)entry.snapshot.crankRevolutions,
+            entry.snapshot.resistanceLevel10,
+            entry.rssi,
+            (unsigned long)entry.lost,
+            (unsigned long)(uint32_t)(now - entry.lastSeen));
+        uBit.serial.send((uint8_t *)line, len, SYNC_SLEEP);
+    }
+}
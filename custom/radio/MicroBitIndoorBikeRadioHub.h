@@ -0,0 +1,85 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MICROBIT_INDOOR_BIKE_RADIO_HUB_H
+#define MICROBIT_INDOOR_BIKE_RADIO_HUB_H
+
+#include "MicroBit.h"
+#include "MicroBitCustom.h"
+#include "MicroBitCustomComponent.h"
+#include "MicroBitIndoorBikeRadioTable.h"
+
+/**
+  * Status flags
+  */
+// Universal flags used as part of the status field
+// #define MICROBIT_COMPONENT_RUNNING		0x01
+#define MICROBIT_INDOOR_BIKE_RADIO_HUB_ADDED_TO_IDLE                0x02
+
+/**
+  * Receives the radio frames of many bikes and streams the table over USB serial.
+  *
+  * Serial output, once per MICROBIT_INDOOR_BIKE_RADIO_HUB_STREAM_PERIOD_MS:
+  *   H,<bikes>,<accepted>,<duplicates>,<stale>,<full>
+  *   B,<bike id>,<sequence>,<speed100>,<cadence2>,<power>,<crank revolutions>,<resistance10>,<rssi>,<lost>,<age ms>
+  *   (one B line per bike)
+  */
+class MicroBitIndoorBikeRadioHub : public MicroBitCustomComponent
+{
+
+public:
+    /**
+      * Constructor.
+      * @param _uBit The instance of a MicroBit runtime include a radio that we're running on.
+      */
+    MicroBitIndoorBikeRadioHub(MicroBit &_uBit, uint16_t id = MICROBIT_INDOOR_BIKE_RADIO_HUB_ID);
+
+    /**
+      * Periodic callback from MicroBit idle thread.
+      */
+    virtual void idleTick();
+
+    /**
+      * The table of the bikes.
+      */
+    MicroBitIndoorBikeRadioTable &getTable(void);
+
+private:
+    // Radio datagram callback
+    void onDatagram(MicroBitEvent e);
+    // Write the table to the serial port (runs in its own fiber)
+    void onStream(MicroBitEvent e);
+
+private:
+    // instance
+    MicroBit &uBit;
+
+    MicroBitIndoorBikeRadioTable table;
+
+    // Next stream time (us)
+    uint64_t streamTimestamp;
+
+};
+
+#endif /* #ifndef MICROBIT_INDOOR_BIKE_RADIO_HUB_H */
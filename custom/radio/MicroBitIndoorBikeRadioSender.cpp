@@ -0,0 +1,59 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "MicroBitIndoorBikeRadioSender.h"
+
+MicroBitIndoorBikeRadioSender::MicroBitIndoorBikeRadioSender(MicroBit &_uBit, MicroBitIndoorBikeStepSensor &_indoorBike)
+    : uBit(_uBit), indoorBike(_indoorBike)
+{
+    this->bikeId = microbit_serial_number();
+    this->sequence = 0;
+
+    uBit.radio.enable();
+    uBit.radio.setGroup(MICROBIT_INDOOR_BIKE_RADIO_GROUP);
+    uBit.radio.setTransmitPower(MICROBIT_INDOOR_BIKE_RADIO_POWER);
+
+    if (EventModel::defaultEventBus)
+    {
+        EventModel::defaultEventBus->listen(this->indoorBike.getId(), MICROBIT_INDOOR_BIKE_STEP_SENSOR_EVT_DATA_UPDATE
+            , this, &MicroBitIndoorBikeRadioSender::indoorBikeUpdate, MESSAGE_BUS_LISTENER_IMMEDIATE);
+    }
+}
+
+void MicroBitIndoorBikeRadioSender::indoorBikeUpdate(MicroBitEvent e)
+{
+    MicroBitIndoorBikeRadioSnapshot snapshot;
+    snapshot.bikeId = this->bikeId;
+    snapshot.sequence = this->sequence++;
+    snapshot.speed100 = (uint16_t)this->indoorBike.getSpeed100();
+    snapshot.cadence2 = (uint16_t)this->indoorBike.getCadence2();
+    snapshot.power = this->indoorBike.getPower();
+    snapshot.crankRevolutions = this->indoorBike.getCrankRevolutions();
+    snapshot.crankEventTime1024 = this->indoorBike.getCrankEventTime1024();
+    snapshot.resistanceLevel10 = this->indoorBike.getResistanceLevel10();
+
+    uint8_t frame[MICROBIT_INDOOR_BIKE_RADIO_FRAME_SIZE];
+    MicroBitIndoorBikeRadioFrame::encode(snapshot, frame);
+    uBit.radio.datagram.send(frame, sizeof(frame));
+}
@@ -0,0 +1,65 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MICROBIT_INDOOR_BIKE_RADIO_SENDER_H
+#define MICROBIT_INDOOR_BIKE_RADIO_SENDER_H
+
+#include "MicroBit.h"
+#include "MicroBitCustom.h"
+#include "MicroBitIndoorBikeStepSensor.h"
+#include "MicroBitIndoorBikeRadioTable.h"
+
+/**
+  * Sends a radio frame of the sensor snapshot on each sensor update.
+  * The radio of the micro:bit v1 cannot run together with BLE (MICROBIT_BLE_ENABLED=0).
+  */
+class MicroBitIndoorBikeRadioSender
+{
+
+public:
+    /**
+      * Constructor.
+      * @param _uBit The instance of a MicroBit runtime include a radio that we're running on.
+      * @param _indoorBike The instance of a Indoor Bike Step Sensor.
+      */
+    MicroBitIndoorBikeRadioSender(MicroBit &_uBit, MicroBitIndoorBikeStepSensor &_indoorBike);
+
+private:
+    /**
+     * Indoor Bike update callback
+     */
+    void indoorBikeUpdate(MicroBitEvent e);
+
+private:
+    // instance
+    MicroBit &uBit;
+    MicroBitIndoorBikeStepSensor &indoorBike;
+
+    // var
+    uint32_t bikeId;
+    uint16_t sequence;
+
+};
+
+#endif /* #ifndef MICROBIT_INDOOR_BIKE_RADIO_SENDER_H */
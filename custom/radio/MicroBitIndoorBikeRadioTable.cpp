@@ -0,0 +1,170 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "MicroBitIndoorBikeRadioTable.h"
+#include "struct.h"
+#include <string.h>
+
+int MicroBitIndoorBikeRadioFrame::encode(const MicroBitIndoorBikeRadioSnapshot &snapshot, uint8_t *frame)
+{
+    return struct_pack(frame, MICROBIT_INDOOR_BIKE_RADIO_FRAME_FORMAT,
+        MICROBIT_INDOOR_BIKE_RADIO_FRAME_TYPE,
+        snapshot.bikeId,
+        snapshot.sequence,
+        snapshot.speed100,
+        snapshot.cadence2,
+        snapshot.power,
+        snapshot.crankRevolutions,
+        snapshot.crankEventTime1024,
+        snapshot.resistanceLevel10
+    );
+}
+
+bool MicroBitIndoorBikeRadioFrame::decode(const uint8_t *frame, int len, MicroBitIndoorBikeRadioSnapshot *snapshot)
+{
+    if (len != MICROBIT_INDOOR_BIKE_RADIO_FRAME_SIZE || frame[0] != MICROBIT_INDOOR_BIKE_RADIO_FRAME_TYPE)
+    {
+        return false;
+    }
+    uint8_t type;
+    struct_unpack(frame, MICROBIT_INDOOR_BIKE_RADIO_FRAME_FORMAT,
+        &type,
+        &snapshot->bikeId,
+        &snapshot->sequence,
+        &snapshot->speed100,
+        &snapshot->cadence2,
+        &snapshot->power,
+        &snapshot->crankRevolutions,
+        &snapshot->crankEventTime1024,
+        &snapshot->resistanceLevel10
+    );
+    return true;
+}
+
+MicroBitIndoorBikeRadioTable::MicroBitIndoorBikeRadioTable()
+{
+    memset(this->entries, 0, sizeof(this->entries));
+    this->accepted=0;
+    this->duplicates=0;
+    this->stale=0;
+    this->full=0;
+}
+
+int MicroBitIndoorBikeRadioTable::find(uint32_t bikeId)
+{
+    for (int i=0; i<MICROBIT_INDOOR_BIKE_RADIO_HUB_SIZE; i++)
+    {
+        if (this->entries[i].inUse && this->entries[i].snapshot.bikeId == bikeId)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int MicroBitIndoorBikeRadioTable::accept(const MicroBitIndoorBikeRadioSnapshot &snapshot, int rssi, uint32_t now)
+{
+    int i = this->find(snapshot.bikeId);
+    if (i < 0)
+    {
+        for (i=0; i<MICROBIT_INDOOR_BIKE_RADIO_HUB_SIZE; i++)
+        {
+            if (!this->entries[i].inUse)
+            {
+                break;
+            }
+        }
+        if (i == MICROBIT_INDOOR_BIKE_RADIO_HUB_SIZE)
+        {
+            this->full++;
+            return MICROBIT_INDOOR_BIKE_RADIO_TABLE_FULL;
+        }
+        memset(&this->entries[i], 0, sizeof(this->entries[i]));
+        this->entries[i].inUse = true;
+    }
+    else
+    {
+        MicroBitIndoorBikeRadioEntry *e = &this->entries[i];
+        // After a silence the sequence numbers start over (the sender rebooted or was out of range).
+        if ((uint32_t)(now - e->lastSeen) < MICROBIT_INDOOR_BIKE_RADIO_HUB_RESYNC_MS)
+        {
+            int16_t delta = (int16_t)(snapshot.sequence - e->snapshot.sequence);
+            if (delta == 0)
+            {
+                this->duplicates++;
+                return MICROBIT_INDOOR_BIKE_RADIO_DUPLICATE;
+            }
+            if (delta < 0)
+            {
+                this->stale++;
+                return MICROBIT_INDOOR_BIKE_RADIO_STALE;
+            }
+            e->lost += delta - 1;
+        }
+    }
+    
+    MicroBitIndoorBikeRadioEntry *e = &this->entries[i];
+    e->snapshot = snapshot;
+    e->lastSeen = now;
+    e->rssi = (int8_t)rssi;
+    e->received++;
+    this->accepted++;
+    return MICROBIT_INDOOR_BIKE_RADIO_ACCEPTED;
+}
+
+int MicroBitIndoorBikeRadioTable::expire(uint32_t now)
+{
+    int n = 0;
+    for (int i=0; i<MICROBIT_INDOOR_BIKE_RADIO_HUB_SIZE; i++)
+    {
+        if (this->entries[i].inUse && (uint32_t)(now - this->entries[i].lastSeen) >= MICROBIT_INDOOR_BIKE_RADIO_HUB_EXPIRE_MS)
+        {
+            this->entries[i].inUse = false;
+            n++;
+        }
+    }
+    return n;
+}
+
+const MicroBitIndoorBikeRadioEntry *MicroBitIndoorBikeRadioTable::get(int index)
+{
+    if (index < 0 || index >= MICROBIT_INDOOR_BIKE_RADIO_HUB_SIZE || !this->entries[index].inUse)
+    {
+        return NULL;
+    }
+    return &this->entries[index];
+}
+
+int MicroBitIndoorBikeRadioTable::count(void)
+{
+    int n = 0;
+    for (int i=0; i<MICROBIT_INDOOR_BIKE_RADIO_HUB_SIZE; i++)
+    {
+        if (this->entries[i].inUse)
+        {
+            n++;
+        }
+    }
+    return n;
+}
@@ -0,0 +1,162 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MICROBIT_INDOOR_BIKE_RADIO_TABLE_H
+#define MICROBIT_INDOOR_BIKE_RADIO_TABLE_H
+
+#include <stdint.h>
+#include "MicroBitCustom.h"
+
+/**
+  * Radio frame of a bike (little-endian, 20 bytes)
+  */
+//  B   type                      MICROBIT_INDOOR_BIKE_RADIO_FRAME_TYPE
+//  I   bike id                   serial number of the sender
+//  H   sequence number           counts up from 0 after each boot, wraps around
+//  H   speed                     km/h x 100
+//  H   cadence                   rpm x 2
+//  h   power                     watt
+//  I   crank revolutions         cumulative
+//  H   last crank event time     1/1024 s
+//  B   resistance level          x 10
+#define MICROBIT_INDOOR_BIKE_RADIO_FRAME_FORMAT "<BIHHHhIHB"
+#define MICROBIT_INDOOR_BIKE_RADIO_FRAME_SIZE   20
+#define MICROBIT_INDOOR_BIKE_RADIO_FRAME_TYPE   0xB1
+
+/**
+  * Result of MicroBitIndoorBikeRadioTable::accept()
+  */
+#define MICROBIT_INDOOR_BIKE_RADIO_ACCEPTED     0
+#define MICROBIT_INDOOR_BIKE_RADIO_DUPLICATE    1   // same sequence number as the stored one
+#define MICROBIT_INDOOR_BIKE_RADIO_STALE        2   // older than the stored one (reordered)
+#define MICROBIT_INDOOR_BIKE_RADIO_TABLE_FULL   3   // new bike and no free entry
+
+/**
+  * Sensor snapshot carried by a radio frame.
+  */
+struct MicroBitIndoorBikeRadioSnapshot
+{
+    uint32_t bikeId;
+    uint16_t sequence;
+    uint16_t speed100;
+    uint16_t cadence2;
+    int16_t power;
+    uint32_t crankRevolutions;
+    uint16_t crankEventTime1024;
+    uint8_t resistanceLevel10;
+};
+
+/**
+  * Per-bike entry of the hub.
+  */
+struct MicroBitIndoorBikeRadioEntry
+{
+    // true while the entry is used by a bike
+    bool inUse;
+    // latest accepted snapshot
+    MicroBitIndoorBikeRadioSnapshot snapshot;
+    // time of the latest accepted frame (ms)
+    uint32_t lastSeen;
+    // signal strength of the latest accepted frame (dBm)
+    int8_t rssi;
+    // frames accepted, and frames missed according to the sequence numbers
+    uint32_t received;
+    uint32_t lost;
+};
+
+/**
+  * Encode and decode radio frames.
+  * No dependency on the micro:bit runtime, so the same code runs in the host simulation (tools/radio_sim).
+  */
+class MicroBitIndoorBikeRadioFrame
+{
+public:
+    /**
+      * Encode a snapshot.
+      * @param frame The buffer of MICROBIT_INDOOR_BIKE_RADIO_FRAME_SIZE bytes.
+      * @return MICROBIT_INDOOR_BIKE_RADIO_FRAME_SIZE.
+      */
+    static int encode(const MicroBitIndoorBikeRadioSnapshot &snapshot, uint8_t *frame);
+
+    /**
+      * Decode a frame.
+      * @return true if the length and the type of the frame are valid.
+      */
+    static bool decode(const uint8_t *frame, int len, MicroBitIndoorBikeRadioSnapshot *snapshot);
+};
+
+/**
+  * Fixed-size table of the bikes heard by the hub.
+  * Frames are accepted in sequence number order per bike; duplicates and reordered frames are dropped.
+  * Times are in milliseconds and may wrap around.
+  */
+class MicroBitIndoorBikeRadioTable
+{
+
+public:
+    /**
+      * Constructor.
+      */
+    MicroBitIndoorBikeRadioTable();
+
+    /**
+      * Store a decoded frame.
+      * @param rssi The signal strength of the frame (dBm).
+      * @param now The current time (ms).
+      * @return MICROBIT_INDOOR_BIKE_RADIO_ACCEPTED, _DUPLICATE, _STALE or _TABLE_FULL.
+      */
+    int accept(const MicroBitIndoorBikeRadioSnapshot &snapshot, int rssi, uint32_t now);
+
+    /**
+      * Free the entries of bikes not heard for MICROBIT_INDOOR_BIKE_RADIO_HUB_EXPIRE_MS.
+      * @return The number of entries freed.
+      */
+    int expire(uint32_t now);
+
+    /**
+      * Entry at index (0 .. MICROBIT_INDOOR_BIKE_RADIO_HUB_SIZE-1), or NULL when unused.
+      */
+    const MicroBitIndoorBikeRadioEntry *get(int index);
+
+    /**
+      * Number of bikes in the table.
+      */
+    int count(void);
+
+    // frames by accept() result, since construction
+    uint32_t accepted;
+    uint32_t duplicates;
+    uint32_t stale;
+    uint32_t full;
+
+private:
+    // index of the bike, or -1
+    int find(uint32_t bikeId);
+
+private:
+    MicroBitIndoorBikeRadioEntry entries[MICROBIT_INDOOR_BIKE_RADIO_HUB_SIZE];
+
+};
+
+#endif /* #ifndef MICROBIT_INDOOR_BIKE_RADIO_TABLE_H */
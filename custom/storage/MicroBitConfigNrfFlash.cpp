@@ -0,0 +1,57 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "MicroBitConfigNrfFlash.h"
+
+MicroBitConfigNrfFlash::MicroBitConfigNrfFlash(int _pageOffset)
+    : pageOffset(_pageOffset)
+{
+}
+
+uint32_t *MicroBitConfigNrfFlash::page(int index)
+{
+    return (uint32_t *)(uintptr_t)(MICROBIT_CONFIG_STORE_PAGE_SIZE * (NRF_FICR->CODESIZE - this->pageOffset - index));
+}
+
+int MicroBitConfigNrfFlash::write(uint32_t *address, const uint32_t *data, int words)
+{
+    if (this->flash.flash_write(address, (void *)data, words * 4) != MICROBIT_OK)
+    {
+        return MICROBIT_CONFIG_STORE_FLASH_ERROR;
+    }
+    return MICROBIT_CONFIG_STORE_OK;
+}
+
+int MicroBitConfigNrfFlash::erase(uint32_t *page)
+{
+    this->flash.erase_page(page);
+    for (int i=0; i<MICROBIT_CONFIG_STORE_PAGE_WORDS; i++)
+    {
+        if (page[i] != 0xFFFFFFFF)
+        {
+            return MICROBIT_CONFIG_STORE_FLASH_ERROR;
+        }
+    }
+    return MICROBIT_CONFIG_STORE_OK;
+}
@@ -0,0 +1,57 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MICROBIT_CONFIG_NRF_FLASH_H
+#define MICROBIT_CONFIG_NRF_FLASH_H
+
+#include "MicroBit.h"
+#include "MicroBitCustom.h"
+#include "MicroBitConfigStore.h"
+
+/**
+  * Pages of the nRF51 flash, counted down from a page below the top:
+  * the two pages of MicroBitConfigStore (MICROBIT_CONFIG_STORE_PAGE_OFFSET), or the ring of MicroBitRideLog.
+  * MicroBitFlash goes through the SoftDevice while BLE is running.
+  */
+class MicroBitConfigNrfFlash : public MicroBitConfigFlash
+{
+
+public:
+    /**
+      * Constructor.
+      * @param _pageOffset Page 0 is this many pages below the top of the flash.
+      */
+    MicroBitConfigNrfFlash(int _pageOffset = MICROBIT_CONFIG_STORE_PAGE_OFFSET);
+
+    virtual uint32_t *page(int index);
+    virtual int write(uint32_t *address, const uint32_t *data, int words);
+    virtual int erase(uint32_t *page);
+
+private:
+    MicroBitFlash flash;
+    int pageOffset;
+
+};
+
+#endif /* #ifndef MICROBIT_CONFIG_NRF_FLASH_H */
@@ -0,0 +1,257 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "MicroBitConfigStore.h"
+#include <string.h>
+
+#define RECORD_KEY(h)       ((uint16_t)((h) & 0xFFFF))
+#define RECORD_LEN(h)       ((uint8_t)(((h) >> 16) & 0xFF))
+#define RECORD_CRC(h)       ((uint8_t)((h) >> 24))
+#define RECORD_WORDS(len)   (2 + ((len) + 3) / 4)
+
+MicroBitConfigStore::MicroBitConfigStore(MicroBitConfigFlash &_flash)
+    : flash(_flash)
+{
+    this->active = 0;
+    this->sequence = 0;
+    this->writeOffset = MICROBIT_CONFIG_STORE_PAGE_WORDS;
+    this->eraseCount = 0;
+    memset(this->index, 0, sizeof(this->index));
+}
+
+uint8_t MicroBitConfigStore::crc8(uint32_t header, const uint8_t *value, uint8_t len)
+{
+    // CRC-8 (polynomial 0x07) of key (2 bytes), length and value
+    uint8_t head[3] = { (uint8_t)header, (uint8_t)(header >> 8), (uint8_t)(header >> 16) };
+    uint8_t crc = 0;
+    for (int i=0; i<3+len; i++)
+    {
+        crc ^= (i < 3) ? head[i] : value[i-3];
+        for (int b=0; b<8; b++)
+        {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+int MicroBitConfigStore::begin(void)
+{
+    uint32_t *p0 = this->flash.page(0);
+    uint32_t *p1 = this->flash.page(1);
+    bool valid0 = p0[0] == MICROBIT_CONFIG_STORE_MAGIC;
+    bool valid1 = p1[0] == MICROBIT_CONFIG_STORE_MAGIC;
+
+    if (!valid0 && !valid1)
+    {
+        // First boot: an empty page 0
+        if (this->flash.erase(p0) != MICROBIT_CONFIG_STORE_OK)
+        {
+            return MICROBIT_CONFIG_STORE_FLASH_ERROR;
+        }
+        this->eraseCount++;
+        uint32_t header[MICROBIT_CONFIG_STORE_PAGE_HEADER_WORDS] = { MICROBIT_CONFIG_STORE_MAGIC, 1 };
+        if (this->flash.write(&p0[1], &header[1], 1) != MICROBIT_CONFIG_STORE_OK
+            || this->flash.write(&p0[0], &header[0], 1) != MICROBIT_CONFIG_STORE_OK)
+        {
+            return MICROBIT_CONFIG_STORE_FLASH_ERROR;
+        }
+        valid0 = true;
+    }
+
+    if (valid0 && valid1)
+    {
+        // Both pages survive a compaction until the old one is erased by the next one.
+        this->active = ((int32_t)(p1[1] - p0[1]) > 0) ? 1 : 0;
+    }
+    else
+    {
+        this->active = valid0 ? 0 : 1;
+    }
+    this->sequence = this->flash.page(this->active)[1];
+    this->scan();
+    return MICROBIT_CONFIG_STORE_OK;
+}
+
+void MicroBitConfigStore::scan(void)
+{
+    const uint32_t *page = this->flash.page(this->active);
+    memset(this->index, 0, sizeof(this->index));
+
+    uint16_t offset = MICROBIT_CONFIG_STORE_PAGE_HEADER_WORDS;
+    while (offset < MICROBIT_CONFIG_STORE_PAGE_WORDS && page[offset] != 0xFFFFFFFF)
+    {
+        uint32_t header = page[offset];
+        uint8_t len = RECORD_LEN(header);
+        if (len == 0 || len > MICROBIT_CONFIG_STORE_VALUE_MAX || offset + RECORD_WORDS(len) > MICROBIT_CONFIG_STORE_PAGE_WORDS)
+        {
+            // Unreadable: keep what was found, the next set() moves it to a clean page.
+            this->writeOffset = MICROBIT_CONFIG_STORE_PAGE_WORDS;
+            return;
+        }
+        uint16_t key = RECORD_KEY(header);
+        if (key < MICROBIT_CONFIG_STORE_KEY_MAX && page[offset+1] == ~header
+            && RECORD_CRC(header) == crc8(header, (const uint8_t *)&page[offset+2], len))
+        {
+            this->index[key] = offset;
+        }
+        offset += RECORD_WORDS(len);
+    }
+    this->writeOffset = offset;
+
+    // A value written without its header (power loss) leaves programmed words behind the last record.
+    for (uint16_t i=offset; i<MICROBIT_CONFIG_STORE_PAGE_WORDS; i++)
+    {
+        if (page[i] != 0xFFFFFFFF)
+        {
+            this->writeOffset = MICROBIT_CONFIG_STORE_PAGE_WORDS;
+            return;
+        }
+    }
+}
+
+bool MicroBitConfigStore::get(uint16_t key, void *value, uint8_t len)
+{
+    if (key >= MICROBIT_CONFIG_STORE_KEY_MAX || this->index[key] == 0)
+    {
+        return false;
+    }
+    const uint32_t *record = &this->flash.page(this->active)[this->index[key]];
+    if (RECORD_LEN(record[0]) != len)
+    {
+        return false;
+    }
+    memcpy(value, &record[2], len);
+    return true;
+}
+
+int MicroBitConfigStore::set(uint16_t key, const void *value, uint8_t len)
+{
+    if (key >= MICROBIT_CONFIG_STORE_KEY_MAX || len == 0 || len > MICROBIT_CONFIG_STORE_VALUE_MAX)
+    {
+        return MICROBIT_CONFIG_STORE_INVALID_PARAMETER;
+    }
+
+    // Unchanged values cost no flash wear.
+    if (this->index[key] != 0)
+    {
+        const uint32_t *record = &this->flash.page(this->active)[this->index[key]];
+        if (RECORD_LEN(record[0]) == len && memcmp(&record[2], value, len) == 0)
+        {
+            return MICROBIT_CONFIG_STORE_OK;
+        }
+    }
+
+    int words = RECORD_WORDS(len);
+    if (this->writeOffset + words > MICROBIT_CONFIG_STORE_PAGE_WORDS)
+    {
+        int result = this->compact();
+        if (result != MICROBIT_CONFIG_STORE_OK)
+        {
+            return result;
+        }
+        if (this->writeOffset + words > MICROBIT_CONFIG_STORE_PAGE_WORDS)
+        {
+            return MICROBIT_CONFIG_STORE_NO_RESOURCES;
+        }
+    }
+
+    uint32_t record[RECORD_WORDS(MICROBIT_CONFIG_STORE_VALUE_MAX)];
+    memset(record, 0xFF, sizeof(record));
+    memcpy(&record[2], value, len);
+    record[0] = (uint32_t)key | ((uint32_t)len << 16);
+    record[0] |= (uint32_t)crc8(record[0], (const uint8_t *)&record[2], len) << 24;
+    record[1] = ~record[0];
+
+    // Value, header, then the commit mark.
+    uint32_t *page = this->flash.page(this->active);
+    uint16_t offset = this->writeOffset;
+    this->writeOffset += words;
+    if (this->flash.write(&page[offset+2], &record[2], words-2) != MICROBIT_CONFIG_STORE_OK
+        || this->flash.write(&page[offset], &record[0], 1) != MICROBIT_CONFIG_STORE_OK
+        || this->flash.write(&page[offset+1], &record[1], 1) != MICROBIT_CONFIG_STORE_OK)
+    {
+        return MICROBIT_CONFIG_STORE_FLASH_ERROR;
+    }
+    this->index[key] = offset;
+    return MICROBIT_CONFIG_STORE_OK;
+}
+
+int MicroBitConfigStore::compact(void)
+{
+    int next = 1 - this->active;
+    const uint32_t *from = this->flash.page(this->active);
+    uint32_t *to = this->flash.page(next);
+
+    // Clear the old magic first: an interrupted erase must not leave a page that looks valid.
+    uint32_t zero = 0;
+    if (this->flash.write(&to[0], &zero, 1) != MICROBIT_CONFIG_STORE_OK
+        || this->flash.erase(to) != MICROBIT_CONFIG_STORE_OK)
+    {
+        return MICROBIT_CONFIG_STORE_FLASH_ERROR;
+    }
+    this->eraseCount++;
+
+    uint16_t offset = MICROBIT_CONFIG_STORE_PAGE_HEADER_WORDS;
+    uint16_t moved[MICROBIT_CONFIG_STORE_KEY_MAX];
+    for (int key=0; key<MICROBIT_CONFIG_STORE_KEY_MAX; key++)
+    {
+        moved[key] = 0;
+        if (this->index[key] != 0)
+        {
+            const uint32_t *record = &from[this->index[key]];
+            int words = RECORD_WORDS(RECORD_LEN(record[0]));
+            if (this->flash.write(&to[offset], record, words) != MICROBIT_CONFIG_STORE_OK)
+            {
+                return MICROBIT_CONFIG_STORE_FLASH_ERROR;
+            }
+            moved[key] = offset;
+            offset += words;
+        }
+    }
+
+    // The magic word last: until then begin() keeps using the old page.
+    uint32_t header[MICROBIT_CONFIG_STORE_PAGE_HEADER_WORDS] = { MICROBIT_CONFIG_STORE_MAGIC, this->sequence + 1 };
+    if (this->flash.write(&to[1], &header[1], 1) != MICROBIT_CONFIG_STORE_OK
+        || this->flash.write(&to[0], &header[0], 1) != MICROBIT_CONFIG_STORE_OK)
+    {
+        return MICROBIT_CONFIG_STORE_FLASH_ERROR;
+    }
+
+    this->active = next;
+    this->sequence++;
+    this->writeOffset = offset;
+    memcpy(this->index, moved, sizeof(this->index));
+    return MICROBIT_CONFIG_STORE_OK;
+}
+
+int MicroBitConfigStore::available(void)
+{
+    return MICROBIT_CONFIG_STORE_PAGE_WORDS - this->writeOffset;
+}
+
+uint32_t MicroBitConfigStore::getEraseCount(void)
+{
+    return this->eraseCount;
+}
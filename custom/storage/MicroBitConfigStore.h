@@ -0,0 +1,156 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MICROBIT_CONFIG_STORE_H
+#define MICROBIT_CONFIG_STORE_H
+
+#include <stdint.h>
+#include "MicroBitCustom.h"
+
+/**
+  * Flash pages used by MicroBitConfigStore and MicroBitRideLog.
+  * Erased flash reads 0xFF, and a write can only clear bits.
+  */
+class MicroBitConfigFlash
+{
+public:
+    virtual ~MicroBitConfigFlash() {}
+
+    /**
+      * Memory-mapped address of a page (MICROBIT_CONFIG_STORE_PAGE_SIZE bytes each).
+      */
+    virtual uint32_t *page(int index) = 0;
+
+    /**
+      * Write words to an erased area.
+      * @return MICROBIT_CONFIG_STORE_OK on success.
+      */
+    virtual int write(uint32_t *address, const uint32_t *data, int words) = 0;
+
+    /**
+      * Erase a page.
+      * @return MICROBIT_CONFIG_STORE_OK on success.
+      */
+    virtual int erase(uint32_t *page) = 0;
+};
+
+/**
+  * Result codes
+  */
+#define MICROBIT_CONFIG_STORE_OK                0
+#define MICROBIT_CONFIG_STORE_INVALID_PARAMETER -1
+#define MICROBIT_CONFIG_STORE_NO_RESOURCES      -2
+#define MICROBIT_CONFIG_STORE_FLASH_ERROR       -3
+
+/**
+  * Page layout (32-bit words)
+  */
+// word 0  magic (MICROBIT_CONFIG_STORE_MAGIC), written last: a page without it is ignored
+// word 1  sequence number, the valid page with the highest one is the active page
+// word 2- records, appended until the first erased word
+//
+// Record
+// word 0  key (bits 0-15), value length (bits 16-23), CRC-8 of key, length and value (bits 24-31)
+// word 1  complement of word 0, the commit mark
+// word 2- value, padded with 0xFF to a word boundary
+// The value is written first and the commit mark last, so a record cut by a power loss is never
+// taken for a complete one, and its programmed words are found before anything is written over them.
+#define MICROBIT_CONFIG_STORE_MAGIC             0x31474643  // "CFG1"
+#define MICROBIT_CONFIG_STORE_PAGE_HEADER_WORDS 2
+#define MICROBIT_CONFIG_STORE_PAGE_WORDS        (MICROBIT_CONFIG_STORE_PAGE_SIZE/4)
+
+/**
+  * Log-structured key-value store on two flash pages.
+  * Every set() appends a record; when the active page is full, the latest record of each key is copied
+  * to the other page, so the erases alternate between the pages.
+  * An index in RAM keeps the position of the latest record of each key: get() is O(1), and begin()
+  * rebuilds it with one pass over the active page.
+  * No dependency on the micro:bit runtime, so the same code runs in the host simulation (tools/config_store_sim).
+  */
+class MicroBitConfigStore
+{
+
+public:
+    /**
+      * Constructor.
+      * @param _flash The two pages of the store.
+      */
+    MicroBitConfigStore(MicroBitConfigFlash &_flash);
+
+    /**
+      * Find the active page and rebuild the index. Formats the store when no page is valid.
+      * @return MICROBIT_CONFIG_STORE_OK, or MICROBIT_CONFIG_STORE_FLASH_ERROR.
+      */
+    int begin(void);
+
+    /**
+      * Read a value.
+      * @param key The key (0 .. MICROBIT_CONFIG_STORE_KEY_MAX-1).
+      * @param len The length of the value; a stored value of another length is not returned.
+      * @return true if the value was found.
+      */
+    bool get(uint16_t key, void *value, uint8_t len);
+
+    /**
+      * Write a value. Nothing is written when the stored value is the same.
+      * @param len The length of the value (1 .. MICROBIT_CONFIG_STORE_VALUE_MAX).
+      * @return MICROBIT_CONFIG_STORE_OK, _INVALID_PARAMETER, _NO_RESOURCES or _FLASH_ERROR.
+      */
+    int set(uint16_t key, const void *value, uint8_t len);
+
+    /**
+      * Free words in the active page.
+      */
+    int available(void);
+
+    /**
+      * Number of page erases since begin().
+      */
+    uint32_t getEraseCount(void);
+
+private:
+    // Copy the latest records to the other page and make it active
+    int compact(void);
+    // Scan the active page into the index
+    void scan(void);
+
+    static uint8_t crc8(uint32_t header, const uint8_t *value, uint8_t len);
+
+private:
+    // instance
+    MicroBitConfigFlash &flash;
+
+    // active page (0 or 1), its sequence number, and the next free word
+    int active;
+    uint32_t sequence;
+    uint16_t writeOffset;
+
+    // word offset of the latest record of each key in the active page, 0: none
+    uint16_t index[MICROBIT_CONFIG_STORE_KEY_MAX];
+
+    uint32_t eraseCount;
+
+};
+
+#endif /* #ifndef MICROBIT_CONFIG_STORE_H */
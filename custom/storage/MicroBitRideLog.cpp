@@ -0,0 +1,373 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "MicroBitRideLog.h"
+#include <string.h>
+
+#define QUEUE_INDEX(i)      ((i) % MICROBIT_RIDE_LOG_QUEUE_SIZE)
+
+static uint32_t zigzag(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value)
+{
+    return (int32_t)((value >> 1) ^ (0u - (value & 1)));
+}
+
+MicroBitRideLog::MicroBitRideLog(MicroBitConfigFlash &_flash, int _pages)
+    : flash(_flash), pages(_pages)
+{
+    this->head = 0;
+    this->tail = 0;
+    this->pulses = 1;
+    this->queuedPulses = 1;
+    this->pulsesHead = 0;
+    this->blockPulses = 1;
+    this->current = 0;
+    this->erased = false;
+    this->opened = false;
+    this->writeOffset = 0;
+    this->sequence = 1;
+    this->session = 1;
+    this->lastTicks = 0;
+    this->lastInterval = 0;
+    this->pendingLen = 0;
+    this->dropped = 0;
+    this->eraseCount = 0;
+}
+
+void MicroBitRideLog::begin(void)
+{
+    bool found = false;
+    uint32_t newest = 0;
+    uint16_t lastSession = 0;
+    int newestPage = this->pages - 1;
+
+    for (int i=0; i<this->pages; i++)
+    {
+        uint32_t *page = this->flash.page(i);
+        if (page[0] == MICROBIT_RIDE_LOG_MAGIC && (!found || page[1] > newest))
+        {
+            found = true;
+            newest = page[1];
+            lastSession = (uint16_t)page[2];
+            newestPage = i;
+        }
+    }
+
+    // The new session overwrites the oldest block.
+    this->current = (newestPage + 1) % this->pages;
+    this->sequence = newest + 1;
+    this->session = lastSession + 1;
+    this->opened = false;
+    this->pendingLen = 0;
+    this->head = this->tail;
+    this->pulsesHead = this->head;
+    this->queuedPulses = this->pulses;
+
+    uint32_t *page = this->flash.page(this->current);
+    this->erased = true;
+    for (int i=0; i<MICROBIT_CONFIG_STORE_PAGE_WORDS; i++)
+    {
+        if (page[i] != 0xFFFFFFFF)
+        {
+            this->erased = false;
+            break;
+        }
+    }
+}
+
+void MicroBitRideLog::setPulses(uint8_t pulses)
+{
+    if (pulses == 0 || pulses == this->pulses)
+    {
+        return;
+    }
+    // The edges still queued keep the pulse count they were measured with
+    // (after two changes within the queue, the oldest one).
+    if (this->pulsesHead == this->tail)
+    {
+        this->queuedPulses = this->pulses;
+    }
+    this->pulses = pulses;
+    this->pulsesHead = this->head;
+}
+
+bool MicroBitRideLog::edge(uint64_t timestamp)
+{
+    if ((uint16_t)(this->head - this->tail) >= MICROBIT_RIDE_LOG_QUEUE_SIZE)
+    {
+        this->dropped++;
+        return false;
+    }
+    // 1/1024 s (us * 128 / 125000)
+    this->queue[QUEUE_INDEX(this->head)] = (uint32_t)((timestamp * 128) / 125000);
+    this->head++;
+    return true;
+}
+
+int MicroBitRideLog::service(void)
+{
+    if (this->head == this->tail)
+    {
+        return MICROBIT_RIDE_LOG_IDLE;
+    }
+    if (this->tail == this->pulsesHead)
+    {
+        // Every edge of the previous pulse count is encoded; the next ones open a block of their own.
+        this->queuedPulses = this->pulses;
+        if (this->opened && this->blockPulses != this->pulses)
+        {
+            int result = this->program(true);
+            this->close();
+            return (result < 0) ? result : MICROBIT_RIDE_LOG_BUSY;
+        }
+    }
+    if (!this->opened)
+    {
+        return this->open();
+    }
+
+    uint32_t ticks = this->queue[QUEUE_INDEX(this->tail)];
+    uint32_t interval = ticks - this->lastTicks;
+    uint8_t bytes[MICROBIT_RIDE_LOG_VARINT_MAX];
+    int n = putVarint(zigzag((int32_t)(interval - this->lastInterval)), bytes);
+
+    if (this->writeOffset + this->pendingLen + n > MICROBIT_CONFIG_STORE_PAGE_SIZE)
+    {
+        // The edge opens the next block.
+        int result = this->program(true);
+        this->close();
+        return (result < 0) ? result : MICROBIT_RIDE_LOG_BUSY;
+    }
+
+    memcpy(&this->pending[this->pendingLen], bytes, n);
+    this->pendingLen += n;
+    this->tail++;
+    this->lastTicks = ticks;
+    this->lastInterval = interval;
+    return this->program(false);
+}
+
+int MicroBitRideLog::flush(void)
+{
+    int result;
+    while ((result = this->service()) == MICROBIT_RIDE_LOG_BUSY)
+    {
+    }
+    if (result < 0)
+    {
+        return result;
+    }
+    if (this->opened && this->pendingLen > 0)
+    {
+        result = this->program(true);
+        this->close();
+    }
+    return (result < 0) ? result : MICROBIT_RIDE_LOG_IDLE;
+}
+
+int MicroBitRideLog::open(void)
+{
+    uint32_t *page = this->flash.page(this->current);
+
+    if (!this->erased)
+    {
+        this->eraseCount++;
+        if (this->flash.erase(page) != MICROBIT_CONFIG_STORE_OK)
+        {
+            this->close();
+            return MICROBIT_RIDE_LOG_FLASH_ERROR;
+        }
+        this->erased = true;
+        return MICROBIT_RIDE_LOG_BUSY;
+    }
+
+    uint32_t first = this->queue[QUEUE_INDEX(this->tail)];
+    this->blockPulses = this->queuedPulses;
+    uint32_t header[MICROBIT_RIDE_LOG_HEADER_SIZE/4] = {
+        MICROBIT_RIDE_LOG_MAGIC,
+        this->sequence,
+        (uint32_t)this->session | ((uint32_t)MICROBIT_RIDE_LOG_VERSION << 16) | ((uint32_t)this->blockPulses << 24),
+        first
+    };
+    if (this->flash.write(&page[1], &header[1], 3) != MICROBIT_CONFIG_STORE_OK
+        || this->flash.write(&page[0], &header[0], 1) != MICROBIT_CONFIG_STORE_OK)
+    {
+        this->close();
+        return MICROBIT_RIDE_LOG_FLASH_ERROR;
+    }
+
+    this->tail++;
+    this->opened = true;
+    this->writeOffset = MICROBIT_RIDE_LOG_HEADER_SIZE;
+    this->lastTicks = first;
+    this->lastInterval = 0;
+    this->pendingLen = 0;
+    return MICROBIT_RIDE_LOG_BUSY;
+}
+
+int MicroBitRideLog::program(bool pad)
+{
+    int words = pad ? (this->pendingLen + 3) / 4 : this->pendingLen / 4;
+    if (words == 0)
+    {
+        return MICROBIT_RIDE_LOG_BUSY;
+    }
+
+    uint32_t data[(sizeof(this->pending) + 3) / 4];
+    int bytes = (this->pendingLen < words * 4) ? this->pendingLen : words * 4;
+    memset(data, 0xFF, sizeof(data));
+    memcpy(data, this->pending, bytes);
+    memmove(this->pending, &this->pending[bytes], this->pendingLen - bytes);
+    this->pendingLen -= bytes;
+
+    uint32_t *page = this->flash.page(this->current);
+    int result = this->flash.write(&page[this->writeOffset / 4], data, words);
+    this->writeOffset += words * 4;
+    if (result != MICROBIT_CONFIG_STORE_OK)
+    {
+        this->close();
+        return MICROBIT_RIDE_LOG_FLASH_ERROR;
+    }
+    return MICROBIT_RIDE_LOG_BUSY;
+}
+
+void MicroBitRideLog::close(void)
+{
+    this->opened = false;
+    this->erased = false;
+    this->pendingLen = 0;
+    this->current = (this->current + 1) % this->pages;
+    this->sequence++;
+}
+
+const uint8_t *MicroBitRideLog::getBlock(uint32_t after, uint32_t *sequence)
+{
+    const uint8_t *block = NULL;
+
+    for (int i=0; i<this->pages; i++)
+    {
+        uint32_t *page = this->flash.page(i);
+        if (page[0] == MICROBIT_RIDE_LOG_MAGIC && page[1] > after && (block == NULL || page[1] < *sequence))
+        {
+            block = (const uint8_t *)page;
+            *sequence = page[1];
+        }
+    }
+    return block;
+}
+
+int MicroBitRideLog::getBlockLength(const uint8_t *block)
+{
+    int len = MICROBIT_CONFIG_STORE_PAGE_SIZE;
+    while (len > MICROBIT_RIDE_LOG_HEADER_SIZE && block[len - 1] == 0xFF)
+    {
+        len--;
+    }
+    return len;
+}
+
+int MicroBitRideLog::decode(const uint8_t *block, int len, uint32_t *sequence, uint16_t *session, uint8_t *pulses, uint32_t *ticks)
+{
+    uint32_t header[MICROBIT_RIDE_LOG_HEADER_SIZE/4];
+
+    if (len < MICROBIT_RIDE_LOG_HEADER_SIZE)
+    {
+        return -1;
+    }
+    memcpy(header, block, sizeof(header));
+    uint8_t version = (uint8_t)(header[2] >> 16);
+    // version 1 logged one edge per crank revolution
+    *pulses = (version == 1) ? 1 : (uint8_t)(header[2] >> 24);
+    if (header[0] != MICROBIT_RIDE_LOG_MAGIC || version < 1 || version > MICROBIT_RIDE_LOG_VERSION || *pulses == 0)
+    {
+        return -1;
+    }
+    *sequence = header[1];
+    *session = (uint16_t)header[2];
+
+    uint32_t t = header[3];
+    uint32_t interval = 0;
+    int n = 0;
+    ticks[n++] = t;
+    for (int offset=MICROBIT_RIDE_LOG_HEADER_SIZE; offset<len && n<MICROBIT_RIDE_LOG_BLOCK_EDGES_MAX; )
+    {
+        uint32_t value;
+        int used = getVarint(&block[offset], len - offset, &value);
+        if (used == 0)
+        {
+            break;
+        }
+        offset += used;
+        interval += (uint32_t)unzigzag(value);
+        t += interval;
+        ticks[n++] = t;
+    }
+    return n;
+}
+
+int MicroBitRideLog::putVarint(uint32_t value, uint8_t *out)
+{
+    int n = 0;
+    while (value >= 0x80)
+    {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+int MicroBitRideLog::getVarint(const uint8_t *in, int len, uint32_t *value)
+{
+    uint32_t v = 0;
+    for (int i=0; i<len && i<MICROBIT_RIDE_LOG_VARINT_MAX; i++)
+    {
+        v |= (uint32_t)(in[i] & 0x7F) << (7 * i);
+        if (!(in[i] & 0x80))
+        {
+            *value = v;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+uint16_t MicroBitRideLog::getSession(void)
+{
+    return this->session;
+}
+
+uint32_t MicroBitRideLog::getDropped(void)
+{
+    return this->dropped;
+}
+
+uint32_t MicroBitRideLog::getEraseCount(void)
+{
+    return this->eraseCount;
+}
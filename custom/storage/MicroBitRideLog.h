@@ -0,0 +1,189 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MICROBIT_RIDE_LOG_H
+#define MICROBIT_RIDE_LOG_H
+
+#include <stdint.h>
+#include "MicroBitCustom.h"
+#include "MicroBitConfigStore.h"
+
+/**
+  * Result codes
+  */
+#define MICROBIT_RIDE_LOG_IDLE                  0
+#define MICROBIT_RIDE_LOG_BUSY                  1
+#define MICROBIT_RIDE_LOG_FLASH_ERROR           -3
+
+/**
+  * Block layout, one block per flash page (32-bit words)
+  */
+// word 0  magic (MICROBIT_RIDE_LOG_MAGIC), written last: a page without it is ignored
+// word 1  block sequence number, the pages are a ring in sequence order
+// word 2  session (bits 0-15, one per boot), format version (bits 16-23),
+//         STEP pulses per crank revolution of the edges of the block (bits 24-31, version 2)
+// word 3  time of the first edge of the block (1/1024 s since boot)
+// byte 16- one varint per following edge: zigzag of (interval - previous interval) in 1/1024 s,
+//          the previous interval of the second edge is 0. A steady cadence takes one byte per edge.
+//          The stream ends at the first incomplete varint (erased 0xFF bytes).
+#define MICROBIT_RIDE_LOG_MAGIC                 0x31474C52  // "RLG1"
+#define MICROBIT_RIDE_LOG_VERSION               2
+#define MICROBIT_RIDE_LOG_HEADER_SIZE           16
+#define MICROBIT_RIDE_LOG_VARINT_MAX            5
+#define MICROBIT_RIDE_LOG_BLOCK_EDGES_MAX       (1+MICROBIT_CONFIG_STORE_PAGE_SIZE-MICROBIT_RIDE_LOG_HEADER_SIZE)
+
+/**
+  * Log of every STEP edge in a ring of flash pages.
+  * edge() only queues the time in RAM, so the edge handler never waits for the flash;
+  * service() encodes the queued edges and programs the flash one operation at a time, from the idle thread.
+  * The bytes of an unfinished word stay in RAM until the word is full or flush() is called:
+  * a power loss costs the last few edges.
+  * No dependency on the micro:bit runtime, so the decoder on the host (tools/telemetry_decode) shares it.
+  */
+class MicroBitRideLog
+{
+
+public:
+    /**
+      * Constructor.
+      * @param _flash The pages of the log.
+      * @param _pages The number of pages (2 .. 255).
+      */
+    MicroBitRideLog(MicroBitConfigFlash &_flash, int _pages);
+
+    /**
+      * Find the newest block and start a new session in the page after it.
+      */
+    void begin(void);
+
+    /**
+      * STEP pulses per crank revolution of the edges queued from now on (1 .. 255).
+      * A block holds edges of one pulse count: a change starts a new block.
+      */
+    void setPulses(uint8_t pulses);
+
+    /**
+      * Queue a STEP edge.
+      * @param timestamp The time of the edge (us since boot).
+      * @return false if the queue was full and the edge is lost.
+      */
+    bool edge(uint64_t timestamp);
+
+    /**
+      * Encode the queued edges, with at most one page erase.
+      * @return MICROBIT_RIDE_LOG_IDLE when nothing is left to do, MICROBIT_RIDE_LOG_BUSY or MICROBIT_RIDE_LOG_FLASH_ERROR.
+      */
+    int service(void);
+
+    /**
+      * Write the queued edges and close the current block, so that a reader sees every edge.
+      * The next edge opens a block in the next page.
+      */
+    int flush(void);
+
+    /**
+      * The oldest block with a sequence number above the given one.
+      * @param after 0 for the oldest block.
+      * @param sequence Set to the sequence number of the block.
+      * @return The block (MICROBIT_CONFIG_STORE_PAGE_SIZE bytes), or NULL.
+      */
+    const uint8_t *getBlock(uint32_t after, uint32_t *sequence);
+
+    /**
+      * Bytes of a block up to the last programmed byte.
+      */
+    static int getBlockLength(const uint8_t *block);
+
+    /**
+      * Decode a block.
+      * @param pulses Receives the STEP pulses per crank revolution of the edges (1 for version 1 blocks).
+      * @param ticks Receives the edge times (1/1024 s since boot), MICROBIT_RIDE_LOG_BLOCK_EDGES_MAX at most.
+      * @return The number of edges, or -1 when the block is not valid.
+      */
+    static int decode(const uint8_t *block, int len, uint32_t *sequence, uint16_t *session, uint8_t *pulses, uint32_t *ticks);
+
+    /**
+      * The session of this boot.
+      */
+    uint16_t getSession(void);
+
+    /**
+      * Number of edges lost because the queue was full.
+      */
+    uint32_t getDropped(void);
+
+    /**
+      * Number of page erases since begin().
+      */
+    uint32_t getEraseCount(void);
+
+    // unsigned LEB128
+    static int putVarint(uint32_t value, uint8_t *out);
+    // @return The bytes read, or 0 when the varint is incomplete.
+    static int getVarint(const uint8_t *in, int len, uint32_t *value);
+
+private:
+    // Open a block for the first queued edge
+    int open(void);
+    // Program the complete words of the pending bytes; with pad, the rest too (padded with 0xFF)
+    int program(bool pad);
+    // Close the current block, the next one goes into the next page
+    void close(void);
+
+private:
+    // instance
+    MicroBitConfigFlash &flash;
+    int pages;
+
+    // queued edges (1/1024 s), free-running indexes
+    uint32_t queue[MICROBIT_RIDE_LOG_QUEUE_SIZE];
+    uint16_t head;
+    uint16_t tail;
+
+    // pulses of the edges from pulsesHead on, of the edges before it (until they are encoded), and of the open block
+    uint8_t pulses;
+    uint8_t queuedPulses;
+    uint16_t pulsesHead;
+    uint8_t blockPulses;
+
+    // current page, whether it is erased and a block is open, and the next byte of the block
+    int current;
+    bool erased;
+    bool opened;
+    uint16_t writeOffset;
+    uint32_t sequence;
+    uint16_t session;
+
+    // encoder state, and the encoded bytes of the unfinished word
+    uint32_t lastTicks;
+    uint32_t lastInterval;
+    uint8_t pending[4+MICROBIT_RIDE_LOG_VARINT_MAX];
+    uint8_t pendingLen;
+
+    uint32_t dropped;
+    uint32_t eraseCount;
+
+};
+
+#endif /* #ifndef MICROBIT_RIDE_LOG_H */
@@ -0,0 +1,126 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "MicroBitRideLogCursor.h"
+#include "struct.h"
+#include <string.h>
+
+MicroBitRideLogCursor::MicroBitRideLogCursor(MicroBitRideLog &_log)
+    : log(_log)
+{
+    this->block = NULL;
+    this->sequence = 0;
+    this->length = 0;
+    this->offset = 0;
+    this->crc = 0xFFFF;
+    this->peeked = 0;
+    this->done = true;
+}
+
+void MicroBitRideLogCursor::start(uint32_t sequence, uint16_t offset)
+{
+    this->done = false;
+    this->load(sequence);
+    if (this->block != NULL && this->sequence == sequence)
+    {
+        // resume: the CRC covers the whole block
+        this->offset = (offset < this->length) ? offset : this->length;
+        this->crc = crc16(0xFFFF, this->block, this->offset);
+    }
+}
+
+void MicroBitRideLogCursor::load(uint32_t sequence)
+{
+    this->block = this->log.getBlock((sequence > 0) ? sequence - 1 : 0, &this->sequence);
+    this->length = (this->block != NULL) ? (uint16_t)MicroBitRideLog::getBlockLength(this->block) : 0;
+    this->offset = 0;
+    this->crc = 0xFFFF;
+}
+
+int MicroBitRideLogCursor::peek(uint8_t *packet)
+{
+    if (this->done)
+    {
+        return 0;
+    }
+    if (this->block == NULL)
+    {
+        return struct_pack(packet, MICROBIT_RIDE_LOG_CURSOR_FORMAT_END, 0, MICROBIT_RIDE_LOG_CURSOR_END_OFFSET, 0, 0);
+    }
+    if (this->offset >= this->length)
+    {
+        return struct_pack(packet, MICROBIT_RIDE_LOG_CURSOR_FORMAT_END
+            , this->sequence, MICROBIT_RIDE_LOG_CURSOR_END_OFFSET, this->length, this->crc);
+    }
+
+    int n = this->length - this->offset;
+    if (n > MICROBIT_RIDE_LOG_CURSOR_DATA_MAX)
+    {
+        n = MICROBIT_RIDE_LOG_CURSOR_DATA_MAX;
+    }
+    int header = struct_pack(packet, MICROBIT_RIDE_LOG_CURSOR_FORMAT_DATA, this->sequence, this->offset);
+    memcpy(&packet[header], &this->block[this->offset], n);
+    this->peeked = (uint8_t)n;
+    return header + n;
+}
+
+void MicroBitRideLogCursor::advance(void)
+{
+    if (this->done)
+    {
+        return;
+    }
+    if (this->block == NULL)
+    {
+        this->done = true;
+    }
+    else if (this->offset >= this->length)
+    {
+        this->load(this->sequence + 1);
+    }
+    else
+    {
+        this->crc = crc16(this->crc, &this->block[this->offset], this->peeked);
+        this->offset += this->peeked;
+    }
+    this->peeked = 0;
+}
+
+bool MicroBitRideLogCursor::finished(void)
+{
+    return this->done;
+}
+
+uint16_t MicroBitRideLogCursor::crc16(uint16_t crc, const uint8_t *data, int len)
+{
+    for (int i=0; i<len; i++)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b=0; b<8; b++)
+        {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
@@ -0,0 +1,110 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MICROBIT_RIDE_LOG_CURSOR_H
+#define MICROBIT_RIDE_LOG_CURSOR_H
+
+#include <stdint.h>
+#include "MicroBitCustom.h"
+#include "MicroBitRideLog.h"
+
+/**
+  * Export packets (little-endian, MICROBIT_RIDE_LOG_CURSOR_PACKET_MAX bytes at most)
+  */
+// "<IH"   block sequence number, byte offset, then up to MICROBIT_RIDE_LOG_CURSOR_DATA_MAX bytes of the block
+// "<IHHH" block sequence number, 0xFFFF, block length, CRC-16/CCITT-FALSE of the block: end of the block
+// "<IHHH" 0, 0xFFFF, 0, 0: end of the export
+// A reader that lost the link resumes with the sequence number and offset of the first byte it is missing.
+#define MICROBIT_RIDE_LOG_CURSOR_PACKET_MAX     20
+#define MICROBIT_RIDE_LOG_CURSOR_FORMAT_DATA    "<IH"
+#define MICROBIT_RIDE_LOG_CURSOR_FORMAT_END     "<IHHH"
+#define MICROBIT_RIDE_LOG_CURSOR_DATA_MAX       (MICROBIT_RIDE_LOG_CURSOR_PACKET_MAX-6)
+#define MICROBIT_RIDE_LOG_CURSOR_END_OFFSET     0xFFFF
+
+/**
+  * Walks the blocks of a MicroBitRideLog as export packets, oldest block first.
+  * peek() builds the packet at the current position and advance() moves past it once the transport took it,
+  * so a packet refused by a full transmit queue is built again later.
+  * The log must not be written while a cursor walks it (MicroBitRideLogRecorder::lock()).
+  * No dependency on the micro:bit runtime, so the host simulation (tools/ride_log_export_sim) shares it.
+  */
+class MicroBitRideLogCursor
+{
+
+public:
+    /**
+      * Constructor.
+      * @param _log The ride log to export.
+      */
+    MicroBitRideLogCursor(MicroBitRideLog &_log);
+
+    /**
+      * Start at the block with the given sequence number, or the next one that still exists.
+      * @param sequence 0 for the oldest block.
+      * @param offset The first byte to send, when the block still exists.
+      */
+    void start(uint32_t sequence, uint16_t offset);
+
+    /**
+      * Build the packet at the current position.
+      * @return The length of the packet, or 0 when the export is finished.
+      */
+    int peek(uint8_t *packet);
+
+    /**
+      * Move past the packet built by peek().
+      */
+    void advance(void);
+
+    /**
+      * true after the end of the export was sent.
+      */
+    bool finished(void);
+
+    /**
+      * CRC-16/CCITT-FALSE (polynomial 0x1021), start with 0xFFFF.
+      */
+    static uint16_t crc16(uint16_t crc, const uint8_t *data, int len);
+
+private:
+    // Load the oldest block with a sequence number of at least the given one
+    void load(uint32_t sequence);
+
+private:
+    // instance
+    MicroBitRideLog &log;
+
+    const uint8_t *block;
+    uint32_t sequence;
+    uint16_t length;
+    uint16_t offset;
+    // CRC of the bytes before offset
+    uint16_t crc;
+    // bytes of the data packet built by peek()
+    uint8_t peeked;
+    bool done;
+
+};
+
+#endif /* #ifndef MICROBIT_RIDE_LOG_CURSOR_H */
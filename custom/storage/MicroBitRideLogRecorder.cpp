@@ -0,0 +1,110 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "MicroBitRideLogRecorder.h"
+
+// Time for the telemetry to drain when its ring buffer is full (ms)
+#define EXPORT_WAIT_MS 5
+
+MicroBitRideLogRecorder::MicroBitRideLogRecorder(MicroBitRideLog &_log, uint16_t id)
+    : log(_log)
+{
+    this->id = id;
+}
+
+void MicroBitRideLogRecorder::idleTick()
+{
+    if(!(status & MICROBIT_RIDE_LOG_RECORDER_ADDED_TO_IDLE))
+    {
+        fiber_add_idle_component(this);
+        status |= MICROBIT_RIDE_LOG_RECORDER_ADDED_TO_IDLE;
+    }
+
+    // The edges stay queued during an export, which reads the pages.
+    if (!(status & MICROBIT_RIDE_LOG_RECORDER_LOCKED))
+    {
+        this->log.service();
+    }
+}
+
+int MicroBitRideLogRecorder::exportLog(MicroBitTelemetry &telemetry)
+{
+    if (!this->lock())
+    {
+        return 0;
+    }
+    this->log.flush();
+
+    int blocks = 0;
+    uint32_t after = 0;
+    uint32_t sequence;
+    const uint8_t *block;
+    while ((block = this->log.getBlock(after, &sequence)) != NULL)
+    {
+        int len = MicroBitRideLog::getBlockLength(block);
+        for (int offset=0; offset<len; offset+=MICROBIT_TELEMETRY_RIDE_LOG_DATA_MAX)
+        {
+            int n = len - offset;
+            if (n > MICROBIT_TELEMETRY_RIDE_LOG_DATA_MAX)
+            {
+                n = MICROBIT_TELEMETRY_RIDE_LOG_DATA_MAX;
+            }
+            while (!telemetry.rideLog(sequence, (uint16_t)offset, &block[offset], (uint8_t)n))
+            {
+                fiber_sleep(EXPORT_WAIT_MS);
+            }
+        }
+        after = sequence;
+        blocks++;
+    }
+    while (!telemetry.rideLog(0, 0, NULL, 0))
+    {
+        fiber_sleep(EXPORT_WAIT_MS);
+    }
+
+    this->unlock();
+    return blocks;
+}
+
+bool MicroBitRideLogRecorder::lock(void)
+{
+    // BLE callbacks unlock from interrupt context.
+    __disable_irq();
+    bool locked = !(status & MICROBIT_RIDE_LOG_RECORDER_LOCKED);
+    status |= MICROBIT_RIDE_LOG_RECORDER_LOCKED;
+    __enable_irq();
+    return locked;
+}
+
+void MicroBitRideLogRecorder::unlock(void)
+{
+    __disable_irq();
+    status &= ~MICROBIT_RIDE_LOG_RECORDER_LOCKED;
+    __enable_irq();
+}
+
+MicroBitRideLog &MicroBitRideLogRecorder::getLog(void)
+{
+    return this->log;
+}
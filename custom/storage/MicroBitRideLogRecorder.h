@@ -0,0 +1,91 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MICROBIT_RIDE_LOG_RECORDER_H
+#define MICROBIT_RIDE_LOG_RECORDER_H
+
+#include "MicroBit.h"
+#include "MicroBitCustom.h"
+#include "MicroBitCustomComponent.h"
+#include "MicroBitRideLog.h"
+#include "MicroBitTelemetry.h"
+
+/**
+  * Status flags
+  */
+// Universal flags used as part of the status field
+// #define MICROBIT_COMPONENT_RUNNING		0x01
+#define MICROBIT_RIDE_LOG_RECORDER_ADDED_TO_IDLE                    0x02
+#define MICROBIT_RIDE_LOG_RECORDER_LOCKED                           0x04
+
+/**
+  * Writes the queued edges of a MicroBitRideLog to the flash from the idle thread,
+  * and exports the blocks in the telemetry stream (tools/telemetry_decode prints the edges).
+  */
+class MicroBitRideLogRecorder : public MicroBitCustomComponent
+{
+
+public:
+    /**
+      * Constructor.
+      * @param _log The ride log, begin() already called.
+      */
+    MicroBitRideLogRecorder(MicroBitRideLog &_log, uint16_t id = MICROBIT_RIDE_LOG_ID);
+
+    /**
+      * Periodic callback from MicroBit idle thread.
+      * One flash operation at most, none while locked.
+      */
+    virtual void idleTick();
+
+    /**
+      * Send every block, oldest first, as ride log records of the telemetry.
+      * Blocks the calling fiber while the telemetry drains (about 2 seconds for 8 full pages).
+      * @return The number of blocks sent.
+      */
+    int exportLog(MicroBitTelemetry &telemetry);
+
+    /**
+      * Stop writing to the flash while a reader walks the pages; the edges stay queued.
+      * @return false if another reader holds the lock.
+      */
+    bool lock(void);
+
+    /**
+      * Resume writing to the flash.
+      */
+    void unlock(void);
+
+    /**
+      * The ride log.
+      */
+    MicroBitRideLog &getLog(void);
+
+private:
+    // instance
+    MicroBitRideLog &log;
+
+};
+
+#endif /* #ifndef MICROBIT_RIDE_LOG_RECORDER_H */
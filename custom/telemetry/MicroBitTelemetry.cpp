@@ -0,0 +1,183 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "MicroBitTelemetry.h"
+#include "struct.h"
+#include <string.h>
+
+MicroBitTelemetry::MicroBitTelemetry(MicroBit &_uBit, uint16_t id)
+    : uBit(_uBit)
+{
+    this->id = id;
+    this->dropped = 0;
+    this->droppedReported = 0;
+
+    uBit.serial.setTxBufferSize(MICROBIT_TELEMETRY_SERIAL_BUFFER_SIZE);
+}
+
+void MicroBitTelemetry::idleTick()
+{
+    if(!(status & MICROBIT_TELEMETRY_ADDED_TO_IDLE))
+    {
+        fiber_add_idle_component(this);
+        status |= MICROBIT_TELEMETRY_ADDED_TO_IDLE;
+    }
+
+    uint32_t dropped = this->dropped;
+    if (dropped != this->droppedReported)
+    {
+        uint8_t record[MICROBIT_TELEMETRY_RECORD_MAX];
+        int len = struct_pack(record, MICROBIT_TELEMETRY_FORMAT_DROPPED, MICROBIT_TELEMETRY_RECORD_DROPPED
+            , (uint32_t)MicroBitCustomClock::currentTimeUs(), dropped - this->droppedReported);
+        this->droppedReported = dropped;
+        this->log(record, len);
+    }
+
+    // ASYNC copies what fits into the serial TX buffer and returns at once.
+    const uint8_t *data;
+    int len = this->ring.peek(&data);
+    if (len > 0)
+    {
+        int sent = uBit.serial.send((uint8_t *)data, len, ASYNC);
+        if (sent > 0)
+        {
+            this->ring.consume(sent);
+        }
+    }
+}
+
+void MicroBitTelemetry::log(const uint8_t *record, int len)
+{
+    if (!this->write(record, len))
+    {
+        this->dropped++;
+    }
+}
+
+bool MicroBitTelemetry::write(const uint8_t *record, int len)
+{
+    uint8_t frame[MICROBIT_TELEMETRY_FRAME_MAX];
+    int frameLen = MicroBitTelemetryFrame::encode(record, len, frame);
+
+    // BLE callbacks write from interrupt context.
+    __disable_irq();
+    bool written = this->ring.write(frame, frameLen);
+    __enable_irq();
+    return written;
+}
+
+void MicroBitTelemetry::stepEdge(uint64_t timestamp, uint32_t crankRevolutions)
+{
+    uint8_t record[MICROBIT_TELEMETRY_RECORD_MAX];
+    int len = struct_pack(record, MICROBIT_TELEMETRY_FORMAT_STEP_EDGE, MICROBIT_TELEMETRY_RECORD_STEP_EDGE
+        , (uint32_t)timestamp, crankRevolutions);
+    this->log(record, len);
+}
+
+void MicroBitTelemetry::sample(uint32_t intervalTime, uint32_t speed100, uint32_t cadence2, int16_t power, uint8_t resistanceLevel10)
+{
+    uint8_t record[MICROBIT_TELEMETRY_RECORD_MAX];
+    int len = struct_pack(record, MICROBIT_TELEMETRY_FORMAT_SAMPLE, MICROBIT_TELEMETRY_RECORD_SAMPLE
+        , (uint32_t)MicroBitCustomClock::currentTimeUs(), intervalTime, speed100, cadence2, power, resistanceLevel10);
+    this->log(record, len);
+}
+
+void MicroBitTelemetry::analytics(int16_t average3, int16_t average10, int16_t average30, uint16_t normalizedPower, uint16_t intensityFactor1000, uint16_t trainingStressScore10, uint16_t ftp)
+{
+    uint8_t record[MICROBIT_TELEMETRY_RECORD_MAX];
+    int len = struct_pack(record, MICROBIT_TELEMETRY_FORMAT_ANALYTICS, MICROBIT_TELEMETRY_RECORD_ANALYTICS
+        , (uint32_t)MicroBitCustomClock::currentTimeUs(), average3, average10, average30, normalizedPower, intensityFactor1000, trainingStressScore10, ftp);
+    this->log(record, len);
+}
+
+void MicroBitTelemetry::peaks(uint16_t best5s, uint16_t best1min, uint16_t best5min, uint16_t best20min)
+{
+    uint8_t record[MICROBIT_TELEMETRY_RECORD_MAX];
+    int len = struct_pack(record, MICROBIT_TELEMETRY_FORMAT_PEAKS, MICROBIT_TELEMETRY_RECORD_PEAKS
+        , (uint32_t)MicroBitCustomClock::currentTimeUs(), best5s, best1min, best5min, best20min);
+    this->log(record, len);
+}
+
+void MicroBitTelemetry::prediction(uint32_t measuredIntervalTime, uint32_t intervalTime, uint8_t confidence)
+{
+    uint8_t record[MICROBIT_TELEMETRY_RECORD_MAX];
+    int len = struct_pack(record, MICROBIT_TELEMETRY_FORMAT_PREDICTION, MICROBIT_TELEMETRY_RECORD_PREDICTION
+        , (uint32_t)MicroBitCustomClock::currentTimeUs(), measuredIntervalTime, intervalTime, confidence);
+    this->log(record, len);
+}
+
+void MicroBitTelemetry::health(MicroBitStepHealth &stepHealth)
+{
+    uint8_t record[MICROBIT_TELEMETRY_RECORD_MAX];
+    int len = struct_pack(record, MICROBIT_TELEMETRY_FORMAT_HEALTH, MICROBIT_TELEMETRY_RECORD_HEALTH
+        , (uint32_t)MicroBitCustomClock::currentTimeUs(), stepHealth.getEdges(), stepHealth.getBounces(), stepHealth.getMissed()
+        , stepHealth.getStops(), stepHealth.getTypicalInterval());
+    for (int i = 0; i < MICROBIT_TELEMETRY_HEALTH_BUCKETS; i++)
+    {
+        len += struct_pack(&record[len], "<H", stepHealth.getHistogram(i));
+    }
+    this->log(record, len);
+}
+
+void MicroBitTelemetry::pipeline(uint16_t id, int32_t value)
+{
+    uint8_t record[MICROBIT_TELEMETRY_RECORD_MAX];
+    int len = struct_pack(record, MICROBIT_TELEMETRY_FORMAT_PIPELINE, MICROBIT_TELEMETRY_RECORD_PIPELINE
+        , (uint32_t)MicroBitCustomClock::currentTimeUs(), id, value);
+    this->log(record, len);
+}
+
+void MicroBitTelemetry::controlPoint(uint16_t connHandle, const uint8_t *data, uint16_t len, uint8_t result)
+{
+    if (len > MICROBIT_TELEMETRY_CONTROL_POINT_DATA_MAX)
+    {
+        len = MICROBIT_TELEMETRY_CONTROL_POINT_DATA_MAX;
+    }
+    uint8_t record[MICROBIT_TELEMETRY_RECORD_MAX];
+    int n = struct_pack(record, MICROBIT_TELEMETRY_FORMAT_CONTROL_POINT, MICROBIT_TELEMETRY_RECORD_CONTROL_POINT
+        , (uint32_t)MicroBitCustomClock::currentTimeUs(), connHandle, result, len);
+    memcpy(&record[n], data, len);
+    this->log(record, n + len);
+}
+
+bool MicroBitTelemetry::rideLog(uint32_t sequence, uint16_t offset, const uint8_t *data, uint8_t len)
+{
+    if (len > MICROBIT_TELEMETRY_RIDE_LOG_DATA_MAX)
+    {
+        len = MICROBIT_TELEMETRY_RIDE_LOG_DATA_MAX;
+    }
+    uint8_t record[MICROBIT_TELEMETRY_RECORD_MAX];
+    int n = struct_pack(record, MICROBIT_TELEMETRY_FORMAT_RIDE_LOG, MICROBIT_TELEMETRY_RECORD_RIDE_LOG
+        , (uint32_t)MicroBitCustomClock::currentTimeUs(), sequence, offset, len);
+    if (len > 0)
+    {
+        memcpy(&record[n], data, len);
+    }
+    return this->write(record, n + len);
+}
+
+uint32_t MicroBitTelemetry::getDropped(void)
+{
+    return this->dropped;
+}
@@ -0,0 +1,132 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MICROBIT_TELEMETRY_H
+#define MICROBIT_TELEMETRY_H
+
+#include "MicroBit.h"
+#include "MicroBitCustom.h"
+#include "MicroBitCustomComponent.h"
+#include "MicroBitTelemetryFrame.h"
+#include "MicroBitStepHealth.h"
+
+/**
+  * Status flags
+  */
+// Universal flags used as part of the status field
+// #define MICROBIT_COMPONENT_RUNNING		0x01
+#define MICROBIT_TELEMETRY_ADDED_TO_IDLE                            0x02
+
+/**
+  * Binary telemetry over USB serial.
+  * Records are packed and COBS framed where they happen (also in BLE callbacks), queued in a ring buffer,
+  * and written to the serial port from the idle thread without blocking.
+  * tools/telemetry_decode turns the stream back into text.
+  */
+class MicroBitTelemetry : public MicroBitCustomComponent
+{
+
+public:
+    /**
+      * Constructor.
+      * @param _uBit The instance of a MicroBit runtime include a serial port that we're running on.
+      */
+    MicroBitTelemetry(MicroBit &_uBit, uint16_t id = MICROBIT_TELEMETRY_ID);
+
+    /**
+      * Periodic callback from MicroBit idle thread.
+      * Moves the queued frames to the serial port.
+      */
+    virtual void idleTick();
+
+    /**
+      * A STEP signal edge.
+      */
+    void stepEdge(uint64_t timestamp, uint32_t crankRevolutions);
+
+    /**
+      * A computed sample of the sensor.
+      */
+    void sample(uint32_t intervalTime, uint32_t speed100, uint32_t cadence2, int16_t power, uint8_t resistanceLevel10);
+
+    /**
+      * The rolling power averages and training load.
+      */
+    void analytics(int16_t average3, int16_t average10, int16_t average30, uint16_t normalizedPower, uint16_t intensityFactor1000, uint16_t trainingStressScore10, uint16_t ftp);
+
+    /**
+      * The session bests of the mean power, when one improves.
+      */
+    void peaks(uint16_t best5s, uint16_t best1min, uint16_t best5min, uint16_t best20min);
+
+    /**
+      * The measured crank interval and the one published with its confidence (MicroBitCadencePredictor).
+      */
+    void prediction(uint32_t measuredIntervalTime, uint32_t intervalTime, uint8_t confidence);
+
+    /**
+      * The STEP edge statistics of the session.
+      */
+    void health(MicroBitStepHealth &stepHealth);
+
+    /**
+      * A sample of a MicroBitCustomPipeline (MicroBitPipelineTelemetrySink).
+      */
+    void pipeline(uint16_t id, int32_t value);
+
+    /**
+      * A control point write and its result code.
+      */
+    void controlPoint(uint16_t connHandle, const uint8_t *data, uint16_t len, uint8_t result);
+
+    /**
+      * A chunk of a ride log block; len 0 ends the export.
+      * @return false if the ring buffer is full: the caller retries, nothing is counted as dropped.
+      */
+    bool rideLog(uint32_t sequence, uint16_t offset, const uint8_t *data, uint8_t len);
+
+    /**
+      * Number of records lost because the ring buffer was full.
+      */
+    uint32_t getDropped(void);
+
+private:
+    // Frame a record and queue it (all or nothing), counting a full ring as a drop
+    void log(const uint8_t *record, int len);
+    // Frame a record and queue it (all or nothing)
+    bool write(const uint8_t *record, int len);
+
+private:
+    // instance
+    MicroBit &uBit;
+
+    MicroBitTelemetryRing ring;
+
+    // records dropped, and the count already reported by a DROPPED record
+    volatile uint32_t dropped;
+    uint32_t droppedReported;
+
+};
+
+#endif /* #ifndef MICROBIT_TELEMETRY_H */
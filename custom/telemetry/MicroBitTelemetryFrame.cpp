@@ -0,0 +1,124 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "MicroBitTelemetryFrame.h"
+
+// The ring indexes wrap around at 65536, so the size must divide it.
+typedef char MICROBIT_TELEMETRY_BUFFER_SIZE_must_be_a_power_of_two[
+    ((MICROBIT_TELEMETRY_BUFFER_SIZE & (MICROBIT_TELEMETRY_BUFFER_SIZE-1))==0 && MICROBIT_TELEMETRY_BUFFER_SIZE<=32768) ? 1 : -1];
+
+int MicroBitTelemetryFrame::encode(const uint8_t *record, int len, uint8_t *frame)
+{
+    int code = 0;       // index of the current code byte
+    int out = 1;
+    for (int i=0; i<len; i++)
+    {
+        if (record[i] == 0)
+        {
+            frame[code] = (uint8_t)(out - code);
+            code = out++;
+        }
+        else
+        {
+            frame[out++] = record[i];
+            if (out - code == 0xFF)
+            {
+                frame[code] = 0xFF;
+                code = out++;
+            }
+        }
+    }
+    frame[code] = (uint8_t)(out - code);
+    frame[out++] = 0x00;
+    return out;
+}
+
+int MicroBitTelemetryFrame::decode(const uint8_t *frame, int len, uint8_t *record)
+{
+    int out = 0;
+    int i = 0;
+    while (i < len)
+    {
+        uint8_t code = frame[i++];
+        if (code == 0 || i + code - 1 > len)
+        {
+            return -1;
+        }
+        for (int j=1; j<code; j++)
+        {
+            if (frame[i] == 0)
+            {
+                return -1;
+            }
+            record[out++] = frame[i++];
+        }
+        // A block shorter than 254 bytes stands for a zero, except at the end.
+        if (code != 0xFF && i < len)
+        {
+            record[out++] = 0;
+        }
+    }
+    return out;
+}
+
+MicroBitTelemetryRing::MicroBitTelemetryRing()
+{
+    this->head=0;
+    this->tail=0;
+}
+
+bool MicroBitTelemetryRing::write(const uint8_t *data, int len)
+{
+    uint16_t head = this->head;
+    if (len > MICROBIT_TELEMETRY_BUFFER_SIZE - (uint16_t)(head - this->tail))
+    {
+        return false;
+    }
+    for (int i=0; i<len; i++)
+    {
+        this->buffer[(uint16_t)(head + i) & (MICROBIT_TELEMETRY_BUFFER_SIZE-1)] = data[i];
+    }
+    this->head = head + len;
+    return true;
+}
+
+int MicroBitTelemetryRing::peek(const uint8_t **data)
+{
+    uint16_t tail = this->tail;
+    int index = tail & (MICROBIT_TELEMETRY_BUFFER_SIZE-1);
+    int used = (uint16_t)(this->head - tail);
+    int contiguous = MICROBIT_TELEMETRY_BUFFER_SIZE - index;
+    *data = &this->buffer[index];
+    return used < contiguous ? used : contiguous;
+}
+
+void MicroBitTelemetryRing::consume(int len)
+{
+    this->tail = this->tail + len;
+}
+
+int MicroBitTelemetryRing::used(void)
+{
+    return (uint16_t)(this->head - this->tail);
+}
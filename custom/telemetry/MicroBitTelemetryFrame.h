@@ -0,0 +1,140 @@
+/*
+MIT License
+
+Copyright (c) 2021 jp-rad
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MICROBIT_TELEMETRY_FRAME_H
+#define MICROBIT_TELEMETRY_FRAME_H
+
+#include <stdint.h>
+#include "MicroBitCustom.h"
+
+/**
+  * Telemetry records (little-endian)
+  */
+// Every record starts with
+//  B   record type
+//  I   time (us, low 32 bits of MicroBitCustomClock::currentTimeUs())
+#define MICROBIT_TELEMETRY_RECORD_HEADER_SIZE       5
+
+// 0x01 Step edge                 "<BII"      + crank revolutions
+#define MICROBIT_TELEMETRY_RECORD_STEP_EDGE         0x01
+#define MICROBIT_TELEMETRY_FORMAT_STEP_EDGE         "<BII"
+// 0x02 Computed sample           "<BIIHHhB"  + interval time (us), speed (km/h x 100), cadence (rpm x 2), power (watt), resistance level (x 10)
+#define MICROBIT_TELEMETRY_RECORD_SAMPLE            0x02
+#define MICROBIT_TELEMETRY_FORMAT_SAMPLE            "<BIIHHhB"
+// 0x03 Control point write       "<BIHBB"    + connection handle, result code, length, then the written bytes
+#define MICROBIT_TELEMETRY_RECORD_CONTROL_POINT     0x03
+#define MICROBIT_TELEMETRY_FORMAT_CONTROL_POINT     "<BIHBB"
+#define MICROBIT_TELEMETRY_CONTROL_POINT_DATA_MAX   20
+// 0x04 Power analytics           "<BIhhhHHHH" + 3 s, 10 s, 30 s average power (watt), NP (watt), IF (x 1000), TSS (x 10), FTP (watt)
+#define MICROBIT_TELEMETRY_RECORD_ANALYTICS         0x04
+#define MICROBIT_TELEMETRY_FORMAT_ANALYTICS         "<BIhhhHHHH"
+// 0x05 Power bests               "<BIHHHH"   + best 5 s, 1 min, 5 min, 20 min mean power of the session (watt), when one improves
+#define MICROBIT_TELEMETRY_RECORD_PEAKS             0x05
+#define MICROBIT_TELEMETRY_FORMAT_PEAKS             "<BIHHHH"
+// 0x06 Cadence prediction        "<BIIIB"    + measured interval time (us), published interval time (us), confidence (100: measured, 0 ~ 99: predicted)
+#define MICROBIT_TELEMETRY_RECORD_PREDICTION        0x06
+#define MICROBIT_TELEMETRY_FORMAT_PREDICTION        "<BIIIB"
+// 0x07 STEP health               "<BIIHHHI"  + edges, bounces, missed pulses, stops, typical interval time (us),
+//                                              then the interval histogram "<16H" (MicroBitStepHealth)
+#define MICROBIT_TELEMETRY_RECORD_HEALTH            0x07
+#define MICROBIT_TELEMETRY_FORMAT_HEALTH            "<BIIHHHI"
+#define MICROBIT_TELEMETRY_HEALTH_BUCKETS           16
+// 0x08 Pipeline sample         "<BIHi"     + Event Bus ID of the pipeline, value (MicroBitPipelineTelemetrySink)
+#define MICROBIT_TELEMETRY_RECORD_PIPELINE          0x08
+#define MICROBIT_TELEMETRY_FORMAT_PIPELINE          "<BIHi"
+// 0x10 Ride log chunk            "<BIIHB"    + block sequence number, byte offset in the block, length, then the bytes
+//                                              (MicroBitRideLog export; length 0: end of the export)
+#define MICROBIT_TELEMETRY_RECORD_RIDE_LOG          0x10
+#define MICROBIT_TELEMETRY_FORMAT_RIDE_LOG          "<BIIHB"
+#define MICROBIT_TELEMETRY_RIDE_LOG_DATA_MAX        16
+// 0x7F Records dropped           "<BII"      + records lost since the previous 0x7F (ring buffer full)
+#define MICROBIT_TELEMETRY_RECORD_DROPPED           0x7F
+#define MICROBIT_TELEMETRY_FORMAT_DROPPED           "<BII"
+
+// Largest record, and largest frame (COBS overhead byte + 0x00 delimiter)
+#define MICROBIT_TELEMETRY_RECORD_MAX               (MICROBIT_TELEMETRY_RECORD_HEADER_SIZE+4+2+2+2+4+MICROBIT_TELEMETRY_HEALTH_BUCKETS*2)
+#define MICROBIT_TELEMETRY_FRAME_MAX                (MICROBIT_TELEMETRY_RECORD_MAX+2)
+
+/**
+  * Consistent Overhead Byte Stuffing.
+  * A frame is the COBS encoded record followed by a 0x00 delimiter; 0x00 never occurs inside a frame,
+  * so a reader resynchronizes at the next delimiter after a lost byte.
+  * No dependency on the micro:bit runtime, so the decoder on the host (tools/telemetry_decode) shares it.
+  */
+class MicroBitTelemetryFrame
+{
+public:
+    /**
+      * Encode a record of up to 254 bytes into a frame.
+      * @param frame The buffer of len+2 bytes.
+      * @return The length of the frame, including the delimiter.
+      */
+    static int encode(const uint8_t *record, int len, uint8_t *frame);
+
+    /**
+      * Decode a frame without its delimiter.
+      * @param record The buffer of len bytes.
+      * @return The length of the record, or -1 when the frame is malformed.
+      */
+    static int decode(const uint8_t *frame, int len, uint8_t *record);
+};
+
+/**
+  * Byte ring buffer between the record writers and the serial port.
+  * One writer and one reader; writers in several contexts must be serialized by the caller.
+  */
+class MicroBitTelemetryRing
+{
+public:
+    MicroBitTelemetryRing();
+
+    /**
+      * Append all the bytes, or none when they do not fit.
+      */
+    bool write(const uint8_t *data, int len);
+
+    /**
+      * Contiguous bytes ready to be read.
+      * @return The number of bytes at *data.
+      */
+    int peek(const uint8_t **data);
+
+    /**
+      * Release bytes returned by peek().
+      */
+    void consume(int len);
+
+    /**
+      * Number of bytes stored.
+      */
+    int used(void);
+
+private:
+    uint8_t buffer[MICROBIT_TELEMETRY_BUFFER_SIZE];
+    // free-running indexes, masked on access
+    volatile uint16_t head;
+    volatile uint16_t tail;
+};
+
+#endif /* #ifndef MICROBIT_TELEMETRY_FRAME_H */
@@ -24,11 +24,48 @@ SOFTWARE.
 
 #include "MicroBit.h"
 #include "MicroBitIndoorBikeStepSensor.h"
+#include "MicroBitBLEConnectionTable.h"
 #include "MicroBitIndoorBikeStepService.h"
+#include "MicroBitCyclingSpeedCadenceService.h"
+#include "MicroBitCyclingPowerService.h"
+#include "MicroBitIndoorBikeRadioSender.h"
+#include "MicroBitIndoorBikeRadioHub.h"
+#include "MicroBitTelemetry.h"
+#include "MicroBitConfigStore.h"
+#include "MicroBitConfigNrfFlash.h"
+#include "MicroBitRideLog.h"
+#include "MicroBitRideLogRecorder.h"
+#include "MicroBitRideLogService.h"
+#include "MicroBitPowerAnalytics.h"
+#include "MicroBitPowerPeaks.h"
+#include "MicroBitCadencePredictor.h"
+#include "MicroBitStepHealth.h"
+#include "MicroBitDiagnosticsService.h"
+
+#if (MICROBIT_INDOOR_BIKE_ROLE != MICROBIT_INDOOR_BIKE_ROLE_BLE) && MICROBIT_BLE_ENABLED
+#error "The radio roles need MICROBIT_BLE_ENABLED=0 (mbed_app.json)"
+#endif
 
 MicroBit uBit;
 MicroBitIndoorBikeStepSensor *sensor;
+MicroBitBLEConnectionTable *connections;
 MicroBitIndoorBikeStepService *service;
+MicroBitCyclingSpeedCadenceService *cscService;
+MicroBitCyclingPowerService *cpsService;
+MicroBitIndoorBikeRadioSender *radioSender;
+MicroBitIndoorBikeRadioHub *radioHub;
+MicroBitTelemetry *telemetry;
+MicroBitConfigNrfFlash *configFlash;
+MicroBitConfigStore *configStore;
+MicroBitConfigNrfFlash *rideLogFlash;
+MicroBitRideLog *rideLog;
+MicroBitRideLogRecorder *rideLogRecorder;
+MicroBitRideLogService *rideLogService;
+MicroBitPowerAnalytics *powerAnalytics;
+MicroBitPowerPeaks *powerPeaks;
+MicroBitCadencePredictor *cadencePredictor;
+MicroBitStepHealth *stepHealth;
+MicroBitDiagnosticsService *diagnosticsService;
 
 void addResistanceLevel(int8_t addLevel)
 {
@@ -46,15 +83,78 @@ void onButtonB(MicroBitEvent e)
     addResistanceLevel(1);
 }
 
+void onButtonAB(MicroBitEvent e)
+{
+    if (rideLogRecorder && telemetry)
+    {
+        uBit.display.print('E');
+        rideLogRecorder->exportLog(*telemetry);
+        addResistanceLevel(0);
+    }
+}
+
 void setup()
 {
+#if MICROBIT_INDOOR_BIKE_ROLE == MICROBIT_INDOOR_BIKE_ROLE_RADIO_HUB
+    radioHub = new MicroBitIndoorBikeRadioHub(uBit);
+    radioHub->idleTick();
+    uBit.display.print('H');
+#else
+#if MICROBIT_TELEMETRY_ENABLED
+    telemetry = new MicroBitTelemetry(uBit);
+    telemetry->idleTick();
+#endif
+    // uBit.init() has started advertising already; restoring reads one flash page.
+    configFlash = new MicroBitConfigNrfFlash();
+    configStore = new MicroBitConfigStore(*configFlash);
+    if (configStore->begin() != MICROBIT_CONFIG_STORE_OK)
+    {
+        delete configStore;
+        configStore = NULL;
+    }
     sensor = new MicroBitIndoorBikeStepSensor(uBit);
-    addResistanceLevel(1);
-    service = new MicroBitIndoorBikeStepService(uBit, *sensor);
+    sensor->setTelemetry(telemetry);
+#if MICROBIT_RIDE_LOG_ENABLED
+    rideLogFlash = new MicroBitConfigNrfFlash(MICROBIT_RIDE_LOG_PAGE_OFFSET);
+    rideLog = new MicroBitRideLog(*rideLogFlash, MICROBIT_RIDE_LOG_PAGES);
+    rideLog->begin();
+    rideLogRecorder = new MicroBitRideLogRecorder(*rideLog);
+    rideLogRecorder->idleTick();
+    sensor->setRideLog(rideLog);
+#endif
+    addResistanceLevel(1);  // first boot
+    sensor->setConfigStore(configStore);
+    addResistanceLevel(0);
+    powerAnalytics = new MicroBitPowerAnalytics();
+    powerAnalytics->setConfigStore(configStore);
+    sensor->setPowerAnalytics(powerAnalytics);
+    powerPeaks = new MicroBitPowerPeaks();
+    sensor->setPowerPeaks(powerPeaks);
+    stepHealth = new MicroBitStepHealth();
+    sensor->setStepHealth(stepHealth);
+#if MICROBIT_CADENCE_PREDICTOR_ENABLED
+    cadencePredictor = new MicroBitCadencePredictor();
+    sensor->setCadencePredictor(cadencePredictor);
+#endif
+#if MICROBIT_INDOOR_BIKE_ROLE == MICROBIT_INDOOR_BIKE_ROLE_RADIO_SENDER
+    radioSender = new MicroBitIndoorBikeRadioSender(uBit, *sensor);
+#else
+    connections = new MicroBitBLEConnectionTable(uBit);
+    service = new MicroBitIndoorBikeStepService(uBit, *sensor, *connections);
+    service->setTelemetry(telemetry);
+    cscService = new MicroBitCyclingSpeedCadenceService(uBit, *sensor, *connections);
+    cpsService = new MicroBitCyclingPowerService(uBit, *sensor, *connections);
+#if MICROBIT_RIDE_LOG_ENABLED
+    rideLogService = new MicroBitRideLogService(uBit, *rideLogRecorder, *connections);
+#endif
+    diagnosticsService = new MicroBitDiagnosticsService(uBit, *sensor, *powerAnalytics, *powerPeaks, *stepHealth, *connections);
+#endif
     sensor->idleTick();
 
     uBit.messageBus.listen(MICROBIT_ID_BUTTON_A, MICROBIT_BUTTON_EVT_CLICK, onButtonA);
     uBit.messageBus.listen(MICROBIT_ID_BUTTON_B, MICROBIT_BUTTON_EVT_CLICK, onButtonB);
+    uBit.messageBus.listen(MICROBIT_ID_BUTTON_AB, MICROBIT_BUTTON_EVT_CLICK, onButtonAB);
+#endif
 
 }
 
@@ -0,0 +1,199 @@
+/*
+ * advertising_test.cpp
+ *
+ * Test of the advertising payload and the scan response the firmware
+ * MicroBitIndoorBikeStepService builds on the host runtime (tools/host),
+ * next to the CSC and CPS services, across changes of the broadcast mode:
+ *
+ *  - off: the payload of the runtime (flags, name) with the FTMS fields,
+ *    the services of CSC and CPS in the scan response;
+ *  - broadcast: flags, FTMS fields and the live data, the name in the scan
+ *    response, once however often the mode changes;
+ *  - off again: byte for byte the payload and the scan response of the
+ *    first off.
+ *
+ * The host Gap refuses scannable and non-connectable advertising faster
+ * than every 100 ms, as nRF5xGap does: broadcast only must advertise
+ * scannable (the scan response reaches scanners) at 100 ms or slower, the
+ * other modes at the interval of the runtime, and a mode the stack refuses
+ * must leave the previous one advertising.
+ *
+ * usage: advertising_test
+ */
+
+#include "MicroBit.h"
+#include "MicroBitIndoorBikeStepSensor.h"
+#include "MicroBitIndoorBikeStepService.h"
+#include "MicroBitCyclingSpeedCadenceService.h"
+#include "MicroBitCyclingPowerService.h"
+#include "MicroBitBLEConnectionTable.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+typedef std::vector<uint8_t> Bytes;
+
+std::string hex(const Bytes &b)
+{
+    std::string s;
+    char text[4];
+    for (size_t i = 0; i < b.size(); i++) {
+        snprintf(text, sizeof(text), "%02X ", b[i]);
+        s += text;
+    }
+    return s;
+}
+
+void expect(const Bytes &actual, const Bytes &expected, const char *what)
+{
+    if (actual != expected && failures++ < 16) {
+        fprintf(stderr, "advertising_test: %s\n  expected: %s\n  actual:   %s\n", what, hex(expected).c_str(), hex(actual).c_str());
+    }
+}
+
+void expect(bool cond, const char *what)
+{
+    if (!cond && failures++ < 16) {
+        fprintf(stderr, "advertising_test: %s\n", what);
+    }
+}
+
+Bytes bytes(const GapAdvertisingData &data)
+{
+    return Bytes(data.getPayload(), data.getPayload() + data.getPayloadLen());
+}
+
+Bytes operator+(Bytes a, const Bytes &b)
+{
+    a.insert(a.end(), b.begin(), b.end());
+    return a;
+}
+
+Bytes field(uint8_t type, const char *text)
+{
+    Bytes b(1, (uint8_t)(strlen(text) + 1));
+    b.push_back(type);
+    b.insert(b.end(), text, text + strlen(text));
+    return b;
+}
+
+// the AD field of a type, empty if there is none
+Bytes find(const Bytes &payload, uint8_t type)
+{
+    for (size_t i = 0; i + 1 < payload.size(); i += payload[i] + 1) {
+        if (payload[i + 1] == type) {
+            return Bytes(payload.begin() + i, payload.begin() + i + 1 + payload[i]);
+        }
+    }
+    return Bytes();
+}
+
+void checkModes()
+{
+    host_reset();
+    MicroBit uBit;
+    // the payload the runtime advertises before the services are made
+    const char *RUNTIME_NAME = "BBC micro:bit [tezet]";
+    uBit.ble->gap().accumulateAdvertisingPayload(GapAdvertisingData::BREDR_NOT_SUPPORTED | GapAdvertisingData::LE_GENERAL_DISCOVERABLE);
+    uBit.ble->gap().accumulateAdvertisingPayload(GapAdvertisingData::COMPLETE_LOCAL_NAME
+        , (const uint8_t *)RUNTIME_NAME, (uint8_t)strlen(RUNTIME_NAME));
+
+    MicroBitIndoorBikeStepSensor sensor(uBit);
+    MicroBitBLEConnectionTable connections(uBit);
+    MicroBitIndoorBikeStepService service(uBit, sensor, connections);
+    MicroBitCyclingSpeedCadenceService csc(uBit, sensor, connections);
+    MicroBitCyclingPowerService cps(uBit, sensor, connections);
+    sensor.idleTick();
+    Gap &gap = uBit.ble->gap();
+
+    const Bytes FLAGS = { 0x02, 0x01, 0x06 };
+    const Bytes NAME = field(GapAdvertisingData::COMPLETE_LOCAL_NAME, BLE_DEVICE_LOCAL_NAME);
+    const Bytes APPEARANCE = { 0x03, 0x19, 0x80, 0x04 };
+    const Bytes FTMS = { 0x03, 0x03, 0x26, 0x18, 0x06, 0x16, 0x26, 0x18, 0x01, 0x20, 0x00 };
+    const Bytes SERVICES = { 0x05, 0x03, 0x16, 0x18, 0x18, 0x18 };
+
+    Bytes off = bytes(gap.getAdvertisingPayload());
+    Bytes offScan = bytes(gap.hostScanResponse());
+    expect(off, FLAGS + NAME + APPEARANCE + FTMS, "payload with broadcast off");
+    expect(offScan, SERVICES, "scan response with broadcast off");
+    expect(gap.hostAdvertising() && gap.hostScannable(), "connectable advertising with broadcast off");
+    const uint16_t RUNTIME_INTERVAL = gap.getAdvertisingParams().getInterval();
+
+    // live data: Manufacturer Specific Data, company 0xFFFF, the encoded Indoor Bike Data
+    service.setBroadcastMode(INDOOR_BIKE_BROADCAST_CONNECTABLE);
+    Bytes broadcast = bytes(gap.getAdvertisingPayload());
+    Bytes msd = find(broadcast, GapAdvertisingData::MANUFACTURER_SPECIFIC_DATA);
+    expect(msd.size() == 2 + 2 + MicroBitFitnessMachineProfile::DATA_SIZE && msd[2] == 0xFF && msd[3] == 0xFF
+        , "live data in the payload");
+    expect(broadcast, FLAGS + APPEARANCE + FTMS + msd, "payload in broadcast");
+    expect(broadcast.size() <= 31, "payload within 31 bytes");
+    expect(bytes(gap.hostScanResponse()), NAME + SERVICES, "scan response in broadcast");
+
+    // the live data follows the ride, in place
+    host_set_time_us(1000000);
+    for (int i = 0; i < 8; i++) {
+        host_set_time_us(1000000 + i * 500000);
+        MicroBitEvent(MICROBIT_ID_IO_P2, MICROBIT_PIN_EVT_FALL);
+        host_idle();
+    }
+    host_set_time_us(5000000);
+    host_idle();
+    Bytes live = bytes(gap.getAdvertisingPayload());
+    Bytes liveMsd = find(live, GapAdvertisingData::MANUFACTURER_SPECIFIC_DATA);
+    expect(liveMsd != msd && liveMsd.size() == msd.size(), "live data updated");
+    expect(live, FLAGS + APPEARANCE + FTMS + liveMsd, "payload after updates");
+
+    // broadcast only: scannable, not connectable, no faster than the stack allows
+    service.setBroadcastMode(INDOOR_BIKE_BROADCAST_ONLY);
+    expect(service.getBroadcastMode() == INDOOR_BIKE_BROADCAST_ONLY, "broadcast only taken");
+    expect(gap.hostAdvertising(), "advertising in broadcast only");
+    expect(gap.hostScannable(), "scan response reachable in broadcast only");
+    expect(gap.getAdvertisingParams().getAdvertisingType() == GapAdvertisingParams::ADV_SCANNABLE_UNDIRECTED
+        , "no connections in broadcast only");
+    expect(gap.getAdvertisingParams().getInterval() >= GapAdvertisingParams::GAP_ADV_PARAMS_INTERVAL_MIN_NONCON
+        , "interval of broadcast only");
+    expect(bytes(gap.hostScanResponse()), NAME + SERVICES, "scan response in broadcast only");
+
+    // the name is in the scan response once, whatever the modes were
+    service.setBroadcastMode(INDOOR_BIKE_BROADCAST_CONNECTABLE);
+    expect(bytes(gap.hostScanResponse()), NAME + SERVICES, "scan response after broadcast modes");
+    expect(gap.getAdvertisingParams().getInterval() == RUNTIME_INTERVAL, "interval of the runtime after broadcast only");
+
+    service.setBroadcastMode(INDOOR_BIKE_BROADCAST_OFF);
+    expect(bytes(gap.getAdvertisingPayload()), off, "payload with broadcast off again");
+    expect(bytes(gap.hostScanResponse()), offScan, "scan response with broadcast off again");
+    expect(gap.hostAdvertising() && gap.getAdvertisingParams().getInterval() == RUNTIME_INTERVAL
+        , "advertising with broadcast off again");
+
+    // the stack refuses the advertising of a mode: the previous mode goes on
+    gap.hostAdvertisingError = BLE_ERROR_INVALID_STATE;
+    service.setBroadcastMode(INDOOR_BIKE_BROADCAST_ONLY);
+    expect(service.getBroadcastMode() == INDOOR_BIKE_BROADCAST_OFF, "refused mode not taken");
+    expect(gap.hostAdvertising(), "advertising after a refused mode");
+    expect(bytes(gap.getAdvertisingPayload()), off, "payload after a refused mode");
+    expect(gap.getAdvertisingParams().getAdvertisingType() == GapAdvertisingParams::ADV_CONNECTABLE_UNDIRECTED
+        , "connectable after a refused mode");
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    checkModes();
+
+    if (failures) {
+        fprintf(stderr, "advertising_test: %d failure(s)\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("advertising_test: ok\n");
+    return EXIT_SUCCESS;
+}
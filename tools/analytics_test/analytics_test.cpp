@@ -0,0 +1,222 @@
+/*
+ * analytics_test.cpp
+ *
+ * Test of the firmware MicroBitPowerAnalytics and MicroBitPowerPeaks against
+ * references computed in double precision from the whole sample history:
+ *
+ *  - 3 s, 10 s and 30 s averages exact (rounded), every sample.
+ *  - Normalized Power within 1 W, Intensity Factor and TSS within the
+ *    rounding that 1 W of NP makes.
+ *  - Session bests exact for 5 s and 1 min; for 5 min and 20 min never
+ *    above the true best, and equal to the best window on a bucket boundary.
+ *  - isqrt exact around squares, up to 2^64 - 1.
+ *
+ * Traces: steady, intervals, sprints, noise, negative power, long rides.
+ *
+ * usage: analytics_test [traces] [seed]
+ */
+
+#include "MicroBitPowerAnalytics.h"
+#include "MicroBitPowerPeaks.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void expect(bool cond, const char *what, int trace, size_t sample)
+{
+    if (!cond && failures++ < 16) {
+        fprintf(stderr, "analytics_test: trace %d sample %zu: %s\n", trace, sample, what);
+    }
+}
+
+// rounded average of the last n samples (fewer at the start)
+double average(const std::vector<int> &p, size_t n)
+{
+    size_t k = std::min(n, p.size());
+    double sum = 0;
+    for (size_t i = p.size() - k; i < p.size(); i++) {
+        sum += p[i];
+    }
+    return floor(sum / k + 0.5);
+}
+
+std::vector<int> trace(int kind, std::mt19937 &rng)
+{
+    std::vector<int> p;
+    size_t length = 30 + rng() % 3600;
+    for (size_t t = 0; t < length; t++) {
+        int w;
+        switch (kind % 5) {
+        case 0:     // steady
+            w = 180;
+            break;
+        case 1:     // 3 min on, 2 min off
+            w = (t % 300 < 180) ? 320 : 120;
+            break;
+        case 2:     // sprints
+            w = (t % 120 < 10) ? 1200 : 150;
+            break;
+        case 3:     // noise, some negative (back pedalling)
+            w = (int)(rng() % 700) - 50;
+            break;
+        default:    // random walk
+            w = p.empty() ? 200 : std::max(0, std::min(2000, p.back() + (int)(rng() % 41) - 20));
+            break;
+        }
+        p.push_back(w);
+    }
+    return p;
+}
+
+// best rounded mean power over n samples, of the windows ending every step samples
+double best(const std::vector<int> &p, size_t n, size_t step)
+{
+    double top = 0;
+    double sum = 0;
+    for (size_t i = 0; i < p.size(); i++) {
+        sum += p[i];
+        if (i >= n) {
+            sum -= p[i - n];
+        }
+        if (i + 1 >= n && (i + 1) % step == 0) {
+            top = std::max(top, floor(sum / n + 0.5));
+        }
+    }
+    return top;
+}
+
+void checkPeaks(int index, const std::vector<int> &p)
+{
+    MicroBitPowerPeaks peaks;
+    std::vector<int> clamped;
+    for (size_t i = 0; i < p.size(); i++) {
+        uint16_t before[MICROBIT_POWER_PEAKS_COUNT];
+        for (int d = 0; d < MICROBIT_POWER_PEAKS_COUNT; d++) {
+            before[d] = peaks.getBest(d);
+        }
+        bool improved = peaks.add((int16_t)p[i]);
+        clamped.push_back(std::max(0, std::min(MICROBIT_POWER_PEAKS_MAX_POWER, p[i])));
+
+        bool changed = false;
+        for (int d = 0; d < MICROBIT_POWER_PEAKS_COUNT; d++) {
+            changed |= peaks.getBest(d) != before[d];
+        }
+        expect(improved == changed, "improved flag", index, i);
+    }
+
+    static const size_t steps[MICROBIT_POWER_PEAKS_COUNT] = { 1, 1, 5, 20 };
+    for (int d = 0; d < MICROBIT_POWER_PEAKS_COUNT; d++) {
+        size_t n = MicroBitPowerPeaks::getSeconds(d);
+        expect(peaks.getBest(d) == best(clamped, n, steps[d]), "best on bucket boundaries", index, d);
+        expect(peaks.getBest(d) <= best(clamped, n, 1), "best above the true best", index, d);
+    }
+}
+
+void checkTrace(int index, const std::vector<int> &p, uint16_t ftp)
+{
+    MicroBitPowerAnalytics analytics;
+    analytics.setFtp(ftp);
+
+    std::vector<int> clamped;
+    double sum4 = 0;
+    size_t count4 = 0;
+    for (size_t i = 0; i < p.size(); i++) {
+        analytics.add((int16_t)p[i]);
+        clamped.push_back(std::max(0, p[i]));
+
+        expect(analytics.getAverage3() == average(clamped, 3), "3 s average", index, i);
+        expect(analytics.getAverage10() == average(clamped, 10), "10 s average", index, i);
+        expect(analytics.getAverage30() == average(clamped, 30), "30 s average", index, i);
+        expect(analytics.getSamples() == i + 1, "samples", index, i);
+
+        if (clamped.size() >= 30) {
+            double a = average(clamped, 30);
+            sum4 += a * a * a * a;
+            count4++;
+        }
+        double np = count4 ? pow(sum4 / count4, 0.25) : 0;
+        expect(fabs(analytics.getNormalizedPower() - np) <= 1.0, "normalized power", index, i);
+
+        // with the NP of the firmware, IF and TSS are only rounded
+        double fnp = analytics.getNormalizedPower();
+        double intensity = fnp * 1000 / ftp;
+        expect(fabs(analytics.getIntensityFactor1000() - intensity) <= 0.5, "intensity factor", index, i);
+        double tss = (i + 1) * fnp * fnp * 10 / (36.0 * ftp * ftp);
+        expect(fabs(analytics.getTrainingStressScore10() - std::min(tss, 65535.0)) <= 0.5, "TSS", index, i);
+    }
+    printf("trace %d: %zu s, FTP %u W, avg30 %d W, NP %u W, IF %.3f, TSS %.1f\n",
+            index, p.size(), analytics.getFtp(), analytics.getAverage30(), analytics.getNormalizedPower(),
+            analytics.getIntensityFactor1000() / 1000.0, analytics.getTrainingStressScore10() / 10.0);
+}
+
+void checkIsqrt(std::mt19937 &rng)
+{
+    for (uint64_t r = 0; r < 70000; r++) {
+        expect(MicroBitPowerAnalytics::isqrt(r * r) == r, "isqrt of a square", -1, (size_t)r);
+        if (r > 0) {
+            expect(MicroBitPowerAnalytics::isqrt(r * r - 1) == r - 1, "isqrt below a square", -1, (size_t)r);
+        }
+    }
+    std::mt19937_64 rng64(rng());
+    for (int i = 0; i < 100000; i++) {
+        uint64_t v = rng64() >> (rng() % 64);
+        uint64_t r = MicroBitPowerAnalytics::isqrt(v);
+        expect(r * r <= v && (r + 1) * (r + 1) > v, "isqrt", -1, (size_t)i);
+    }
+    expect(MicroBitPowerAnalytics::isqrt(UINT64_MAX) == 0xFFFFFFFFu, "isqrt of 2^64 - 1", -1, 0);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    int traces = (argc > 1) ? atoi(argv[1]) : 20;
+    std::mt19937 rng((argc > 2) ? (unsigned)atoi(argv[2]) : 1);
+
+    checkIsqrt(rng);
+    for (int i = 0; i < traces; i++) {
+        std::vector<int> p = trace(i, rng);
+        checkTrace(i, p, (uint16_t)(MIN_FTP + rng() % (MAX_FTP - MIN_FTP + 1)));
+        checkPeaks(i, p);
+    }
+
+    // FTP limits, reset
+    MicroBitPowerAnalytics analytics;
+    analytics.setFtp(0);
+    expect(analytics.getFtp() == MIN_FTP, "FTP lower limit", -1, 0);
+    analytics.setFtp(5000);
+    expect(analytics.getFtp() == MAX_FTP, "FTP upper limit", -1, 0);
+    for (int i = 0; i < 100; i++) {
+        analytics.add(250);
+    }
+    analytics.reset();
+    expect(analytics.getSamples() == 0 && analytics.getAverage30() == 0 && analytics.getNormalizedPower() == 0,
+            "reset", -1, 0);
+
+    // a 20 min effort at 250 W in the middle of easy riding
+    MicroBitPowerPeaks peaks;
+    for (int t = 0; t < 3600; t++) {
+        peaks.add((t >= 600 && t < 1800) ? 250 : 100);
+    }
+    expect(peaks.getBest(MICROBIT_POWER_PEAKS_20MIN) == 250, "20 min effort", -1, 0);
+    expect(peaks.getBest(MICROBIT_POWER_PEAKS_5S) == 250, "5 s of the 20 min effort", -1, 0);
+    peaks.reset();
+    expect(peaks.getBest(MICROBIT_POWER_PEAKS_5S) == 0, "peaks reset", -1, 0);
+
+    if (failures) {
+        fprintf(stderr, "analytics_test: %d failure(s)\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("analytics_test: ok\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,189 @@
+/*
+ * cadence_predictor_test.cpp
+ *
+ * Test of the firmware MicroBitCadencePredictor on synthetic rides, sampled
+ * at 1 Hz like MicroBitIndoorBikeStepSensor::update():
+ *
+ *  - Steady cadence: the prediction is the interval, with high confidence.
+ *  - Standing start (cadence ramping up): the published interval (the
+ *    prediction when confident, else the measured average) is closer to the
+ *    true one than the measured average alone.
+ *  - Stop: the estimate never falls below the time since the last edge,
+ *    never decreases, and its confidence falls.
+ *
+ * usage: cadence_predictor_test
+ */
+
+#include "MicroBitCadencePredictor.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <deque>
+#include <vector>
+
+namespace {
+
+const uint64_t MAX_STEPS_INTERVAL_TIME_US = 2500000;
+
+int failures = 0;
+
+void expect(bool cond, const char *what, double t)
+{
+    if (!cond && failures++ < 16) {
+        fprintf(stderr, "cadence_predictor_test: t=%.1f s: %s\n", t, what);
+    }
+}
+
+struct Ride {
+    std::vector<uint64_t> edges;
+    // true interval (us) at a time
+    double interval(uint64_t t) const
+    {
+        for (size_t i = 1; i < edges.size(); i++) {
+            if (edges[i] >= t) {
+                return (double)(edges[i] - edges[i - 1]);
+            }
+        }
+        return 0;
+    }
+};
+
+// cadence (rpm) from rpm0 to rpm1 over the ride, then steady
+Ride ramp(double rpm0, double rpm1, double seconds, double total)
+{
+    Ride r;
+    double t = 1.0;
+    while (t < total) {
+        r.edges.push_back((uint64_t)(t * 1e6));
+        double rpm = (t < seconds) ? rpm0 + (rpm1 - rpm0) * t / seconds : rpm1;
+        t += 60.0 / rpm;
+    }
+    return r;
+}
+
+// The sensor: average of the last two intervals, bounded by the time since the last edge
+struct Sensor {
+    MicroBitCadencePredictor predictor;
+    std::deque<uint64_t> list;
+    double measured;
+    double published;
+    uint8_t confidence;
+
+    void edge(uint64_t t)
+    {
+        if (list.empty()) {
+            list.push_back(t - MAX_STEPS_INTERVAL_TIME_US);
+        }
+        list.push_back(t);
+        if (list.size() > 3) {
+            list.pop_front();
+        }
+        predictor.edge(t);
+    }
+
+    void update(uint64_t now)
+    {
+        if (!list.empty() && now - list.back() >= MAX_STEPS_INTERVAL_TIME_US) {
+            list.clear();
+            predictor.reset();
+        }
+        measured = 0;
+        if (list.size() >= 2) {
+            measured = (double)(list.back() - list.front()) / (list.size() - 1);
+            if (now - list.back() > measured) {
+                measured = (double)(now - list.back());
+            }
+        }
+        published = measured;
+        confidence = MICROBIT_CADENCE_PREDICTOR_MEASURED;
+        uint8_t c;
+        uint32_t p = predictor.predict(now, &c);
+        if (measured != 0 && p != 0 && c >= 50) {
+            published = p;
+            confidence = c;
+        }
+    }
+};
+
+// mean absolute cadence error (rpm) of the measured and the published values
+void run(const char *name, const Ride &ride, double *measuredError, double *publishedError, uint8_t *lastConfidence)
+{
+    Sensor s;
+    size_t next = 0;
+    double me = 0, pe = 0;
+    int n = 0;
+    uint64_t end = ride.edges.back();
+    for (uint64_t now = 1000000; now <= end; now += 1000000) {
+        while (next < ride.edges.size() && ride.edges[next] <= now) {
+            s.edge(ride.edges[next++]);
+        }
+        s.update(now);
+        double truth = ride.interval(now);
+        if (truth == 0 || s.measured == 0) {
+            continue;
+        }
+        me += fabs(60e6 / s.measured - 60e6 / truth);
+        pe += fabs(60e6 / s.published - 60e6 / truth);
+        n++;
+    }
+    *measuredError = me / n;
+    *publishedError = pe / n;
+    *lastConfidence = s.confidence;
+    printf("%s: measured %.2f rpm, published %.2f rpm mean error, confidence %u\n",
+            name, *measuredError, *publishedError, s.confidence);
+}
+
+} // namespace
+
+int main()
+{
+    double me, pe;
+    uint8_t confidence;
+
+    run("steady 80 rpm", ramp(80, 80, 1, 60), &me, &pe, &confidence);
+    expect(pe <= me + 0.5, "steady: prediction worse than the measurement", 60);
+    expect(confidence >= 90, "steady: low confidence", 60);
+
+    run("standing start 30 -> 100 rpm", ramp(30, 100, 15, 30), &me, &pe, &confidence);
+    expect(pe < me, "standing start: prediction no better than the measurement", 30);
+
+    run("slowing 100 -> 40 rpm", ramp(100, 40, 15, 30), &me, &pe, &confidence);
+    expect(pe < me, "slowing: prediction no better than the measurement", 30);
+
+    // stop after a steady ride
+    MicroBitCadencePredictor p;
+    uint64_t t = 1000000;
+    for (int i = 0; i < 30; i++, t += 750000) {
+        p.edge(t);
+    }
+    uint64_t last = t - 750000;
+    uint32_t previous = 0;
+    uint8_t previousConfidence = 100;
+    for (uint64_t now = last; now < last + MAX_STEPS_INTERVAL_TIME_US; now += 100000) {
+        uint8_t c;
+        uint32_t interval = p.predict(now, &c);
+        expect(interval >= now - last, "stop: estimate below the time since the edge", now / 1e6);
+        expect(interval >= previous, "stop: estimate decreasing", now / 1e6);
+        expect(c <= previousConfidence, "stop: confidence rising", now / 1e6);
+        previous = interval;
+        previousConfidence = c;
+    }
+    expect(previousConfidence < 50, "stop: still confident after 2.5 s", 0);
+
+    // no estimate before two edges
+    MicroBitCadencePredictor q;
+    uint8_t c;
+    expect(q.predict(0, &c) == 0 && c == 0, "estimate without edges", 0);
+    q.edge(1000000);
+    expect(q.predict(1500000, &c) == 0 && c == 0, "estimate after one edge", 0);
+
+    if (failures) {
+        fprintf(stderr, "cadence_predictor_test: %d failure(s)\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("cadence_predictor_test: ok\n");
+    return EXIT_SUCCESS;
+}
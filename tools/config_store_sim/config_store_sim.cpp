@@ -0,0 +1,197 @@
+/*
+ * config_store_sim.cpp
+ *
+ * Power-loss test of MicroBitConfigStore on a simulated NOR flash.
+ *
+ * The simulated flash only clears bits on write (a write that would set a
+ * bit is reported as a store bug) and cuts the power after a random number
+ * of word writes and page erases. The word being written when the power
+ * goes is torn (a random subset of its bits programmed); an erase in
+ * progress leaves a random subset of the page erased.
+ *
+ * After every power cut the store is opened again, and every key must read
+ * back the last value whose set() returned, or the value being written when
+ * the power went.
+ *
+ * usage: config_store_sim [cycles] [seed]
+ */
+
+#include "MicroBitConfigStore.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <random>
+#include <vector>
+
+namespace {
+
+std::mt19937 rng;
+
+class SimFlash : public MicroBitConfigFlash {
+public:
+    SimFlash()
+    {
+        // flash of a new device is erased; one page with leftovers of another firmware
+        memset(mem, 0xFF, sizeof(mem));
+        for (int i = 0; i < MICROBIT_CONFIG_STORE_PAGE_WORDS; i += 3) {
+            mem[1][i] = rng();
+        }
+    }
+
+    virtual uint32_t *page(int index) { return mem[index]; }
+
+    virtual int write(uint32_t *address, const uint32_t *data, int words)
+    {
+        for (int i = 0; i < words; i++) {
+            if (!step()) {
+                address[i] &= data[i] | rng();     // torn: some of the bits programmed
+                return MICROBIT_CONFIG_STORE_FLASH_ERROR;
+            }
+            if ((address[i] & data[i]) != data[i]) {
+                fprintf(stderr, "config_store_sim: write sets bits at word %ld\n", (long)(address + i - &mem[0][0]));
+                overwrites++;
+            }
+            address[i] &= data[i];
+            writes++;
+        }
+        return MICROBIT_CONFIG_STORE_OK;
+    }
+
+    virtual int erase(uint32_t *page)
+    {
+        int index = (page == mem[0]) ? 0 : 1;
+        if (!step()) {
+            for (int i = 0; i < MICROBIT_CONFIG_STORE_PAGE_WORDS; i++) {
+                if (rng() & 1) {
+                    page[i] = 0xFFFFFFFF;
+                }
+            }
+            return MICROBIT_CONFIG_STORE_FLASH_ERROR;
+        }
+        memset(page, 0xFF, MICROBIT_CONFIG_STORE_PAGE_SIZE);
+        erases[index]++;
+        return MICROBIT_CONFIG_STORE_OK;
+    }
+
+    // power for n more flash operations, -1: no cut
+    void power(long n) { budget = n; }
+
+    uint32_t mem[2][MICROBIT_CONFIG_STORE_PAGE_WORDS];
+    unsigned long writes = 0;
+    unsigned long erases[2] = { 0, 0 };
+    unsigned long overwrites = 0;
+
+private:
+    bool step()
+    {
+        if (budget == 0) {
+            return false;
+        }
+        if (budget > 0) {
+            budget--;
+        }
+        return true;
+    }
+
+    long budget = -1;
+};
+
+struct Value {
+    bool present;
+    uint8_t len;
+    uint8_t bytes[MICROBIT_CONFIG_STORE_VALUE_MAX];
+};
+
+bool same(const Value &v, const uint8_t *bytes, uint8_t len)
+{
+    return v.present && v.len == len && memcmp(v.bytes, bytes, len) == 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    long cycles = (argc > 1) ? atol(argv[1]) : 20000;
+    rng.seed((argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 0) : 1);
+
+    SimFlash flash;
+    std::vector<Value> committed(MICROBIT_CONFIG_STORE_KEY_MAX);
+    std::vector<Value> inFlight(MICROBIT_CONFIG_STORE_KEY_MAX);
+    unsigned long sets = 0, failures = 0, interrupted = 0;
+
+    for (long cycle = 0; cycle < cycles; cycle++) {
+        // boot
+        flash.power(-1);
+        MicroBitConfigStore store(flash);
+        if (store.begin() != MICROBIT_CONFIG_STORE_OK) {
+            fprintf(stderr, "config_store_sim: begin failed (cycle %ld)\n", cycle);
+            failures++;
+            continue;
+        }
+        for (int key = 0; key < MICROBIT_CONFIG_STORE_KEY_MAX; key++) {
+            uint8_t buf[MICROBIT_CONFIG_STORE_VALUE_MAX];
+            const Value &c = committed[key];
+            const Value &f = inFlight[key];
+            bool gotCommitted = c.present && store.get(key, buf, c.len) && same(c, buf, c.len);
+            bool gotInFlight = f.present && store.get(key, buf, f.len) && same(f, buf, f.len);
+            bool ok = gotCommitted || gotInFlight;
+            if (!c.present && !gotInFlight) {
+                ok = true;
+                for (uint8_t len = 1; len <= MICROBIT_CONFIG_STORE_VALUE_MAX; len++) {
+                    ok = ok && !store.get(key, buf, len);
+                }
+            }
+            if (!ok) {
+                if (failures < 16) {
+                    fprintf(stderr, "config_store_sim: key %d lost (cycle %ld)\n", key, cycle);
+                }
+                failures++;
+            }
+            if (gotInFlight) {
+                committed[key] = f;
+            }
+            inFlight[key].present = false;
+        }
+
+        // run until the power goes
+        flash.power((long)(rng() % 600));
+        for (;;) {
+            Value v;
+            int key = (int)(rng() % MICROBIT_CONFIG_STORE_KEY_MAX);
+            v.present = true;
+            v.len = (uint8_t)(1 + rng() % MICROBIT_CONFIG_STORE_VALUE_MAX);
+            for (int i = 0; i < v.len; i++) {
+                v.bytes[i] = (rng() % 4 == 0) ? 0xFF : (uint8_t)rng();
+            }
+            sets++;
+            int result = store.set((uint16_t)key, v.bytes, v.len);
+            if (result == MICROBIT_CONFIG_STORE_FLASH_ERROR) {
+                inFlight[key] = v;
+                interrupted++;
+                break;
+            }
+            if (result != MICROBIT_CONFIG_STORE_OK) {
+                fprintf(stderr, "config_store_sim: set returned %d\n", result);
+                failures++;
+                break;
+            }
+            committed[key] = v;
+            uint8_t buf[MICROBIT_CONFIG_STORE_VALUE_MAX];
+            if (!store.get((uint16_t)key, buf, v.len) || memcmp(buf, v.bytes, v.len) != 0) {
+                fprintf(stderr, "config_store_sim: read back failed\n");
+                failures++;
+            }
+        }
+    }
+
+    printf("%ld power cycles, %lu sets (%lu interrupted), %lu word writes, erases page0 %lu page1 %lu\n",
+            cycles, sets, interrupted, flash.writes, flash.erases[0], flash.erases[1]);
+    if (failures != 0 || flash.overwrites != 0) {
+        fprintf(stderr, "config_store_sim: %lu failure(s), %lu overwrite(s)\n", failures, flash.overwrites);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
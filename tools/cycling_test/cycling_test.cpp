@@ -0,0 +1,146 @@
+/*
+ * cycling_test.cpp
+ *
+ * Test of the crank revolution data of the firmware
+ * MicroBitCyclingSpeedCadenceService and MicroBitCyclingPowerService on the
+ * host runtime (tools/host): the sensor sees STEP edges of a constant
+ * cadence, a central subscribes to the CSC or Cycling Power Measurement,
+ * and the cadence a central computes from two packets,
+ *
+ *   rpm = delta revolutions * 60 * 1024 / delta last crank event time,
+ *
+ * must be the cadence of the ride, across the wrap of both 16 bit fields.
+ * The last crank event time must be the time of the last revolution.
+ *
+ * usage: cycling_test
+ */
+
+#include "MicroBit.h"
+#include "MicroBitIndoorBikeStepSensor.h"
+#include "MicroBitCyclingSpeedCadenceService.h"
+#include "MicroBitCyclingPowerService.h"
+#include "MicroBitBLEConnectionTable.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+namespace {
+
+const uint64_t TICK_US = 10000;
+
+int failures = 0;
+
+void expect(bool cond, const char *what, double at)
+{
+    if (!cond && failures++ < 16) {
+        fprintf(stderr, "cycling_test: %s (at %g)\n", what, at);
+    }
+}
+
+struct Crank {
+    uint16_t revolutions;
+    uint16_t eventTime1024;
+};
+
+// rides at rpm with pulses magnets, and returns the crank data of every notification of uuid
+std::vector<Crank> ride(double rpm, int pulses, double seconds, uint16_t uuid, size_t offset, std::vector<uint64_t> &revolutions)
+{
+    host_reset();
+    MicroBit uBit;
+    MicroBitIndoorBikeStepSensor sensor(uBit);
+    MicroBitBLEConnectionTable connections(uBit);
+    MicroBitCyclingSpeedCadenceService csc(uBit, sensor, connections);
+    MicroBitCyclingPowerService cps(uBit, sensor, connections);
+    sensor.setPulsesPerRevolution((uint8_t)pulses);
+    sensor.idleTick();
+
+    std::vector<Crank> cranks;
+    uBit.ble->gattServer().hostOutput = [&](const char *kind, Gap::Handle_t, uint16_t u, const uint8_t *data, uint16_t len) {
+        if (u == uuid && kind[0] == 'n' && len >= offset + 4) {
+            Crank c;
+            c.revolutions = (uint16_t)(data[offset] | data[offset + 1] << 8);
+            c.eventTime1024 = (uint16_t)(data[offset + 2] | data[offset + 3] << 8);
+            cranks.push_back(c);
+        }
+    };
+    uBit.ble->gap().hostConnect(1);
+    uBit.ble->gattServer().hostSubscribe(1, uBit.ble->gattServer().hostFind(uuid), true);
+
+    uint64_t interval = (uint64_t)(60e6 / rpm / pulses);
+    uint64_t edge = 1000000;
+    revolutions.clear();
+    for (uint64_t t = TICK_US; t <= (uint64_t)(seconds * 1e6); t += TICK_US) {
+        for (; edge < t; edge += interval) {
+            host_set_time_us(edge);
+            MicroBitEvent(MICROBIT_ID_IO_P2, MICROBIT_PIN_EVT_FALL);
+            revolutions.push_back(edge);
+        }
+        host_set_time_us(t);
+        host_idle();
+    }
+    return cranks;
+}
+
+void checkCadence(double rpm, int pulses, uint16_t uuid, size_t offset)
+{
+    // long enough for both fields to wrap at 120 rpm (65536 / 1024 s)
+    std::vector<uint64_t> edges;
+    std::vector<Crank> cranks = ride(rpm, pulses, 200, uuid, offset, edges);
+    // one notification per update (1 s)
+    expect(cranks.size() >= 199, "notifications", (double)cranks.size());
+
+    uint32_t revolutions = 0;
+    uint32_t time1024 = 0;
+    int pairs = 0;
+    for (size_t i = 1; i < cranks.size(); i++) {
+        // a central starts with the first packet that holds a revolution
+        if (cranks[i - 1].revolutions == 0) {
+            continue;
+        }
+        uint16_t dr = (uint16_t)(cranks[i].revolutions - cranks[i - 1].revolutions);
+        uint16_t dt = (uint16_t)(cranks[i].eventTime1024 - cranks[i - 1].eventTime1024);
+        if (dr == 0) {
+            expect(dt == 0, "event time without a revolution", (double)i);
+            continue;
+        }
+        double measured = dr * 60.0 * 1024 / dt;
+        expect(fabs(measured - rpm) < rpm * 0.002, "cadence of two packets", measured);
+        revolutions += dr;
+        time1024 += dt;
+        pairs++;
+    }
+    expect(pairs > 100, "packets with new revolutions", pairs);
+    double mean = revolutions * 60.0 * 1024 / time1024;
+    expect(fabs(mean - rpm) < 0.05, "cadence of the ride", mean);
+
+    // a revolution ends with the edge of the last magnet
+    size_t count = edges.size() / pulses;
+    uint64_t last = edges[count * pulses - 1];
+    expect(cranks.back().eventTime1024 == (uint16_t)((last * 128) / 125000), "last crank event time"
+        , (double)cranks.back().eventTime1024);
+    expect(cranks.back().revolutions == (uint16_t)count, "cumulative revolutions", (double)cranks.back().revolutions);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    // CSC Measurement "<BHH": the crank data follows the flags
+    checkCadence(90, 1, 0x2A5B, 1);
+    checkCadence(60, 1, 0x2A5B, 1);
+    checkCadence(120, 2, 0x2A5B, 1);
+    // Cycling Power Measurement "<HhHH": after the flags and the power
+    checkCadence(90, 1, 0x2A63, 4);
+    checkCadence(120, 2, 0x2A63, 4);
+
+    if (failures) {
+        fprintf(stderr, "cycling_test: %d failure(s)\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("cycling_test: ok\n");
+    return EXIT_SUCCESS;
+}
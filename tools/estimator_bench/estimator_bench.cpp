@@ -0,0 +1,239 @@
+/*
+ * estimator_bench.cpp
+ *
+ * Accuracy against latency of the cadence and power estimates: synthetic
+ * STEP signals (tools/ride_signal) go through the firmware
+ * MicroBitIndoorBikeStepSensor on the host runtime, and every sample of
+ * getCadence2()/getPower() is scored against the true ride.
+ *
+ * For every profile, noise model, magnets per revolution and estimator
+ * (measured intervals, or the cadence predictor, which the sensor only
+ * uses with one magnet):
+ *  - error: mean and 95th percentile of |cadence - true cadence| (rpm),
+ *    mean |power - true power| (W), at the time of the sample;
+ *  - lag: the delay of the true cadence that fits the samples best (ms),
+ *    and the mean cadence error left at that delay.
+ *
+ * usage: estimator_bench [--csv] [--seed N] [--check]
+ *        --check fails if a clean steady ride is off by more than the
+ *        resolution of the cadence (0.5 rpm)
+ */
+
+#include "MicroBit.h"
+#include "MicroBitIndoorBikeStepSensor.h"
+#include "MicroBitCadencePredictor.h"
+#include "RideSignal.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+const uint64_t TICK_US = 10000;
+// the first samples of a ride (it starts at 1 s) hold no estimate yet
+const uint64_t SETTLE_US = 6000000;
+const int MAX_LAG_MS = 5000;
+const int LAG_STEP_MS = 50;
+
+struct Sample {
+    uint64_t time;
+    double cadence;
+    double power;
+};
+
+struct Score {
+    double cadenceError = 0;
+    double cadenceError95 = 0;
+    double powerError = 0;
+    int lagMs = 0;
+    double lagError = 0;
+    unsigned long edges = 0;
+};
+
+class Bench {
+public:
+    Bench(bool predictor, int pulses)
+        : sensor(uBit)
+    {
+        if (predictor) {
+            sensor.setCadencePredictor(&cadencePredictor);
+        }
+        sensor.setPulsesPerRevolution((uint8_t)pulses);
+        uBit.messageBus.listen(sensor.getId(), MICROBIT_INDOOR_BIKE_STEP_SENSOR_EVT_DATA_UPDATE, this, &Bench::onSample);
+        sensor.idleTick();
+    }
+
+    void ride(const RideSignal &signal);
+
+    // power of the sensor's model at a cadence (rpm)
+    double modelPower(double rpm);
+
+    std::vector<Sample> samples;
+
+private:
+    void onSample(MicroBitEvent e)
+    {
+        Sample s;
+        s.time = e.timestamp;
+        s.cadence = sensor.getCadence2() / 2.0;
+        s.power = sensor.getPower();
+        samples.push_back(s);
+    }
+
+    MicroBit uBit;
+    MicroBitIndoorBikeStepSensor sensor;
+    MicroBitCadencePredictor cadencePredictor;
+};
+
+void Bench::ride(const RideSignal &signal)
+{
+    const std::vector<uint64_t> &edges = signal.getEdges();
+    size_t next = 0;
+    for (uint64_t t = TICK_US; t <= signal.getEnd(); t += TICK_US) {
+        for (; next < edges.size() && edges[next] < t; next++) {
+            host_set_time_us(edges[next]);
+            MicroBitEvent(MICROBIT_ID_IO_P2, MICROBIT_PIN_EVT_FALL);
+        }
+        host_set_time_us(t);
+        host_idle();
+    }
+}
+
+double Bench::modelPower(double rpm)
+{
+    // speed100 = K_STEP_SPEED / interval = 30 * rpm
+    double kPower = 0.8 * (sensor.getRiderWeight() * 9.80665) / (360 * 0.95 * 100);
+    double incline = sensor.getInclineA() * sensor.getResistanceLevel10() / 10.0 + sensor.getInclineB();
+    return 30 * rpm * incline * kPower;
+}
+
+Score score(Bench &bench, const RideSignal &signal)
+{
+    Score s;
+    std::vector<double> errors;
+    double power = 0;
+    for (size_t i = 0; i < bench.samples.size(); i++) {
+        const Sample &x = bench.samples[i];
+        if (x.time < SETTLE_US || x.time >= signal.getEnd()) {
+            continue;
+        }
+        double truth = signal.getCadence(x.time);
+        errors.push_back(fabs(x.cadence - truth));
+        power += fabs(x.power - bench.modelPower(truth));
+    }
+    if (errors.empty()) {
+        return s;
+    }
+    for (size_t i = 0; i < errors.size(); i++) {
+        s.cadenceError += errors[i];
+    }
+    s.cadenceError /= errors.size();
+    s.powerError = power / errors.size();
+    std::sort(errors.begin(), errors.end());
+    s.cadenceError95 = errors[(size_t)(errors.size() * 0.95)];
+
+    s.lagError = s.cadenceError;
+    for (int lag = LAG_STEP_MS; lag <= MAX_LAG_MS; lag += LAG_STEP_MS) {
+        double e = 0;
+        int n = 0;
+        for (size_t i = 0; i < bench.samples.size(); i++) {
+            const Sample &x = bench.samples[i];
+            if (x.time >= SETTLE_US + lag * 1000ull && x.time < signal.getEnd()) {
+                e += fabs(x.cadence - signal.getCadence(x.time - lag * 1000ull));
+                n++;
+            }
+        }
+        if (n > 0 && e / n < s.lagError) {
+            s.lagError = e / n;
+            s.lagMs = lag;
+        }
+    }
+    s.edges = signal.getEdges().size();
+    return s;
+}
+
+struct Noise {
+    const char *name;
+    RideNoise noise;
+};
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    bool csv = false, check = false;
+    uint32_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--csv") == 0) {
+            csv = true;
+        } else if (strcmp(argv[i], "--check") == 0) {
+            check = true;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (uint32_t)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "estimator_bench: unknown option %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<RideProfile> profiles;
+    profiles.push_back(RideProfile::steady(90, 300));
+    profiles.push_back(RideProfile::intervals(70, 110, 30, 30, 5));
+    profiles.push_back(RideProfile::sprints(85, 125, 4));
+    profiles.push_back(RideProfile::stops(85, 40, 15, 4));
+
+    std::vector<Noise> noises(3);
+    noises[0].name = "clean";
+    noises[1].name = "jitter";
+    noises[1].noise.jitterUs = 3000;
+    noises[2].name = "switch";
+    noises[2].noise.jitterUs = 2000;
+    noises[2].noise.bounce = 0.03;
+    noises[2].noise.missed = 0.02;
+    noises[2].noise.driftPpm = 200;
+
+    if (csv) {
+        printf("profile,noise,pulses,estimator,edges,cadence_mae_rpm,cadence_p95_rpm,power_mae_w,lag_ms,lag_mae_rpm\n");
+    } else {
+        printf("%-10s %-7s %6s %-10s %10s %10s %10s %8s %10s\n"
+                , "profile", "noise", "pulses", "estimator", "MAE rpm", "p95 rpm", "MAE W", "lag ms", "at lag");
+    }
+    int failures = 0;
+    for (size_t p = 0; p < profiles.size(); p++) {
+        for (size_t n = 0; n < noises.size(); n++) {
+            for (int pulses = 1; pulses <= 2; pulses++) {
+                RideNoise noise = noises[n].noise;
+                noise.pulses = pulses;
+                RideSignal signal(profiles[p], noise, seed);
+                for (int predictor = 0; predictor <= 1; predictor++) {
+                    host_reset();
+                    Bench bench(predictor != 0, pulses);
+                    bench.ride(signal);
+                    Score s = score(bench, signal);
+                    const char *estimator = predictor ? "predicted" : "measured";
+                    if (csv) {
+                        printf("%s,%s,%d,%s,%lu,%.3f,%.3f,%.2f,%d,%.3f\n", profiles[p].name.c_str(), noises[n].name
+                                , pulses, estimator, s.edges, s.cadenceError, s.cadenceError95, s.powerError
+                                , s.lagMs, s.lagError);
+                    } else {
+                        printf("%-10s %-7s %6d %-10s %10.2f %10.2f %10.2f %8d %10.2f\n", profiles[p].name.c_str()
+                                , noises[n].name, pulses, estimator, s.cadenceError, s.cadenceError95
+                                , s.powerError, s.lagMs, s.lagError);
+                    }
+                    if (check && p == 0 && n == 0 && (s.cadenceError > 0.5 || s.powerError > 1.0)) {
+                        fprintf(stderr, "estimator_bench: clean steady ride off by %.2f rpm, %.2f W (%d pulses, %s)\n"
+                                , s.cadenceError, s.powerError, pulses, estimator);
+                        failures++;
+                    }
+                }
+            }
+        }
+    }
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,353 @@
+/*
+ * fleet_sim.cpp
+ *
+ * Fleet-scale load test: thousands of independent bikes, each the firmware
+ * MicroBitIndoorBikeStepSensor, MicroBitCadencePredictor and
+ * MicroBitIndoorBikeStepService on its own host runtime (tools/host) with
+ * one subscribed central, fed by a synthetic rider.
+ *
+ * The ride is cut into slices of virtual time. A work-stealing pool runs
+ * the slices on every core: a worker keeps advancing its own bikes and
+ * steals from the other workers when it runs out.
+ *
+ * Reported: edges, samples and Indoor Bike Data packets per wall second,
+ * p50/p99 time to process one STEP edge, and memory per bike.
+ *
+ * Checked: every bike produced one sample per second of its ride, one
+ * packet per sample, and counted every revolution its rider made.
+ *
+ * usage: fleet_sim [--bikes N] [--seconds S] [--threads N] [--slice S]
+ *                  [--tick MS] [--seed N]
+ */
+
+#include "MicroBit.h"
+#include "MicroBitIndoorBikeStepSensor.h"
+#include "MicroBitIndoorBikeStepService.h"
+#include "MicroBitBLEConnectionTable.h"
+#include "MicroBitCadencePredictor.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+    int bikes = 2000;
+    int seconds = 600;
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    int slice = 10;             // virtual seconds per task
+    int tick = 50;              // ms between idle ticks of a bike
+    uint32_t seed = 1;
+};
+
+const uint64_t START_US = 1000000;
+const Gap::Handle_t CENTRAL = 1;
+
+// edge processing time, 1 ns buckets, the last one holds the rest
+const size_t LATENCY_BUCKETS = 100000;
+
+struct WorkerStats {
+    uint64_t edges = 0;
+    uint64_t steals = 0;
+    std::vector<uint64_t> latency = std::vector<uint64_t>(LATENCY_BUCKETS, 0);
+};
+
+// a rider: cadence wanders around a preference, with a stop now and then
+class Rider {
+public:
+    Rider(uint32_t seed)
+        : rng(seed), preferred(60 + rng() % 50), rpm(preferred)
+    {
+        nextEdge = START_US + rng() % 1000000;
+    }
+
+    uint64_t next(void)
+    {
+        uint64_t t = nextEdge;
+        std::normal_distribution<double> jitter(0.0, 0.01);
+        rpm += (preferred - rpm) * 0.05 + (int)(rng() % 5) - 2;
+        rpm = std::min(130.0, std::max(40.0, rpm));
+        nextEdge += (uint64_t)(60e6 / rpm * (1.0 + jitter(rng)));
+        if (rng() % 600 == 0) {
+            // stop for 5-30 s
+            nextEdge += 5000000 + rng() % 25000000;
+        }
+        revolutions++;
+        return t;
+    }
+
+    uint64_t peek(void) const { return nextEdge; }
+
+    uint32_t revolutions = 0;
+
+private:
+    std::mt19937 rng;
+    double preferred;
+    double rpm;
+    uint64_t nextEdge;
+};
+
+class Bike {
+public:
+    Bike(uint32_t seed)
+        : sensor(uBit), connections(uBit), service(uBit, sensor, connections), rider(seed)
+    {
+        sensor.setCadencePredictor(&cadencePredictor);
+        uBit.ble->gattServer().hostOutput = std::bind(&Bike::output, this
+            , std::placeholders::_1, std::placeholders::_2, std::placeholders::_3
+            , std::placeholders::_4, std::placeholders::_5);
+        uBit.messageBus.listen(sensor.getId(), MICROBIT_INDOOR_BIKE_STEP_SENSOR_EVT_DATA_UPDATE, this, &Bike::onSample);
+        uBit.ble->gap().hostConnect(CENTRAL);
+        uBit.ble->gattServer().hostSubscribe(CENTRAL, uBit.ble->gattServer().hostFind(0x2AD2), true);
+    }
+
+    // ride up to end (us) on the calling thread
+    void advance(uint64_t end, uint64_t tick, WorkerStats &stats);
+
+    MicroBit uBit;
+    MicroBitIndoorBikeStepSensor sensor;
+    MicroBitCadencePredictor cadencePredictor;
+    MicroBitBLEConnectionTable connections;
+    MicroBitIndoorBikeStepService service;
+    Rider rider;
+    uint64_t time = START_US;
+    uint32_t samples = 0;
+    uint32_t packets = 0;
+
+private:
+    void onSample(MicroBitEvent) { samples++; }
+
+    void output(const char *kind, Gap::Handle_t, uint16_t uuid, const uint8_t *, uint16_t)
+    {
+        if (uuid == 0x2AD2) {
+            packets++;
+        }
+    }
+};
+
+void Bike::advance(uint64_t end, uint64_t tick, WorkerStats &stats)
+{
+    // the runtime of this bike runs on this thread for now
+    EventModel::defaultEventBus = &uBit.messageBus;
+    while (time < end) {
+        uint64_t nextTick = (time / tick + 1) * tick;
+        if (rider.peek() < nextTick && rider.peek() < end) {
+            host_set_time_us(rider.next());
+            Clock::time_point t0 = Clock::now();
+            MicroBitEvent(MICROBIT_ID_IO_P2, MICROBIT_PIN_EVT_FALL);
+            uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count();
+            stats.latency[std::min<uint64_t>(ns, LATENCY_BUCKETS - 1)]++;
+            stats.edges++;
+            time = host_time_us;
+        } else {
+            time = std::min(nextTick, end);
+            host_set_time_us(time);
+            sensor.idleTick();
+        }
+    }
+}
+
+// work-stealing pool: the owner takes from the back of its deque, thieves from the front
+class Pool {
+public:
+    explicit Pool(int workers) : queues(workers) {}
+
+    void push(int worker, size_t task)
+    {
+        std::lock_guard<std::mutex> lock(queues[worker].mutex);
+        queues[worker].tasks.push_back(task);
+    }
+
+    // run(task, worker) returns true if the task has more to do
+    template <typename Run>
+    void run(size_t tasks, std::vector<WorkerStats> &stats, Run run)
+    {
+        std::atomic<size_t> remaining(tasks);
+        std::vector<std::thread> threads;
+        for (size_t w = 0; w < queues.size(); w++) {
+            threads.push_back(std::thread([this, w, &remaining, &stats, &run]() {
+                size_t task;
+                while (remaining.load() > 0) {
+                    if (!pop(w, &task)) {
+                        if (!steal(w, &task)) {
+                            std::this_thread::yield();
+                            continue;
+                        }
+                        stats[w].steals++;
+                    }
+                    if (run(task, stats[w])) {
+                        push(w, task);
+                    } else {
+                        remaining--;
+                    }
+                }
+            }));
+        }
+        for (size_t w = 0; w < threads.size(); w++) {
+            threads[w].join();
+        }
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    bool pop(size_t worker, size_t *task)
+    {
+        std::lock_guard<std::mutex> lock(queues[worker].mutex);
+        if (queues[worker].tasks.empty()) {
+            return false;
+        }
+        *task = queues[worker].tasks.back();
+        queues[worker].tasks.pop_back();
+        return true;
+    }
+
+    bool steal(size_t thief, size_t *task)
+    {
+        for (size_t i = 1; i < queues.size(); i++) {
+            Queue &q = queues[(thief + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (!q.tasks.empty()) {
+                *task = q.tasks.front();
+                q.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<Queue> queues;
+};
+
+// resident memory (bytes), 0 if unknown
+long residentBytes(void)
+{
+    FILE *fp = fopen("/proc/self/statm", "r");
+    long pages = 0, resident = 0;
+    if (fp == NULL) {
+        return 0;
+    }
+    if (fscanf(fp, "%ld %ld", &pages, &resident) != 2) {
+        resident = 0;
+    }
+    fclose(fp);
+    return resident * 4096;
+}
+
+uint64_t percentile(const std::vector<uint64_t> &histogram, uint64_t count, double p)
+{
+    uint64_t rank = (uint64_t)(count * p), seen = 0;
+    for (size_t i = 0; i < histogram.size(); i++) {
+        seen += histogram[i];
+        if (seen > rank) {
+            return i;
+        }
+    }
+    return histogram.size() - 1;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options o;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--bikes") == 0) {
+            o.bikes = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--seconds") == 0) {
+            o.seconds = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            o.threads = std::max(1, atoi(argv[i + 1]));
+        } else if (strcmp(argv[i], "--slice") == 0) {
+            o.slice = std::max(1, atoi(argv[i + 1]));
+        } else if (strcmp(argv[i], "--tick") == 0) {
+            o.tick = std::max(1, atoi(argv[i + 1]));
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            o.seed = (uint32_t)atoi(argv[i + 1]);
+        } else {
+            fprintf(stderr, "fleet_sim: unknown option %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // the runtimes are made on this thread, then ridden on the workers
+    long before = residentBytes();
+    std::vector<Bike *> bikes;
+    for (int i = 0; i < o.bikes; i++) {
+        bikes.push_back(new Bike(o.seed * 7919u + i));
+    }
+    long after = residentBytes();
+
+    Pool pool(o.threads);
+    for (int i = 0; i < o.bikes; i++) {
+        pool.push(i % o.threads, i);
+    }
+    const uint64_t end = START_US + (uint64_t)o.seconds * 1000000;
+    const uint64_t slice = (uint64_t)o.slice * 1000000;
+    const uint64_t tick = (uint64_t)o.tick * 1000;
+    std::vector<WorkerStats> stats(o.threads);
+    Clock::time_point t0 = Clock::now();
+    pool.run(bikes.size(), stats, [&](size_t task, WorkerStats &s) {
+        Bike *b = bikes[task];
+        b->advance(std::min(end, b->time + slice), tick, s);
+        return b->time < end;
+    });
+    double wall = std::chrono::duration<double>(Clock::now() - t0).count();
+
+    // totals and checks
+    int failures = 0;
+    uint64_t edges = 0, steals = 0, samples = 0, packets = 0;
+    std::vector<uint64_t> latency(LATENCY_BUCKETS, 0);
+    for (size_t w = 0; w < stats.size(); w++) {
+        edges += stats[w].edges;
+        steals += stats[w].steals;
+        for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+            latency[i] += stats[w].latency[i];
+        }
+    }
+    for (size_t i = 0; i < bikes.size(); i++) {
+        Bike *b = bikes[i];
+        samples += b->samples;
+        packets += b->packets;
+        // one update at the first tick, then one per second; the edges after the last one are not counted yet
+        if (b->samples < (uint32_t)o.seconds || b->samples > (uint32_t)o.seconds + 1 || b->packets != b->samples
+                || b->sensor.getCrankRevolutions() + 3 < b->rider.revolutions) {
+            if (failures++ < 10) {
+                fprintf(stderr, "fleet_sim: bike %zu: %u samples, %u packets, %u of %u revolutions\n", i
+                    , b->samples, b->packets, b->sensor.getCrankRevolutions(), b->rider.revolutions);
+            }
+        }
+    }
+
+    printf("%d bikes x %d s on %d threads: %.2f s wall (%.0fx real time per bike)\n"
+            , o.bikes, o.seconds, o.threads, wall, (double)o.seconds * o.bikes / wall);
+    printf("  edges   %10llu  %12.0f /s\n", (unsigned long long)edges, edges / wall);
+    printf("  samples %10llu  %12.0f /s\n", (unsigned long long)samples, samples / wall);
+    printf("  packets %10llu  %12.0f /s (Indoor Bike Data)\n", (unsigned long long)packets, packets / wall);
+    printf("  edge processing p50 %llu ns, p99 %llu ns; %llu steals\n"
+            , (unsigned long long)percentile(latency, edges, 0.50)
+            , (unsigned long long)percentile(latency, edges, 0.99), (unsigned long long)steals);
+    printf("  memory per bike: %zu bytes of objects (sensor %zu), %ld bytes resident\n"
+            , sizeof(Bike), sizeof(MicroBitIndoorBikeStepSensor), o.bikes ? (after - before) / o.bikes : 0);
+
+    for (size_t i = 0; i < bikes.size(); i++) {
+        delete bikes[i];
+    }
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,368 @@
+/*
+ * ftms_golden.cpp
+ *
+ * Golden-output regression test of the FTMS packets: the firmware
+ * MicroBitIndoorBikeStepSensor and MicroBitIndoorBikeStepService (and the
+ * CSC and CPS services a trace adds) on the host runtime (tools/host)
+ * replay a trace of STEP edges and central actions
+ * under a virtual clock, and every value write, notification and
+ * indication they emit must match the golden file byte for byte.
+ * The fitness machine is the one the firmware is built for
+ * (MICROBIT_FTMS_MACHINE): ftms_golden_rower and ftms_golden_cross_trainer
+ * replay the traces of corpus/rower and corpus/cross_trainer.
+ *
+ *  - The idle components run every millisecond, as the fiber scheduler does.
+ *  - Indications are confirmed by the central at the next millisecond.
+ *
+ * Trace (<name>.trace), one action per line, times in microseconds;
+ * '#' starts a comment, actions of the same time run in file order:
+ *
+ *   <t> service <uuid>                    add the CSC (1816) or CPS (1818) service
+ *   <t> connect <conn>
+ *   <t> disconnect <conn>
+ *   <t> subscribe <conn> <uuid>           CCCD on (uuid in hex, e.g. 2AD2)
+ *   <t> unsubscribe <conn> <uuid>
+ *   <t> write <conn> <uuid> <byte>...     e.g. 0 write 1 2AD9 08 01
+ *   <t> step                              one STEP edge
+ *   <t> steps <interval> <count>          count edges from t on
+ *   <t> resistance <level10>
+ *   <t> pulses <n>
+ *   <t> broadcast <mode>                  live data in the advertising payload (0: off, 1, 2)
+ *   <t> end                               run the clock up to t
+ *
+ * Golden (<name>.golden), one line per emitted packet:
+ *
+ *   <t> value|notify|indicate <conn> <uuid> <byte>...
+ *   <t> error <conn> <uuid> <code>        ATT error of a refused write
+ *   <t> dropped <conn> <reason>           the firmware dropped the link
+ *   <t> advertise <byte>...               new live data (Manufacturer Specific Data) in the payload,
+ *                                         no bytes when it left the payload
+ *
+ * usage: ftms_golden [--update] <name>.trace...
+ *        --update writes the golden files instead of comparing
+ */
+
+#include "MicroBit.h"
+#include "MicroBitIndoorBikeStepSensor.h"
+#include "MicroBitIndoorBikeStepService.h"
+#include "MicroBitCyclingSpeedCadenceService.h"
+#include "MicroBitCyclingPowerService.h"
+#include "MicroBitBLEConnectionTable.h"
+#include "MicroBitCadencePredictor.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+const uint64_t TICK_US = 1000;
+
+struct Action {
+    uint64_t time;
+    size_t order;           // line order within the same time
+    std::string verb;
+    std::vector<unsigned long> args;
+    int line;
+};
+
+bool operator<(const Action &a, const Action &b)
+{
+    return a.time < b.time || (a.time == b.time && a.order < b.order);
+}
+
+bool parseTrace(const char *path, std::vector<Action> &actions)
+{
+    std::ifstream in(path);
+    if (!in) {
+        fprintf(stderr, "ftms_golden: cannot open %s\n", path);
+        return false;
+    }
+    std::string text;
+    for (int line = 1; std::getline(in, text); line++) {
+        text = text.substr(0, text.find('#'));
+        std::istringstream words(text);
+        Action a;
+        if (!(words >> a.time)) {
+            continue;
+        }
+        a.line = line;
+        a.order = actions.size();
+        if (!(words >> a.verb)) {
+            fprintf(stderr, "%s:%d: no action\n", path, line);
+            return false;
+        }
+        // connections and counts are decimal, UUIDs and bytes hex
+        bool hex = (a.verb == "subscribe" || a.verb == "unsubscribe" || a.verb == "write");
+        std::string word;
+        while (words >> word) {
+            char *end;
+            unsigned long v = strtoul(word.c_str(), &end, ((hex && !a.args.empty()) || a.verb == "service") ? 16 : 10);
+            if (*end != '\0') {
+                fprintf(stderr, "%s:%d: bad number %s\n", path, line, word.c_str());
+                return false;
+            }
+            a.args.push_back(v);
+        }
+        if (a.verb == "steps") {
+            if (a.args.size() != 2) {
+                fprintf(stderr, "%s:%d: steps <interval> <count>\n", path, line);
+                return false;
+            }
+            Action edge = a;
+            edge.verb = "step";
+            edge.args.clear();
+            for (unsigned long i = 0; i < a.args[1]; i++) {
+                edge.time = a.time + i * a.args[0];
+                actions.push_back(edge);
+            }
+            continue;
+        }
+        actions.push_back(a);
+    }
+    std::stable_sort(actions.begin(), actions.end());
+    return true;
+}
+
+// one replay of a trace on a fresh runtime
+class Replay {
+public:
+    Replay()
+        : sensor(uBit), connections(uBit), csc(NULL), cps(NULL), confirms(0)
+    {
+        // the values the service writes while it is made are part of the output
+        uBit.ble->gattServer().hostOutput = std::bind(&Replay::output, this
+            , std::placeholders::_1, std::placeholders::_2, std::placeholders::_3
+            , std::placeholders::_4, std::placeholders::_5);
+        uBit.ble->gap().hostDisconnected = std::bind(&Replay::dropped, this, std::placeholders::_1, std::placeholders::_2);
+#if MICROBIT_CADENCE_PREDICTOR_ENABLED
+        sensor.setCadencePredictor(&cadencePredictor);
+#endif
+        service = new MicroBitIndoorBikeStepService(uBit, sensor, connections);
+        sensor.idleTick();
+    }
+
+    ~Replay()
+    {
+        delete cps;
+        delete csc;
+        delete service;
+    }
+
+    bool run(const char *path, const std::vector<Action> &actions);
+
+    std::string result;
+
+private:
+    void output(const char *kind, Gap::Handle_t connection, uint16_t uuid, const uint8_t *data, uint16_t len);
+    void dropped(Gap::Handle_t connection, int reason);
+    void advertised(void);
+    bool apply(const char *path, const Action &a);
+    void tick(uint64_t time);
+
+    MicroBit uBit;
+    MicroBitIndoorBikeStepSensor sensor;
+    MicroBitCadencePredictor cadencePredictor;
+    MicroBitBLEConnectionTable connections;
+    MicroBitIndoorBikeStepService *service;
+    MicroBitCyclingSpeedCadenceService *csc;
+    MicroBitCyclingPowerService *cps;
+    int confirms;
+    std::vector<uint8_t> liveData;
+};
+
+void Replay::output(const char *kind, Gap::Handle_t connection, uint16_t uuid, const uint8_t *data, uint16_t len)
+{
+    char text[32];
+    snprintf(text, sizeof(text), "%llu %s %u %04X", (unsigned long long)system_timer_current_time_us(), kind, connection, uuid);
+    result += text;
+    for (int i = 0; i < len; i++) {
+        snprintf(text, sizeof(text), " %02X", data[i]);
+        result += text;
+    }
+    result += '\n';
+    if (strcmp(kind, "indicate") == 0) {
+        confirms++;
+    }
+}
+
+void Replay::dropped(Gap::Handle_t connection, int reason)
+{
+    char text[48];
+    snprintf(text, sizeof(text), "%llu dropped %u %02X\n", (unsigned long long)system_timer_current_time_us(), connection, reason);
+    result += text;
+    uBit.ble->gattServer().hostDisconnect(connection);
+}
+
+// the Manufacturer Specific Data of the advertising payload, when it changed
+void Replay::advertised(void)
+{
+    const GapAdvertisingData &payload = uBit.ble->gap().getAdvertisingPayload();
+    const uint8_t *p = payload.getPayload();
+    std::vector<uint8_t> data;
+    for (size_t i = 0; i + 1 < payload.getPayloadLen(); i += p[i] + 1) {
+        if (p[i + 1] == GapAdvertisingData::MANUFACTURER_SPECIFIC_DATA) {
+            data.assign(p + i + 2, p + i + 1 + p[i]);
+        }
+    }
+    if (data == liveData) {
+        return;
+    }
+    liveData = data;
+    char text[32];
+    snprintf(text, sizeof(text), "%llu advertise", (unsigned long long)system_timer_current_time_us());
+    result += text;
+    for (size_t i = 0; i < data.size(); i++) {
+        snprintf(text, sizeof(text), " %02X", data[i]);
+        result += text;
+    }
+    result += '\n';
+}
+
+void Replay::tick(uint64_t time)
+{
+    host_set_time_us(time);
+    for (; confirms > 0; confirms--) {
+        uBit.ble->gattServer().hostConfirm(uBit.ble->gattServer().hostFind(0x2AD9));
+    }
+    host_idle();
+    advertised();
+}
+
+bool Replay::apply(const char *path, const Action &a)
+{
+    GattServer &server = uBit.ble->gattServer();
+    size_t n = a.args.size();
+    if (a.verb == "service" && n == 1 && a.args[0] == 0x1816 && csc == NULL) {
+        csc = new MicroBitCyclingSpeedCadenceService(uBit, sensor, connections);
+    } else if (a.verb == "service" && n == 1 && a.args[0] == 0x1818 && cps == NULL) {
+        cps = new MicroBitCyclingPowerService(uBit, sensor, connections);
+    } else if (a.verb == "connect" && n == 1) {
+        uBit.ble->gap().hostConnect((Gap::Handle_t)a.args[0]);
+    } else if (a.verb == "disconnect" && n == 1) {
+        server.hostDisconnect((Gap::Handle_t)a.args[0]);
+        uBit.ble->gap().hostDisconnect((Gap::Handle_t)a.args[0]);
+    } else if ((a.verb == "subscribe" || a.verb == "unsubscribe") && n == 2 && server.hostFind(a.args[1]) != 0) {
+        server.hostSubscribe((Gap::Handle_t)a.args[0], server.hostFind(a.args[1]), a.verb == "subscribe");
+    } else if (a.verb == "write" && n >= 2 && server.hostFind(a.args[1]) != 0) {
+        std::vector<uint8_t> data(a.args.begin() + 2, a.args.end());
+        uBit.ble->hostWrite((Gap::Handle_t)a.args[0], server.hostFind(a.args[1])
+            , data.empty() ? NULL : &data[0], (uint16_t)data.size());
+    } else if (a.verb == "step" && n == 0) {
+        MicroBitEvent(MICROBIT_ID_IO_P2, MICROBIT_PIN_EVT_FALL);
+    } else if (a.verb == "resistance" && n == 1) {
+        sensor.setResistanceLevel10((uint8_t)a.args[0]);
+    } else if (a.verb == "pulses" && n == 1) {
+        sensor.setPulsesPerRevolution((uint8_t)a.args[0]);
+    } else if (a.verb == "broadcast" && n == 1 && a.args[0] <= INDOOR_BIKE_BROADCAST_ONLY) {
+        service->setBroadcastMode((MicroBitIndoorBikeBroadcastMode)a.args[0]);
+    } else if (a.verb != "end" || n != 0) {
+        fprintf(stderr, "%s:%d: bad action %s\n", path, a.line, a.verb.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool Replay::run(const char *path, const std::vector<Action> &actions)
+{
+    uint64_t now = 0;
+    for (size_t i = 0; i < actions.size(); i++) {
+        const Action &a = actions[i];
+        // the scheduler runs up to the action
+        for (uint64_t t = (now / TICK_US + 1) * TICK_US; t <= a.time; t += TICK_US) {
+            tick(t);
+        }
+        now = a.time;
+        host_set_time_us(now);
+        if (!apply(path, a)) {
+            return false;
+        }
+        advertised();
+    }
+    return true;
+}
+
+std::string goldenPath(const std::string &trace)
+{
+    std::string base = trace;
+    if (base.size() > 6 && base.compare(base.size() - 6, 6, ".trace") == 0) {
+        base.resize(base.size() - 6);
+    }
+    return base + ".golden";
+}
+
+// @return false if the golden file differs from result
+bool compare(const std::string &path, const std::string &result)
+{
+    std::ifstream in(path.c_str());
+    if (!in) {
+        fprintf(stderr, "ftms_golden: cannot open %s (run with --update)\n", path.c_str());
+        return false;
+    }
+    std::istringstream got(result);
+    std::string expected, actual;
+    for (int line = 1; ; line++) {
+        bool e = (bool)std::getline(in, expected);
+        bool g = (bool)std::getline(got, actual);
+        if (!e && !g) {
+            return true;
+        }
+        if (!e || !g || expected != actual) {
+            fprintf(stderr, "%s:%d: differs\n  expected: %s\n  actual:   %s\n", path.c_str(), line
+                , e ? expected.c_str() : "(end)", g ? actual.c_str() : "(end)");
+            return false;
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    bool update = false;
+    int failures = 0;
+    int traces = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--update") == 0) {
+            update = true;
+            continue;
+        }
+        traces++;
+        std::vector<Action> actions;
+        if (!parseTrace(argv[i], actions)) {
+            failures++;
+            continue;
+        }
+        host_reset();
+        Replay replay;
+        if (!replay.run(argv[i], actions)) {
+            failures++;
+            continue;
+        }
+        std::string golden = goldenPath(argv[i]);
+        if (update) {
+            std::ofstream out(golden.c_str());
+            out << replay.result;
+            if (!out) {
+                fprintf(stderr, "ftms_golden: cannot write %s\n", golden.c_str());
+                failures++;
+            }
+        } else if (!compare(golden, replay.result)) {
+            failures++;
+        } else {
+            printf("%s: ok\n", argv[i]);
+        }
+    }
+    if (traces == 0) {
+        fprintf(stderr, "usage: ftms_golden [--update] <name>.trace...\n");
+        return EXIT_FAILURE;
+    }
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
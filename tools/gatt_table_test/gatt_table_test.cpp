@@ -0,0 +1,175 @@
+/*
+ * gatt_table_test.cpp
+ *
+ * Size of the GATT table of the SoftDevice (MICROBIT_SD_GATT_TABLE_SIZE in
+ * mbed_app.json) against the services of the BLE role of main.cpp, made on
+ * the host runtime (tools/host), which estimates the bytes of every
+ * attribute.
+ *
+ * The table of the baseline (0x340) held the services of the runtime and
+ * the first FTMS service; the services added since must fit on top of it:
+ *
+ *   0x340 - first FTMS service + services of main.cpp <= table size <= 0x700
+ *
+ * 0x700 is the room between the SoftDevice data (MICROBIT_SD_GATT_TABLE_START,
+ * 0x20001900) and the end of its RAM (0x20002000): the part of it the table
+ * does not take goes to the heap. A service the table has no room for must
+ * stop the device with MICROBIT_BLE_PANIC_GATT_TABLE_FULL.
+ *
+ * usage: gatt_table_test <mbed_app.json>
+ */
+
+#include "MicroBit.h"
+#include "MicroBitIndoorBikeStepSensor.h"
+#include "MicroBitIndoorBikeStepService.h"
+#include "MicroBitCyclingSpeedCadenceService.h"
+#include "MicroBitCyclingPowerService.h"
+#include "MicroBitBLEConnectionTable.h"
+#include "MicroBitRideLog.h"
+#include "MicroBitRideLogRecorder.h"
+#include "MicroBitRideLogService.h"
+#include "MicroBitPowerAnalytics.h"
+#include "MicroBitPowerPeaks.h"
+#include "MicroBitStepHealth.h"
+#include "MicroBitDiagnosticsService.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+const unsigned BASELINE_TABLE_SIZE = 0x340;
+const unsigned MAX_TABLE_SIZE = 0x700;
+
+int failures = 0;
+
+void expect(bool cond, const char *what, unsigned value)
+{
+    if (!cond && failures++ < 16) {
+        fprintf(stderr, "gatt_table_test: %s (0x%X)\n", what, value);
+    }
+}
+
+// Flash of the ride log in RAM: a write can only clear bits
+class RamFlash : public MicroBitConfigFlash {
+public:
+    explicit RamFlash(int pages) : words(pages * MICROBIT_CONFIG_STORE_PAGE_WORDS, 0xFFFFFFFFu) {}
+
+    uint32_t *page(int index) override { return &words[index * MICROBIT_CONFIG_STORE_PAGE_WORDS]; }
+
+    int write(uint32_t *address, const uint32_t *data, int n) override
+    {
+        for (int i = 0; i < n; i++) {
+            address[i] &= data[i];
+        }
+        return MICROBIT_CONFIG_STORE_OK;
+    }
+
+    int erase(uint32_t *page) override
+    {
+        std::fill(page, page + MICROBIT_CONFIG_STORE_PAGE_WORDS, 0xFFFFFFFFu);
+        return MICROBIT_CONFIG_STORE_OK;
+    }
+
+private:
+    std::vector<uint32_t> words;
+};
+
+// MICROBIT_SD_GATT_TABLE_SIZE of the macros of mbed_app.json, 0 if there is none
+unsigned readTableSize(const char *path)
+{
+    std::ifstream in(path);
+    std::stringstream text;
+    text << in.rdbuf();
+    const std::string KEY = "MICROBIT_SD_GATT_TABLE_SIZE=";
+    size_t at = text.str().find(KEY);
+    if (at == std::string::npos) {
+        return 0;
+    }
+    return (unsigned)strtoul(text.str().c_str() + at + KEY.size(), NULL, 0);
+}
+
+// the FTMS service of the baseline: Indoor Bike Data, Control Point, Feature, Status, Training Status
+unsigned baselineFtmsSize()
+{
+    GattServer server;
+    uint8_t buffer[20];
+    GattCharacteristic data(UUID(0x2AD2), buffer, 0, 2+2+2+2, GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
+    GattCharacteristic controlPoint(UUID(0x2AD9), buffer, 0, 1+18
+        , GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE | GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_INDICATE);
+    GattCharacteristic feature(UUID(0x2ACC), buffer, 0, 4+4, GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ);
+    GattCharacteristic status(UUID(0x2ADA), buffer, 0, 1, GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
+    GattCharacteristic trainingStatus(UUID(0x2AD3), buffer, 0, 1+1
+        , GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ | GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
+    GattCharacteristic *characteristics[] = { &data, &controlPoint, &feature, &status, &trainingStatus };
+    GattService service(UUID(0x1826), characteristics, sizeof(characteristics) / sizeof(GattCharacteristic *));
+    server.hostAddService(service);
+    return server.hostTableUsed();
+}
+
+// makes the services of the BLE role in a table of tableSize bytes (0: not limited);
+// returns the bytes they take, and the panic code
+unsigned makeServices(uint16_t tableSize, int &panicCode)
+{
+    host_reset();
+    MicroBit uBit;
+    uBit.ble->gattServer().hostSetTableSize(tableSize);
+    RamFlash flash(MICROBIT_RIDE_LOG_PAGES);
+    MicroBitRideLog rideLog(flash, MICROBIT_RIDE_LOG_PAGES);
+    rideLog.begin();
+    MicroBitRideLogRecorder recorder(rideLog);
+    MicroBitIndoorBikeStepSensor sensor(uBit);
+    MicroBitPowerAnalytics powerAnalytics;
+    MicroBitPowerPeaks powerPeaks;
+    MicroBitStepHealth stepHealth;
+
+    MicroBitBLEConnectionTable connections(uBit);
+    MicroBitIndoorBikeStepService service(uBit, sensor, connections);
+    MicroBitCyclingSpeedCadenceService cscService(uBit, sensor, connections);
+    MicroBitCyclingPowerService cpsService(uBit, sensor, connections);
+    MicroBitRideLogService rideLogService(uBit, recorder, connections);
+    MicroBitDiagnosticsService diagnosticsService(uBit, sensor, powerAnalytics, powerPeaks, stepHealth, connections);
+
+    panicCode = uBit.panicCode;
+    return uBit.ble->gattServer().hostTableUsed();
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: gatt_table_test <mbed_app.json>\n");
+        return EXIT_FAILURE;
+    }
+    unsigned tableSize = readTableSize(argv[1]);
+    expect(tableSize != 0, "MICROBIT_SD_GATT_TABLE_SIZE in mbed_app.json", tableSize);
+
+    int panicCode = 0;
+    unsigned services = makeServices(0, panicCode);
+    unsigned needed = BASELINE_TABLE_SIZE - baselineFtmsSize() + services;
+    printf("gatt_table_test: services 0x%X bytes, table 0x%X of 0x%X\n", services, needed, tableSize);
+    expect(needed <= tableSize, "the services do not fit MICROBIT_SD_GATT_TABLE_SIZE", needed);
+    expect(tableSize <= MAX_TABLE_SIZE, "MICROBIT_SD_GATT_TABLE_SIZE past the RAM of the SoftDevice", tableSize);
+
+    // exactly enough room, then one word too little
+    makeServices((uint16_t)services, panicCode);
+    expect(panicCode == 0, "panic with room for the services", (unsigned)panicCode);
+    makeServices((uint16_t)(services - 4), panicCode);
+    expect(panicCode == MICROBIT_BLE_PANIC_GATT_TABLE_FULL, "no panic without room for the services", (unsigned)panicCode);
+
+    if (failures) {
+        fprintf(stderr, "gatt_table_test: %d failure(s)\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("gatt_table_test: ok\n");
+    return EXIT_SUCCESS;
+}
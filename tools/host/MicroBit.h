@@ -0,0 +1,722 @@
+/*
+ * MicroBit.h
+ *
+ * Host runtime for building the firmware sources on Linux: the parts of
+ * microbit-dal and BLE_API the custom sources use, driven by a virtual
+ * clock instead of the nRF51.
+ *
+ *  - system_timer_current_time_us() and the clock of the custom components
+ *    (MicroBitHostClock) return the virtual clock, set with host_set_time_us().
+ *  - The clock, the idle components and EventModel::defaultEventBus belong
+ *    to the calling thread, so threads can each run their own runtimes.
+ *  - The message bus delivers every event at once to its listeners, and
+ *    host_idle() runs the idle components, as the fiber scheduler does.
+ *  - The GATT server hands every value write and every notification or
+ *    indication to GattServer::hostOutput, and only sends to a connection
+ *    that enabled updates with hostSubscribe().
+ *  - Centrals connect, write and confirm indications with the host*()
+ *    members of Gap, BLEDevice and GattServer. A write the characteristic's
+ *    write authorization refuses goes to hostOutput as an "error" with the
+ *    ATT error code, and a link the firmware drops goes to
+ *    Gap::hostDisconnected.
+ *
+ *  - Pins read the analog value and the accelerometer the acceleration the
+ *    host set, radio datagrams go to MicroBitRadioDatagram::hostOutput and
+ *    the bytes sent on the serial port to MicroBitSerial::hostOutput.
+ *
+ *  - Gap keeps the advertising payload and the scan response as the
+ *    BLE_API of the micro:bit builds them (at most 31 bytes each).
+ *    startAdvertising() refuses scannable and non-connectable advertising
+ *    faster than every 100 ms with BLE_ERROR_PARAM_OUT_OF_RANGE, as
+ *    nRF5xGap does, and hostScannable() tells whether a scanner gets the
+ *    scan response.
+ *  - The GATT server estimates the bytes every service takes in the
+ *    attribute table of the SoftDevice, and refuses a service with
+ *    BLE_ERROR_NO_MEM past the size set with hostSetTableSize().
+ *    MicroBit::panic() keeps the code in panicCode.
+ *
+ * Display and flash are not simulated.
+ */
+
+#ifndef HOST_MICROBIT_H
+#define HOST_MICROBIT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <functional>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+#define MICROBIT_OK 0
+#define MICROBIT_INVALID_PARAMETER -1001
+#define MICROBIT_BUSY -1004
+#define MICROBIT_NO_RESOURCES -1005
+
+#ifndef MICROBIT_BLE_ENABLED
+#define MICROBIT_BLE_ENABLED 1
+#endif
+
+#define MICROBIT_ID_ANY 0
+#define MICROBIT_EVT_ANY 0
+#define MICROBIT_ID_BUTTON_A 1
+#define MICROBIT_ID_BUTTON_B 2
+#define MICROBIT_ID_IO_P0 7
+#define MICROBIT_ID_IO_P1 8
+#define MICROBIT_ID_IO_P2 9
+#define MICROBIT_ID_BUTTON_AB 26
+#define MICROBIT_ID_RADIO 29
+#define MICROBIT_ID_SERIAL 32
+
+#define MICROBIT_BUTTON_EVT_CLICK 3
+#define MICROBIT_BUTTON_EVT_LONG_CLICK 4
+#define MICROBIT_PIN_EVT_RISE 2
+#define MICROBIT_PIN_EVT_FALL 3
+#define MICROBIT_PIN_EVENT_ON_EDGE 1
+#define MICROBIT_RADIO_EVT_DATAGRAM 1
+#define MICROBIT_RADIO_MAX_PACKET_SIZE 32
+
+#define MESSAGE_BUS_LISTENER_IMMEDIATE 0x10
+#define MESSAGE_BUS_LISTENER_QUEUE_IF_BUSY 0x20
+#define MESSAGE_BUS_LISTENER_DROP_IF_BUSY 0x40
+
+#define MICROBIT_COMPONENT_RUNNING 0x01
+
+// virtual clock of the calling thread
+extern thread_local uint64_t host_time_us;
+uint64_t system_timer_current_time_us();
+unsigned long system_timer_current_time();
+void host_set_time_us(uint64_t time);
+
+// clock of the custom components (MicroBitCustomClock.h), read inline
+class MicroBitHostClock
+{
+public:
+    static inline uint64_t currentTimeUs(void) { return host_time_us; }
+};
+#define MICROBIT_CUSTOM_CLOCK MicroBitHostClock
+
+inline void __disable_irq() {}
+inline void __enable_irq() {}
+
+enum MicroBitEventLaunchMode { CREATE_ONLY, CREATE_AND_FIRE };
+
+class MicroBitEvent
+{
+public:
+    uint16_t source;
+    uint16_t value;
+    uint64_t timestamp;
+
+    MicroBitEvent(uint16_t source, uint16_t value, MicroBitEventLaunchMode mode = CREATE_AND_FIRE);
+    MicroBitEvent();
+    void fire();
+};
+
+class MicroBitComponent
+{
+public:
+    uint16_t id;
+    uint8_t status;
+
+    MicroBitComponent() : id(0), status(0) {}
+    virtual ~MicroBitComponent() {}
+    virtual void systemTick() {}
+    virtual void idleTick() {}
+};
+
+// idle components, run by host_idle()
+int fiber_add_idle_component(MicroBitComponent *component);
+int fiber_remove_idle_component(MicroBitComponent *component);
+void host_idle();
+// forget the idle components and restart the clock, before a new runtime is made
+void host_reset();
+
+inline void fiber_sleep(unsigned long) {}
+inline void schedule() {}
+
+class EventModel
+{
+public:
+    static thread_local EventModel *defaultEventBus;
+
+    virtual ~EventModel() {}
+
+    // every listener runs at once, whatever its flags
+    virtual int send(MicroBitEvent evt);
+
+    template <typename T>
+    int listen(uint16_t id, uint16_t value, T *object, void (T::*handler)(MicroBitEvent), uint16_t flags = 0)
+    {
+        Listener l;
+        l.id = id;
+        l.value = value;
+        l.object = object;
+        l.handler = std::bind(handler, object, std::placeholders::_1);
+        listeners.push_back(l);
+        return MICROBIT_OK;
+    }
+
+    int listen(uint16_t id, uint16_t value, void (*handler)(MicroBitEvent), uint16_t flags = 0)
+    {
+        Listener l;
+        l.id = id;
+        l.value = value;
+        l.object = NULL;
+        l.handler = handler;
+        listeners.push_back(l);
+        return MICROBIT_OK;
+    }
+
+    template <typename T>
+    int ignore(uint16_t id, uint16_t value, T *object, void (T::*handler)(MicroBitEvent))
+    {
+        for (size_t i = 0; i < listeners.size(); i++) {
+            if (listeners[i].id == id && listeners[i].value == value && listeners[i].object == object) {
+                listeners.erase(listeners.begin() + i);
+                return MICROBIT_OK;
+            }
+        }
+        return MICROBIT_INVALID_PARAMETER;
+    }
+
+private:
+    struct Listener {
+        uint16_t id;
+        uint16_t value;
+        void *object;
+        std::function<void(MicroBitEvent)> handler;
+    };
+    std::vector<Listener> listeners;
+};
+
+class MicroBitMessageBus : public EventModel {};
+
+class ManagedString
+{
+public:
+    ManagedString(const char *s) : s(s) {}
+    const char *toCharArray() const { return s; }
+    int length() const { return (int)strlen(s); }
+
+private:
+    const char *s;
+};
+
+class MicroBitPin
+{
+public:
+    int hostAnalogValue = 0;
+
+    int eventOn(int) { return MICROBIT_OK; }
+    int getDigitalValue() { return 1; }
+    int getAnalogValue() { return hostAnalogValue; }
+};
+
+class MicroBitIO
+{
+public:
+    MicroBitPin P0, P1, P2;
+};
+
+class MicroBitAccelerometer
+{
+public:
+    int hostX = 0, hostY = 0, hostZ = 0;
+
+    int getX() { return hostX; }
+    int getY() { return hostY; }
+    int getZ() { return hostZ; }
+};
+
+class MicroBitRadioDatagram
+{
+public:
+    std::function<void(const uint8_t *data, int len)> hostOutput;
+
+    int send(uint8_t *data, int len)
+    {
+        if (hostOutput) {
+            hostOutput(data, len);
+        }
+        return MICROBIT_OK;
+    }
+};
+
+class MicroBitRadio
+{
+public:
+    MicroBitRadioDatagram datagram;
+
+    int enable() { return MICROBIT_OK; }
+    int disable() { return MICROBIT_OK; }
+    int setGroup(uint8_t) { return MICROBIT_OK; }
+    int setTransmitPower(int) { return MICROBIT_OK; }
+};
+
+class MicroBitDisplay
+{
+public:
+    void print(int) {}
+    void print(char) {}
+    void scroll(const char *) {}
+    void clear() {}
+};
+
+enum MicroBitSerialMode { ASYNC, SYNC_SPINWAIT, SYNC_SLEEP };
+
+// swallows everything: the telemetry stream is not part of the simulation
+class MicroBitSerial
+{
+public:
+    std::function<void(const uint8_t *data, int len)> hostOutput;
+
+    int setTxBufferSize(uint8_t) { return MICROBIT_OK; }
+    int send(const uint8_t *data, int len, MicroBitSerialMode = ASYNC)
+    {
+        if (hostOutput) {
+            hostOutput(data, len);
+        }
+        return len;
+    }
+    int send(ManagedString s, MicroBitSerialMode = ASYNC) { return s.length(); }
+    int printf(const char *, ...) { return 0; }
+};
+
+// BLE_API
+
+enum ble_error_t {
+    BLE_ERROR_NONE = 0,
+    BLE_ERROR_BUFFER_OVERFLOW,
+    BLE_ERROR_NOT_IMPLEMENTED,
+    BLE_ERROR_PARAM_OUT_OF_RANGE,
+    BLE_ERROR_INVALID_PARAM,
+    BLE_STACK_BUSY,
+    BLE_ERROR_INVALID_STATE,
+    BLE_ERROR_NO_MEM,
+    BLE_ERROR_OPERATION_NOT_PERMITTED,
+    BLE_ERROR_INITIALIZATION_INCOMPLETE,
+    BLE_ERROR_ALREADY_INITIALIZED,
+    BLE_ERROR_UNSPECIFIED
+};
+
+// 16 bit UUIDs keep their value, 128 bit ones read as 0
+class UUID
+{
+public:
+    typedef uint8_t ShortUUIDBytes_t[2];
+    typedef uint8_t LongUUIDBytes_t[16];
+
+    UUID(uint16_t shortUUID) : shortUUID(shortUUID), longUUID(false) {}
+    UUID(const uint8_t *) : shortUUID(0), longUUID(true) {}
+    UUID(const char *) : shortUUID(0), longUUID(true) {}
+    uint16_t getShortUUID() const { return shortUUID; }
+    uint8_t getLen() const { return longUUID ? 16 : 2; }
+
+private:
+    uint16_t shortUUID;
+    bool longUUID;
+};
+
+class GattAttribute
+{
+public:
+    typedef uint16_t Handle_t;
+};
+
+class SecurityManager
+{
+public:
+    enum SecurityMode_t { SECURITY_MODE_NO_ACCESS, SECURITY_MODE_ENCRYPTION_OPEN_LINK };
+    static const SecurityMode_t MICROBIT_BLE_SECURITY_LEVEL = SECURITY_MODE_ENCRYPTION_OPEN_LINK;
+};
+
+enum GattAuthCallbackReply_t {
+    AUTH_CALLBACK_REPLY_SUCCESS = 0x00,
+    AUTH_CALLBACK_REPLY_ATTERR_WRITE_NOT_PERMITTED = 0x0103
+};
+
+struct GattWriteAuthCallbackParams {
+    uint16_t connHandle;
+    uint16_t handle;
+    uint16_t offset;
+    uint16_t len;
+    const uint8_t *data;
+    GattAuthCallbackReply_t authorizationReply;
+};
+
+class GattCharacteristic
+{
+public:
+    enum {
+        BLE_GATT_CHAR_PROPERTIES_BROADCAST = 0x01,
+        BLE_GATT_CHAR_PROPERTIES_READ = 0x02,
+        BLE_GATT_CHAR_PROPERTIES_WRITE_WITHOUT_RESPONSE = 0x04,
+        BLE_GATT_CHAR_PROPERTIES_WRITE = 0x08,
+        BLE_GATT_CHAR_PROPERTIES_NOTIFY = 0x10,
+        BLE_GATT_CHAR_PROPERTIES_INDICATE = 0x20
+    };
+
+    // the GATT server gives out the value handle when the service is added
+    GattCharacteristic(const UUID &uuid, uint8_t *, uint16_t, uint16_t maxLen, uint8_t properties)
+        : uuid(uuid), maxLen(maxLen), properties(properties), valueHandle(0) {}
+
+    void requireSecurity(SecurityManager::SecurityMode_t) {}
+
+    template <typename T>
+    void setWriteAuthorizationCallback(T *object, void (T::*member)(GattWriteAuthCallbackParams *))
+    {
+        writeAuthorization = std::bind(member, object, std::placeholders::_1);
+    }
+    bool isWriteAuthorizationEnabled() const { return (bool)writeAuthorization; }
+    GattAuthCallbackReply_t authorizeWrite(GattWriteAuthCallbackParams *params) const
+    {
+        params->authorizationReply = AUTH_CALLBACK_REPLY_SUCCESS;
+        if (writeAuthorization) {
+            writeAuthorization(params);
+        }
+        return params->authorizationReply;
+    }
+
+    GattAttribute::Handle_t getValueHandle() const { return valueHandle; }
+    const UUID &getUUID() const { return uuid; }
+    uint16_t getMaxLength() const { return maxLen; }
+    uint8_t getProperties() const { return properties; }
+    void hostSetValueHandle(GattAttribute::Handle_t handle) { valueHandle = handle; }
+
+private:
+    UUID uuid;
+    uint16_t maxLen;
+    uint8_t properties;
+    GattAttribute::Handle_t valueHandle;
+    std::function<void(GattWriteAuthCallbackParams *)> writeAuthorization;
+};
+
+class GattService
+{
+public:
+    GattService(const UUID &uuid, GattCharacteristic **characteristics, unsigned count)
+        : uuid(uuid), characteristics(characteristics), count(count) {}
+
+    UUID uuid;
+    GattCharacteristic **characteristics;
+    unsigned count;
+};
+
+struct GattWriteCallbackParams {
+    uint16_t connHandle;
+    GattAttribute::Handle_t handle;
+    int writeOp;
+    uint16_t offset;
+    uint16_t len;
+    const uint8_t *data;
+};
+
+class GapAdvertisingParams
+{
+public:
+    enum AdvertisingType_t {
+        ADV_CONNECTABLE_UNDIRECTED,
+        ADV_CONNECTABLE_DIRECTED,
+        ADV_SCANNABLE_UNDIRECTED,
+        ADV_NON_CONNECTABLE_UNDIRECTED
+    };
+    // the shortest interval of scannable and non-connectable advertising (ms)
+    static const uint16_t GAP_ADV_PARAMS_INTERVAL_MIN_NONCON = 100;
+
+    // the DAL advertises every 50 ms (MICROBIT_BLE_ADVERTISING_INTERVAL)
+    GapAdvertisingParams() : type(ADV_CONNECTABLE_UNDIRECTED), interval(50) {}
+
+    AdvertisingType_t getAdvertisingType() const { return type; }
+    void setAdvertisingType(AdvertisingType_t t) { type = t; }
+    // ms
+    uint16_t getInterval() const { return interval; }
+    void setInterval(uint16_t ms) { interval = ms; }
+
+private:
+    AdvertisingType_t type;
+    uint16_t interval;
+};
+
+class GapAdvertisingData
+{
+public:
+    enum DataType_t {
+        FLAGS = 0x01,
+        INCOMPLETE_LIST_16BIT_SERVICE_IDS = 0x02,
+        COMPLETE_LIST_16BIT_SERVICE_IDS = 0x03,
+        SHORTENED_LOCAL_NAME = 0x08,
+        COMPLETE_LOCAL_NAME = 0x09,
+        SERVICE_DATA = 0x16,
+        APPEARANCE = 0x19,
+        MANUFACTURER_SPECIFIC_DATA = 0xFF
+    };
+    enum Flags_t { LE_LIMITED_DISCOVERABLE = 0x01, LE_GENERAL_DISCOVERABLE = 0x02, BREDR_NOT_SUPPORTED = 0x04 };
+    enum Appearance_t { UNKNOWN = 0, GENERIC_CYCLING = 1152 };
+
+    GapAdvertisingData() : payloadLen(0) {}
+
+    // a field of a type already there replaces it, or extends it for lists of service UUIDs
+    ble_error_t addData(DataType_t type, const uint8_t *data, uint8_t len);
+    // replaces the field of the type
+    ble_error_t updateData(DataType_t type, const uint8_t *data, uint8_t len);
+    ble_error_t addFlags(uint8_t flags) { return addData(FLAGS, &flags, 1); }
+    ble_error_t addAppearance(Appearance_t appearance)
+    {
+        uint8_t data[2] = { (uint8_t)appearance, (uint8_t)(appearance >> 8) };
+        return addData(APPEARANCE, data, 2);
+    }
+    void clear() { payloadLen = 0; }
+    const uint8_t *getPayload() const { return payload; }
+    uint8_t getPayloadLen() const { return payloadLen; }
+
+private:
+    // offset of the field of the type, -1 if there is none
+    int findField(DataType_t type) const;
+
+    uint8_t payload[31];
+    uint8_t payloadLen;
+};
+
+// the advertising payload, the scan response and the parameters are kept, and startAdvertising()
+// checks them as nRF5xGap does; the packets themselves are not simulated
+class Gap
+{
+public:
+    typedef uint16_t Handle_t;
+
+    struct ConnectionCallbackParams_t {
+        Handle_t handle;
+    };
+    struct DisconnectionCallbackParams_t {
+        Handle_t handle;
+        int reason;
+    };
+    enum DisconnectionReason_t {
+        CONNECTION_TIMEOUT = 0x08,
+        REMOTE_USER_TERMINATED_CONNECTION = 0x13,
+        REMOTE_DEV_TERMINATION_DUE_TO_LOW_RESOURCES = 0x14,
+        REMOTE_DEV_TERMINATION_DUE_TO_POWER_OFF = 0x15,
+        LOCAL_HOST_TERMINATED_CONNECTION = 0x16,
+        CONN_INTERVAL_UNACCEPTABLE = 0x3B
+    };
+
+    ble_error_t accumulateAdvertisingPayload(uint8_t flags) { return advertisingPayload.addFlags(flags); }
+    ble_error_t accumulateAdvertisingPayload(GapAdvertisingData::Appearance_t appearance) { return advertisingPayload.addAppearance(appearance); }
+    ble_error_t accumulateAdvertisingPayload(GapAdvertisingData::DataType_t type, const uint8_t *data, uint8_t len)
+    {
+        return advertisingPayload.addData(type, data, len);
+    }
+    ble_error_t accumulateScanResponse(GapAdvertisingData::DataType_t type, const uint8_t *data, uint8_t len)
+    {
+        return scanResponse.addData(type, data, len);
+    }
+    ble_error_t updateAdvertisingPayload(GapAdvertisingData::DataType_t type, const uint8_t *data, uint8_t len)
+    {
+        return advertisingPayload.updateData(type, data, len);
+    }
+    ble_error_t setAdvertisingPayload(const GapAdvertisingData &payload)
+    {
+        advertisingPayload = payload;
+        return BLE_ERROR_NONE;
+    }
+    const GapAdvertisingData &getAdvertisingPayload() const { return advertisingPayload; }
+    void clearAdvertisingPayload() { advertisingPayload.clear(); }
+    void clearScanResponse() { scanResponse.clear(); }
+    // BLE_ERROR_PARAM_OUT_OF_RANGE: scannable or non-connectable advertising faster than every 100 ms
+    ble_error_t startAdvertising();
+    ble_error_t stopAdvertising() { advertising = false; return BLE_ERROR_NONE; }
+    void setAdvertisingType(GapAdvertisingParams::AdvertisingType_t type) { advertisingParams.setAdvertisingType(type); }
+    void setAdvertisingInterval(uint16_t ms) { advertisingParams.setInterval(ms); }
+    GapAdvertisingParams &getAdvertisingParams() { return advertisingParams; }
+    // the link goes at once, with the reason the central sees in hostDisconnected
+    ble_error_t disconnect(Handle_t handle, DisconnectionReason_t reason);
+
+    template <typename T>
+    void onConnection(T *object, void (T::*handler)(const ConnectionCallbackParams_t *))
+    {
+        connectionCallbacks.push_back(std::bind(handler, object, std::placeholders::_1));
+    }
+
+    template <typename T>
+    void onDisconnection(T *object, void (T::*handler)(const DisconnectionCallbackParams_t *))
+    {
+        disconnectionCallbacks.push_back(std::bind(handler, object, std::placeholders::_1));
+    }
+
+    // a central connects or goes
+    void hostConnect(Handle_t handle);
+    void hostDisconnect(Handle_t handle);
+
+    std::function<void(Handle_t handle, int reason)> hostDisconnected;
+
+    const GapAdvertisingData &hostScanResponse() const { return scanResponse; }
+    // advertising started and not stopped since
+    bool hostAdvertising() const { return advertising; }
+    // a scanner gets the scan response: the advertising takes scan requests
+    bool hostScannable() const
+    {
+        return advertising && (advertisingParams.getAdvertisingType() == GapAdvertisingParams::ADV_CONNECTABLE_UNDIRECTED
+            || advertisingParams.getAdvertisingType() == GapAdvertisingParams::ADV_SCANNABLE_UNDIRECTED);
+    }
+    // the stack refuses the next startAdvertising() with this error (BLE_ERROR_NONE: it does not)
+    ble_error_t hostAdvertisingError = BLE_ERROR_NONE;
+
+private:
+    bool advertising = false;
+    GapAdvertisingParams advertisingParams;
+    GapAdvertisingData advertisingPayload;
+    GapAdvertisingData scanResponse;
+    std::vector<std::function<void(const ConnectionCallbackParams_t *)> > connectionCallbacks;
+    std::vector<std::function<void(const DisconnectionCallbackParams_t *)> > disconnectionCallbacks;
+};
+
+template <typename ContextType>
+class FunctionPointerWithContext
+{
+public:
+    template <typename T>
+    FunctionPointerWithContext(T *object, void (T::*member)(ContextType))
+        : function(std::bind(member, object, std::placeholders::_1)) {}
+    FunctionPointerWithContext(void (*function)(ContextType)) : function(function) {}
+
+    void call(ContextType context) const { function(context); }
+
+private:
+    std::function<void(ContextType)> function;
+};
+
+class GattServer
+{
+public:
+    GattServer() : nextHandle(0x0010), tableSize(0), tableUsed(0) {}
+
+    typedef FunctionPointerWithContext<GattAttribute::Handle_t> EventCallback_t;
+
+    // kind: "value" (local write, connection 0), "notify" or "indicate"
+    typedef std::function<void(const char *kind, Gap::Handle_t connection, uint16_t uuid
+        , const uint8_t *data, uint16_t len)> HostOutput_t;
+
+    void onUpdatesEnabled(EventCallback_t callback) { updatesEnabled.push_back(callback); }
+    void onUpdatesDisabled(EventCallback_t callback) { updatesDisabled.push_back(callback); }
+    void onConfirmationReceived(EventCallback_t callback) { confirmationReceived.push_back(callback); }
+    template <typename T>
+    void onDataSent(T *object, void (T::*handler)(unsigned count))
+    {
+        dataSent.push_back(std::bind(handler, object, std::placeholders::_1));
+    }
+
+    // local value of the attribute
+    ble_error_t write(GattAttribute::Handle_t handle, const uint8_t *data, uint16_t len, bool localOnly = false);
+    // notification or indication to one connection, if it enabled updates
+    ble_error_t write(Gap::Handle_t connection, GattAttribute::Handle_t handle, const uint8_t *data, uint16_t len, bool localOnly = false);
+    ble_error_t areUpdatesEnabled(const GattCharacteristic &characteristic, bool *enabled);
+    ble_error_t areUpdatesEnabled(Gap::Handle_t connection, const GattCharacteristic &characteristic, bool *enabled);
+
+    // BLE_ERROR_NO_MEM if the service does not fit the attribute table
+    ble_error_t hostAddService(const GattService &service);
+    // size of the attribute table of the SoftDevice (MICROBIT_SD_GATT_TABLE_SIZE), 0: not limited
+    void hostSetTableSize(uint16_t size) { tableSize = size; }
+    // bytes of the attribute table the services added so far take
+    uint16_t hostTableUsed() const { return tableUsed; }
+    // value handle of a characteristic by its 16 bit UUID, 0 if there is none
+    GattAttribute::Handle_t hostFind(uint16_t uuid) const;
+    // the central writes the CCCD
+    void hostSubscribe(Gap::Handle_t connection, GattAttribute::Handle_t handle, bool enabled);
+    // the central confirms the oldest indication
+    void hostConfirm(GattAttribute::Handle_t handle);
+    // the write authorization of the attribute, a refusal goes to hostOutput
+    GattAuthCallbackReply_t hostAuthorizeWrite(GattWriteAuthCallbackParams *params);
+    void hostDisconnect(Gap::Handle_t connection);
+    // the stack has sent count notifications and has room for more
+    void hostDataSent(unsigned count)
+    {
+        for (size_t i = 0; i < dataSent.size(); i++) {
+            dataSent[i](count);
+        }
+    }
+
+    HostOutput_t hostOutput;
+
+private:
+    // the write authorization is taken when the service is added
+    struct Attribute {
+        uint16_t uuid;
+        uint8_t properties;
+        std::function<GattAuthCallbackReply_t(GattWriteAuthCallbackParams *)> authorizeWrite;
+    };
+    GattAttribute::Handle_t nextHandle;
+    uint16_t tableSize;
+    uint16_t tableUsed;
+    std::map<GattAttribute::Handle_t, Attribute> attributes;
+    std::set<std::pair<Gap::Handle_t, GattAttribute::Handle_t> > subscriptions;
+    std::vector<EventCallback_t> updatesEnabled;
+    std::vector<EventCallback_t> updatesDisabled;
+    std::vector<EventCallback_t> confirmationReceived;
+    std::vector<std::function<void(unsigned)> > dataSent;
+};
+
+class BLEDevice
+{
+public:
+    Gap &gap() { return gapInstance; }
+    GattServer &gattServer() { return gattServerInstance; }
+
+    ble_error_t addService(GattService &service)
+    {
+        return gattServerInstance.hostAddService(service);
+    }
+
+    ble_error_t accumulateAdvertisingPayload(GapAdvertisingData::DataType_t type, const uint8_t *data, uint8_t len)
+    {
+        return gapInstance.accumulateAdvertisingPayload(type, data, len);
+    }
+
+    template <typename T>
+    void onDataWritten(T *object, void (T::*handler)(const GattWriteCallbackParams *))
+    {
+        dataWritten.push_back(std::bind(handler, object, std::placeholders::_1));
+    }
+
+    // the central writes an attribute
+    void hostWrite(Gap::Handle_t connection, GattAttribute::Handle_t handle, const uint8_t *data, uint16_t len);
+
+private:
+    Gap gapInstance;
+    GattServer gattServerInstance;
+    std::vector<std::function<void(const GattWriteCallbackParams *)> > dataWritten;
+};
+
+class MicroBit
+{
+public:
+    MicroBitMessageBus messageBus;
+    MicroBitIO io;
+    MicroBitDisplay display;
+    MicroBitSerial serial;
+    MicroBitAccelerometer accelerometer;
+    MicroBitRadio radio;
+    BLEDevice *ble;
+
+    MicroBit() : ble(&bleDevice)
+    {
+        EventModel::defaultEventBus = &messageBus;
+    }
+
+    void init() {}
+    void sleep(unsigned long) {}
+    uint64_t systemTime() { return system_timer_current_time(); }
+    // the device stops with the code on the display; the host keeps the code and goes on
+    void panic(int statusCode) { panicCode = statusCode; }
+
+    int panicCode = 0;
+
+private:
+    BLEDevice bleDevice;
+};
+
+#endif /* #ifndef HOST_MICROBIT_H */
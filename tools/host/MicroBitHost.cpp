@@ -0,0 +1,382 @@
+/*
+ * MicroBitHost.cpp
+ *
+ * Host runtime: virtual clock, message bus, idle components and the GATT
+ * server of MicroBit.h.
+ */
+
+#include "MicroBit.h"
+
+#include <algorithm>
+
+thread_local uint64_t host_time_us = 0;
+
+namespace {
+
+thread_local std::vector<MicroBitComponent *> idleComponents;
+
+} // namespace
+
+uint64_t system_timer_current_time_us()
+{
+    return host_time_us;
+}
+
+unsigned long system_timer_current_time()
+{
+    return (unsigned long)(host_time_us / 1000);
+}
+
+void host_set_time_us(uint64_t time)
+{
+    host_time_us = time;
+}
+
+int fiber_add_idle_component(MicroBitComponent *component)
+{
+    if (std::find(idleComponents.begin(), idleComponents.end(), component) == idleComponents.end()) {
+        idleComponents.push_back(component);
+    }
+    return MICROBIT_OK;
+}
+
+int fiber_remove_idle_component(MicroBitComponent *component)
+{
+    idleComponents.erase(std::remove(idleComponents.begin(), idleComponents.end(), component), idleComponents.end());
+    return MICROBIT_OK;
+}
+
+void host_idle()
+{
+    std::vector<MicroBitComponent *> components(idleComponents);
+    for (size_t i = 0; i < components.size(); i++) {
+        components[i]->idleTick();
+    }
+}
+
+void host_reset()
+{
+    idleComponents.clear();
+    host_time_us = 0;
+}
+
+// message bus
+
+thread_local EventModel *EventModel::defaultEventBus = NULL;
+
+MicroBitEvent::MicroBitEvent(uint16_t source, uint16_t value, MicroBitEventLaunchMode mode)
+    : source(source), value(value), timestamp(system_timer_current_time_us())
+{
+    if (mode == CREATE_AND_FIRE) {
+        fire();
+    }
+}
+
+MicroBitEvent::MicroBitEvent()
+    : source(0), value(0), timestamp(system_timer_current_time_us())
+{
+}
+
+void MicroBitEvent::fire()
+{
+    if (EventModel::defaultEventBus) {
+        EventModel::defaultEventBus->send(*this);
+    }
+}
+
+int EventModel::send(MicroBitEvent evt)
+{
+    // a listener may add listeners
+    std::vector<Listener> current(listeners);
+    for (size_t i = 0; i < current.size(); i++) {
+        const Listener &l = current[i];
+        if ((l.id == MICROBIT_ID_ANY || l.id == evt.source) && (l.value == MICROBIT_EVT_ANY || l.value == evt.value)) {
+            l.handler(evt);
+        }
+    }
+    return MICROBIT_OK;
+}
+
+// BLE
+
+int GapAdvertisingData::findField(DataType_t type) const
+{
+    for (int i = 0; i + 1 < payloadLen; i += payload[i] + 1) {
+        if (payload[i + 1] == type) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+ble_error_t GapAdvertisingData::addData(DataType_t type, const uint8_t *data, uint8_t len)
+{
+    int field = findField(type);
+    bool list = (type == INCOMPLETE_LIST_16BIT_SERVICE_IDS || type == COMPLETE_LIST_16BIT_SERVICE_IDS);
+    if (field < 0) {
+        if (payloadLen + 2 + len > (int)sizeof(payload)) {
+            return BLE_ERROR_BUFFER_OVERFLOW;
+        }
+        payload[payloadLen] = (uint8_t)(len + 1);
+        payload[payloadLen + 1] = (uint8_t)type;
+        memcpy(&payload[payloadLen + 2], data, len);
+        payloadLen = (uint8_t)(payloadLen + 2 + len);
+        return BLE_ERROR_NONE;
+    }
+    if (!list) {
+        return updateData(type, data, len);
+    }
+    // the list grows in place
+    int end = field + 1 + payload[field];
+    if (payloadLen + len > (int)sizeof(payload)) {
+        return BLE_ERROR_BUFFER_OVERFLOW;
+    }
+    memmove(&payload[end + len], &payload[end], payloadLen - end);
+    memcpy(&payload[end], data, len);
+    payload[field] = (uint8_t)(payload[field] + len);
+    payloadLen = (uint8_t)(payloadLen + len);
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t GapAdvertisingData::updateData(DataType_t type, const uint8_t *data, uint8_t len)
+{
+    int field = findField(type);
+    if (field < 0) {
+        return BLE_ERROR_UNSPECIFIED;
+    }
+    int old = payload[field] - 1;
+    if (payloadLen - old + len > (int)sizeof(payload)) {
+        return BLE_ERROR_BUFFER_OVERFLOW;
+    }
+    int end = field + 2 + old;
+    memmove(&payload[field + 2 + len], &payload[end], payloadLen - end);
+    memcpy(&payload[field + 2], data, len);
+    payload[field] = (uint8_t)(len + 1);
+    payloadLen = (uint8_t)(payloadLen - old + len);
+    return BLE_ERROR_NONE;
+}
+
+void Gap::hostConnect(Handle_t handle)
+{
+    ConnectionCallbackParams_t params;
+    params.handle = handle;
+    for (size_t i = 0; i < connectionCallbacks.size(); i++) {
+        connectionCallbacks[i](&params);
+    }
+}
+
+void Gap::hostDisconnect(Handle_t handle)
+{
+    DisconnectionCallbackParams_t params;
+    params.handle = handle;
+    params.reason = REMOTE_USER_TERMINATED_CONNECTION;
+    for (size_t i = 0; i < disconnectionCallbacks.size(); i++) {
+        disconnectionCallbacks[i](&params);
+    }
+}
+
+ble_error_t Gap::startAdvertising()
+{
+    GapAdvertisingParams::AdvertisingType_t type = advertisingParams.getAdvertisingType();
+    if ((type == GapAdvertisingParams::ADV_SCANNABLE_UNDIRECTED || type == GapAdvertisingParams::ADV_NON_CONNECTABLE_UNDIRECTED)
+        && advertisingParams.getInterval() < GapAdvertisingParams::GAP_ADV_PARAMS_INTERVAL_MIN_NONCON) {
+        return BLE_ERROR_PARAM_OUT_OF_RANGE;
+    }
+    if (hostAdvertisingError != BLE_ERROR_NONE) {
+        ble_error_t error = hostAdvertisingError;
+        hostAdvertisingError = BLE_ERROR_NONE;
+        return error;
+    }
+    advertising = true;
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t Gap::disconnect(Handle_t handle, DisconnectionReason_t reason)
+{
+    if (hostDisconnected) {
+        hostDisconnected(handle, reason);
+    }
+    DisconnectionCallbackParams_t params;
+    params.handle = handle;
+    params.reason = LOCAL_HOST_TERMINATED_CONNECTION;
+    for (size_t i = 0; i < disconnectionCallbacks.size(); i++) {
+        disconnectionCallbacks[i](&params);
+    }
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t GattServer::write(GattAttribute::Handle_t handle, const uint8_t *data, uint16_t len, bool localOnly)
+{
+    std::map<GattAttribute::Handle_t, Attribute>::const_iterator it = attributes.find(handle);
+    if (it == attributes.end()) {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+    if (hostOutput) {
+        hostOutput("value", 0, it->second.uuid, data, len);
+    }
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t GattServer::write(Gap::Handle_t connection, GattAttribute::Handle_t handle, const uint8_t *data, uint16_t len, bool localOnly)
+{
+    std::map<GattAttribute::Handle_t, Attribute>::const_iterator it = attributes.find(handle);
+    if (it == attributes.end()) {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+    // the value is updated even when nothing can be sent
+    if (localOnly || subscriptions.count(std::make_pair(connection, handle)) == 0) {
+        return BLE_ERROR_INVALID_STATE;
+    }
+    if (hostOutput) {
+        bool indicate = (it->second.properties & GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_INDICATE) != 0;
+        hostOutput(indicate ? "indicate" : "notify", connection, it->second.uuid, data, len);
+    }
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t GattServer::areUpdatesEnabled(const GattCharacteristic &characteristic, bool *enabled)
+{
+    *enabled = false;
+    std::set<std::pair<Gap::Handle_t, GattAttribute::Handle_t> >::const_iterator it;
+    for (it = subscriptions.begin(); it != subscriptions.end(); ++it) {
+        if (it->second == characteristic.getValueHandle()) {
+            *enabled = true;
+        }
+    }
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t GattServer::areUpdatesEnabled(Gap::Handle_t connection, const GattCharacteristic &characteristic, bool *enabled)
+{
+    *enabled = subscriptions.count(std::make_pair(connection, characteristic.getValueHandle())) != 0;
+    return BLE_ERROR_NONE;
+}
+
+namespace {
+
+// An attribute of the S110 table: a header and the value, stored in the
+// table (BLE_GATTS_VLOC_STACK as the BLE_API of the nRF51 adds them), word aligned.
+const uint16_t ATTRIBUTE_HEADER_SIZE = 8;
+
+uint16_t attributeSize(uint16_t valueLen)
+{
+    return (uint16_t)((ATTRIBUTE_HEADER_SIZE + valueLen + 3) & ~3);
+}
+
+} // namespace
+
+ble_error_t GattServer::hostAddService(const GattService &service)
+{
+    // service declaration, then per characteristic: declaration (properties,
+    // value handle, UUID), value and the CCCD of notify / indicate
+    unsigned size = attributeSize(service.uuid.getLen());
+    for (unsigned i = 0; i < service.count; i++) {
+        GattCharacteristic *c = service.characteristics[i];
+        size += attributeSize(1 + 2 + c->getUUID().getLen()) + attributeSize(c->getMaxLength());
+        if (c->getProperties() & (GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY | GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_INDICATE)) {
+            size += attributeSize(2);
+        }
+    }
+    if (tableSize != 0 && tableUsed + size > tableSize) {
+        return BLE_ERROR_NO_MEM;
+    }
+    tableUsed = (uint16_t)(tableUsed + size);
+
+    for (unsigned i = 0; i < service.count; i++) {
+        GattCharacteristic *c = service.characteristics[i];
+        // declaration and value: two handles per characteristic
+        c->hostSetValueHandle(nextHandle);
+        nextHandle += 2;
+        Attribute a;
+        a.uuid = c->getUUID().getShortUUID();
+        a.properties = c->getProperties();
+        if (c->isWriteAuthorizationEnabled()) {
+            // the characteristic may be gone when the service is made, as on the nRF51
+            GattCharacteristic copy(*c);
+            a.authorizeWrite = [copy](GattWriteAuthCallbackParams *params) { return copy.authorizeWrite(params); };
+        }
+        attributes[c->getValueHandle()] = a;
+    }
+    return BLE_ERROR_NONE;
+}
+
+GattAttribute::Handle_t GattServer::hostFind(uint16_t uuid) const
+{
+    std::map<GattAttribute::Handle_t, Attribute>::const_iterator it;
+    for (it = attributes.begin(); it != attributes.end(); ++it) {
+        if (it->second.uuid == uuid) {
+            return it->first;
+        }
+    }
+    return 0;
+}
+
+void GattServer::hostSubscribe(Gap::Handle_t connection, GattAttribute::Handle_t handle, bool enabled)
+{
+    if (enabled) {
+        subscriptions.insert(std::make_pair(connection, handle));
+    } else {
+        subscriptions.erase(std::make_pair(connection, handle));
+    }
+    std::vector<EventCallback_t> &callbacks = enabled ? updatesEnabled : updatesDisabled;
+    for (size_t i = 0; i < callbacks.size(); i++) {
+        callbacks[i].call(handle);
+    }
+}
+
+void GattServer::hostConfirm(GattAttribute::Handle_t handle)
+{
+    for (size_t i = 0; i < confirmationReceived.size(); i++) {
+        confirmationReceived[i].call(handle);
+    }
+}
+
+GattAuthCallbackReply_t GattServer::hostAuthorizeWrite(GattWriteAuthCallbackParams *params)
+{
+    std::map<GattAttribute::Handle_t, Attribute>::const_iterator it = attributes.find(params->handle);
+    if (it == attributes.end() || !it->second.authorizeWrite) {
+        return AUTH_CALLBACK_REPLY_SUCCESS;
+    }
+    GattAuthCallbackReply_t reply = it->second.authorizeWrite(params);
+    if (reply != AUTH_CALLBACK_REPLY_SUCCESS && hostOutput) {
+        uint8_t error = (uint8_t)(reply & 0xFF);
+        hostOutput("error", params->connHandle, it->second.uuid, &error, 1);
+    }
+    return reply;
+}
+
+void GattServer::hostDisconnect(Gap::Handle_t connection)
+{
+    std::set<std::pair<Gap::Handle_t, GattAttribute::Handle_t> >::iterator it = subscriptions.begin();
+    while (it != subscriptions.end()) {
+        if (it->first == connection) {
+            subscriptions.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void BLEDevice::hostWrite(Gap::Handle_t connection, GattAttribute::Handle_t handle, const uint8_t *data, uint16_t len)
+{
+    // a refused write is answered with the ATT error and written nowhere
+    GattWriteAuthCallbackParams auth;
+    auth.connHandle = connection;
+    auth.handle = handle;
+    auth.offset = 0;
+    auth.len = len;
+    auth.data = data;
+    if (gattServerInstance.hostAuthorizeWrite(&auth) != AUTH_CALLBACK_REPLY_SUCCESS) {
+        return;
+    }
+    GattWriteCallbackParams params;
+    params.connHandle = connection;
+    params.handle = handle;
+    params.writeOp = 1;     // write request
+    params.offset = 0;
+    params.len = len;
+    params.data = data;
+    for (size_t i = 0; i < dataWritten.size(); i++) {
+        dataWritten[i](&params);
+    }
+}
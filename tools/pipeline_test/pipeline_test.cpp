@@ -0,0 +1,254 @@
+/*
+ * pipeline_test.cpp
+ *
+ * Test of the firmware MicroBitCustomPipeline and its parts on the host
+ * runtime (tools/host), driven by STEP edges, analog values and
+ * accelerations under the virtual clock:
+ *
+ *  - edges -> event: every edge time in order, queue overflow counted;
+ *  - moving average and decimation against references on random samples;
+ *  - analog values packed and sent to the radio and to a BLE subscriber
+ *    through a tee, once per period;
+ *  - the accelerometer, passed through to an event sink;
+ *  - analog values averaged and recorded as COBS framed telemetry records.
+ *
+ * usage: pipeline_test [seed]
+ */
+
+#include "MicroBit.h"
+#include "MicroBitCustomPipeline.h"
+#include "MicroBitCustomPipelineParts.h"
+#include "MicroBitBLEConnectionTable.h"
+#include "MicroBitTelemetry.h"
+#include "struct.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void expect(bool cond, const char *what, long at)
+{
+    if (!cond && failures++ < 16) {
+        fprintf(stderr, "pipeline_test: %s (at %ld)\n", what, at);
+    }
+}
+
+void edge(uint64_t time)
+{
+    host_set_time_us(time);
+    MicroBitEvent(MICROBIT_ID_IO_P2, MICROBIT_PIN_EVT_FALL);
+}
+
+typedef MicroBitCustomPipeline<MicroBitPipelineEdgeSource, MicroBitPipelinePass<uint64_t>, MicroBitPipelineEventSink<uint64_t> > EdgePipeline;
+
+class EdgeListener {
+public:
+    EdgeListener(MicroBit &uBit, EdgePipeline &pipeline) : pipeline(pipeline)
+    {
+        uBit.messageBus.listen(pipeline.getId(), MICROBIT_CUSTOM_PIPELINE_EVT_DATA_UPDATE, this, &EdgeListener::onUpdate);
+    }
+    std::vector<uint64_t> edges;
+
+private:
+    void onUpdate(MicroBitEvent)
+    {
+        edges.push_back(pipeline.sink.get());
+    }
+    EdgePipeline &pipeline;
+};
+
+void checkEdges()
+{
+    host_reset();
+    MicroBit uBit;
+    EdgePipeline pipeline(MicroBitPipelineEdgeSource(uBit.io.P2, MICROBIT_ID_IO_P2));
+    pipeline.start();
+    EdgeListener listener(uBit, pipeline);
+
+    // 2 magnets at 90 rpm: an edge every 333333 us, two edges queued before some ticks
+    std::vector<uint64_t> expected;
+    uint64_t t = 1000000;
+    for (int i = 0; i < 20; i++, t += 333333) {
+        edge(t);
+        expected.push_back(t);
+        if (i % 4 == 0) {
+            edge(t + 2000);
+            expected.push_back(t + 2000);
+        }
+        host_idle();
+    }
+    expect(listener.edges == expected, "every edge time in order", (long)listener.edges.size());
+
+    // more edges than the queue holds between two ticks
+    for (int i = 0; i < MICROBIT_CUSTOM_PIPELINE_EDGES + 3; i++) {
+        edge(t + i * 20000);
+    }
+    int written = pipeline.run();
+    expect(written == MICROBIT_CUSTOM_PIPELINE_EDGES, "queued edges", written);
+    expect(pipeline.source.getDropped() == 3, "dropped edges", (long)pipeline.source.getDropped());
+    expect(listener.edges.back() == t + (MICROBIT_CUSTOM_PIPELINE_EDGES - 1) * 20000, "the edges beyond are dropped"
+        , (long)(listener.edges.back() - t));
+}
+
+void checkFilters(std::mt19937 &rng)
+{
+    MicroBitPipelineMovingAverage<int16_t, 5> average;
+    MicroBitPipelineDecimate<int16_t, 3> decimate;
+    std::vector<int> samples;
+    for (int i = 0; i < 1000; i++) {
+        int16_t in = (int16_t)(rng() % 2001) - 1000;
+        samples.push_back(in);
+        int16_t out;
+        expect(average.process(in, out), "average passes", i);
+        int n = std::min(5, (int)samples.size());
+        int sum = 0;
+        for (int k = 0; k < n; k++) {
+            sum += samples[samples.size() - 1 - k];
+        }
+        expect(out == sum / n, "moving average", i);
+        expect(decimate.process(in, out) == (i % 3 == 0) && out == in, "decimation", i);
+    }
+}
+
+typedef MicroBitPipelineTee<MicroBitPipelineRadioSink<2>, MicroBitPipelineNotifySink<2> > PacketSinks;
+typedef MicroBitCustomPipeline<MicroBitPipelineAnalogSource, MicroBitPipelinePack<int, 2>, PacketSinks> AnalogPipeline;
+
+void checkAnalog()
+{
+    host_reset();
+    MicroBit uBit;
+    MicroBitBLEConnectionTable connections(uBit);
+    uint8_t buffer[2];
+    GattCharacteristic characteristic(UUID(0xFFF1), buffer, 0, sizeof(buffer), GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
+    GattCharacteristic *characteristics[] = { &characteristic };
+    GattService service(UUID(0xFFF0), characteristics, 1);
+    uBit.ble->addService(service);
+    int index = connections.addCharacteristic(&characteristic);
+    uBit.ble->gap().hostConnect(1);
+    uBit.ble->gattServer().hostSubscribe(1, characteristic.getValueHandle(), true);
+
+    std::vector<int> radio, notified;
+    uBit.radio.datagram.hostOutput = [&](const uint8_t *data, int len) {
+        expect(len == 2, "radio packet length", len);
+        radio.push_back(data[0] | data[1] << 8);
+    };
+    uBit.ble->gattServer().hostOutput = [&](const char *, Gap::Handle_t, uint16_t, const uint8_t *data, uint16_t len) {
+        expect(len == 2, "notification length", len);
+        notified.push_back(data[0] | data[1] << 8);
+    };
+
+    AnalogPipeline pipeline(MicroBitPipelineAnalogSource(uBit.io.P0, 100000), MicroBitPipelinePack<int, 2>("<H")
+        , PacketSinks(MicroBitPipelineRadioSink<2>(uBit.radio), MicroBitPipelineNotifySink<2>(connections, index)));
+    pipeline.start();
+    for (uint64_t t = 1000; t <= 1000000; t += 1000) {
+        uBit.io.P0.hostAnalogValue = (int)(t / 1000);
+        host_set_time_us(t);
+        host_idle();
+    }
+    expect(radio.size() == 10, "one sample per period", (long)radio.size());
+    expect(radio == notified, "the tee writes both sinks", (long)notified.size());
+    for (size_t i = 0; i < radio.size(); i++) {
+        expect(radio[i] == (int)(1 + i * 100), "analog value", (long)i);
+    }
+}
+
+void checkAccelerometer()
+{
+    host_reset();
+    MicroBit uBit;
+    MicroBitCustomPipeline<MicroBitPipelineAccelerometerSource, MicroBitPipelinePass<MicroBitPipelineAcceleration>
+        , MicroBitPipelineEventSink<MicroBitPipelineAcceleration> > pipeline(MicroBitPipelineAccelerometerSource(uBit.accelerometer, 20000));
+    pipeline.start();
+    uBit.accelerometer.hostX = -12;
+    uBit.accelerometer.hostY = 40;
+    uBit.accelerometer.hostZ = -1024;
+    host_set_time_us(1000);
+    int first = pipeline.run();
+    int second = pipeline.run();
+    expect(first == 1 && second == 0, "one sample per period", second);
+    const MicroBitPipelineAcceleration &a = pipeline.sink.get();
+    expect(a.x == -12 && a.y == 40 && a.z == -1024, "acceleration", a.z);
+}
+
+typedef MicroBitCustomPipeline<MicroBitPipelineAnalogSource, MicroBitPipelineMovingAverage<int, 4>, MicroBitPipelineTelemetrySink> TelemetryPipeline;
+
+void checkTelemetry()
+{
+    host_reset();
+    MicroBit uBit;
+    MicroBitTelemetry telemetry(uBit);
+    std::vector<uint8_t> wire;
+    uBit.serial.hostOutput = [&](const uint8_t *data, int len) {
+        wire.insert(wire.end(), data, data + len);
+    };
+    telemetry.idleTick();
+
+    TelemetryPipeline pipeline(MicroBitPipelineAnalogSource(uBit.io.P1, 100000), MicroBitPipelineMovingAverage<int, 4>()
+        , MicroBitPipelineTelemetrySink(telemetry, 0x1234));
+    pipeline.start();
+    for (uint64_t t = 1000; t <= 1000000; t += 1000) {
+        uBit.io.P1.hostAnalogValue = (int)(t / 1000);
+        host_set_time_us(t);
+        host_idle();
+    }
+
+    // the COBS frames of MicroBitTelemetry, one PIPELINE record per sample
+    std::vector<int32_t> values;
+    size_t start = 0;
+    for (size_t i = 0; i < wire.size(); i++) {
+        if (wire[i] != 0) {
+            continue;
+        }
+        uint8_t record[MICROBIT_TELEMETRY_RECORD_MAX];
+        int len = MicroBitTelemetryFrame::decode(&wire[start], (int)(i - start), record);
+        start = i + 1;
+        uint8_t type;
+        uint32_t time;
+        uint16_t id;
+        int32_t value;
+        expect(len == struct_calcsize(MICROBIT_TELEMETRY_FORMAT_PIPELINE), "record length", len);
+        if (len != struct_calcsize(MICROBIT_TELEMETRY_FORMAT_PIPELINE)) {
+            continue;
+        }
+        struct_unpack(record, MICROBIT_TELEMETRY_FORMAT_PIPELINE, &type, &time, &id, &value);
+        expect(type == MICROBIT_TELEMETRY_RECORD_PIPELINE && id == 0x1234, "pipeline record", type);
+        expect(time == 1000 + values.size() * 100000, "record time", (long)time);
+        values.push_back(value);
+    }
+    expect(start == wire.size(), "whole frames", (long)(wire.size() - start));
+    expect(values.size() == 10, "one record per sample", (long)values.size());
+    // samples 1, 101, 201, ... averaged over the last 4
+    for (size_t i = 0; i < values.size(); i++) {
+        size_t n = std::min<size_t>(4, i + 1);
+        int32_t average = (int32_t)(1 + (i - (n - 1) / 2.0) * 100);
+        expect(values[i] == average, "moving average in the record", (long)i);
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    std::mt19937 rng(argc > 1 ? atoi(argv[1]) : 1);
+
+    checkEdges();
+    checkFilters(rng);
+    checkAnalog();
+    checkAccelerometer();
+    checkTelemetry();
+
+    if (failures) {
+        fprintf(stderr, "pipeline_test: %d failure(s)\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("pipeline_test: ok\n");
+    return EXIT_SUCCESS;
+}
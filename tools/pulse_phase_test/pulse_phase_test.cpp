@@ -0,0 +1,148 @@
+/*
+ * pulse_phase_test.cpp
+ *
+ * Test of the firmware MicroBitPulsePhase with magnets spaced unevenly on
+ * the flywheel:
+ *
+ *  - The learned shares converge to the gaps between the magnets.
+ *  - Once learned, the interval of every pulse is the revolution interval
+ *    within 1 %, where the raw pulse interval x N is off by the spacing.
+ *  - A change of cadence shows after one pulse, not one revolution.
+ *  - One pulse per revolution gives the plain edge interval.
+ *  - A stop keeps the shares and the magnet numbers.
+ *
+ * usage: pulse_phase_test
+ */
+
+#include "MicroBitPulsePhase.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <random>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void expect(bool cond, const char *what, double value)
+{
+    if (!cond && failures++ < 16) {
+        fprintf(stderr, "pulse_phase_test: %s (%.4f)\n", what, value);
+    }
+}
+
+// pulse times of a ride at a cadence (rpm), magnets at the angles (degrees), jitter in us
+struct Flywheel {
+    std::vector<double> angles;
+    double jitter;
+    std::mt19937 rng;
+    double position;    // revolutions
+    double time;        // us
+    size_t next;
+
+    Flywheel(const std::vector<double> &a, double j) : angles(a), jitter(j), rng(1), position(0), time(1e6), next(0) {}
+
+    // time of the next pulse at a cadence
+    uint64_t pulse(double rpm)
+    {
+        double revolution = floor(position);
+        double target = revolution + angles[next] / 360.0;
+        if (target <= position) {
+            target += 1;
+        }
+        time += (target - position) * 60e6 / rpm;
+        position = target;
+        next = (next + 1) % angles.size();
+        std::uniform_real_distribution<double> noise(-jitter, jitter);
+        return (uint64_t)(time + noise(rng));
+    }
+};
+
+void uneven(const std::vector<double> &angles)
+{
+    uint8_t n = (uint8_t)angles.size();
+    MicroBitPulsePhase phase(n);
+    Flywheel fly(angles, 200);
+
+    // learn at 80 rpm
+    for (int i = 0; i < 100 * n; i++) {
+        phase.edge(fly.pulse(80));
+    }
+    for (uint8_t k = 0; k < n; k++) {
+        double gap = (angles[(k + 1) % n] - angles[k] + 360.0) / 360.0;
+        gap -= floor(gap);
+        if (gap == 0) {
+            gap = 1;
+        }
+        expect(fabs(phase.getShare(k) / 65536.0 - gap) < 0.005, "share of a magnet", phase.getShare(k) / 65536.0);
+    }
+
+    // every pulse gives the revolution interval, the raw interval does not
+    double worstCorrected = 0, worstRaw = 0;
+    uint64_t last = 0;
+    for (int i = 0; i < 20 * n; i++) {
+        uint64_t t = fly.pulse(80);
+        phase.edge(t);
+        if (last) {
+            worstRaw = std::max(worstRaw, fabs((double)(t - last) * n / 750000 - 1));
+        }
+        worstCorrected = std::max(worstCorrected, fabs(phase.getIntervalTime() / 750000.0 - 1));
+        last = t;
+    }
+    printf("%u magnets: worst error %.2f %% corrected, %.2f %% raw\n", n, worstCorrected * 100, worstRaw * 100);
+    expect(worstCorrected < 0.01, "corrected interval", worstCorrected);
+
+    // a stop keeps the magnet numbers
+    phase.reset();
+    fly.time += 10e6;
+    for (int i = 0; i < 3 * n; i++) {
+        phase.edge(fly.pulse(80));
+    }
+    expect(fabs(phase.getIntervalTime() / 750000.0 - 1) < 0.01, "interval after a stop", phase.getIntervalTime() / 750000.0);
+
+    // 80 -> 120 rpm: the next two pulses show it
+    phase.edge(fly.pulse(120));
+    phase.edge(fly.pulse(120));
+    expect(fabs(phase.getIntervalTime() / 500000.0 - 1) < 0.02, "latency of a cadence change", phase.getIntervalTime() / 500000.0);
+
+    // the bound: the next pulse is at least as late as now
+    uint64_t elapsed = 2000000;
+    expect(phase.getIntervalBound(elapsed) > elapsed, "bound below the elapsed time", phase.getIntervalBound(elapsed));
+}
+
+} // namespace
+
+int main()
+{
+    // one magnet: the edge interval
+    MicroBitPulsePhase one;
+    one.edge(1000000);
+    expect(one.getIntervalTime() == 0, "interval after one edge", one.getIntervalTime());
+    one.edge(1750000);
+    expect(one.getIntervalTime() == 750000, "interval of one magnet", one.getIntervalTime());
+    one.edge(2250000);
+    expect(one.getIntervalTime() == 625000, "average of two intervals", one.getIntervalTime());
+    expect(one.getIntervalBound(1000000) == 1000000, "bound of one magnet", one.getIntervalBound(1000000));
+
+    uneven(std::vector<double>{0, 180});
+    uneven(std::vector<double>{0, 150});
+    uneven(std::vector<double>{0, 100, 200, 300});
+    uneven(std::vector<double>{0, 80, 200, 290});
+
+    // limits
+    MicroBitPulsePhase limits(0);
+    expect(limits.getPulses() == MIN_PULSES_PER_REVOLUTION, "lower limit", limits.getPulses());
+    limits.setPulses(20);
+    expect(limits.getPulses() == MAX_PULSES_PER_REVOLUTION, "upper limit", limits.getPulses());
+
+    if (failures) {
+        fprintf(stderr, "pulse_phase_test: %d failure(s)\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("pulse_phase_test: ok\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,354 @@
+/*
+ * radio_sim.cpp
+ *
+ * Load test of the radio hub: hundreds of virtual bikes send frames through a
+ * simulated 1 Mbps radio channel into MicroBitIndoorBikeRadioTable, the same
+ * code the hub firmware runs.
+ *
+ * The channel models on-air collisions (overlapping frames are both lost,
+ * no capture effect), random loss, duplicated frames, frames delivered late
+ * (out of order) and bikes rebooting (sequence numbers start over).
+ *
+ * Invariants checked on every frame:
+ *  - an accepted frame is stored as is;
+ *  - a duplicate is never accepted;
+ *  - within the resync window the stored sequence number and crank
+ *    revolutions of a bike never go backwards.
+ *
+ * usage: radio_sim [--senders N] [--seconds S] [--loss P] [--dup P]
+ *                  [--late P] [--reboot P] [--seed N]
+ */
+
+#include "MicroBitIndoorBikeRadioTable.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <queue>
+#include <random>
+#include <vector>
+
+namespace {
+
+// on air: preamble(1) + address(4) + length(1) + DAL header(3) + frame + CRC(2), 1 us/bit
+const uint64_t AIRTIME_US = (1 + 4 + 1 + 3 + MICROBIT_INDOOR_BIKE_RADIO_FRAME_SIZE + 2) * 8;
+const uint64_t PERIOD_US = 1000000;
+const uint64_t REBOOT_US = 2000000;
+const uint64_t LATE_US = 1500000;
+
+struct Options {
+    int senders = 300;
+    int seconds = 120;
+    double loss = 0.02;
+    double dup = 0.01;
+    double late = 0.01;
+    double reboot = 0.001;
+    uint32_t seed = 1;
+};
+
+struct Bike {
+    uint32_t id;
+    uint16_t sequence;
+    uint32_t crankRevolutions;
+    double cadence;
+    int64_t period;             // us, differs per bike (clock drift)
+    uint64_t offline;           // rebooting until (us)
+    // hub state seen by the checker
+    bool seen;
+    uint16_t lastSequence;
+    uint32_t lastRevolutions;
+    uint32_t lastAccepted;      // ms
+};
+
+struct Tx {
+    uint64_t start;
+    int bike;
+    uint8_t frame[MICROBIT_INDOOR_BIKE_RADIO_FRAME_SIZE];
+    bool collided;
+};
+
+struct Late {
+    uint64_t at;
+    Tx tx;
+    bool operator<(const Late &o) const { return at > o.at; }
+};
+
+struct Stats {
+    uint64_t sent = 0;
+    uint64_t collided = 0;
+    uint64_t lost = 0;
+    uint64_t duplicated = 0;
+    uint64_t late = 0;
+    uint64_t reboots = 0;
+    uint64_t delivered = 0;
+    uint64_t fresh = 0;         // bike-seconds with data younger than 2 periods
+    uint64_t samples = 0;
+    double acceptNs = 0;
+};
+
+int failures = 0;
+
+void fail(const char *what, const Bike &b, uint16_t sequence)
+{
+    if (failures++ < 16) {
+        fprintf(stderr, "radio_sim: %s (bike %08X sequence %u)\n", what, (unsigned)b.id, sequence);
+    }
+}
+
+class Simulation {
+public:
+    Simulation(const Options &o) : opt(o), rng(o.seed), table(new MicroBitIndoorBikeRadioTable()) {}
+    ~Simulation() { delete table; }
+
+    int run();
+
+private:
+    void send(int i, uint64_t now);
+    void air(const Tx &tx);
+    void deliver(const Tx &tx, uint64_t now, bool duplicate);
+    bool chance(double p) { return std::uniform_real_distribution<double>(0, 1)(rng) < p; }
+
+    Options opt;
+    std::mt19937 rng;
+    MicroBitIndoorBikeRadioTable *table;    // large with a big MICROBIT_INDOOR_BIKE_RADIO_HUB_SIZE
+    std::vector<Bike> bikes;
+    std::priority_queue<Late> lateQueue;
+    Stats stats;
+
+    // channel: the last frame stays pending until the next one starts
+    bool pending = false;
+    Tx pendingTx;
+    uint64_t busyUntil = 0;
+};
+
+void Simulation::send(int i, uint64_t now)
+{
+    Bike &b = bikes[i];
+    if (now < b.offline) {
+        return;
+    }
+    if (chance(opt.reboot)) {
+        stats.reboots++;
+        b.offline = now + REBOOT_US;
+        b.sequence = 0;
+        b.crankRevolutions = 0;
+        return;
+    }
+
+    b.cadence += std::normal_distribution<double>(0, 2)(rng);
+    b.cadence = b.cadence < 0 ? 0 : (b.cadence > 140 ? 140 : b.cadence);
+    b.crankRevolutions += (uint32_t)(b.cadence / 60.0 + 0.5);
+
+    MicroBitIndoorBikeRadioSnapshot s;
+    s.bikeId = b.id;
+    s.sequence = b.sequence++;
+    s.speed100 = (uint16_t)(b.cadence * 30);
+    s.cadence2 = (uint16_t)(b.cadence * 2);
+    s.power = (int16_t)(b.cadence * 2);
+    s.crankRevolutions = b.crankRevolutions;
+    s.crankEventTime1024 = (uint16_t)((now * 128) / 125000);
+    s.resistanceLevel10 = 30;
+
+    Tx tx;
+    tx.start = now;
+    tx.bike = i;
+    tx.collided = false;
+    MicroBitIndoorBikeRadioFrame::encode(s, tx.frame);
+    stats.sent++;
+    air(tx);
+}
+
+void Simulation::air(const Tx &tx)
+{
+    Tx t = tx;
+    if (pending && t.start < busyUntil) {
+        pendingTx.collided = true;
+        t.collided = true;
+    }
+    if (pending) {
+        // nothing starting later can overlap the pending frame any more
+        if (pendingTx.collided) {
+            stats.collided++;
+        } else if (chance(opt.loss)) {
+            stats.lost++;
+        } else if (chance(opt.late)) {
+            stats.late++;
+            Late l = { pendingTx.start + LATE_US, pendingTx };
+            lateQueue.push(l);
+        } else {
+            deliver(pendingTx, pendingTx.start + AIRTIME_US, false);
+            if (chance(opt.dup)) {
+                stats.duplicated++;
+                deliver(pendingTx, pendingTx.start + AIRTIME_US, true);
+            }
+        }
+    }
+    pending = true;
+    pendingTx = t;
+    if (t.start + AIRTIME_US > busyUntil) {
+        busyUntil = t.start + AIRTIME_US;
+    }
+}
+
+void Simulation::deliver(const Tx &tx, uint64_t now, bool duplicate)
+{
+    MicroBitIndoorBikeRadioSnapshot s;
+    if (!MicroBitIndoorBikeRadioFrame::decode(tx.frame, sizeof(tx.frame), &s)) {
+        fail("frame does not decode", bikes[tx.bike], 0);
+        return;
+    }
+    Bike &b = bikes[tx.bike];
+    uint32_t ms = (uint32_t)(now / 1000);
+    stats.delivered++;
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    int result = table->accept(s, -60, ms);
+    stats.acceptNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+
+    if (result != MICROBIT_INDOOR_BIKE_RADIO_ACCEPTED) {
+        return;
+    }
+    if (duplicate) {
+        fail("duplicate accepted", b, s.sequence);
+    }
+    if (b.seen && (uint32_t)(ms - b.lastAccepted) < MICROBIT_INDOOR_BIKE_RADIO_HUB_RESYNC_MS) {
+        if ((int16_t)(s.sequence - b.lastSequence) <= 0) {
+            fail("sequence went backwards", b, s.sequence);
+        }
+        if (s.crankRevolutions < b.lastRevolutions) {
+            fail("crank revolutions went backwards", b, s.sequence);
+        }
+    }
+    bool stored = false;
+    for (int i = 0; i < MICROBIT_INDOOR_BIKE_RADIO_HUB_SIZE; i++) {
+        const MicroBitIndoorBikeRadioEntry *e = table->get(i);
+        if (e != NULL && e->snapshot.bikeId == s.bikeId) {
+            stored = memcmp(&e->snapshot, &s, sizeof(s)) == 0 && e->lastSeen == ms;
+            break;
+        }
+    }
+    if (!stored) {
+        fail("accepted frame not stored", b, s.sequence);
+    }
+    b.seen = true;
+    b.lastSequence = s.sequence;
+    b.lastRevolutions = s.crankRevolutions;
+    b.lastAccepted = ms;
+}
+
+int Simulation::run()
+{
+    typedef std::pair<uint64_t, int> Event;   // next send time, bike
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event> > schedule;
+
+    bikes.resize(opt.senders);
+    for (int i = 0; i < opt.senders; i++) {
+        Bike &b = bikes[i];
+        memset(&b, 0, sizeof(b));
+        b.id = 0x9E000000u + (uint32_t)rng() % 0x01000000u;
+        for (int j = 0; j < i; j++) {
+            if (bikes[j].id == b.id) {
+                b.id++;
+                j = -1;
+            }
+        }
+        b.cadence = std::uniform_real_distribution<double>(60, 100)(rng);
+        b.period = (int64_t)PERIOD_US + std::uniform_int_distribution<int>(-200, 200)(rng);
+        schedule.push(Event(std::uniform_int_distribution<uint64_t>(0, PERIOD_US - 1)(rng), i));
+    }
+
+    const uint64_t end = (uint64_t)opt.seconds * 1000000;
+    uint64_t nextTick = PERIOD_US;
+    while (!schedule.empty() && schedule.top().first < end) {
+        Event ev = schedule.top();
+        schedule.pop();
+        uint64_t now = ev.first;
+
+        while (!lateQueue.empty() && lateQueue.top().at <= now) {
+            deliver(lateQueue.top().tx, lateQueue.top().at, false);
+            lateQueue.pop();
+        }
+        // the hub streams and expires once a period
+        while (nextTick <= now) {
+            table->expire((uint32_t)(nextTick / 1000));
+            for (int i = 0; i < MICROBIT_INDOOR_BIKE_RADIO_HUB_SIZE; i++) {
+                const MicroBitIndoorBikeRadioEntry *e = table->get(i);
+                if (e != NULL && (uint32_t)(nextTick / 1000 - e->lastSeen) < 2 * PERIOD_US / 1000) {
+                    stats.fresh++;
+                }
+            }
+            stats.samples += opt.senders;
+            nextTick += PERIOD_US;
+        }
+
+        send(ev.second, now);
+        schedule.push(Event(now + bikes[ev.second].period, ev.second));
+    }
+
+    printf("senders %d, %d s, hub table %d entries\n", opt.senders, opt.seconds, MICROBIT_INDOOR_BIKE_RADIO_HUB_SIZE);
+    printf("frames sent %llu, collided %llu (%.2f%%), lost %llu, late %llu, duplicated %llu, reboots %llu\n",
+            (unsigned long long)stats.sent, (unsigned long long)stats.collided,
+            stats.sent ? 100.0 * stats.collided / stats.sent : 0.0,
+            (unsigned long long)stats.lost, (unsigned long long)stats.late,
+            (unsigned long long)stats.duplicated, (unsigned long long)stats.reboots);
+    printf("hub accepted %lu, duplicates %lu, stale %lu, table full %lu, bikes %d\n",
+            (unsigned long)table->accepted, (unsigned long)table->duplicates,
+            (unsigned long)table->stale, (unsigned long)table->full, table->count());
+    printf("fresh data %.2f%% of bike-seconds, accept() %.1f ns/frame\n",
+            stats.samples ? 100.0 * stats.fresh / stats.samples : 0.0,
+            stats.delivered ? stats.acceptNs / stats.delivered : 0.0);
+
+    if (opt.senders > MICROBIT_INDOOR_BIKE_RADIO_HUB_SIZE && table->full == 0) {
+        fprintf(stderr, "radio_sim: more senders than entries but no table full\n");
+        failures++;
+    }
+    if (table->count() > MICROBIT_INDOOR_BIKE_RADIO_HUB_SIZE) {
+        fprintf(stderr, "radio_sim: table overflow\n");
+        failures++;
+    }
+    if (failures != 0) {
+        fprintf(stderr, "radio_sim: %d failure(s)\n", failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options opt;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char *k = argv[i];
+        const char *v = argv[i + 1];
+        if (strcmp(k, "--senders") == 0) {
+            opt.senders = atoi(v);
+        } else if (strcmp(k, "--seconds") == 0) {
+            opt.seconds = atoi(v);
+        } else if (strcmp(k, "--loss") == 0) {
+            opt.loss = atof(v);
+        } else if (strcmp(k, "--dup") == 0) {
+            opt.dup = atof(v);
+        } else if (strcmp(k, "--late") == 0) {
+            opt.late = atof(v);
+        } else if (strcmp(k, "--reboot") == 0) {
+            opt.reboot = atof(v);
+        } else if (strcmp(k, "--seed") == 0) {
+            opt.seed = (uint32_t)strtoul(v, NULL, 0);
+        } else {
+            fprintf(stderr, "radio_sim: unknown option %s\n", k);
+            return EXIT_FAILURE;
+        }
+    }
+    if (opt.senders < 1 || opt.seconds < 1) {
+        fprintf(stderr, "radio_sim: --senders and --seconds must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    Simulation sim(opt);
+    return sim.run();
+}
@@ -0,0 +1,294 @@
+/*
+ * ride_log_export_sim.cpp
+ *
+ * Simulation of the BLE bulk export of the ride log (MicroBitRideLogService):
+ * the firmware MicroBitRideLog and MicroBitRideLogCursor on a flash in RAM,
+ * a link that carries a few notifications per connection event out of a
+ * small transmit queue, and a reader that reassembles the blocks.
+ *
+ *  - The queue is refilled after every connection event, as the service does
+ *    on the TX complete events of the stack.
+ *  - The link drops now and then: the queued packets are lost and the reader
+ *    resumes at its first missing byte.
+ *  - Packets are corrupted now and then: the block CRC catches them and the
+ *    reader asks for the block again.
+ *
+ * Every block must arrive intact and decode to the edges in the flash.
+ *
+ * usage: ride_log_export_sim [--pages N] [--buffers N] [--per-event N]
+ *                            [--disconnect P] [--corrupt P] [--seed N]
+ */
+
+#include "MicroBitRideLog.h"
+#include "MicroBitRideLogCursor.h"
+#include "struct.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct Options {
+    int pages = 8;
+    int buffers = 7;            // transmit buffers of the stack
+    int perEvent = 6;           // notifications per connection event
+    double disconnect = 0.002;  // per connection event
+    double corrupt = 0.001;     // per packet
+    unsigned seed = 1;
+};
+
+// Flash of the ride log in RAM: a write can only clear bits
+class RamFlash : public MicroBitConfigFlash {
+public:
+    explicit RamFlash(int pages) : words(pages * MICROBIT_CONFIG_STORE_PAGE_WORDS, 0xFFFFFFFFu) {}
+
+    uint32_t *page(int index) override { return &words[index * MICROBIT_CONFIG_STORE_PAGE_WORDS]; }
+
+    int write(uint32_t *address, const uint32_t *data, int n) override
+    {
+        for (int i = 0; i < n; i++) {
+            address[i] &= data[i];
+        }
+        return MICROBIT_CONFIG_STORE_OK;
+    }
+
+    int erase(uint32_t *page) override
+    {
+        std::fill(page, page + MICROBIT_CONFIG_STORE_PAGE_WORDS, 0xFFFFFFFFu);
+        return MICROBIT_CONFIG_STORE_OK;
+    }
+
+private:
+    std::vector<uint32_t> words;
+};
+
+typedef std::vector<uint8_t> Packet;
+
+// The reader side: blocks in order, resume position after a drop
+class Reader {
+public:
+    // @return false once the end of the export arrived
+    bool receive(const Packet &p);
+
+    uint32_t resumeSequence() const { return sequence; }
+    uint16_t resumeOffset() const { return (uint16_t)block.size(); }
+
+    std::map<uint32_t, std::vector<uint8_t> > blocks;
+    unsigned long crcErrors = 0;
+    unsigned long outOfOrder = 0;
+    // a block failed its CRC: Start at its first byte
+    bool restart = false;
+
+private:
+    uint32_t sequence = 0;      // block being received, 0: the oldest
+    std::vector<uint8_t> block;
+    // packets in flight before the restart are ignored
+    bool waiting = false;
+};
+
+bool Reader::receive(const Packet &p)
+{
+    uint32_t seq;
+    uint16_t offset;
+    struct_unpack(&p[0], MICROBIT_RIDE_LOG_CURSOR_FORMAT_DATA, &seq, &offset);
+
+    if (waiting) {
+        if (seq != sequence || offset != 0) {
+            return true;
+        }
+        waiting = false;
+    }
+
+    if (offset == MICROBIT_RIDE_LOG_CURSOR_END_OFFSET) {
+        uint16_t length, crc;
+        struct_unpack(&p[0], MICROBIT_RIDE_LOG_CURSOR_FORMAT_END, &seq, &offset, &length, &crc);
+        if (seq == 0) {
+            return false;
+        }
+        if (seq != sequence && sequence != 0) {
+            outOfOrder++;
+        }
+        if (block.size() == length && MicroBitRideLogCursor::crc16(0xFFFF, &block[0], length) == crc) {
+            blocks[seq] = block;
+            sequence = seq + 1;
+        } else {
+            // from the start of the block again
+            crcErrors++;
+            sequence = seq;
+            restart = true;
+            waiting = true;
+        }
+        block.clear();
+        return true;
+    }
+
+    if (seq != sequence) {
+        // the oldest block, or the next one when a block vanished
+        if (offset != 0 || (sequence != 0 && seq < sequence)) {
+            outOfOrder++;
+            return true;
+        }
+        sequence = seq;
+        block.clear();
+    }
+    if (offset != block.size()) {
+        outOfOrder++;
+        return true;
+    }
+    block.insert(block.end(), p.begin() + 6, p.end());
+    return true;
+}
+
+void fillLog(MicroBitRideLog &log, int pages, std::mt19937 &rng)
+{
+    uint64_t t = 1000000;
+    double rpm = 85;
+    uint32_t sequence = 0;
+    // ride until the ring wrapped once
+    while (log.getBlock(pages, &sequence) == NULL) {
+        rpm = std::min(120.0, std::max(40.0, rpm + (int)(rng() % 5) - 2));
+        t += (uint64_t)(60e6 / rpm) + rng() % 20000;
+        log.edge(t);
+        while (log.service() == MICROBIT_RIDE_LOG_BUSY) {
+        }
+    }
+    log.flush();
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options o;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--pages") == 0) {
+            o.pages = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--buffers") == 0) {
+            o.buffers = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--per-event") == 0) {
+            o.perEvent = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--disconnect") == 0) {
+            o.disconnect = atof(argv[i + 1]);
+        } else if (strcmp(argv[i], "--corrupt") == 0) {
+            o.corrupt = atof(argv[i + 1]);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            o.seed = (unsigned)atoi(argv[i + 1]);
+        } else {
+            fprintf(stderr, "ride_log_export_sim: unknown option %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::mt19937 rng(o.seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    RamFlash flash(o.pages);
+    MicroBitRideLog log(flash, o.pages);
+    log.begin();
+    fillLog(log, o.pages, rng);
+
+    MicroBitRideLogCursor cursor(log);
+    Reader reader;
+    std::deque<Packet> queue;
+    unsigned long events = 0, packets = 0, drops = 0;
+    bool connected = true;
+    cursor.start(0, 0);
+
+    for (bool running = true; running; events++) {
+        if (events > 1000000) {
+            fprintf(stderr, "ride_log_export_sim: no progress\n");
+            return EXIT_FAILURE;
+        }
+        if (!connected) {
+            // reconnect, Start at the first missing byte
+            connected = true;
+            cursor.start(reader.resumeSequence(), reader.resumeOffset());
+        }
+
+        // pump(): fill the transmit buffers
+        while ((int)queue.size() < o.buffers) {
+            Packet p(MICROBIT_RIDE_LOG_CURSOR_PACKET_MAX);
+            int len = cursor.peek(&p[0]);
+            if (len == 0) {
+                break;
+            }
+            p.resize(len);
+            queue.push_back(p);
+            cursor.advance();
+        }
+
+        // connection event
+        if (uniform(rng) < o.disconnect) {
+            queue.clear();
+            connected = false;
+            drops++;
+            continue;
+        }
+        for (int i = 0; i < o.perEvent && !queue.empty() && running; i++) {
+            Packet p = queue.front();
+            queue.pop_front();
+            packets++;
+            if (uniform(rng) < o.corrupt) {
+                p[p.size() > 6 ? 6 + rng() % (p.size() - 6) : 0] ^= 0x20;
+            }
+            running = reader.receive(p);
+        }
+        if (reader.restart) {
+            reader.restart = false;
+            cursor.start(reader.resumeSequence(), 0);
+        }
+    }
+
+    // compare with the flash
+    int failures = 0;
+    size_t blocks = 0, bytes = 0;
+    uint32_t after = 0, sequence;
+    const uint8_t *block;
+    static uint32_t expected[MICROBIT_RIDE_LOG_BLOCK_EDGES_MAX];
+    static uint32_t got[MICROBIT_RIDE_LOG_BLOCK_EDGES_MAX];
+    while ((block = log.getBlock(after, &sequence)) != NULL) {
+        int len = MicroBitRideLog::getBlockLength(block);
+        std::map<uint32_t, std::vector<uint8_t> >::iterator it = reader.blocks.find(sequence);
+        if (it == reader.blocks.end() || it->second.size() != (size_t)len
+                || memcmp(&it->second[0], block, len) != 0) {
+            fprintf(stderr, "ride_log_export_sim: block %u missing or different\n", sequence);
+            failures++;
+        } else {
+            uint32_t s1, s2;
+            uint16_t session1, session2;
+            uint8_t pulses1, pulses2;
+            int n1 = MicroBitRideLog::decode(block, len, &s1, &session1, &pulses1, expected);
+            int n2 = MicroBitRideLog::decode(&it->second[0], len, &s2, &session2, &pulses2, got);
+            if (n1 <= 0 || n1 != n2 || pulses1 != pulses2 || !std::equal(expected, expected + n1, got)) {
+                fprintf(stderr, "ride_log_export_sim: block %u decodes differently\n", sequence);
+                failures++;
+            }
+        }
+        blocks++;
+        bytes += len;
+        after = sequence;
+    }
+    if (reader.blocks.size() != blocks) {
+        fprintf(stderr, "ride_log_export_sim: %zu blocks received, %zu in the flash\n", reader.blocks.size(), blocks);
+        failures++;
+    }
+
+    // one notification per connection event would take one event per packet
+    size_t single = 0;
+    for (after = 0; (block = log.getBlock(after, &sequence)) != NULL; after = sequence) {
+        int len = MicroBitRideLog::getBlockLength(block);
+        single += (len + MICROBIT_RIDE_LOG_CURSOR_DATA_MAX - 1) / MICROBIT_RIDE_LOG_CURSOR_DATA_MAX + 1;
+    }
+    single++;
+    printf("%zu blocks, %zu bytes: %lu connection events (%lu packets, %lu drops, %lu CRC errors), "
+            "%.0f bytes/s at 30 ms; one per event: %zu events\n",
+            blocks, bytes, events, packets, drops, reader.crcErrors, bytes / (events * 0.030), single);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
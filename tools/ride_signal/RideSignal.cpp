@@ -0,0 +1,157 @@
+/*
+ * RideSignal.cpp
+ */
+
+#include "RideSignal.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <random>
+
+RideProfile &RideProfile::ramp(double seconds, double rpm)
+{
+    RideSegment s;
+    s.seconds = seconds;
+    s.rpmStart = segments.empty() ? rpm : segments.back().rpmEnd;
+    s.rpmEnd = rpm;
+    segments.push_back(s);
+    return *this;
+}
+
+RideProfile &RideProfile::hold(double seconds, double rpm)
+{
+    RideSegment s;
+    s.seconds = seconds;
+    s.rpmStart = rpm;
+    s.rpmEnd = rpm;
+    segments.push_back(s);
+    return *this;
+}
+
+RideProfile RideProfile::steady(double rpm, double seconds)
+{
+    RideProfile p;
+    p.name = "steady";
+    p.hold(seconds, rpm);
+    return p;
+}
+
+RideProfile RideProfile::intervals(double restRpm, double workRpm, double workSeconds, double restSeconds, int count)
+{
+    RideProfile p;
+    p.name = "intervals";
+    p.hold(30, restRpm);
+    for (int i = 0; i < count; i++) {
+        p.ramp(2, workRpm).hold(workSeconds - 2, workRpm);
+        p.ramp(2, restRpm).hold(restSeconds - 2, restRpm);
+    }
+    return p;
+}
+
+RideProfile RideProfile::sprints(double cruiseRpm, double sprintRpm, int count)
+{
+    RideProfile p;
+    p.name = "sprints";
+    p.hold(30, cruiseRpm);
+    for (int i = 0; i < count; i++) {
+        p.ramp(4, sprintRpm).hold(8, sprintRpm);
+        p.ramp(6, cruiseRpm).hold(40, cruiseRpm);
+    }
+    return p;
+}
+
+RideProfile RideProfile::stops(double rpm, double rideSeconds, double stopSeconds, int count)
+{
+    RideProfile p;
+    p.name = "stops";
+    for (int i = 0; i < count; i++) {
+        p.hold(1, 0).ramp(3, rpm).hold(rideSeconds - 3, rpm);
+        p.ramp(2, 0).hold(stopSeconds - 3, 0);
+    }
+    return p;
+}
+
+double RideProfile::seconds(void) const
+{
+    double t = 0;
+    for (size_t i = 0; i < segments.size(); i++) {
+        t += segments[i].seconds;
+    }
+    return t;
+}
+
+RideSignal::RideSignal(const RideProfile &profile, const RideNoise &noise, uint32_t seed, uint64_t startUs)
+    : profile(profile), drift(noise.driftPpm * 1e-6), start(startUs)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::normal_distribution<double> jitter(0.0, noise.jitterUs > 0 ? noise.jitterUs : 1.0);
+    const int pulses = std::max(1, noise.pulses);
+
+    // crank angle (revolutions) at the start of the segment, next magnet to pass
+    double phase = 0, segmentStart = 0;
+    long magnet = 1;
+    for (size_t i = 0; i < profile.segments.size(); i++) {
+        const RideSegment &s = profile.segments[i];
+        // phase(t) = (r0 t + (r1 - r0) t^2 / 2T) / 60
+        double a = (s.rpmEnd - s.rpmStart) / (2 * s.seconds * 60);
+        double b = s.rpmStart / 60;
+        for (;;) {
+            double c = phase - (double)magnet / pulses;
+            double t;
+            if (fabs(a) < 1e-12) {
+                t = (b > 0) ? -c / b : INFINITY;
+            } else {
+                double d = b * b - 4 * a * c;
+                t = (d < 0) ? INFINITY : (-b + sqrt(d)) / (2 * a);
+            }
+            if (!(t >= 0 && t <= s.seconds)) {
+                break;
+            }
+            double edge = (segmentStart + t) * 1e6 * (1 + drift) + start;
+            if (noise.jitterUs > 0) {
+                edge += jitter(rng);
+            }
+            if (uniform(rng) < noise.missed) {
+                missed++;
+            } else {
+                edges.push_back((uint64_t)edge);
+                if (uniform(rng) < noise.bounce) {
+                    for (int n = 1 + rng() % 3; n > 0; n--) {
+                        edges.push_back((uint64_t)edge + 1000 + rng() % std::max(1u, noise.bounceMaxUs - 1000));
+                        bounces++;
+                    }
+                }
+            }
+            magnet++;
+        }
+        phase += (s.rpmStart * s.seconds + (s.rpmEnd - s.rpmStart) * s.seconds / 2) / 60;
+        segmentStart += s.seconds;
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+}
+
+double RideSignal::toTrueSeconds(uint64_t timeUs) const
+{
+    return ((double)timeUs - start) / (1e6 * (1 + drift));
+}
+
+double RideSignal::getCadence(uint64_t timeUs) const
+{
+    double t = toTrueSeconds(timeUs);
+    for (size_t i = 0; i < profile.segments.size(); i++) {
+        const RideSegment &s = profile.segments[i];
+        if (t < s.seconds) {
+            return (t < 0) ? 0 : s.rpmStart + (s.rpmEnd - s.rpmStart) * t / s.seconds;
+        }
+        t -= s.seconds;
+    }
+    return 0;
+}
+
+uint64_t RideSignal::getEnd(void) const
+{
+    return start + (uint64_t)(profile.seconds() * 1e6 * (1 + drift));
+}
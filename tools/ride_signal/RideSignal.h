@@ -0,0 +1,90 @@
+/*
+ * RideSignal.h
+ *
+ * Synthetic STEP signal for the host tools: a cadence profile turns the
+ * crank, magnets on the crank make the edges, and the noise model spoils
+ * them the way a reed switch on a real bike does.
+ *
+ *  - Profiles are made of segments whose cadence ramps linearly from one
+ *    value to another (0 rpm: the rider stops).
+ *  - Gaussian jitter moves every edge, contact bounce adds short extra
+ *    edges after one, missed pulses drop edges, and clock drift stretches
+ *    the time line as the sensor's clock sees it.
+ *
+ * The true cadence is kept, on the sensor's clock, to score the output of
+ * the sensor against.
+ */
+
+#ifndef RIDE_SIGNAL_H
+#define RIDE_SIGNAL_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+struct RideSegment {
+    double seconds;
+    double rpmStart;
+    double rpmEnd;
+};
+
+class RideProfile {
+public:
+    // a segment, ramping from the end of the previous one
+    RideProfile &ramp(double seconds, double rpm);
+    // a segment at a constant cadence
+    RideProfile &hold(double seconds, double rpm);
+
+    // constant cadence
+    static RideProfile steady(double rpm, double seconds);
+    // work and rest intervals with short ramps
+    static RideProfile intervals(double restRpm, double workRpm, double workSeconds, double restSeconds, int count);
+    // sprints from a cruise, a few seconds of hard spin-up each
+    static RideProfile sprints(double cruiseRpm, double sprintRpm, int count);
+    // riding with full stops between the rides
+    static RideProfile stops(double rpm, double rideSeconds, double stopSeconds, int count);
+
+    double seconds(void) const;
+
+    std::string name;
+    std::vector<RideSegment> segments;
+};
+
+struct RideNoise {
+    double jitterUs = 0;            // standard deviation of every edge
+    double bounce = 0;              // probability of contact bounce per edge
+    uint32_t bounceMaxUs = 15000;   // bounces follow the edge within this time
+    double missed = 0;              // probability of a missed pulse
+    double driftPpm = 0;            // sensor clock against true time
+    int pulses = 1;                 // magnets per revolution, evenly spaced
+};
+
+class RideSignal {
+public:
+    // edges of the profile from startUs on (sensor clock)
+    RideSignal(const RideProfile &profile, const RideNoise &noise, uint32_t seed, uint64_t startUs = 1000000);
+
+    // STEP edges (us, sensor clock), in order
+    const std::vector<uint64_t> &getEdges(void) const { return edges; }
+
+    // true cadence (rpm) at a time of the sensor clock
+    double getCadence(uint64_t timeUs) const;
+
+    // end of the profile (us, sensor clock)
+    uint64_t getEnd(void) const;
+
+    // edges the noise added and removed
+    unsigned long bounces = 0;
+    unsigned long missed = 0;
+
+private:
+    double toTrueSeconds(uint64_t timeUs) const;
+
+    RideProfile profile;
+    double drift;
+    uint64_t start;
+    std::vector<uint64_t> edges;
+};
+
+#endif /* RIDE_SIGNAL_H */
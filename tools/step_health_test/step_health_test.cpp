@@ -0,0 +1,123 @@
+/*
+ * step_health_test.cpp
+ *
+ * Test of the firmware MicroBitStepHealth on STEP edge streams with the
+ * faults it is there to find:
+ *
+ *  - A clean ride: no bounces, no missed pulses, the histogram around the
+ *    cadence.
+ *  - A bouncing reed switch: extra edges a few ms after the real ones.
+ *  - A weak magnet: pulses dropped now and then.
+ *  - Stops, and the bucket boundaries.
+ *
+ * usage: step_health_test
+ */
+
+#include "MicroBitStepHealth.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <random>
+
+namespace {
+
+int failures = 0;
+
+void expect(bool cond, const char *what, long value)
+{
+    if (!cond && failures++ < 16) {
+        fprintf(stderr, "step_health_test: %s (%ld)\n", what, value);
+    }
+}
+
+void print(const char *name, MicroBitStepHealth &h)
+{
+    printf("%s: edges %u, bounces %u, missed %u, stops %u, typical %u us, histogram [",
+            name, h.getEdges(), h.getBounces(), h.getMissed(), h.getStops(), h.getTypicalInterval());
+    for (int i = 0; i < MICROBIT_STEP_HEALTH_BUCKETS; i++) {
+        printf("%s%u", i ? " " : "", h.getHistogram(i));
+    }
+    printf("]\n");
+}
+
+// ride at 70 ~ 90 rpm, with bounces and misses at the given rates
+void ride(MicroBitStepHealth &h, int revolutions, double bounce, double miss, unsigned seed, int *bounces, int *misses)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    uint64_t t = 1000000;
+    *bounces = 0;
+    *misses = 0;
+    for (int i = 0; i < revolutions; i++) {
+        t += 60000000 / (70 + rng() % 21);
+        if (uniform(rng) < miss) {
+            (*misses)++;
+            continue;
+        }
+        h.edge(t);
+        if (uniform(rng) < bounce) {
+            (*bounces)++;
+            h.edge(t + 1000 + rng() % 8000);
+        }
+    }
+}
+
+} // namespace
+
+int main()
+{
+    MicroBitStepHealth h;
+    int bounces, misses;
+
+    ride(h, 1000, 0, 0, 1, &bounces, &misses);
+    print("clean", h);
+    expect(h.getBounces() == 0, "clean: bounces", h.getBounces());
+    expect(h.getMissed() == 0, "clean: missed", h.getMissed());
+    expect(h.getEdges() == 1000, "clean: edges", h.getEdges());
+    // 667 ~ 857 ms: buckets of 512 ~ 724 and 724 ~ 1024 ms
+    expect(h.getHistogram(10) + h.getHistogram(11) == 999, "clean: histogram", h.getHistogram(10) + h.getHistogram(11));
+
+    h.reset();
+    ride(h, 1000, 0.05, 0, 2, &bounces, &misses);
+    print("bouncing switch", h);
+    expect(h.getBounces() == bounces, "bouncing: bounces", h.getBounces());
+    expect(h.getMissed() == 0, "bouncing: missed", h.getMissed());
+
+    h.reset();
+    ride(h, 1000, 0, 0.03, 3, &bounces, &misses);
+    print("weak magnet", h);
+    expect(h.getBounces() == 0, "weak magnet: bounces", h.getBounces());
+    // two misses in a row are three intervals: counted as one at most
+    expect(h.getMissed() <= misses && h.getMissed() >= misses * 9 / 10, "weak magnet: missed", h.getMissed());
+
+    // a stop forgets the interval and the typical cadence
+    h.reset();
+    for (int i = 0; i < 10; i++) {
+        h.edge(1000000 + i * 300000);
+    }
+    h.stop();
+    expect(h.getTypicalInterval() == 0, "stop: typical", h.getTypicalInterval());
+    for (int i = 0; i < 10; i++) {
+        h.edge(20000000 + i * 600000);
+    }
+    expect(h.getMissed() == 0, "stop: slower cadence is no missed pulse", h.getMissed());
+    expect(h.getStops() == 1, "stop: count", h.getStops());
+
+    // buckets: half octaves from 16 ms
+    expect(MicroBitStepHealth::getBucket(0) == 0, "bucket of 0", MicroBitStepHealth::getBucket(0));
+    expect(MicroBitStepHealth::getBucket(22000) == 0, "bucket of 22 ms", MicroBitStepHealth::getBucket(22000));
+    expect(MicroBitStepHealth::getBucket(23000) == 1, "bucket of 23 ms", MicroBitStepHealth::getBucket(23000));
+    expect(MicroBitStepHealth::getBucket(32000) == 2, "bucket of 32 ms", MicroBitStepHealth::getBucket(32000));
+    expect(MicroBitStepHealth::getBucket(1000000) == 11, "bucket of 1 s", MicroBitStepHealth::getBucket(1000000));
+    expect(MicroBitStepHealth::getBucket(0xFFFFFFFF) == MICROBIT_STEP_HEALTH_BUCKETS - 1, "last bucket",
+            MicroBitStepHealth::getBucket(0xFFFFFFFF));
+
+    if (failures) {
+        fprintf(stderr, "step_health_test: %d failure(s)\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("step_health_test: ok\n");
+    return EXIT_SUCCESS;
+}
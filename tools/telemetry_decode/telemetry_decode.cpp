@@ -0,0 +1,657 @@
+/*
+ * telemetry_decode.cpp
+ *
+ * Decoder for the binary telemetry stream of MicroBitTelemetry: splits the
+ * serial stream at the 0x00 delimiters, undoes COBS and prints one line per
+ * record. Malformed frames (lost or corrupted bytes) are counted and skipped;
+ * decoding resumes at the next delimiter.
+ *
+ * The blocks of a ride log export (button A+B) are collected and printed as
+ * one RIDE line per STEP edge at the end of the export: the time is the
+ * device clock of the session (a session per boot), and the cadence comes
+ * from the interval and the STEP pulses per crank revolution of the block.
+ *
+ * usage: telemetry_decode [device|file|-]   (default: stdin)
+ *        telemetry_decode --selftest
+ *
+ * A tty is switched to raw mode at 115200 baud, e.g.
+ *        telemetry_decode /dev/ttyACM0
+ */
+
+#include "MicroBitTelemetryFrame.h"
+#include "MicroBitCadencePredictor.h"
+#include "MicroBitRideLog.h"
+#include "struct.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Stats {
+    unsigned long frames = 0;
+    unsigned long malformed = 0;
+    unsigned long unknown = 0;
+    unsigned long dropped = 0;
+    unsigned long rideBlocks = 0;
+    unsigned long rideEdges = 0;
+};
+
+struct RideEdge {
+    uint16_t session;
+    uint8_t pulses;                     // per crank revolution
+    uint32_t ticks;                     // 1/1024 s since boot
+};
+
+class Decoder {
+public:
+    explicit Decoder(FILE *out) : out(out) {}
+
+    // feed raw bytes from the serial port
+    void feed(const uint8_t *data, size_t len);
+    // print the ride log blocks received so far
+    void rideLog();
+
+    Stats stats;
+    std::vector<std::string> lines;     // kept for --selftest
+    std::vector<RideEdge> edges;        // kept for --selftest
+    bool keep = false;
+
+private:
+    void frame(const uint8_t *data, size_t len);
+    void record(const uint8_t *r, int len);
+    void print(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+    double seconds(uint32_t time);
+
+    FILE *out;
+    std::vector<uint8_t> pending;
+    bool haveTime = false;
+    uint32_t lastTime = 0;
+    uint64_t epoch = 0;                 // added to the 32-bit timestamps after each wrap
+    std::map<uint32_t, std::vector<uint8_t> > blocks;   // ride log export, by block sequence number
+};
+
+void Decoder::feed(const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] == 0x00) {
+            if (!pending.empty()) {
+                frame(&pending[0], pending.size());
+                pending.clear();
+            }
+        } else if (pending.size() < MICROBIT_TELEMETRY_FRAME_MAX) {
+            pending.push_back(data[i]);
+        } else {
+            // no delimiter where one must be: skip to the next one
+            stats.malformed++;
+            pending.clear();
+            pending.push_back(0xFF);    // poisons the frame until the delimiter
+        }
+    }
+}
+
+void Decoder::frame(const uint8_t *data, size_t len)
+{
+    uint8_t r[MICROBIT_TELEMETRY_FRAME_MAX];
+    int n = MicroBitTelemetryFrame::decode(data, (int)len, r);
+    if (n < MICROBIT_TELEMETRY_RECORD_HEADER_SIZE || n > MICROBIT_TELEMETRY_RECORD_MAX) {
+        stats.malformed++;
+        return;
+    }
+    stats.frames++;
+    record(r, n);
+}
+
+double Decoder::seconds(uint32_t time)
+{
+    // the firmware sends the low 32 bits of a microsecond clock (wraps every 71.6 minutes)
+    if (haveTime && time < lastTime && lastTime - time > 0x80000000u) {
+        epoch += 0x100000000ull;
+    }
+    haveTime = true;
+    lastTime = time;
+    return (double)(epoch + time) / 1e6;
+}
+
+void Decoder::print(const char *fmt, ...)
+{
+    char line[256];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (keep) {
+        lines.push_back(line);
+    }
+    if (out != NULL) {
+        fprintf(out, "%s\n", line);
+    }
+}
+
+void Decoder::record(const uint8_t *r, int len)
+{
+    uint8_t type;
+    uint32_t time;
+    struct_unpack(r, "<BI", &type, &time);
+
+    switch (type) {
+    case MICROBIT_TELEMETRY_RECORD_STEP_EDGE: {
+        uint32_t revolutions;
+        if (len != struct_calcsize(MICROBIT_TELEMETRY_FORMAT_STEP_EDGE)) {
+            break;
+        }
+        struct_unpack(r, MICROBIT_TELEMETRY_FORMAT_STEP_EDGE, &type, &time, &revolutions);
+        print("%.6f STEP revolutions=%u", seconds(time), revolutions);
+        return;
+    }
+    case MICROBIT_TELEMETRY_RECORD_SAMPLE: {
+        uint32_t interval;
+        uint16_t speed100, cadence2;
+        int16_t power;
+        uint8_t resistance10;
+        if (len != struct_calcsize(MICROBIT_TELEMETRY_FORMAT_SAMPLE)) {
+            break;
+        }
+        struct_unpack(r, MICROBIT_TELEMETRY_FORMAT_SAMPLE, &type, &time, &interval, &speed100, &cadence2, &power, &resistance10);
+        print("%.6f SAMPLE interval_us=%u speed_kmh=%.2f cadence_rpm=%.1f power_w=%d resistance=%.1f",
+                seconds(time), interval, speed100 / 100.0, cadence2 / 2.0, power, resistance10 / 10.0);
+        return;
+    }
+    case MICROBIT_TELEMETRY_RECORD_CONTROL_POINT: {
+        uint16_t handle;
+        uint8_t result, n;
+        int header = struct_calcsize(MICROBIT_TELEMETRY_FORMAT_CONTROL_POINT);
+        if (len < header) {
+            break;
+        }
+        struct_unpack(r, MICROBIT_TELEMETRY_FORMAT_CONTROL_POINT, &type, &time, &handle, &result, &n);
+        if (len != header + n) {
+            break;
+        }
+        std::string data;
+        for (int i = 0; i < n; i++) {
+            char hex[8];
+            snprintf(hex, sizeof(hex), "%s%02X", i ? " " : "", r[header + i]);
+            data += hex;
+        }
+        print("%.6f CP conn=%u op=0x%02X result=0x%02X data=[%s]",
+                seconds(time), handle, n ? r[header] : 0, result, data.c_str());
+        return;
+    }
+    case MICROBIT_TELEMETRY_RECORD_ANALYTICS: {
+        int16_t average3, average10, average30;
+        uint16_t np, if1000, tss10, ftp;
+        if (len != struct_calcsize(MICROBIT_TELEMETRY_FORMAT_ANALYTICS)) {
+            break;
+        }
+        struct_unpack(r, MICROBIT_TELEMETRY_FORMAT_ANALYTICS, &type, &time, &average3, &average10, &average30, &np, &if1000, &tss10, &ftp);
+        print("%.6f ANALYTICS avg3_w=%d avg10_w=%d avg30_w=%d np_w=%u if=%.3f tss=%.1f ftp_w=%u",
+                seconds(time), average3, average10, average30, np, if1000 / 1000.0, tss10 / 10.0, ftp);
+        return;
+    }
+    case MICROBIT_TELEMETRY_RECORD_PEAKS: {
+        uint16_t best5s, best1min, best5min, best20min;
+        if (len != struct_calcsize(MICROBIT_TELEMETRY_FORMAT_PEAKS)) {
+            break;
+        }
+        struct_unpack(r, MICROBIT_TELEMETRY_FORMAT_PEAKS, &type, &time, &best5s, &best1min, &best5min, &best20min);
+        print("%.6f PEAKS best5s_w=%u best1min_w=%u best5min_w=%u best20min_w=%u",
+                seconds(time), best5s, best1min, best5min, best20min);
+        return;
+    }
+    case MICROBIT_TELEMETRY_RECORD_PREDICTION: {
+        uint32_t measured, interval;
+        uint8_t confidence;
+        if (len != struct_calcsize(MICROBIT_TELEMETRY_FORMAT_PREDICTION)) {
+            break;
+        }
+        struct_unpack(r, MICROBIT_TELEMETRY_FORMAT_PREDICTION, &type, &time, &measured, &interval, &confidence);
+        print("%.6f PREDICTION measured_us=%u interval_us=%u confidence=%u%s",
+                seconds(time), measured, interval, confidence,
+                confidence == MICROBIT_CADENCE_PREDICTOR_MEASURED ? " (measured)" : "");
+        return;
+    }
+    case MICROBIT_TELEMETRY_RECORD_HEALTH: {
+        uint32_t edges, typical;
+        uint16_t bounces, missed, stops;
+        int header = struct_calcsize(MICROBIT_TELEMETRY_FORMAT_HEALTH);
+        if (len != header + MICROBIT_TELEMETRY_HEALTH_BUCKETS * 2) {
+            break;
+        }
+        struct_unpack(r, MICROBIT_TELEMETRY_FORMAT_HEALTH, &type, &time, &edges, &bounces, &missed, &stops, &typical);
+        std::string histogram;
+        for (int i = 0; i < MICROBIT_TELEMETRY_HEALTH_BUCKETS; i++) {
+            uint16_t count;
+            char text[8];
+            struct_unpack(&r[header + i * 2], "<H", &count);
+            snprintf(text, sizeof(text), "%s%u", i ? " " : "", count);
+            histogram += text;
+        }
+        print("%.6f HEALTH edges=%u bounces=%u missed=%u stops=%u typical_us=%u histogram=[%s]",
+                seconds(time), edges, bounces, missed, stops, typical, histogram.c_str());
+        return;
+    }
+    case MICROBIT_TELEMETRY_RECORD_PIPELINE: {
+        uint16_t id;
+        int32_t value;
+        if (len != struct_calcsize(MICROBIT_TELEMETRY_FORMAT_PIPELINE)) {
+            break;
+        }
+        struct_unpack(r, MICROBIT_TELEMETRY_FORMAT_PIPELINE, &type, &time, &id, &value);
+        print("%.6f PIPELINE id=%u value=%d", seconds(time), id, value);
+        return;
+    }
+    case MICROBIT_TELEMETRY_RECORD_RIDE_LOG: {
+        uint32_t sequence;
+        uint16_t offset;
+        uint8_t n;
+        int header = struct_calcsize(MICROBIT_TELEMETRY_FORMAT_RIDE_LOG);
+        if (len < header) {
+            break;
+        }
+        struct_unpack(r, MICROBIT_TELEMETRY_FORMAT_RIDE_LOG, &type, &time, &sequence, &offset, &n);
+        if (len != header + n || offset + n > MICROBIT_CONFIG_STORE_PAGE_SIZE) {
+            break;
+        }
+        if (n == 0) {
+            rideLog();
+            return;
+        }
+        std::vector<uint8_t> &block = blocks[sequence];
+        if (block.empty()) {
+            block.assign(MICROBIT_CONFIG_STORE_PAGE_SIZE, 0xFF);
+        }
+        memcpy(&block[offset], &r[header], n);
+        return;
+    }
+    case MICROBIT_TELEMETRY_RECORD_DROPPED: {
+        uint32_t count;
+        if (len != struct_calcsize(MICROBIT_TELEMETRY_FORMAT_DROPPED)) {
+            break;
+        }
+        struct_unpack(r, MICROBIT_TELEMETRY_FORMAT_DROPPED, &type, &time, &count);
+        stats.dropped += count;
+        print("%.6f DROPPED records=%u", seconds(time), count);
+        return;
+    }
+    default:
+        stats.unknown++;
+        return;
+    }
+    stats.malformed++;
+}
+
+void Decoder::rideLog()
+{
+    static uint32_t ticks[MICROBIT_RIDE_LOG_BLOCK_EDGES_MAX];
+    bool haveLast = false;
+    uint16_t lastSession = 0;
+    uint32_t lastSequence = 0;
+    uint32_t lastTicks = 0;
+    unsigned long index = 0;
+
+    for (std::map<uint32_t, std::vector<uint8_t> >::iterator it = blocks.begin(); it != blocks.end(); ++it) {
+        uint32_t sequence;
+        uint16_t session;
+        uint8_t pulses;
+        int n = MicroBitRideLog::decode(&it->second[0], (int)it->second.size(), &sequence, &session, &pulses, ticks);
+        if (n < 0 || sequence != it->first) {
+            stats.malformed++;
+            continue;
+        }
+        stats.rideBlocks++;
+        // a session continues in the next block; a lost block breaks it
+        if (!haveLast || session != lastSession || sequence != lastSequence + 1) {
+            haveLast = false;
+            index = 0;
+        }
+        for (int i = 0; i < n; i++) {
+            uint32_t interval = haveLast ? ticks[i] - lastTicks : 0;
+            print("%.6f RIDE session=%u edge=%lu pulses=%u interval_s=%.4f cadence_rpm=%.1f",
+                    ticks[i] / 1024.0, session, index++, pulses, interval / 1024.0,
+                    interval ? 60.0 * 1024.0 / ((double)interval * pulses) : 0.0);
+            if (keep) {
+                RideEdge e = { session, pulses, ticks[i] };
+                edges.push_back(e);
+            }
+            stats.rideEdges++;
+            haveLast = true;
+            lastTicks = ticks[i];
+        }
+        lastSession = session;
+        lastSequence = sequence;
+    }
+    blocks.clear();
+}
+
+int open_input(const char *path)
+{
+    if (strcmp(path, "-") == 0) {
+        return STDIN_FILENO;
+    }
+    int fd = open(path, O_RDONLY | O_NOCTTY);
+    if (fd < 0) {
+        fprintf(stderr, "telemetry_decode: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (isatty(fd)) {
+        struct termios t;
+        if (tcgetattr(fd, &t) == 0) {
+            cfmakeraw(&t);
+            cfsetispeed(&t, B115200);
+            cfsetospeed(&t, B115200);
+            t.c_cc[VMIN] = 1;
+            t.c_cc[VTIME] = 0;
+            tcsetattr(fd, TCSANOW, &t);
+        }
+    }
+    return fd;
+}
+
+// Flash of the ride log in RAM: a write can only clear bits
+class RamFlash : public MicroBitConfigFlash {
+public:
+    explicit RamFlash(int pages) : words(pages * MICROBIT_CONFIG_STORE_PAGE_WORDS, 0xFFFFFFFFu) {}
+
+    uint32_t *page(int index) override { return &words[index * MICROBIT_CONFIG_STORE_PAGE_WORDS]; }
+
+    int write(uint32_t *address, const uint32_t *data, int n) override
+    {
+        for (int i = 0; i < n; i++) {
+            address[i] &= data[i];
+        }
+        return MICROBIT_CONFIG_STORE_OK;
+    }
+
+    int erase(uint32_t *page) override
+    {
+        std::fill(page, page + MICROBIT_CONFIG_STORE_PAGE_WORDS, 0xFFFFFFFFu);
+        return MICROBIT_CONFIG_STORE_OK;
+    }
+
+private:
+    std::vector<uint32_t> words;
+};
+
+// Rides of several boots through MicroBitRideLog, wrapping the page ring, exported like
+// MicroBitRideLogRecorder and decoded: every session must come back as a contiguous run of its edges.
+int selftestRideLog(std::mt19937 &rng)
+{
+    const int pages = 4;
+    const int sessions = 6;
+    RamFlash flash(pages);
+    std::vector<std::vector<uint32_t> > truth(sessions + 1);
+    std::vector<std::vector<uint8_t> > truthPulses(sessions + 1);
+    std::vector<bool> flushed(sessions + 1);
+    int failures = 0;
+
+    for (int s = 1; s <= sessions; s++) {
+        MicroBitRideLog log(flash, pages);
+        log.begin();
+        if (log.getSession() != s) {
+            fprintf(stderr, "selftest: ride log session %u, expected %d\n", log.getSession(), s);
+            failures++;
+        }
+        uint64_t t = 2000000 + rng() % 1000000;
+        double rpm = 60 + rng() % 40;
+        int n = 300 + (int)(rng() % 1500);
+        // magnets per session, and a change in the middle of every other one
+        uint8_t pulses = (uint8_t)(1 + s % 3);
+        log.setPulses(pulses);
+        for (int i = 0; i < n; i++) {
+            if (s % 2 == 0 && i == n / 2) {
+                pulses = (uint8_t)(pulses % 3 + 1);
+                log.setPulses(pulses);
+            }
+            // a cadence that drifts, jitter, and a rest now and then
+            rpm = std::min(120.0, std::max(40.0, rpm + (int)(rng() % 5) - 2));
+            t += (uint64_t)(60e6 / rpm) + rng() % 20000;
+            if (rng() % 200 == 0) {
+                t += 10000000 + rng() % 600000000;
+            }
+            if (!log.edge(t)) {
+                fprintf(stderr, "selftest: ride log queue full\n");
+                failures++;
+            }
+            truth[s].push_back((uint32_t)((t * 128) / 125000));
+            truthPulses[s].push_back(pulses);
+            for (int k = 1 + rng() % 3; k > 0; k--) {
+                log.service();
+            }
+        }
+        // an export closes the block; a power loss loses the unfinished word
+        flushed[s] = (s == sessions) || rng() % 2;
+        if (flushed[s]) {
+            log.flush();
+        } else {
+            while (log.service() != MICROBIT_RIDE_LOG_IDLE) {
+            }
+        }
+        if (s == sessions) {
+            std::vector<uint8_t> wire;
+            size_t bytes = 0;
+            uint32_t after = 0;
+            uint32_t sequence;
+            const uint8_t *block;
+            while ((block = log.getBlock(after, &sequence)) != NULL) {
+                int len = MicroBitRideLog::getBlockLength(block);
+                bytes += len - MICROBIT_RIDE_LOG_HEADER_SIZE;
+                for (int offset = 0; offset <= len; offset += MICROBIT_TELEMETRY_RIDE_LOG_DATA_MAX) {
+                    uint8_t r[MICROBIT_TELEMETRY_RECORD_MAX];
+                    uint8_t f[MICROBIT_TELEMETRY_FRAME_MAX];
+                    int chunk = std::min(len - offset, MICROBIT_TELEMETRY_RIDE_LOG_DATA_MAX);
+                    // the end of the export after the last block
+                    bool end = chunk == 0;
+                    int h = struct_pack(r, MICROBIT_TELEMETRY_FORMAT_RIDE_LOG, MICROBIT_TELEMETRY_RECORD_RIDE_LOG,
+                            0u, end ? 0u : sequence, offset, chunk);
+                    memcpy(&r[h], &block[offset], chunk);
+                    int flen = MicroBitTelemetryFrame::encode(r, h + chunk, f);
+                    if (!end) {
+                        wire.insert(wire.end(), f, f + flen);
+                    }
+                }
+                after = sequence;
+            }
+            uint8_t r[MICROBIT_TELEMETRY_RECORD_MAX];
+            uint8_t f[MICROBIT_TELEMETRY_FRAME_MAX];
+            int flen = MicroBitTelemetryFrame::encode(r, struct_pack(r, MICROBIT_TELEMETRY_FORMAT_RIDE_LOG,
+                    MICROBIT_TELEMETRY_RECORD_RIDE_LOG, 0u, 0u, 0, 0), f);
+            wire.insert(wire.end(), f, f + flen);
+
+            Decoder decoder(NULL);
+            decoder.keep = true;
+            decoder.feed(&wire[0], wire.size());
+
+            // per session: a run of the truth with its pulse counts, complete at the end when flushed
+            std::map<uint16_t, std::vector<uint32_t> > decoded;
+            std::map<uint16_t, std::vector<uint8_t> > decodedPulses;
+            for (size_t i = 0; i < decoder.edges.size(); i++) {
+                decoded[decoder.edges[i].session].push_back(decoder.edges[i].ticks);
+                decodedPulses[decoder.edges[i].session].push_back(decoder.edges[i].pulses);
+            }
+            bool oldest = true;
+            for (std::map<uint16_t, std::vector<uint32_t> >::iterator it = decoded.begin(); it != decoded.end(); ++it) {
+                const std::vector<uint32_t> &d = it->second;
+                const std::vector<uint32_t> &e = truth[it->first];
+                size_t start = std::find(e.begin(), e.end(), d[0]) - e.begin();
+                const std::vector<uint8_t> &p = decodedPulses[it->first];
+                bool run = start + d.size() <= e.size() && std::equal(d.begin(), d.end(), e.begin() + start)
+                        && std::equal(p.begin(), p.end(), truthPulses[it->first].begin() + start);
+                size_t lost = run ? e.size() - start - d.size() : 0;
+                if (!run || (!oldest && start != 0) || (flushed[it->first] ? lost != 0 : lost > 3)) {
+                    fprintf(stderr, "selftest: ride log session %u: %zu edges (and pulse counts) from %zu of %zu, lost %zu\n",
+                            it->first, d.size(), start, e.size(), lost);
+                    failures++;
+                }
+                oldest = false;
+            }
+            if (decoded.size() < 2 || log.getEraseCount() == 0 || decoder.stats.malformed != 0) {
+                fprintf(stderr, "selftest: ride log decoded %zu sessions\n", decoded.size());
+                failures++;
+            }
+            printf("selftest: ride log %lu blocks, %lu edges, %.2f bytes per edge\n",
+                    decoder.stats.rideBlocks, decoder.stats.rideEdges, (double)bytes / decoder.stats.rideEdges);
+        }
+    }
+    return failures;
+}
+
+// Records through the firmware ring buffer, drained in random chunks like the ASYNC
+// serial writes, then decoded; then again with bytes lost on the wire.
+int selftest()
+{
+    std::mt19937 rng(7);
+    MicroBitTelemetryRing ring;
+    std::vector<uint8_t> wire;
+    std::vector<std::string> expected;
+    int failures = 0;
+
+    for (uint32_t i = 0; i < 5000; i++) {
+        uint8_t r[MICROBIT_TELEMETRY_RECORD_MAX];
+        uint8_t f[MICROBIT_TELEMETRY_FRAME_MAX];
+        char line[256];
+        int len;
+        uint32_t time = 0xFFFF0000u + i * 977;     // wraps around during the test
+        double s = (double)(((uint64_t)(time < 0xFFFF0000u) << 32) + time) / 1e6;
+
+        switch (i % 4) {
+        case 0:
+            len = struct_pack(r, MICROBIT_TELEMETRY_FORMAT_STEP_EDGE, MICROBIT_TELEMETRY_RECORD_STEP_EDGE, time, i);
+            snprintf(line, sizeof(line), "%.6f STEP revolutions=%u", s, i);
+            break;
+        case 1:
+            // zeros everywhere, for COBS
+            len = struct_pack(r, MICROBIT_TELEMETRY_FORMAT_SAMPLE, MICROBIT_TELEMETRY_RECORD_SAMPLE, time, 0u, 0, i & 0xFF, -(int)(i & 0xFF), 0);
+            snprintf(line, sizeof(line), "%.6f SAMPLE interval_us=0 speed_kmh=0.00 cadence_rpm=%.1f power_w=%d resistance=0.0",
+                    s, (i & 0xFF) / 2.0, -(int)(i & 0xFF));
+            break;
+        case 2:
+            len = struct_pack(r, MICROBIT_TELEMETRY_FORMAT_PIPELINE, MICROBIT_TELEMETRY_RECORD_PIPELINE, time, 0x400 + (i & 0xF), (int)i - 2500);
+            snprintf(line, sizeof(line), "%.6f PIPELINE id=%u value=%d", s, 0x400 + (i & 0xF), (int)i - 2500);
+            break;
+        default: {
+            uint8_t n = (uint8_t)(i % (MICROBIT_TELEMETRY_CONTROL_POINT_DATA_MAX + 1));
+            len = struct_pack(r, MICROBIT_TELEMETRY_FORMAT_CONTROL_POINT, MICROBIT_TELEMETRY_RECORD_CONTROL_POINT, time, 0, 0x01, n);
+            std::string data;
+            for (int j = 0; j < n; j++) {
+                char hex[8];
+                r[len + j] = (uint8_t)(j * 37);
+                snprintf(hex, sizeof(hex), "%s%02X", j ? " " : "", r[len + j]);
+                data += hex;
+            }
+            snprintf(line, sizeof(line), "%.6f CP conn=0 op=0x%02X result=0x01 data=[%s]", s, n ? r[len] : 0, data.c_str());
+            len += n;
+            break;
+        }
+        }
+        int flen = MicroBitTelemetryFrame::encode(r, len, f);
+        if (flen > MICROBIT_TELEMETRY_FRAME_MAX || memchr(f, 0, flen - 1) != NULL || f[flen - 1] != 0) {
+            fprintf(stderr, "selftest: bad frame %u\n", i);
+            failures++;
+        }
+        while (!ring.write(f, flen)) {
+            const uint8_t *p;
+            int n = ring.peek(&p);
+            int chunk = 1 + (int)(rng() % (unsigned)n);
+            wire.insert(wire.end(), p, p + chunk);
+            ring.consume(chunk);
+        }
+        expected.push_back(line);
+    }
+    const uint8_t *p;
+    int n;
+    while ((n = ring.peek(&p)) > 0) {
+        wire.insert(wire.end(), p, p + n);
+        ring.consume(n);
+    }
+
+    Decoder clean(NULL);
+    clean.keep = true;
+    clean.feed(&wire[0], wire.size());
+    if (clean.lines != expected || clean.stats.malformed != 0) {
+        fprintf(stderr, "selftest: clean stream decoded %zu of %zu records, %lu malformed\n",
+                clean.lines.size(), expected.size(), clean.stats.malformed);
+        failures++;
+    }
+
+    // lose bytes: every damaged frame is dropped, the others still decode
+    std::vector<uint8_t> lossy;
+    for (size_t i = 0; i < wire.size(); i++) {
+        if (rng() % 500 != 0) {
+            lossy.push_back(wire[i]);
+        }
+    }
+    Decoder damaged(NULL);
+    damaged.keep = true;
+    damaged.feed(&lossy[0], lossy.size());
+    size_t matched = 0;
+    for (size_t i = 0, j = 0; i < damaged.lines.size(); i++) {
+        // a record that is not expected at all leaves the search where it was
+        size_t k = j;
+        while (k < expected.size() && expected[k] != damaged.lines[i]) {
+            k++;
+        }
+        if (k < expected.size()) {
+            matched++;
+            j = k + 1;
+        }
+    }
+    // a damaged frame can still decode to a record of the right length, rarely
+    if (damaged.lines.size() < expected.size() * 9 / 10 || matched < damaged.lines.size() * 99 / 100) {
+        fprintf(stderr, "selftest: lossy stream decoded %zu records, %zu intact\n", damaged.lines.size(), matched);
+        failures++;
+    }
+
+    printf("selftest: %zu records, %zu wire bytes, lossy: %zu decoded, %lu malformed\n",
+            expected.size(), wire.size(), damaged.lines.size(), damaged.stats.malformed);
+
+    failures += selftestRideLog(rng);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && strcmp(argv[1], "--selftest") == 0) {
+        return selftest();
+    }
+
+    int fd = open_input(argc > 1 ? argv[1] : "-");
+    if (fd < 0) {
+        return EXIT_FAILURE;
+    }
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    Decoder decoder(stdout);
+    uint8_t buf[4096];
+    for (;;) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        decoder.feed(buf, (size_t)n);
+    }
+    // an export cut short
+    decoder.rideLog();
+
+    fprintf(stderr, "telemetry_decode: %lu records, %lu malformed, %lu unknown, %lu dropped on the device, %lu ride log edges\n",
+            decoder.stats.frames, decoder.stats.malformed, decoder.stats.unknown, decoder.stats.dropped, decoder.stats.rideEdges);
+    return EXIT_SUCCESS;
+}